@@ -56,7 +56,12 @@ Classifier::Classifier(const string& model_file,
 #endif
 
   /* Load the network. */
-  net_.reset(new Net<float>(model_file, TEST));
+  NetParameter net_param;
+  ReadNetParamsFromTextFileOrDie(model_file, &net_param);
+  net_param.mutable_state()->set_phase(TEST);
+  /* Skip the fillers of the weights loaded right after. */
+  net_param.set_defer_fill(true);
+  net_.reset(new Net<float>(net_param));
   net_->CopyTrainedLayersFrom(trained_file);
 
   CHECK_EQ(net_->num_inputs(), 1) << "Network should have exactly one input.";
@@ -8,6 +8,7 @@
 #include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/syncedmem.hpp"
+#include "caffe/util/row_set.hpp"
 
 const int kMaxBlobAxes = 32;
 
@@ -24,7 +25,8 @@ template <typename Dtype>
 class Blob {
  public:
   Blob()
-       : data_(), diff_(), count_(0), capacity_(0) {}
+       : data_(), diff_(), count_(0), capacity_(0), diff_disabled_(false),
+         storage_precision_(NATIVE), channel_block_(0) {}
 
   /// @brief Deprecated; use <code>Blob(const vector<int>& shape)</code>.
   explicit Blob(const int num, const int channels, const int height,
@@ -212,7 +214,7 @@ class Blob {
   }
 
   inline const shared_ptr<SyncedMemory>& diff() const {
-    CHECK(diff_);
+    CHECK(diff_) << "Blob has no diff";
     return diff_;
   }
 
@@ -262,6 +264,94 @@ class Blob {
    * shared_ptr calls its destructor when reset with the "=" operator.
    */
   void ShareDiff(const Blob& other);
+  /**
+   * @brief Set the data_ shared_ptr to point to an externally managed
+   *        SyncedMemory, which must be large enough to hold this Blob --
+   *        used by Net to alias blobs whose lifetimes do not overlap.
+   *
+   * The capacity is clipped to the size of the shared memory, so a later
+   * Reshape beyond it reallocates rather than overflowing the shared buffer.
+   */
+  void ShareDataMemory(const shared_ptr<SyncedMemory>& data);
+  /**
+   * @brief Release the diff_ and never allocate it again -- used by Net for
+   *        the blobs of forward-only nets, which are never backpropagated.
+   *
+   * Any later access to the diff fails, except for asum_diff and sumsq_diff
+   * which return 0. ShareDiff from a blob whose diff is disabled leaves the
+   * diff of a blob which has one alone.
+   */
+  void DisableDiff();
+  inline bool diff_disabled() const { return diff_disabled_; }
+  /**
+   * @brief Track the rows (the indices along the first axis) of the diff
+   *        that are written, in diff_rows -- used by Net for the parameters
+   *        which the solver updates lazily (see SolverParameter.lazy_update).
+   *
+   * ShareDiff shares the tracked rows along with the diff, and Update on the
+   * CPU updates those rows only.
+   */
+  void TrackDiffRows();
+  /// @brief The rows of the diff written since they were last cleared, or
+  ///        NULL if they are not tracked.
+  inline RowSet* diff_rows() const { return diff_rows_.get(); }
+  /// @brief Mark a row of the diff as written, if the rows are tracked.
+  inline void mark_diff_row(const int row) {
+    if (diff_rows_) { diff_rows_->insert(row); }
+  }
+  /**
+   * @brief Store the data in a lower precision (FP16, BF16 or INT8),
+   *        releasing the Dtype data, or return it to NATIVE storage -- used
+   *        by Net for the parameters given in NetParameter.param_storage, and
+   *        by the INT8 engines for their weights.
+   *
+   * The Dtype data is unpacked again on the first access through cpu_data()
+   * and the like, and writing to it returns the blob to NATIVE storage.
+   * Layers computing from packed data read it with unpacked_cpu_data, or
+   * packed_cpu_data itself.
+   */
+  void Pack(const StoragePrecision precision);
+  inline StoragePrecision storage_precision() const {
+    return storage_precision_;
+  }
+  /// @brief Returns the packed data: uint16_t for FP16 and BF16, int8_t for
+  ///        INT8.
+  const void* packed_cpu_data() const;
+  /// @brief Returns the scales of the slices of INT8 packed data.
+  const float* packed_cpu_scales() const;
+  /**
+   * @brief Returns the data in Dtype; packed data which was not unpacked yet
+   *        is unpacked into buffer, of at least count() Dtype%s, rather than
+   *        into the blob itself.
+   */
+  const Dtype* unpacked_cpu_data(SyncedMemory* buffer) const;
+  /// @brief Returns whether the data is only held packed, so that reading it
+  ///        through cpu_data() would unpack it into the blob for good.
+  bool data_packed() const;
+  /**
+   * @brief Unpacks the count Dtype%s of the data from offset into data, as
+   *        unpacked_cpu_data does for the whole of it -- used by the layers
+   *        converting packed weights a panel at a time. The range must cover
+   *        whole slices along the first axis for INT8.
+   */
+  void UnpackTo(const int offset, const int count, Dtype* data) const;
+  /**
+   * @brief The number of channels interleaved by the blocked layout of the
+   *        data, NCHW[block]c (see nchwc.hpp), or 0 for NCHW.
+   *
+   * This is metadata which only Net and the layers supporting the blocked
+   * layout (see Layer::SupportsChannelBlock) interpret; the shape stays
+   * (num, channels, height, width) either way.
+   */
+  inline int channel_block() const { return channel_block_; }
+  inline void set_channel_block(const int block) { channel_block_ = block; }
+  /**
+   * @brief Reorder the data of a 4D blob into the layout of the given
+   *        channel block, or NCHW for 0. The data is reordered in place,
+   *        keeping its memory, so the blobs sharing it must be given the new
+   *        channel block too (see Net::ReorderChannelBlock).
+   */
+  void ReorderChannelBlock(const int block);
 
   bool ShapeEquals(const BlobProto& other);
 
@@ -272,6 +362,23 @@ class Blob {
   vector<int> shape_;
   int count_;
   int capacity_;
+  bool diff_disabled_;
+  /// The rows of the diff tracked by TrackDiffRows, or NULL
+  shared_ptr<RowSet> diff_rows_;
+  /// The data packed by Pack, or NULL in NATIVE storage
+  shared_ptr<SyncedMemory> packed_data_;
+  /// The scale of each slice along the first axis of INT8 packed data
+  shared_ptr<SyncedMemory> packed_scales_;
+  StoragePrecision storage_precision_;
+  int channel_block_;
+
+ private:
+  /// Unpacks packed data into data_ unless done already.
+  void UnpackData() const;
+  /// Unpacks the data and drops the packed data, as data_ is written to.
+  void Unpack();
+  /// Unpacks the packed data into data.
+  void UnpackTo(Dtype* data) const;
 
   DISABLE_COPY_AND_ASSIGN(Blob);
 };  // class Blob
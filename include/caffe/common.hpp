@@ -158,6 +158,22 @@ class Caffe {
   inline static void set_solver_count(int val) { Get().solver_count_ = val; }
   inline static bool root_solver() { return Get().root_solver_; }
   inline static void set_root_solver(bool val) { Get().root_solver_ = val; }
+  // Host memory layout: the alignment in bytes of the host buffers allocated
+  // by SyncedMemory (a power of two, 64 by default to suit SIMD loads), and
+  // whether buffers of at least kHugePageSize bytes are aligned to a huge
+  // page and advised to be backed by transparent huge pages (off by default).
+  inline static size_t host_alignment() { return Get().host_alignment_; }
+  static void set_host_alignment(size_t alignment);
+  inline static bool host_huge_pages() { return Get().host_huge_pages_; }
+  inline static void set_host_huge_pages(bool val) {
+    Get().host_huge_pages_ = val;
+  }
+  // The number of threads of the CPU: those over which parallel_for splits
+  // the loops of the layers, and those of the BLAS library, which never run
+  // at the same time. By default all the cores, or OMP_NUM_THREADS.
+  inline static int num_threads() { return Get().num_threads_; }
+  // Sets the number of threads, of all the cores for 0.
+  static void set_num_threads(int threads);
 
  protected:
 #ifndef CPU_ONLY
@@ -169,6 +185,9 @@ class Caffe {
   Brew mode_;
   int solver_count_;
   bool root_solver_;
+  size_t host_alignment_;
+  bool host_huge_pages_;
+  int num_threads_;
 
  private:
   // The private constructor to avoid duplicate instantiation.
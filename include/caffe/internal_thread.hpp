@@ -43,7 +43,8 @@ class InternalThread {
 
  private:
   void entry(int device, Caffe::Brew mode, int rand_seed, int solver_count,
-      bool root_solver);
+      bool root_solver, size_t host_alignment, bool host_huge_pages,
+      int num_threads);
 
   shared_ptr<boost::thread> thread_;
 };
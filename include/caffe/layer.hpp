@@ -2,6 +2,7 @@
 #define CAFFE_LAYER_H_
 
 #include <algorithm>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -38,7 +39,7 @@ class Layer {
    * layer.
    */
   explicit Layer(const LayerParameter& param)
-    : layer_param_(param), is_shared_(false) {
+    : layer_param_(param), defer_fill_(false), is_shared_(false) {
       // Set phase and copy blobs (if there are any).
       phase_ = param.phase();
       if (layer_param_.blobs_size() > 0) {
@@ -183,6 +184,30 @@ class Layer {
     return blobs_;
   }
 
+  /**
+   * @brief Sets whether the fillers of the learnable parameters are deferred
+   *        rather than run by LayerSetUp (see NetParameter.defer_fill).
+   */
+  inline void set_defer_fill(bool defer_fill) { defer_fill_ = defer_fill; }
+  /**
+   * @brief Returns whether the filler of a parameter has been deferred and
+   *        is yet to be run.
+   */
+  inline bool fill_deferred(const int param_id) const {
+    return deferred_fillers_.count(param_id) > 0;
+  }
+  /**
+   * @brief Drops the deferred filler of a parameter, e.g., as its values were
+   *        loaded or it shares those of another blob.
+   */
+  inline void CancelDeferredFill(const int param_id) {
+    deferred_fillers_.erase(param_id);
+  }
+  /**
+   * @brief Runs the deferred fillers of the parameters.
+   */
+  void FillDeferredParams();
+
   /**
    * @brief Returns the layer parameter.
    */
@@ -294,6 +319,60 @@ class Layer {
     return true;
   }
 
+  /**
+   * @brief Return whether the top blob at the given index is pointed at the
+   *        data of the first bottom blob during Forward (see Blob::ShareData).
+   *
+   * Layers sharing data in Reshape need not override this, as the sharing is
+   * visible once the net is set up. Net::PlanMemory keeps such a bottom
+   * alive for as long as the top is in use.
+   */
+  virtual inline bool SharesBottomData(const int top_index) const {
+    return false;
+  }
+
+  /**
+   * @brief Return whether Forward points the top blob at the given index at
+   *        memory of its own with Blob::set_cpu_data or set_gpu_data.
+   *
+   * Net::PlanMemory leaves such a top out of its shared regions, which
+   * set_cpu_data would otherwise point at the layer's memory for the other
+   * blobs of the region too.
+   */
+  virtual inline bool SetsTopData(const int top_index) const {
+    return false;
+  }
+
+  /**
+   * @brief Return whether Forward_cpu reads the parameter at the given index
+   *        with Blob::unpacked_cpu_data, so that it may be packed (see
+   *        NetParameter.param_storage) without being unpacked for good.
+   */
+  virtual inline bool ReadsPackedParam(const int param_id) const {
+    return false;
+  }
+
+  /**
+   * @brief Return whether Backward_cpu writes only some rows (the indices
+   *        along the first axis) of the diff of the parameter at the given
+   *        index, marking each with Blob::mark_diff_row, so that the solver
+   *        may update only those (see SolverParameter.lazy_update).
+   */
+  virtual inline bool RowSparseParamDiff(const int param_id) const {
+    return false;
+  }
+
+  /**
+   * @brief Return whether Forward_cpu computes from bottoms in the blocked
+   *        layout NCHW[block]c (see Blob::channel_block), producing its tops
+   *        in the same layout. Net only asks if every bottom is 4D with
+   *        channels divisible by block (see NetParameter.channel_block).
+   */
+  virtual inline bool SupportsChannelBlock(
+      const vector<Blob<Dtype>*>& bottom, const int block) const {
+    return false;
+  }
+
   /**
    * @brief Specifies whether the layer should compute gradients w.r.t. a
    *        parameter at a particular index given by param_id.
@@ -330,6 +409,17 @@ class Layer {
   /** The vector that indicates whether each top blob has a non-zero weight in
    *  the objective function. */
   vector<Dtype> loss_;
+  /** Whether FillParam defers the fillers. */
+  bool defer_fill_;
+  /** The deferred fillers, by param index. */
+  std::map<int, FillerParameter> deferred_fillers_;
+
+  /**
+   * Called by LayerSetUp to fill the parameter blobs_[param_id] as given by
+   * filler_param, or to keep filler_param for FillDeferredParams if filling
+   * is deferred.
+   */
+  void FillParam(const int param_id, const FillerParameter& filler_param);
 
   /** @brief Using the CPU device, compute the layer output. */
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
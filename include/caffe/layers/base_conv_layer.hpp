@@ -7,6 +7,8 @@
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/im2col.hpp"
+#include "caffe/util/packed_weights.hpp"
+#include "caffe/util/sparse.hpp"
 
 namespace caffe {
 
@@ -27,11 +29,24 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   virtual inline int MinBottomBlobs() const { return 1; }
   virtual inline int MinTopBlobs() const { return 1; }
   virtual inline bool EqualNumBottomTopBlobs() const { return true; }
+  virtual inline bool ReadsPackedParam(const int param_id) const {
+    return param_id == 0;
+  }
+  // 2D convolution without groups computes NCHW[block]c outputs directly
+  // from NCHW[block]c inputs (see forward_cpu_nchwc), for blocks of 16 only:
+  // smaller blocks fill too little of a vector to beat im2col and GEMM.
+  virtual inline bool SupportsChannelBlock(
+      const vector<Blob<Dtype>*>& bottom, const int block) const {
+    return !force_nd_im2col_ && num_spatial_axes_ == 2 && channel_axis_ == 1
+        && group_ == 1 && block == 16 && num_output_ % block == 0;
+  }
 
  protected:
   // Helper functions that abstract away the column buffer and gemm arguments.
   // The last argument in forward_cpu_gemm is so that we can skip the im2col if
-  // we just called weight_cpu_gemm with the same input.
+  // we just called weight_cpu_gemm with the same input. The weights of the
+  // forward helpers may be NULL for the packed weights of the layer, as
+  // forward_cpu_weights returns them.
   void forward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output, bool skip_im2col = false);
   void forward_cpu_bias(Dtype* output, const Dtype* bias);
@@ -40,6 +55,67 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype*
       weights);
   void backward_cpu_bias(Dtype* bias, const Dtype* input);
+  // Batched counterparts of forward_cpu_gemm and weight_cpu_gemm for batch
+  // consecutive images (at most im2col_batch_), which are lowered into one
+  // column buffer for a single GEMM per group.
+  void forward_cpu_gemm_batch(const Dtype* input, const Dtype* weights,
+      Dtype* output, const int batch);
+  void weight_cpu_gemm_batch(const Dtype* input, const Dtype* output,
+      Dtype* weights, const int batch);
+  // Compute the convolution of the whole batch, its gradient w.r.t. the
+  // input, or accumulate that w.r.t. the weights, by algorithm_.
+  void forward_cpu_conv(const Dtype* input, const Dtype* weights,
+      Dtype* output);
+  void backward_cpu_conv(const Dtype* output, const Dtype* weights,
+      Dtype* input);
+  void weight_cpu_conv(const Dtype* input, const Dtype* output,
+      Dtype* weights);
+  // Winograd counterparts of forward_cpu_gemm, backward_cpu_gemm and
+  // weight_cpu_gemm for the whole batch, when winograd_tile_ is nonzero.
+  void forward_cpu_winograd(const Dtype* input, const Dtype* weights,
+      Dtype* output);
+  void backward_cpu_winograd(const Dtype* output, const Dtype* weights,
+      Dtype* input);
+  void weight_cpu_winograd(const Dtype* input, const Dtype* output,
+      Dtype* weights);
+  // Direct counterparts of forward_cpu_gemm, backward_cpu_gemm and
+  // weight_cpu_gemm for the whole batch, when algorithm_ is DIRECT.
+  void forward_cpu_direct(const Dtype* input, const Dtype* weights,
+      Dtype* output);
+  void backward_cpu_direct(const Dtype* output, const Dtype* weights,
+      Dtype* input);
+  void weight_cpu_direct(const Dtype* input, const Dtype* output,
+      Dtype* weights);
+  // FFT counterparts of forward_cpu_gemm, backward_cpu_gemm and
+  // weight_cpu_gemm for the whole batch, when algorithm_ is FFT.
+  void forward_cpu_fft(const Dtype* input, const Dtype* weights,
+      Dtype* output);
+  void backward_cpu_fft(const Dtype* output, const Dtype* weights,
+      Dtype* input);
+  void weight_cpu_fft(const Dtype* input, const Dtype* output,
+      Dtype* weights);
+  // The counterpart of forward_cpu_conv and forward_cpu_bias for inputs and
+  // outputs in NCHW[block]c, which convolves the whole batch directly with
+  // the weights of the layer reordered by conv_weights_to_nchwc_cpu; bias
+  // may be NULL.
+  void forward_cpu_nchwc(const Dtype* input, const Dtype* bias,
+      Dtype* output, const int block);
+  // The weights of the layer for forward_cpu_conv: NULL if they are packed
+  // (see Blob::Pack), for the algorithms to unpack them as they read them:
+  // GEMM a panel at a time, Winograd and FFT only while transforming them
+  // again once they change, DIRECT into a buffer for the pass.
+  const Dtype* forward_cpu_weights();
+  // Compress the weights into sparse_weights_ if enough of them are zero, by
+  // sparse_weight_threshold, for forward_cpu_conv to multiply them without
+  // their zeros, by GEMM whatever algorithm_; returns whether it will.
+  bool update_sparse_weights();
+  // The INT8 engine's counterpart of forward_cpu_gemm: the input quantized to
+  // int8 is lowered into col_buff and multiplied by the int8 weights with
+  // int32 accumulation into accum (top_dim_ values), which is scaled back to
+  // Dtype by the output_scales of the output channels.
+  void forward_cpu_gemm_int8(const int8_t* input, const int8_t* weights,
+      const Dtype* output_scales, Dtype* output, int8_t* col_buff,
+      int32_t* accum);
 
 #ifndef CPU_ONLY
   void forward_gpu_gemm(const Dtype* col_input, const Dtype* weights,
@@ -92,10 +168,24 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool bias_term_;
   bool is_1x1_;
   bool force_nd_im2col_;
+  /// @brief The number of images lowered together by the batched helpers.
+  int im2col_batch_;
+  /// @brief The algorithm of the CPU implementation, never AUTO or AUTOTUNE.
+  ConvolutionParameter_Algorithm algorithm_;
+  /// @brief The output tile size of the Winograd algorithm, or 0.
+  int winograd_tile_;
+  /// @brief The weights in compressed sparse row form, one row per output.
+  SparseWeights<Dtype> sparse_weights_;
+  /// @brief Whether forward_cpu_gemm multiplies sparse_weights_ rather than
+  ///        its weights, as set by update_sparse_weights.
+  bool use_sparse_weights_;
+  /// @brief The weights unpacked from their storage precision.
+  PackedWeights<Dtype> packed_weights_;
 
  private:
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
-  inline void conv_im2col_cpu(const Dtype* data, Dtype* col_buff) {
+  template <typename T>
+  inline void conv_im2col_cpu(const T* data, T* col_buff) {
     if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
       im2col_cpu(data, conv_in_channels_,
           conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
@@ -123,6 +213,38 @@ class BaseConvolutionLayer : public Layer<Dtype> {
           pad_.cpu_data(), stride_.cpu_data(), dilation_.cpu_data(), data);
     }
   }
+  // Lower batch images into batch_col_buffer_, as kernel_dim_ * group_ rows
+  // of the columns of every image side by side.
+  void conv_im2col_batch_cpu(const Dtype* data, const int batch);
+  // Multiply the weights of group g by its spatial_dim columns of col_buff
+  // into its output channels in output, by GEMM or sparse_weights_.
+  void forward_cpu_gemm_group(const int g, const Dtype* weights,
+      const Dtype* col_buff, const int spatial_dim, Dtype* output);
+  // Move the outputs of batch images from output, in the layout of the top,
+  // to batch_output_buffer_, in the layout of the batched GEMM, or back.
+  void gather_output_batch_cpu(const Dtype* output, const int batch);
+  void scatter_output_batch_cpu(Dtype* output, const int batch);
+  // Whether the algorithm can compute this convolution.
+  bool algorithm_applies(const ConvolutionParameter_Algorithm algorithm);
+  // Select the algorithm and shape its buffers, once Reshape has set the
+  // output shape.
+  void set_algorithm(const ConvolutionParameter_Algorithm algorithm);
+  // Select the fastest algorithm for the current shape from the
+  // ConvAutotuneCache, or else by timing the candidates on scratch blobs.
+  void autotune_algorithm();
+  // Whether the FFT algorithm applies and is estimated to take less than
+  // 1 / margin of the arithmetic of GEMM, with the spectra of the weights
+  // within col_buffer_limit.
+  bool fft_preferred(const double margin);
+  // Transform the weights, NULL for the packed weights of the layer, into
+  // fft_weight_buffer_, unless it holds the spectra of the same weights,
+  // unchanged, already.
+  void fft_transform_weights(const Dtype* weights);
+  // Likewise into winograd_weight_buffer_.
+  void winograd_transform_weights(const Dtype* weights);
+  // Whether weights are those of the layer, as forward_cpu_weights reads
+  // them, whose transforms may be cached by the version of their memory.
+  bool own_weights(const Dtype* weights);
 #ifndef CPU_ONLY
   inline void conv_im2col_gpu(const Dtype* data, Dtype* col_buff) {
     if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
@@ -166,6 +288,42 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   int output_offset_;
 
   Blob<Dtype> col_buffer_;
+  Blob<Dtype> batch_col_buffer_;
+  Blob<Dtype> batch_output_buffer_;
+  // The Winograd transforms of the input and output tiles of an image, and
+  // of the weights, with that of their gradient in the diff; NULL unless
+  // algorithm_ is Winograd.
+  int winograd_tiles_h_;
+  int winograd_tiles_w_;
+  shared_ptr<Blob<Dtype> > winograd_input_buffer_;
+  shared_ptr<Blob<Dtype> > winograd_output_buffer_;
+  shared_ptr<Blob<Dtype> > winograd_weight_buffer_;
+  // The memory of the weights whose transform winograd_weight_buffer_
+  // holds, and its version then, as for the FFT below.
+  shared_ptr<SyncedMemory> winograd_weights_memory_;
+  int winograd_weights_version_;
+  // The FFT size, and the spectra of the channels of an image, of its
+  // outputs, and of the weights, with that of their gradient in the diff;
+  // NULL unless algorithm_ is FFT.
+  int fft_h_;
+  int fft_w_;
+  shared_ptr<Blob<Dtype> > fft_input_buffer_;
+  shared_ptr<Blob<Dtype> > fft_output_buffer_;
+  shared_ptr<Blob<Dtype> > fft_weight_buffer_;
+  // The memory of the weights whose spectra fft_weight_buffer_ holds, and
+  // its version then; the spectra are only cached for the layer's own
+  // weights, and transformed again once they change.
+  shared_ptr<SyncedMemory> fft_weights_memory_;
+  int fft_weights_version_;
+  // The weights reordered by forward_cpu_nchwc, for the channel block
+  // nchwc_weights_block_, and the memory and version of the weights then,
+  // as for the FFT above.
+  Blob<Dtype> nchwc_weight_buffer_;
+  shared_ptr<SyncedMemory> nchwc_weights_memory_;
+  int nchwc_weights_version_;
+  int nchwc_weights_block_;
+  // The bottom shape for which AUTOTUNE last selected algorithm_.
+  vector<int> autotuned_shape_;
   Blob<Dtype> bias_multiplier_;
 };
 
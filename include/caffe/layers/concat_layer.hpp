@@ -26,6 +26,12 @@ class ConcatLayer : public Layer<Dtype> {
   virtual inline const char* type() const { return "Concat"; }
   virtual inline int MinBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
+  // The blocks of the channels of an image are contiguous in NCHW[block]c
+  // as the channels are in NCHW.
+  virtual inline bool SupportsChannelBlock(
+      const vector<Blob<Dtype>*>& bottom, const int block) const {
+    return concat_axis_ == 1;
+  }
 
  protected:
   /**
@@ -29,6 +29,10 @@ class EmbedLayer : public Layer<Dtype> {
   virtual inline const char* type() const { return "Embed"; }
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
+  /// Backward_cpu writes the rows of the weights of the inputs only.
+  virtual inline bool RowSparseParamDiff(const int param_id) const {
+    return param_id == 0;
+  }
 
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
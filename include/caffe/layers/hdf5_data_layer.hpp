@@ -17,6 +17,13 @@ namespace caffe {
 /**
  * @brief Provides data to the Net from HDF5 files.
  *
+ * The tops "<name>/data", "<name>/indices" and "<name>/indptr" are the
+ * values, columns and row offsets of the nonzeros of the sparse matrix
+ * <name>, in compressed sparse row (CSR) form as scipy.sparse.csr_matrix
+ * holds them, batched by rows as the other tops: a batch has the offsets of
+ * its rows, from 0, and their nonzeros only (see InnerProductLayer). The
+ * offsets and columns of a batch must be exact in Dtype, below 2^24 for float.
+ *
  * TODO(dox): thorough documentation for Forward and proto params.
  */
 template <typename Dtype>
@@ -55,6 +62,18 @@ class HDF5DataLayer : public Layer<Dtype> {
   std::vector<shared_ptr<Blob<Dtype> > > hdf_blobs_;
   std::vector<unsigned int> data_permutation_;
   std::vector<unsigned int> file_permutation_;
+  /// For the row offsets top of a sparse matrix, the tops of its values and
+  /// columns, and -1 for the other tops.
+  std::vector<int> csr_values_top_;
+  std::vector<int> csr_columns_top_;
+  /// For the values and columns tops of a sparse matrix, its row offsets
+  /// top, and -1 for the other tops.
+  std::vector<int> csr_offsets_top_;
+  /// The row offsets and columns of the sparse matrices, read as integers
+  /// as they may not be exact in Dtype; their hdf_blobs_ only keep the shape.
+  std::vector<shared_ptr<Blob<int> > > hdf_index_blobs_;
+  /// The batch of the tops of the sparse matrices, gathered row by row.
+  std::vector<std::vector<Dtype> > csr_batch_;
 };
 
 }  // namespace caffe
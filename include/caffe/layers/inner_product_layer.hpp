@@ -6,6 +6,8 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/packed_weights.hpp"
+#include "caffe/util/sparse.hpp"
 
 namespace caffe {
 
@@ -13,6 +15,14 @@ namespace caffe {
  * @brief Also known as a "fully-connected" layer, computes an inner product
  *        with a set of learned weights, and (optionally) adds biases.
  *
+ * The input may also be a sparse matrix of inner_product_param.input_dim
+ * columns in compressed sparse row (CSR) form, in three bottoms, as
+ * HDF5DataLayer produces them: the values of its nonzeros, their columns,
+ * and the offsets of the rows in them (one more than the rows); only its
+ * nonzeros are then multiplied, and only their values are backpropagated
+ * to. The weight diff is still the dense num_output x input_dim one, though
+ * only the columns of the nonzeros of the batch are added to.
+ *
  * TODO(dox): thorough documentation for Forward, Backward, and proto params.
  */
 template <typename Dtype>
@@ -26,8 +36,15 @@ class InnerProductLayer : public Layer<Dtype> {
       const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "InnerProduct"; }
-  virtual inline int ExactNumBottomBlobs() const { return 1; }
+  virtual inline int MinBottomBlobs() const { return 1; }
+  virtual inline int MaxBottomBlobs() const { return 3; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
+  virtual inline bool AllowForceBackward(const int bottom_index) const {
+    return bottom_index == 0;
+  }
+  virtual inline bool ReadsPackedParam(const int param_id) const {
+    return param_id == 0;
+  }
 
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -39,11 +56,24 @@ class InnerProductLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
+  /// Reads the row offsets and columns of a sparse input into csr_offsets_
+  /// and csr_columns_.
+  void ReadSparseInput(const vector<Blob<Dtype>*>& bottom);
+
   int M_;
   int K_;
   int N_;
   bool bias_term_;
   Blob<Dtype> bias_multiplier_;
+  // The weights in compressed sparse row form, when enough of them are zero.
+  SparseWeights<Dtype> sparse_weights_;
+  // The weights unpacked from their storage precision, a panel at a time.
+  PackedWeights<Dtype> packed_weights_;
+  /// Whether the input is a sparse matrix (see InnerProductParameter
+  /// input_dim).
+  bool sparse_input_;
+  vector<int> csr_offsets_;
+  vector<int> csr_columns_;
 };
 
 }  // namespace caffe
@@ -0,0 +1,60 @@
+#ifndef CAFFE_INT8_CONV_LAYER_HPP_
+#define CAFFE_INT8_CONV_LAYER_HPP_
+
+#include <stdint.h>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief INT8 implementation of ConvolutionLayer for CPU inference.
+ *        Fallback to ConvolutionLayer for Backward and GPU mode.
+ *
+ * The bottom is quantized to int8 with the range given by
+ * quantization_param (see the calibrate_int8 tool), or with its own largest
+ * absolute value, and the weights with one scale per output channel. The
+ * products are accumulated in int32 and scaled back to Dtype before the bias
+ * is added, so that the next layer quantizes its own bottom again.
+ *
+ * The weights are packed in INT8 (see Blob::Pack) into a copy private to
+ * the layer, again only once they have been written to, e.g. by the solver,
+ * so that the weights the net saves stay in Dtype.
+ */
+template <typename Dtype>
+class Int8ConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit Int8ConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param) {}
+
+  // The weights are packed in INT8 rather than param_storage.
+  virtual inline bool ReadsPackedParam(const int param_id) const {
+    return false;
+  }
+  virtual inline bool SupportsChannelBlock(
+      const vector<Blob<Dtype>*>& bottom, const int block) const {
+    return false;
+  }
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  // The quantized bottom, and the column buffer and accumulators of an
+  // image, kept across Forward.
+  vector<int8_t> quantized_bottom_;
+  vector<int8_t> quantized_col_buffer_;
+  vector<int32_t> accum_;
+  vector<Dtype> output_scales_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INT8_CONV_LAYER_HPP_
@@ -0,0 +1,47 @@
+#ifndef CAFFE_INT8_INNER_PRODUCT_LAYER_HPP_
+#define CAFFE_INT8_INNER_PRODUCT_LAYER_HPP_
+
+#include <stdint.h>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/inner_product_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief INT8 implementation of InnerProductLayer for CPU inference.
+ *        Fallback to InnerProductLayer for Backward and GPU mode.
+ *
+ * The bottom and weights are quantized as by Int8ConvolutionLayer, with one
+ * weight scale per output, and multiplied with int32 accumulation.
+ */
+template <typename Dtype>
+class Int8InnerProductLayer : public InnerProductLayer<Dtype> {
+ public:
+  explicit Int8InnerProductLayer(const LayerParameter& param)
+      : InnerProductLayer<Dtype>(param) {}
+
+  // The weights are packed in INT8 rather than param_storage.
+  virtual inline bool ReadsPackedParam(const int param_id) const {
+    return false;
+  }
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  // The quantized bottom and the accumulators, kept across Forward.
+  vector<int8_t> quantized_bottom_;
+  vector<int32_t> accum_;
+  vector<Dtype> output_scales_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INT8_INNER_PRODUCT_LAYER_HPP_
@@ -9,6 +9,8 @@
 
 namespace caffe {
 
+struct PoolingWindows;
+
 /**
  * @brief Pools the input image by taking the max, average, etc. within regions.
  *
@@ -18,7 +20,7 @@ template <typename Dtype>
 class PoolingLayer : public Layer<Dtype> {
  public:
   explicit PoolingLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), max_window_idx_size_(0) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -33,6 +35,16 @@ class PoolingLayer : public Layer<Dtype> {
     return (this->layer_param_.pooling_param().pool() ==
             PoolingParameter_PoolMethod_MAX) ? 2 : 1;
   }
+  // MAX and AVE pooling, without the mask top, pool NCHW[block]c inputs
+  // along the channels of a block at once.
+  virtual inline bool SupportsChannelBlock(
+      const vector<Blob<Dtype>*>& bottom, const int block) const {
+    const PoolingParameter_PoolMethod pool =
+        this->layer_param_.pooling_param().pool();
+    return this->layer_param_.top_size() < 2 &&
+        (pool == PoolingParameter_PoolMethod_MAX ||
+         pool == PoolingParameter_PoolMethod_AVE);
+  }
 
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -43,6 +55,12 @@ class PoolingLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  // Forward_cpu for a bottom in NCHW[block]c, which leaves the max pooling
+  // mask unset as only TEST phase nets use the blocked layout.
+  void ForwardNCHWc_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  // The geometry of the pooling of a channel, for the CPU.
+  PoolingWindows windows() const;
 
   int kernel_h_, kernel_w_;
   int stride_h_, stride_w_;
@@ -53,6 +71,8 @@ class PoolingLayer : public Layer<Dtype> {
   bool global_pooling_;
   Blob<Dtype> rand_idx_;
   Blob<int> max_idx_;
+  shared_ptr<SyncedMemory> max_window_idx_;
+  size_t max_window_idx_size_;
 };
 
 }  // namespace caffe
@@ -0,0 +1,102 @@
+#ifndef CAFFE_SAMPLED_SOFTMAX_LOSS_LAYER_HPP_
+#define CAFFE_SAMPLED_SOFTMAX_LOSS_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/loss_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Computes the loss of a classification over very many classes, an
+ *        InnerProductLayer followed by a SoftmaxWithLossLayer, from the true
+ *        class of each example and a sample of the others.
+ *
+ * In the TRAIN phase, each batch draws sampled_softmax_param.num_sampled
+ * classes from the sampler, shared by its examples, and only the rows of
+ * the weights of those classes and of the true ones are multiplied; the
+ * logits are corrected by the log of the expected count of their class in
+ * the sample, and the loss is the softmax over the true class and the
+ * sampled ones (sampled softmax), or the logistic regression of the true
+ * class against them (NCE). The cost of a step is that of the sample and not
+ * of the classes, provided the solver updates the weights lazily (see
+ * SolverParameter.lazy_update).
+ *
+ * The weights and the bias are those of the InnerProductLayer of
+ * inner_product_param, N x K with a row per class, so a net trained with
+ * this layer runs with an InnerProductLayer and a SoftmaxLayer in their
+ * place; weights of another shape, e.g. transposed, are rejected. In the
+ * TEST phase, the loss is that of the full softmax, as SoftmaxWithLossLayer.
+ *
+ * @param bottom input Blob vector (length 2)
+ *   -# @f$ (M \times K) @f$, or any shape which inner_product_param.axis
+ *      flattens to it, the features @f$ x @f$
+ *   -# @f$ (M \times 1 \times 1 \times 1) @f$
+ *      the labels @f$ l @f$, in @f$ [0, N - 1] @f$ for N classes
+ * @param top output Blob vector (length 1)
+ *   -# @f$ (1 \times 1 \times 1 \times 1) @f$
+ *      the loss, normalized as loss_param.normalization
+ */
+template <typename Dtype>
+class SampledSoftmaxLossLayer : public LossLayer<Dtype> {
+ public:
+  explicit SampledSoftmaxLossLayer(const LayerParameter& param)
+      : LossLayer<Dtype>(param) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "SampledSoftmaxLoss"; }
+  /// Backward_cpu writes the rows of the sampled and true classes only.
+  virtual inline bool RowSparseParamDiff(const int param_id) const {
+    return true;
+  }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  /// Draws sampled_ and the logs of the expected counts of their classes.
+  void Sample();
+  /// The log of the expected count of class k in the sample.
+  Dtype LogExpectedCount(const int k) const;
+  /// The loss of the full softmax, for the TEST phase.
+  Dtype ForwardFull(const Dtype* bottom_data, const Dtype* label);
+  /// The normalizer of the loss, as SoftmaxWithLossLayer.
+  Dtype get_normalizer(const Dtype valid_count) const;
+
+  int M_;
+  int K_;
+  int N_;
+  int num_sampled_;
+  bool bias_term_;
+  bool has_ignore_label_;
+  int ignore_label_;
+  LossParameter_NormalizationMode normalization_;
+  /// The classes sampled for the batch.
+  vector<int> sampled_;
+  vector<Dtype> sampled_log_count_;
+  vector<double> uniform_;
+  /// The rows of the weights of sampled_, and in the diff their gradient.
+  Blob<Dtype> sampled_weights_;
+  /// The M x num_sampled products of the features with sampled_weights_.
+  Blob<Dtype> sampled_logits_;
+  /// The M x (1 + num_sampled) corrected logits of the true classes and of
+  /// the sampled ones, and in the diff the gradient of the loss (M x N
+  /// logits of the full softmax in the TEST phase).
+  Blob<Dtype> logits_;
+  /// The logs of the normalizers of the softmaxes of logits_.
+  Blob<Dtype> log_norm_;
+  Dtype valid_count_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_SAMPLED_SOFTMAX_LOSS_LAYER_HPP_
@@ -61,8 +61,19 @@ class Net {
   /**
    * @brief Zeroes out the diffs of all net parameters.
    *        Should be run before Backward.
+   *
+   * On the CPU, only the rows written of the diffs whose rows are tracked
+   * (see TrackParamDiffRows) are zeroed, as the others are zero already.
    */
   void ClearParamDiffs();
+  /**
+   * @brief Tracks the rows written of the diffs of the learnable parameters
+   *        whose layers all write only some rows of them (see
+   *        Layer::RowSparseParamDiff and Blob::TrackDiffRows), so that
+   *        ClearParamDiffs and Update work on those rows only on the CPU --
+   *        used by the solvers which update them lazily.
+   */
+  void TrackParamDiffRows();
 
   /**
    * The network backward should take no input and output, since it solely
@@ -82,6 +93,41 @@ class Net {
    */
   void Reshape();
 
+  /**
+   * @brief Alias the data of intermediate blobs whose lifetimes do not
+   *        overlap onto shared SyncedMemory regions.
+   *
+   * Lifetimes are derived from the layer order: a blob is live from the
+   * first layer that touches it to the last layer that reads it. Blobs that
+   * already share data (e.g., through Split, Flatten or Reshape layers) are
+   * planned together. Net inputs and outputs are never aliased. Only valid
+   * for forward-only nets, as Backward needs every forward activation; the
+   * contents of intermediate blobs are undefined after a forward pass.
+   * Called by Init when NetParameter.optimize_memory is set, and again by
+   * Reshape() to follow shape changes.
+   */
+  void PlanMemory();
+  /**
+   * @brief Releases the diffs of the blobs and parameters of a forward-only
+   *        net, but for the blobs of loss layers, and keeps them from being
+   *        allocated again. Called by Init when NetParameter.forward_only is
+   *        set.
+   */
+  void DisableDiffs();
+  /**
+   * @brief Packs the parameters the layers read packed into the precision
+   *        of NetParameter.param_storage, unless they still are. Called by
+   *        Forward, as the parameters may have been written since.
+   */
+  void PackParams();
+  /**
+   * @brief Reorders the bottoms of a layer into the blocked layout of
+   *        NetParameter.channel_block if the layer supports it on the
+   *        current device, or else into NCHW, and returns the channel block
+   *        of its tops. Called by ForwardFromTo for every layer.
+   */
+  int ReorderBottoms(const int layer_id);
+
   Dtype ForwardBackward(const vector<Blob<Dtype>* > & bottom) {
     Dtype loss;
     Forward(bottom, &loss);
@@ -90,6 +136,8 @@ class Net {
   }
 
   /// @brief Updates the network weights based on the diff values computed.
+  ///        Parameters whose diff rows are tracked are updated on those rows
+  ///        only on the CPU.
   void Update();
   /**
    * @brief Shares weight data of owner blobs with shared blobs.
@@ -104,6 +152,14 @@ class Net {
    *        additional memory) the pre-trained layers from another Net.
    */
   void ShareTrainedLayersWith(const Net* other);
+  /**
+   * @brief Runs the fillers deferred by NetParameter.defer_fill for the
+   *        parameters which have been neither loaded nor shared since.
+   *
+   * Called by the first Forward; call it earlier to read or write the
+   * parameters before then (e.g., with ToProto or Solver::Snapshot).
+   */
+  void FillDeferredParams();
   // For an already initialized net, CopyTrainedLayersFrom() copies the already
   // trained layers from another net parameter instance.
   /**
@@ -114,10 +170,26 @@ class Net {
   void CopyTrainedLayersFrom(const string trained_filename);
   void CopyTrainedLayersFromBinaryProto(const string trained_filename);
   void CopyTrainedLayersFromHDF5(const string trained_filename);
+  /**
+   * @brief Loads the pre-trained layers from a flat weight file (see ToFlat)
+   *        without copying them: the file is mapped into memory, and the
+   *        parameter blobs point into the mapping for the lifetime of the net.
+   *
+   * Processes loading the same file share one copy of the weights in the page
+   * cache. Writing to a parameter (e.g., when fine-tuning) copies just the
+   * pages written to, and never modifies the file.
+   */
+  void CopyTrainedLayersFromFlat(const string trained_filename);
   /// @brief Writes the net to a proto.
   void ToProto(NetParameter* param, bool write_diff = false) const;
   /// @brief Writes the net to an HDF5 file.
   void ToHDF5(const string& filename, bool write_diff = false) const;
+  /**
+   * @brief Writes the weights of the net to a flat file, which
+   *        CopyTrainedLayersFrom() maps rather than reads if its name ends in
+   *        ".flat".
+   */
+  void ToFlat(const string& filename) const;
 
   /// @brief returns the network name.
   inline const string& name() const { return name_; }
@@ -216,6 +288,24 @@ class Net {
 
   void set_debug_info(const bool value) { debug_info_ = value; }
 
+  /// @brief returns the number of elements needed for the data of the top
+  ///        blobs
+  inline size_t memory_used() const { return memory_used_; }
+  /// @brief returns the number of elements needed for the diffs of the top
+  ///        blobs, which forward-only nets do without
+  inline size_t diff_memory_used() const { return diff_memory_used_; }
+  /// @brief returns whether the blobs and parameters of the net lack diffs
+  inline bool forward_only() const { return forward_only_; }
+  /// @brief returns the precision in which PackParams stores the parameters
+  inline StoragePrecision param_storage() const { return param_storage_; }
+  /// @brief returns the channel block of the activations, or 0 for NCHW
+  inline int channel_block() const { return channel_block_; }
+  /**
+   * @brief returns the number of elements actually held by the blobs after
+   *        PlanMemory, or memory_used() if memory is not planned
+   */
+  inline size_t memory_planned() const { return memory_planned_; }
+
   // Helpers for Init.
   /**
    * @brief Remove layers that the user specified should be excluded given the current
@@ -241,6 +331,9 @@ class Net {
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
 
+  /// @brief Reorders a blob into a channel block in place, along with the
+  ///        layout of the blobs sharing its data, as the tops of a split.
+  void ReorderChannelBlock(Blob<Dtype>* blob, const int block);
   /// @brief Helper for displaying debug info in Forward about input Blobs.
   void InputDebugInfo(const int layer_id);
   /// @brief Helper for displaying debug info in Forward.
@@ -303,8 +396,25 @@ class Net {
   /// the weight decay multipliers for learnable_params_
   vector<float> params_weight_decay_;
   vector<bool> has_params_decay_;
-  /// The bytes of memory used by this net
+  /// Whether some fillers of the parameters may still be deferred
+  bool fill_deferred_;
+  /// The number of elements of the data of the top blobs
   size_t memory_used_;
+  /// The number of elements of the diffs of the top blobs
+  size_t diff_memory_used_;
+  /// Whether the diffs are disabled by DisableDiffs
+  bool forward_only_;
+  /// The precision of the parameters packed by PackParams
+  StoragePrecision param_storage_;
+  /// The channel block of the blocked layout used by ReorderBottoms
+  int channel_block_;
+  /// Whether the activation memory is planned by PlanMemory
+  bool optimize_memory_;
+  /// The number of elements held by the blobs after PlanMemory
+  size_t memory_planned_;
+  /// The buffer each blob belongs to in PlanMemory (blobs sharing data belong
+  /// to the same buffer); -1 for the net inputs and outputs
+  vector<int> blob_buffer_ids_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
   /// The root net that actually holds the shared layers in data parallelism
@@ -31,6 +31,15 @@ class SGDSolver : public Solver<Dtype> {
   virtual void Regularize(int param_id);
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
   virtual void ClipGradients();
+  /**
+   * @brief The number of spans of span_size values of learnable param
+   *        param_id which its update works on, on the CPU: the rows of its
+   *        diff written by Backward if it is updated lazily (see
+   *        SolverParameter.lazy_update), or else the whole of it.
+   */
+  int UpdateSpans(int param_id, int* span_size) const;
+  /// @brief The offset of the given span of UpdateSpans.
+  int UpdateSpanOffset(int param_id, int span) const;
   virtual void SnapshotSolverState(const string& model_filename);
   virtual void SnapshotSolverStateToBinaryProto(const string& model_filename);
   virtual void SnapshotSolverStateToHDF5(const string& model_filename);
@@ -49,13 +58,17 @@ template <typename Dtype>
 class NesterovSolver : public SGDSolver<Dtype> {
  public:
   explicit NesterovSolver(const SolverParameter& param)
-      : SGDSolver<Dtype>(param) {}
+      : SGDSolver<Dtype>(param) { constructor_sanity_check(); }
   explicit NesterovSolver(const string& param_file)
-      : SGDSolver<Dtype>(param_file) {}
+      : SGDSolver<Dtype>(param_file) { constructor_sanity_check(); }
   virtual inline const char* type() const { return "Nesterov"; }
 
  protected:
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  void constructor_sanity_check() {
+    CHECK(!this->param_.lazy_update())
+        << "Lazy updates cannot be used with Nesterov.";
+  }
 
   DISABLE_COPY_AND_ASSIGN(NesterovSolver);
 };
@@ -94,6 +107,8 @@ class RMSPropSolver : public SGDSolver<Dtype> {
   void constructor_sanity_check() {
     CHECK_EQ(0, this->param_.momentum())
         << "Momentum cannot be used with RMSProp.";
+    CHECK(!this->param_.lazy_update())
+        << "Lazy updates cannot be used with RMSProp.";
     CHECK_GE(this->param_.rms_decay(), 0)
         << "rms_decay should lie between 0 and 1.";
     CHECK_LT(this->param_.rms_decay(), 1)
@@ -100,6 +100,7 @@ class Solver {
   string SnapshotFilename(const string extension);
   string SnapshotToBinaryProto();
   string SnapshotToHDF5();
+  string SnapshotToFlat();
   // The test routine
   void TestAll();
   void Test(const int test_net_id = 0);
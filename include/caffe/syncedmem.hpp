@@ -4,6 +4,7 @@
 #include <cstdlib>
 
 #include "caffe/common.hpp"
+#include "caffe/util/host_memory_pool.hpp"
 
 namespace caffe {
 
@@ -12,26 +13,41 @@ namespace caffe {
 // The improvement in performance seems negligible in the single GPU case,
 // but might be more significant for parallel training. Most importantly,
 // it improved stability for large models on many GPUs.
-inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda) {
+// Otherwise host memory comes from the caching HostMemoryPool, unless it is
+// disabled; use_pool records which, as the block must be freed the same way.
+// Either way it is aligned as set by Caffe::set_host_alignment() and, for
+// large buffers, Caffe::set_host_huge_pages().
+inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda,
+    bool* use_pool) {
 #ifndef CPU_ONLY
   if (Caffe::mode() == Caffe::GPU) {
     CUDA_CHECK(cudaMallocHost(ptr, size));
     *use_cuda = true;
+    *use_pool = false;
     return;
   }
 #endif
-  *ptr = malloc(size);
   *use_cuda = false;
-  CHECK(*ptr) << "host allocation of size " << size << " failed";
+  *use_pool = HostMemoryPool::enabled();
+  if (*use_pool) {
+    *ptr = HostMemoryPool::Allocate(size);
+    return;
+  }
+  *ptr = AlignedMallocHost(size);
 }
 
-inline void CaffeFreeHost(void* ptr, bool use_cuda) {
+inline void CaffeFreeHost(void* ptr, size_t size, bool use_cuda,
+    bool use_pool) {
 #ifndef CPU_ONLY
   if (use_cuda) {
     CUDA_CHECK(cudaFreeHost(ptr));
     return;
   }
 #endif
+  if (use_pool) {
+    HostMemoryPool::Free(ptr, size);
+    return;
+  }
   free(ptr);
 }
 
@@ -46,15 +62,22 @@ class SyncedMemory {
  public:
   SyncedMemory()
       : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(0), head_(UNINITIALIZED),
-        own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
-        gpu_device_(-1) {}
+        own_cpu_data_(false), cpu_malloc_use_cuda_(false),
+        cpu_malloc_use_pool_(false), own_gpu_data_(false), gpu_device_(-1),
+        version_(0) {}
   explicit SyncedMemory(size_t size)
       : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(size), head_(UNINITIALIZED),
-        own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
-        gpu_device_(-1) {}
+        own_cpu_data_(false), cpu_malloc_use_cuda_(false),
+        cpu_malloc_use_pool_(false), own_gpu_data_(false), gpu_device_(-1),
+        version_(0) {}
   ~SyncedMemory();
   const void* cpu_data();
   void set_cpu_data(void* data);
+  /**
+   * @brief Points at data as set_cpu_data, keeping owner, which holds it (for
+   *        instance a MappedFile), alive for as long as the memory does.
+   */
+  void set_cpu_data(void* data, const shared_ptr<void>& owner);
   const void* gpu_data();
   void set_gpu_data(void* data);
   void* mutable_cpu_data();
@@ -62,6 +85,13 @@ class SyncedMemory {
   enum SyncedHead { UNINITIALIZED, HEAD_AT_CPU, HEAD_AT_GPU, SYNCED };
   SyncedHead head() { return head_; }
   size_t size() { return size_; }
+  /**
+   * @brief Returns a counter of the accesses which may change the data:
+   *        mutable_cpu_data, mutable_gpu_data, set_cpu_data and set_gpu_data.
+   *        Layers caching data derived from a blob compare it to tell
+   *        whether the blob was written to since.
+   */
+  int version() const { return version_; }
 
 #ifndef CPU_ONLY
   void async_gpu_push(const cudaStream_t& stream);
@@ -76,8 +106,11 @@ class SyncedMemory {
   SyncedHead head_;
   bool own_cpu_data_;
   bool cpu_malloc_use_cuda_;
+  bool cpu_malloc_use_pool_;
   bool own_gpu_data_;
   int gpu_device_;
+  int version_;
+  shared_ptr<void> cpu_data_owner_;
 
   DISABLE_COPY_AND_ASSIGN(SyncedMemory);
 };  // class SyncedMemory
@@ -0,0 +1,51 @@
+#ifndef CAFFE_UTIL_CONV_AUTOTUNE_HPP_
+#define CAFFE_UTIL_CONV_AUTOTUNE_HPP_
+
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief The process-wide cache of the CPU convolution algorithms selected
+ *        by benchmark for ConvolutionParameter.algorithm AUTOTUNE.
+ *
+ * The keys describe the convolution (shapes, kernel geometry, phase and
+ * Dtype) followed by the MachineKey(), so that a cache file copied to
+ * another machine or run with another number of threads is not trusted. If
+ * a path is set, the entries are read from that file on first use and each
+ * new entry is appended to it as a "<key> <algorithm name>" line, so later
+ * runs skip the benchmarks; otherwise they last for the process.
+ *
+ * All the state lives in conv_autotune.cpp to keep boost/thread.hpp out of
+ * this header (see BlockingQueue).
+ */
+class ConvAutotuneCache {
+ public:
+  /// @brief Returns whether key is cached, setting algorithm if so.
+  static bool Lookup(const string& key,
+      ConvolutionParameter_Algorithm* algorithm);
+  /// @brief Caches the algorithm for key, and appends it to the file.
+  static void Insert(const string& key,
+      const ConvolutionParameter_Algorithm algorithm);
+  /// @brief Forgets the cached entries, which are read again from the file.
+  static void Clear();
+  /**
+   * @brief Returns the part of the keys describing the machine: the number
+   *        of threads (see Caffe::num_threads) and the CPU model.
+   */
+  static string MachineKey();
+
+  /// The file holding the cache across runs, or "" to keep it in memory.
+  static string path();
+  static void set_path(const string& path);
+
+ private:
+  ConvAutotuneCache();
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_CONV_AUTOTUNE_HPP_
@@ -0,0 +1,41 @@
+#ifndef CAFFE_UTIL_DIRECT_CONV_HPP_
+#define CAFFE_UTIL_DIRECT_CONV_HPP_
+
+namespace caffe {
+
+/**
+ * Direct 2D grouped convolution of an image, without a column buffer, for
+ * depthwise convolution and groups of few channels: weights are num_output x
+ * (channels / group) x kernel_h x kernel_w as in ConvolutionLayer, and the
+ * output is num_output x output_h x output_w with the output size of
+ * im2col_cpu.
+ */
+template <typename Dtype>
+void conv_direct_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const Dtype* weights,
+    const int num_output, const int group, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    Dtype* data_out);
+
+/// @brief Computes the gradient w.r.t. the image, overwriting data_im.
+template <typename Dtype>
+void conv_direct_backward_cpu(const Dtype* data_out, const int channels,
+    const int height, const int width, const Dtype* weights,
+    const int num_output, const int group, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    Dtype* data_im);
+
+/// @brief Accumulates the gradient w.r.t. the weights.
+template <typename Dtype>
+void conv_direct_weight_cpu(const Dtype* data_im, const Dtype* data_out,
+    const int channels, const int height, const int width,
+    const int num_output, const int group, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    Dtype* weights);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_DIRECT_CONV_HPP_
@@ -0,0 +1,35 @@
+#ifndef CAFFE_UTIL_FAST_MATH_HPP_
+#define CAFFE_UTIL_FAST_MATH_HPP_
+
+namespace caffe {
+
+/**
+ * Vectorized approximations of the transcendental functions of activations,
+ * for layers with the FAST MathAccuracy. For float, they evaluate the
+ * polynomials of simd.hpp, branch-free, and are within a relative error of
+ * kFastMathRelativeError of the exact functions over the whole float range
+ * (below FLT_MIN, within that of FLT_MIN), with the same infinities and NaNs;
+ * for double, they compute the exact functions.
+ */
+const double kFastMathRelativeError = 1e-6;
+
+/// @brief y = exp(x)
+template <typename Dtype>
+void caffe_cpu_fast_exp(const int n, const Dtype* x, Dtype* y);
+
+/// @brief y = 1 / (1 + exp(-x))
+template <typename Dtype>
+void caffe_cpu_fast_sigmoid(const int n, const Dtype* x, Dtype* y);
+
+/// @brief y = tanh(x)
+template <typename Dtype>
+void caffe_cpu_fast_tanh(const int n, const Dtype* x, Dtype* y);
+
+/// @brief y = x for the positive x, and alpha (exp(x) - 1) for the others
+template <typename Dtype>
+void caffe_cpu_fast_elu(const int n, const Dtype alpha, const Dtype* x,
+    Dtype* y);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FAST_MATH_HPP_
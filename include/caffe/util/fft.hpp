@@ -0,0 +1,55 @@
+#ifndef CAFFE_UTIL_FFT_HPP_
+#define CAFFE_UTIL_FFT_HPP_
+
+namespace caffe {
+
+/**
+ * Radix-2 fast Fourier transforms of real 2D images, for convolution by
+ * elementwise products in the frequency domain (see BaseConvolutionLayer
+ * with the FFT algorithm).
+ *
+ * An image of height x width values is placed in a zero fft_h x fft_w grid,
+ * value (i, j) at (offset_h + i * step_h, offset_w + j * step_w), so that
+ * padding, strided outputs and dilated filters are placed where they belong.
+ * As the image is real, only the fft_h x (fft_w / 2 + 1) half of its
+ * spectrum is kept, as planar real then imaginary parts of fft_spectrum_size
+ * values each.
+ */
+
+/// @brief Returns the smallest power of 2 which is not less than n.
+int fft_size(const int n);
+
+/// @brief Returns the number of complex values of a half spectrum.
+inline int fft_spectrum_size(const int fft_h, const int fft_w) {
+  return fft_h * (fft_w / 2 + 1);
+}
+
+/// @brief Transforms an image placed in the grid into its half spectrum, of
+///        2 * fft_spectrum_size values.
+template <typename Dtype>
+void fft2d_forward_cpu(const Dtype* data, const int height, const int width,
+    const int offset_h, const int offset_w, const int step_h,
+    const int step_w, const int fft_h, const int fft_w, Dtype* spectrum);
+
+/**
+ * @brief Transforms a half spectrum back into the grid, and reads the image
+ *        placed in it, scaled by 1 / (fft_h * fft_w): the inverse of
+ *        fft2d_forward_cpu.
+ */
+template <typename Dtype>
+void fft2d_inverse_cpu(const Dtype* spectrum, const int fft_h,
+    const int fft_w, const int height, const int width, const int offset_h,
+    const int offset_w, const int step_h, const int step_w, Dtype* data);
+
+/**
+ * @brief Accumulates the product of the spectra a and b, or of a and the
+ *        conjugate of b, into c: the spectrum of the circular convolution or
+ *        correlation of their images.
+ */
+template <typename Dtype>
+void fft_multiply_add_cpu(const int spectrum_size, const Dtype* a,
+    const Dtype* b, const bool conjugate_b, Dtype* c);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FFT_HPP_
@@ -0,0 +1,35 @@
+#ifndef CAFFE_UTIL_HALF_HPP_
+#define CAFFE_UTIL_HALF_HPP_
+
+#include <stdint.h>
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/// @brief Rounds a float to the nearest IEEE 754 half-precision value.
+uint16_t float_to_half(float value);
+/// @brief Returns the float equal to an IEEE 754 half-precision value.
+float half_to_float(uint16_t value);
+/// @brief Rounds a float to the nearest bfloat16, i.e., a float keeping only
+///        the upper 16 bits.
+uint16_t float_to_bfloat16(float value);
+/// @brief Returns the float equal to a bfloat16 value.
+float bfloat16_to_float(uint16_t value);
+
+/**
+ * @brief Rounds n values to the 16-bit storage precision (FP16 or BF16),
+ *        to nearest even.
+ */
+template <typename Dtype>
+void caffe_cpu_pack(const int n, const Dtype* x,
+    const StoragePrecision precision, uint16_t* y);
+
+/// @brief Converts n values packed by caffe_cpu_pack back to Dtype.
+template <typename Dtype>
+void caffe_cpu_unpack(const int n, const uint16_t* x,
+    const StoragePrecision precision, Dtype* y);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_HALF_HPP_
@@ -0,0 +1,89 @@
+#ifndef CAFFE_UTIL_HOST_MEMORY_POOL_HPP_
+#define CAFFE_UTIL_HOST_MEMORY_POOL_HPP_
+
+#include <cstddef>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/// Buffers of at least this size may be backed by transparent huge pages.
+const size_t kHugePageSize = size_t(2) << 20;
+
+/**
+ * @brief Returns the alignment of a host buffer of the given size: the
+ *        Caffe::host_alignment(), or kHugePageSize for large buffers when
+ *        Caffe::host_huge_pages() is set.
+ */
+size_t HostAlignment(size_t size);
+
+/**
+ * @brief Allocates size bytes aligned to HostAlignment(size), advising the
+ *        kernel to back large buffers with huge pages if enabled. The block
+ *        is released with free().
+ */
+void* AlignedMallocHost(size_t size);
+
+/**
+ * @brief A caching allocator for the host memory behind SyncedMemory.
+ *
+ * Requests are rounded up to a size class (four classes per power of two,
+ * at least 64 bytes) and freed blocks are kept on per-class free lists, so
+ * that blobs which are repeatedly reshaped or rebuilt (e.g., the temporary
+ * blobs of a layer's Forward) reuse memory instead of going back to malloc.
+ *
+ * By default all threads share one cache guarded by a mutex. In per-thread
+ * mode every thread allocates from and frees to a cache of its own, which
+ * is released when the thread exits. Either way each cache holds at most
+ * max_cached_bytes() of free blocks; beyond that, blocks are freed.
+ * Blocks come from AlignedMallocHost, and a cached block which does not meet
+ * the current HostAlignment is released rather than reused.
+ *
+ * All the state lives in host_memory_pool.cpp to keep boost/thread.hpp out
+ * of this header (see BlockingQueue).
+ */
+class HostMemoryPool {
+ public:
+  struct Stats {
+    Stats() : hits(0), misses(0), bytes_in_use(0), bytes_cached(0) {}
+    /// Allocations served from a free list
+    size_t hits;
+    /// Allocations that went to the system allocator
+    size_t misses;
+    /// Bytes handed out by the pool and not yet returned
+    size_t bytes_in_use;
+    /// Bytes held on the free lists
+    size_t bytes_cached;
+  };
+
+  /// @brief Returns a block of at least size bytes.
+  static void* Allocate(size_t size);
+  /// @brief Returns a block obtained from Allocate(size) to the pool.
+  static void Free(void* ptr, size_t size);
+  /// @brief Releases all the cached blocks to the system.
+  static void Trim();
+  /// @brief Returns the statistics summed over all the caches.
+  static Stats GetStats();
+  /// @brief Returns the number of bytes actually allocated for size.
+  static size_t SizeClass(size_t size);
+
+  /// Whether CaffeMallocHost allocates through the pool.
+  static bool enabled();
+  static void set_enabled(bool enabled);
+  /// Whether each thread has a cache of its own.
+  static bool per_thread();
+  static void set_per_thread(bool per_thread);
+  /// The maximum number of bytes of free blocks held by each cache.
+  static size_t max_cached_bytes();
+  static void set_max_cached_bytes(size_t max_cached_bytes);
+
+ private:
+  class Cache;
+  static Cache* GetCache();
+
+  HostMemoryPool();
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_HOST_MEMORY_POOL_HPP_
@@ -0,0 +1,36 @@
+#ifndef CAFFE_UTIL_MAPPED_FILE_HPP_
+#define CAFFE_UTIL_MAPPED_FILE_HPP_
+
+#include <string>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A file mapped privately into memory for as long as the object lives.
+ *
+ * The pages are those of the page cache, shared by every process mapping the
+ * file, until they are written to; a written page is copied for this mapping
+ * alone and the file itself is never modified.
+ */
+class MappedFile {
+ public:
+  explicit MappedFile(const string& filename);
+  ~MappedFile();
+
+  inline char* data() const { return data_; }
+  inline size_t size() const { return size_; }
+  inline const string& filename() const { return filename_; }
+
+ private:
+  string filename_;
+  char* data_;
+  size_t size_;
+
+  DISABLE_COPY_AND_ASSIGN(MappedFile);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_MAPPED_FILE_HPP_
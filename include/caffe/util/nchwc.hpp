@@ -0,0 +1,51 @@
+#ifndef CAFFE_UTIL_NCHWC_HPP_
+#define CAFFE_UTIL_NCHWC_HPP_
+
+namespace caffe {
+
+/**
+ * The blocked layout NCHW[block]c (see Blob::channel_block) stores a 4D blob
+ * whose channels are divisible by block as num x (channels / block) x height
+ * x width x block: the channels of a block are contiguous at every position,
+ * so that CPU kernels can vectorize along them.
+ */
+template <typename Dtype>
+void nchw_to_nchwc_cpu(const int num, const int channels,
+    const int spatial_dim, const int block, const Dtype* src, Dtype* dst);
+
+/// @brief Reorders data from NCHW[block]c back to NCHW.
+template <typename Dtype>
+void nchwc_to_nchw_cpu(const int num, const int channels,
+    const int spatial_dim, const int block, const Dtype* src, Dtype* dst);
+
+/**
+ * @brief Reorders num_output x channels x kernel_h x kernel_w convolution
+ *        weights for conv_nchwc_cpu, as (num_output / block) x (channels /
+ *        block) x kernel_h x kernel_w x block input channels x block output
+ *        channels.
+ */
+template <typename Dtype>
+void conv_weights_to_nchwc_cpu(const Dtype* weights, const int num_output,
+    const int channels, const int kernel_h, const int kernel_w,
+    const int block, Dtype* dst);
+
+/**
+ * Direct 2D convolution, without groups, of an image in NCHW[block]c into an
+ * output in NCHW[block]c, with the weights reordered by
+ * conv_weights_to_nchwc_cpu and the output size of im2col_cpu. The outputs
+ * of a row are summed by tiles of four, held in registers: each input channel
+ * of the four is multiplied by a row of block weights into their blocks of
+ * output channels, which vectorizes along the channels. The rows run in
+ * parallel.
+ */
+template <typename Dtype>
+void conv_nchwc_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const Dtype* weights,
+    const int num_output, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int block,
+    Dtype* data_out);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_NCHWC_HPP_
@@ -0,0 +1,57 @@
+#ifndef CAFFE_UTIL_PACKED_WEIGHTS_HPP_
+#define CAFFE_UTIL_PACKED_WEIGHTS_HPP_
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Reads the weights of a layer, which may be packed in a lower
+ *        precision (see Blob::Pack), without unpacking them into the blob.
+ *
+ * Panel converts a panel of rows at a time into a buffer small enough to
+ * stay in cache while the GEMM reading it runs, so that the packed weights
+ * are read from memory once per product. Weights which are not packed are
+ * read in place. The algorithms which reorder or transform the weights read
+ * all of them with Blob::unpacked_cpu_data instead, into a buffer dropped
+ * once they are done, so that no full precision copy outlives them.
+ * Int8 keeps a copy of the weights packed in INT8 for the int8 engines,
+ * quantized again only once they change, which it tells by the version of
+ * their memory (see SyncedMemory::version); the weights of the layer are
+ * left as they are.
+ */
+template <typename Dtype>
+class PackedWeights {
+ public:
+  PackedWeights() : int8_version_(0) {}
+
+  /// @brief The number of rows of row_size Dtype%s in a panel.
+  static int panel_rows(const int row_size);
+  /**
+   * @brief Returns the rows [row_begin, row_end) of the weights, seen as
+   *        rows of row_size Dtype%s; packed ones are unpacked into a buffer
+   *        which the next call overwrites.
+   */
+  const Dtype* Panel(const Blob<Dtype>& weights, const int row_size,
+      const int row_begin, const int row_end);
+  /**
+   * @brief Returns a blob of the weights packed in INT8 (see Blob::Pack),
+   *        quantized again only once they changed.
+   */
+  const Blob<Dtype>& Int8(const Blob<Dtype>& weights);
+
+ private:
+  shared_ptr<SyncedMemory> panel_;
+  Blob<Dtype> int8_;
+  // The memory and version of the weights quantized into int8_.
+  shared_ptr<SyncedMemory> int8_memory_;
+  int int8_version_;
+
+  DISABLE_COPY_AND_ASSIGN(PackedWeights);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_PACKED_WEIGHTS_HPP_
@@ -0,0 +1,92 @@
+#ifndef CAFFE_UTIL_PARALLEL_HPP_
+#define CAFFE_UTIL_PARALLEL_HPP_
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/// About the number of multiply-adds, or of elements copied, below which a
+/// thread costs more than it saves.
+const int kParallelWork = 1 << 15;
+
+/// The grain of parallel_for for items of the given work each.
+inline int parallel_grain(const int work_per_item) {
+  return work_per_item >= kParallelWork ? 1 : kParallelWork /
+      (work_per_item > 0 ? work_per_item : 1);
+}
+
+/**
+ * The number of threads over which parallel_for splits n items, in ranges
+ * of at least grain items: at most Caffe::num_threads(), and 1 inside
+ * another parallel loop.
+ */
+int parallel_threads(const int n, const int grain);
+
+/// Sets the number of threads of the BLAS library, if it has a way to (MKL
+/// and OpenBLAS).
+void caffe_set_blas_num_threads(const int threads);
+
+/**
+ * While it exists on a thread which splits a loop over several threads,
+ * limits a BLAS library that runs its own threads (OpenBLAS built with
+ * pthreads) to one thread, so that each thread of the loop may call BLAS
+ * without oversubscribing the cores. The other libraries already run one
+ * thread inside the parallel regions of OpenMP.
+ */
+class BlasThreadsGuard {
+ public:
+  explicit BlasThreadsGuard(const int threads);
+  ~BlasThreadsGuard();
+
+ private:
+  int blas_threads_;
+
+  DISABLE_COPY_AND_ASSIGN(BlasThreadsGuard);
+};
+
+/**
+ * @brief Calls body(begin, end) on disjoint ranges which cover [0, n), on
+ *        the threads of Caffe.
+ *
+ * This is the way for layers to use all the cores: the threads are those of
+ * the OpenMP runtime, which persist between loops, and there are
+ * Caffe::num_threads() of them (see Caffe::set_num_threads), the number the
+ * BLAS library runs too. Each range has at least grain items, so that small
+ * loops, whose threads would cost more than they save, run on the calling
+ * thread; the ranges are contiguous, and as even as grain allows, so that a
+ * body may keep its own state across the items of its range. Without
+ * OpenMP, or inside another parallel_for, body(0, n) runs on the calling
+ * thread. The other threads have a Caffe context of their own, so the body
+ * should not depend on Caffe::mode() nor draw from Caffe::rng_stream().
+ */
+template <typename Body>
+void parallel_for(const int n, const Body& body, const int grain = 1) {
+  const int threads = parallel_threads(n, grain);
+  if (threads <= 1) {
+    if (n > 0) {
+      body(0, n);
+    }
+    return;
+  }
+#ifdef _OPENMP
+  BlasThreadsGuard blas_guard(threads);
+  #pragma omp parallel num_threads(threads)
+  {
+    const int64_t thread = omp_get_thread_num();
+    const int64_t count = omp_get_num_threads();
+    const int begin = static_cast<int>(thread * n / count);
+    const int end = static_cast<int>((thread + 1) * n / count);
+    if (begin < end) {
+      body(begin, end);
+    }
+  }
+#endif
+}
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_PARALLEL_HPP_
@@ -0,0 +1,60 @@
+#ifndef CAFFE_UTIL_QUANTIZE_HPP_
+#define CAFFE_UTIL_QUANTIZE_HPP_
+
+#include <stdint.h>
+
+#include "caffe/common.hpp"
+#include "caffe/util/mkl_alternate.hpp"
+
+namespace caffe {
+
+/// The largest magnitude of a quantized value, symmetric around 0.
+const int kInt8Max = 127;
+
+/// @brief Returns the largest absolute value of x.
+template <typename Dtype>
+Dtype caffe_cpu_amax(const int n, const Dtype* x);
+
+/// @brief Returns the scale mapping [-range, range] onto
+///        [-kInt8Max, kInt8Max], or 1 if range is 0.
+template <typename Dtype>
+inline Dtype int8_scale(const Dtype range) {
+  return range > 0 ? range / kInt8Max : Dtype(1);
+}
+
+/// @brief Computes y = x / scale rounded to nearest and clipped to
+///        [-kInt8Max, kInt8Max].
+template <typename Dtype>
+void caffe_cpu_quantize(const int n, const Dtype* x, const Dtype scale,
+    int8_t* y);
+
+/// @brief Computes y = x * scale.
+template <typename Dtype>
+void caffe_cpu_dequantize(const int n, const int8_t* x, const Dtype scale,
+    Dtype* y);
+
+/**
+ * @brief Quantizes each of the slices of x (e.g., the weights of each output
+ *        channel) with the scale given by its largest absolute value, which
+ *        is stored in scales.
+ */
+template <typename Dtype>
+void caffe_cpu_quantize_slices(const int slices, const int slice_size,
+    const Dtype* x, int8_t* y, float* scales);
+
+/// @brief Dequantizes slices quantized by caffe_cpu_quantize_slices.
+template <typename Dtype>
+void caffe_cpu_dequantize_slices(const int slices, const int slice_size,
+    const int8_t* x, const float* scales, Dtype* y);
+
+/**
+ * @brief Computes C = A * op(B) on int8 matrices with int32 accumulation,
+ *        where A is M x K and op(B) is K x N. As with caffe_cpu_gemm, the
+ *        matrices are contiguous and row-major.
+ */
+void caffe_cpu_gemm_int8(const CBLAS_TRANSPOSE TransB, const int M,
+    const int N, const int K, const int8_t* A, const int8_t* B, int32_t* C);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_QUANTIZE_HPP_
@@ -0,0 +1,48 @@
+#ifndef CAFFE_UTIL_ROW_SET_HPP_
+#define CAFFE_UTIL_ROW_SET_HPP_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A set of the rows of a matrix, in the order of their insertion,
+ *        which inserts in constant time and clears in the time of the rows
+ *        inserted rather than of the matrix.
+ */
+class RowSet {
+ public:
+  explicit RowSet(const int num_rows) : inserted_(num_rows, false) {}
+
+  inline void insert(const int row) {
+    DCHECK_GE(row, 0);
+    DCHECK_LT(row, num_rows());
+    if (!inserted_[row]) {
+      inserted_[row] = true;
+      rows_.push_back(row);
+    }
+  }
+  inline void clear() {
+    for (int i = 0; i < rows_.size(); ++i) {
+      inserted_[rows_[i]] = false;
+    }
+    rows_.clear();
+  }
+  /// @brief The number of rows inserted.
+  inline int size() const { return rows_.size(); }
+  /// @brief The i-th row inserted.
+  inline int row(const int i) const { return rows_[i]; }
+  inline int num_rows() const { return inserted_.size(); }
+
+ private:
+  vector<bool> inserted_;
+  vector<int> rows_;
+
+  DISABLE_COPY_AND_ASSIGN(RowSet);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_ROW_SET_HPP_
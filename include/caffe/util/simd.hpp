@@ -0,0 +1,152 @@
+#ifndef CAFFE_UTIL_SIMD_HPP_
+#define CAFFE_UTIL_SIMD_HPP_
+
+#include <stdint.h>
+#include <cstring>
+#include <limits>
+
+/**
+ * CAFFE_SIMD_CLONES builds a function for AVX-512, AVX2 and the baseline
+ * instruction set, and picks one when the program loads by the CPU it runs
+ * on (the target_clones of GCC on x86-64 Linux); elsewhere only the baseline
+ * is built. It suits functions of loops which the compiler vectorizes, with
+ * branch-free bodies calling nothing but inline functions, whatever the
+ * instruction set the rest of Caffe is built for.
+ */
+#if defined(__GNUC__) && __GNUC__ >= 8 && !defined(__clang__) && \
+    !defined(__INTEL_COMPILER) && !defined(__CUDACC__) && \
+    defined(__x86_64__) && defined(__linux__)
+#define CAFFE_SIMD_CLONES \
+    __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define CAFFE_SIMD_CLONES
+#endif
+
+namespace caffe {
+
+// The float functions below are branch-free, for the loops of
+// CAFFE_SIMD_CLONES. exp, expm1 and log are the Cephes polynomials, within
+// 1 ulp over the whole float range, with the infinities and NaN of libm.
+
+inline float simd_bits_to_float(const int32_t bits) {
+  float x;
+  std::memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+inline int32_t simd_float_to_bits(const float x) {
+  int32_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  return bits;
+}
+
+// Returns c ? a : b by masking the bits, as the compiler would otherwise
+// branch around the trapping float operations that compute a or b.
+inline float simd_select(const bool c, const float a, const float b) {
+  const int32_t mask = -static_cast<int32_t>(c);
+  return simd_bits_to_float((simd_float_to_bits(a) & mask) |
+      (simd_float_to_bits(b) & ~mask));
+}
+
+inline float simd_abs(const float x) {
+  return simd_bits_to_float(simd_float_to_bits(x) & 0x7fffffff);
+}
+
+// |x| with the sign of s.
+inline float simd_copysign(const float x, const float s) {
+  return simd_bits_to_float((simd_float_to_bits(x) & 0x7fffffff) |
+      (simd_float_to_bits(s) & ~0x7fffffff));
+}
+
+// exp(x) overflows above log(FLT_MAX), and rounds to 0 below the log of
+// half the smallest denormal.
+const float kSimdExpHigh = 88.72283935546875f;
+const float kSimdExpLow = -103.97208404541015625f;
+
+// Reduces x to n ln(2) + r with |r| <= ln(2) / 2, and returns e^r - 1 with
+// the two factors of 2^n, as it is a denormal or infinite at the ends.
+inline float simd_exp_reduce(const float x, float* f1, float* f2,
+    int32_t* n) {
+  const float t = simd_select(x < kSimdExpLow, kSimdExpLow,
+      simd_select(x > kSimdExpHigh, kSimdExpHigh, x));
+  const float fn = t * 1.44269504088896341f + 0.5f;
+  *n = static_cast<int32_t>(fn);
+  *n -= fn < static_cast<float>(*n);
+  const float nf = static_cast<float>(*n);
+  // ln(2) in two parts.
+  float r = t - nf * 0.693359375f;
+  r -= nf * -2.12194440e-4f;
+  float p = 1.9875691500e-4f;
+  p = p * r + 1.3981999507e-3f;
+  p = p * r + 8.3334519073e-3f;
+  p = p * r + 4.1665795894e-2f;
+  p = p * r + 1.6666665459e-1f;
+  p = p * r + 5.0000001201e-1f;
+  const int32_t n1 = *n >> 1;
+  *f1 = simd_bits_to_float((n1 + 127) << 23);
+  *f2 = simd_bits_to_float((*n - n1 + 127) << 23);
+  return p * r * r + r;
+}
+
+inline float simd_exp(const float x) {
+  float f1, f2;
+  int32_t n;
+  const float p = simd_exp_reduce(x, &f1, &f2, &n);
+  float y = (p + 1.0f) * f1 * f2;
+  y = simd_select(x > kSimdExpHigh, std::numeric_limits<float>::infinity(),
+      y);
+  y = simd_select(x < kSimdExpLow, 0.f, y);
+  return simd_select(x != x, x, y);
+}
+
+// exp(x) - 1, without the cancellation near 0.
+inline float simd_expm1(const float x) {
+  float f1, f2;
+  int32_t n;
+  const float p = simd_exp_reduce(x, &f1, &f2, &n);
+  const float f = f1 * f2;
+  // 2^n (e^r - 1) + 2^n - 1, unless 2^n is beyond a float.
+  float y = simd_select(n > 64, (p + 1.0f) * f1 * f2 - 1.0f,
+      f * p + (f - 1.0f));
+  y = simd_select(x > kSimdExpHigh, std::numeric_limits<float>::infinity(),
+      y);
+  y = simd_select(x < kSimdExpLow, -1.f, y);
+  return simd_select(x != x, x, y);
+}
+
+inline float simd_log(const float x) {
+  // Denormals are scaled into the normal range first.
+  const bool denormal = x < std::numeric_limits<float>::min();
+  const float scaled = x * 8388608.0f;
+  const int32_t bits = simd_float_to_bits(simd_select(denormal, scaled, x));
+  // x = m 2^e with m in [sqrt(1/2), sqrt(2)).
+  float e = static_cast<float>((bits >> 23) - 126) -
+      simd_select(denormal, 23.f, 0.f);
+  float m = simd_bits_to_float((bits & 0x007fffff) | 0x3f000000);
+  const bool small = m < 0.707106781186547524f;
+  e -= simd_select(small, 1.f, 0.f);
+  const float doubled = m + m;
+  m = simd_select(small, doubled, m) - 1.0f;
+  const float z = m * m;
+  float p = 7.0376836292e-2f;
+  p = p * m - 1.1514610310e-1f;
+  p = p * m + 1.1676998740e-1f;
+  p = p * m - 1.2420140846e-1f;
+  p = p * m + 1.4249322787e-1f;
+  p = p * m - 1.6668057665e-1f;
+  p = p * m + 2.0000714765e-1f;
+  p = p * m - 2.4999993993e-1f;
+  p = p * m + 3.3333331174e-1f;
+  float y = p * m * z;
+  y += e * -2.12194440e-4f;
+  y -= 0.5f * z;
+  y = m + y + e * 0.693359375f;
+  y = simd_select(x == 0, -std::numeric_limits<float>::infinity(), y);
+  y = simd_select(x < 0, std::numeric_limits<float>::quiet_NaN(), y);
+  y = simd_select(x == std::numeric_limits<float>::infinity(), x, y);
+  return simd_select(x != x, x, y);
+}
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SIMD_HPP_
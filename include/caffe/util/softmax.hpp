@@ -0,0 +1,35 @@
+#ifndef CAFFE_UTIL_SOFTMAX_HPP_
+#define CAFFE_UTIL_SOFTMAX_HPP_
+
+namespace caffe {
+
+/**
+ * @brief The softmax of x over the channels axis of an
+ *        outer_num x channels x inner_num array, into y (which may be x).
+ *
+ * Each softmax is computed in one go while it is in cache, the rows of the
+ * long ones (inner_num 1) and tiles of the others, over the threads of
+ * Caffe (see parallel_for). If log_norm is not NULL, it receives the
+ * outer_num x inner_num logs of the normalizers, max + log(sum(exp(x -
+ * max))), so that the log-softmax is x - log_norm, exactly, where y
+ * underflows. fast uses caffe_cpu_fast_exp and multiplies by the reciprocal
+ * of the sum (the FAST MathAccuracy).
+ */
+template <typename Dtype>
+void caffe_cpu_softmax(const int outer_num, const int channels,
+    const int inner_num, const Dtype* x, Dtype* y, Dtype* log_norm,
+    const bool fast);
+
+/**
+ * @brief The gradient of the softmax y, laid out as in caffe_cpu_softmax:
+ *        x_diff = y (y_diff - sum over the channels of y_diff y). x_diff
+ *        may be y_diff.
+ */
+template <typename Dtype>
+void caffe_cpu_softmax_backward(const int outer_num, const int channels,
+    const int inner_num, const Dtype* y, const Dtype* y_diff,
+    Dtype* x_diff);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SOFTMAX_HPP_
@@ -0,0 +1,107 @@
+#ifndef CAFFE_UTIL_SPARSE_HPP_
+#define CAFFE_UTIL_SPARSE_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+
+namespace caffe {
+
+/// @brief Returns the fraction of the n values of x which are zero.
+template <typename Dtype>
+double caffe_cpu_sparsity(const int n, const Dtype* x);
+
+/**
+ * @brief The weights of a layer, a matrix of one row per output, in
+ *        compressed sparse row (CSR) form while enough of them are zero, so
+ *        that pruned weights are multiplied without their zeros.
+ *
+ * Update compresses the weights again only once they change, which it tells
+ * by the version of their memory (see SyncedMemory::version), so the
+ * compression of fixed weights, as for inference, happens once.
+ */
+template <typename Dtype>
+class SparseWeights {
+ public:
+  SparseWeights()
+      : version_(0), sparsity_(0), active_(false), row_offsets_(1, 0) {}
+
+  /**
+   * @brief Compresses the weights, rows x (count / rows), if at least the
+   *        threshold fraction of them are zero, and returns whether they are
+   *        held compressed. A threshold above 1 never compresses them.
+   */
+  bool Update(const Blob<Dtype>& weights, const int rows,
+      const float threshold);
+  /// @brief The fraction of zeros of the weights at the last Update.
+  inline double sparsity() const { return sparsity_; }
+  inline int rows() const { return row_offsets_.size() - 1; }
+  inline int nonzeros() const { return values_.size(); }
+
+  /**
+   * @brief Computes C = A B, where A is the rows [row_begin, row_end) of the
+   *        weights, B is cols x N and C is (row_end - row_begin) x N.
+   */
+  void MultiplyDense(const int row_begin, const int row_end, const int N,
+      const Dtype* B, Dtype* C) const;
+  /**
+   * @brief Computes C = B W^T for the weights W, where B is M x cols and C
+   *        is M x rows.
+   */
+  void MultiplyDenseTransposed(const int M, const int cols, const Dtype* B,
+      Dtype* C);
+
+ private:
+  // The memory and version of the weights at the last Update.
+  shared_ptr<SyncedMemory> memory_;
+  int version_;
+  double sparsity_;
+  bool active_;
+  // The nonzeros of row r are values_ and columns_ [row_offsets_[r],
+  // row_offsets_[r + 1]).
+  vector<int> row_offsets_;
+  vector<int> columns_;
+  vector<Dtype> values_;
+  // B^T and C^T of MultiplyDenseTransposed.
+  vector<Dtype> transposed_input_;
+  vector<Dtype> transposed_output_;
+
+  DISABLE_COPY_AND_ASSIGN(SparseWeights);
+};
+
+/**
+ * @brief Computes C = A B^T, where A is a rows x cols matrix in compressed
+ *        sparse row (CSR) form, whose row r has the nonzeros values and
+ *        columns [row_offsets[r], row_offsets[r + 1]), B is N x cols and C is
+ *        rows x N.
+ */
+template <typename Dtype>
+void caffe_cpu_csrmm_nt(const int rows, const int N, const int cols,
+    const int* row_offsets, const int* columns, const Dtype* values,
+    const Dtype* B, Dtype* C);
+
+/**
+ * @brief Computes C += D^T A, for A as in caffe_cpu_csrmm_nt, D rows x N and
+ *        C N x cols. Only the columns of C of the nonzeros of A are written.
+ */
+template <typename Dtype>
+void caffe_cpu_csrmm_tn(const int rows, const int N, const int cols,
+    const int* row_offsets, const int* columns, const Dtype* values,
+    const Dtype* D, Dtype* C);
+
+/**
+ * @brief Computes the entries of D B at the nonzeros of A, as in
+ *        caffe_cpu_csrmm_nt, into x (one per nonzero), where D is rows x N and
+ *        B is N x cols -- the gradient of the values of A of
+ *        caffe_cpu_csrmm_nt, for the gradient D of C.
+ */
+template <typename Dtype>
+void caffe_cpu_csr_sddmm(const int rows, const int N, const int cols,
+    const int* row_offsets, const int* columns, const Dtype* D,
+    const Dtype* B, Dtype* x);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SPARSE_HPP_
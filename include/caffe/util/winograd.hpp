@@ -0,0 +1,59 @@
+#ifndef CAFFE_UTIL_WINOGRAD_HPP_
+#define CAFFE_UTIL_WINOGRAD_HPP_
+
+namespace caffe {
+
+/**
+ * Transforms of the Winograd minimal filtering algorithm F(m x m, 3 x 3)
+ * (Lavin & Gray, "Fast Algorithms for Convolutional Neural Networks"), for
+ * an output tile size m of 2 or 4: an (m + 2) x (m + 2) input tile and a 3 x 3
+ * filter are transformed into the Winograd domain, where their elementwise
+ * product is the transform of the m x m output tile. Summed over channels,
+ * the elementwise products are (m + 2)^2 independent GEMMs.
+ *
+ * The transformed data of channel c and tile p (tiles in row-major order)
+ * is kept at (x * channels + c) * tiles + p for each of the (m + 2)^2
+ * elements x of the transform, and that of filter f at x * num + f. The
+ * backward functions apply the transposed transforms, for the gradient.
+ */
+
+/// @brief Transforms the tiles of an image, with zero padding.
+template <typename Dtype>
+void winograd_input_transform_cpu(const int tile, const Dtype* data_im,
+    const int channels, const int height, const int width, const int pad_h,
+    const int pad_w, const int tiles_h, const int tiles_w, Dtype* data_tile);
+
+/// @brief Transforms back the gradient of the tiles into that of the image.
+template <typename Dtype>
+void winograd_input_transform_backward_cpu(const int tile,
+    const Dtype* data_tile, const int channels, const int height,
+    const int width, const int pad_h, const int pad_w, const int tiles_h,
+    const int tiles_w, Dtype* data_im);
+
+/// @brief Transforms num 3 x 3 filters.
+template <typename Dtype>
+void winograd_filter_transform_cpu(const int tile, const Dtype* weights,
+    const int num, Dtype* filter_tile);
+
+/// @brief Accumulates the gradient of the filters from that of their
+///        transform.
+template <typename Dtype>
+void winograd_filter_transform_backward_cpu(const int tile,
+    const Dtype* filter_tile, const int num, Dtype* weights);
+
+/// @brief Transforms back the products into the output tiles of an image,
+///        cropped to height x width.
+template <typename Dtype>
+void winograd_output_transform_cpu(const int tile, const Dtype* data_tile,
+    const int channels, const int height, const int width, const int tiles_h,
+    const int tiles_w, Dtype* data_im);
+
+/// @brief Transforms the gradient of the output into that of the products.
+template <typename Dtype>
+void winograd_output_transform_backward_cpu(const int tile,
+    const Dtype* data_im, const int channels, const int height,
+    const int width, const int tiles_h, const int tiles_w, Dtype* data_tile);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_WINOGRAD_HPP_
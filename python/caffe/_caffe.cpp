@@ -89,8 +89,12 @@ shared_ptr<Net<Dtype> > Net_Init_Load(
   CheckFile(param_file);
   CheckFile(pretrained_param_file);
 
-  shared_ptr<Net<Dtype> > net(new Net<Dtype>(param_file,
-      static_cast<Phase>(phase)));
+  NetParameter net_param;
+  ReadNetParamsFromTextFileOrDie(param_file, &net_param);
+  net_param.mutable_state()->set_phase(static_cast<Phase>(phase));
+  // Skip the fillers of the weights loaded right after.
+  net_param.set_defer_fill(true);
+  shared_ptr<Net<Dtype> > net(new Net<Dtype>(net_param));
   net->CopyTrainedLayersFrom(pretrained_param_file);
   return net;
 }
@@ -1,10 +1,14 @@
+#include <algorithm>
 #include <climits>
 #include <vector>
 
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/syncedmem.hpp"
+#include "caffe/util/half.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/nchwc.hpp"
+#include "caffe/util/quantize.hpp"
 
 namespace caffe {
 
@@ -38,7 +42,12 @@ void Blob<Dtype>::Reshape(const vector<int>& shape) {
   if (count_ > capacity_) {
     capacity_ = count_;
     data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
-    diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+    packed_data_.reset();
+    packed_scales_.reset();
+    storage_precision_ = NATIVE;
+    if (!diff_disabled_) {
+      diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+    }
   }
 }
 
@@ -61,14 +70,16 @@ template <typename Dtype>
 Blob<Dtype>::Blob(const int num, const int channels, const int height,
     const int width)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), diff_disabled_(false), storage_precision_(NATIVE),
+    channel_block_(0) {
   Reshape(num, channels, height, width);
 }
 
 template <typename Dtype>
 Blob<Dtype>::Blob(const vector<int>& shape)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), diff_disabled_(false), storage_precision_(NATIVE),
+    channel_block_(0) {
   Reshape(shape);
 }
 
@@ -81,54 +92,61 @@ const int* Blob<Dtype>::gpu_shape() const {
 template <typename Dtype>
 const Dtype* Blob<Dtype>::cpu_data() const {
   CHECK(data_);
+  UnpackData();
   return (const Dtype*)data_->cpu_data();
 }
 
 template <typename Dtype>
 void Blob<Dtype>::set_cpu_data(Dtype* data) {
   CHECK(data);
+  packed_data_.reset();
+  packed_scales_.reset();
+  storage_precision_ = NATIVE;
   data_->set_cpu_data(data);
 }
 
 template <typename Dtype>
 const Dtype* Blob<Dtype>::gpu_data() const {
   CHECK(data_);
+  UnpackData();
   return (const Dtype*)data_->gpu_data();
 }
 
 template <typename Dtype>
 const Dtype* Blob<Dtype>::cpu_diff() const {
-  CHECK(diff_);
+  CHECK(diff_) << "Blob has no diff";
   return (const Dtype*)diff_->cpu_data();
 }
 
 template <typename Dtype>
 const Dtype* Blob<Dtype>::gpu_diff() const {
-  CHECK(diff_);
+  CHECK(diff_) << "Blob has no diff";
   return (const Dtype*)diff_->gpu_data();
 }
 
 template <typename Dtype>
 Dtype* Blob<Dtype>::mutable_cpu_data() {
   CHECK(data_);
+  Unpack();
   return static_cast<Dtype*>(data_->mutable_cpu_data());
 }
 
 template <typename Dtype>
 Dtype* Blob<Dtype>::mutable_gpu_data() {
   CHECK(data_);
+  Unpack();
   return static_cast<Dtype*>(data_->mutable_gpu_data());
 }
 
 template <typename Dtype>
 Dtype* Blob<Dtype>::mutable_cpu_diff() {
-  CHECK(diff_);
+  CHECK(diff_) << "Blob has no diff";
   return static_cast<Dtype*>(diff_->mutable_cpu_data());
 }
 
 template <typename Dtype>
 Dtype* Blob<Dtype>::mutable_gpu_diff() {
-  CHECK(diff_);
+  CHECK(diff_) << "Blob has no diff";
   return static_cast<Dtype*>(diff_->mutable_gpu_data());
 }
 
@@ -136,12 +154,226 @@ template <typename Dtype>
 void Blob<Dtype>::ShareData(const Blob& other) {
   CHECK_EQ(count_, other.count());
   data_ = other.data();
+  packed_data_ = other.packed_data_;
+  packed_scales_ = other.packed_scales_;
+  storage_precision_ = other.storage_precision_;
 }
 
 template <typename Dtype>
 void Blob<Dtype>::ShareDiff(const Blob& other) {
   CHECK_EQ(count_, other.count());
-  diff_ = other.diff();
+  // A blob keeps its own diff rather than share the absence of one, as the
+  // layers reading it may use it as scratch even in forward-only nets.
+  if (other.diff_disabled_ && !diff_disabled_) { return; }
+  diff_ = other.diff_;
+  diff_rows_ = other.diff_rows_;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::ShareDataMemory(const shared_ptr<SyncedMemory>& data) {
+  CHECK(data);
+  const int data_capacity = data->size() / sizeof(Dtype);
+  CHECK_GE(data_capacity, count_);
+  data_ = data;
+  packed_data_.reset();
+  packed_scales_.reset();
+  storage_precision_ = NATIVE;
+  capacity_ = std::min(capacity_, data_capacity);
+}
+
+template <typename Dtype>
+void Blob<Dtype>::DisableDiff() {
+  diff_.reset();
+  diff_disabled_ = true;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::TrackDiffRows() {
+  CHECK_GT(num_axes(), 0) << "Cannot track the rows of a scalar blob.";
+  diff_rows_.reset(new RowSet(shape(0)));
+}
+
+// Integer blobs are never packed.
+template <> void Blob<unsigned int>::Pack(const StoragePrecision precision) {
+  NOT_IMPLEMENTED;
+}
+
+template <> void Blob<int>::Pack(const StoragePrecision precision) {
+  NOT_IMPLEMENTED;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::Pack(const StoragePrecision precision) {
+  CHECK(data_);
+  if (precision == storage_precision_) { return; }
+  if (precision == NATIVE) {
+    Unpack();
+    return;
+  }
+  shared_ptr<SyncedMemory> packed;
+  shared_ptr<SyncedMemory> scales;
+  if (precision == INT8) {
+    // One scale per slice along the first axis.
+    const int slices = num_axes() ? shape(0) : 1;
+    packed.reset(new SyncedMemory(capacity_ * sizeof(int8_t)));
+    scales.reset(new SyncedMemory(slices * sizeof(float)));
+    if (count_) {
+      caffe_cpu_quantize_slices(slices, count_ / slices, cpu_data(),
+          static_cast<int8_t*>(packed->mutable_cpu_data()),
+          static_cast<float*>(scales->mutable_cpu_data()));
+    }
+  } else {
+    packed.reset(new SyncedMemory(capacity_ * sizeof(uint16_t)));
+    caffe_cpu_pack(count_, cpu_data(), precision,
+        static_cast<uint16_t*>(packed->mutable_cpu_data()));
+  }
+  // The data is allocated again only once accessed.
+  data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+  packed_data_ = packed;
+  packed_scales_ = scales;
+  storage_precision_ = precision;
+}
+
+template <typename Dtype>
+const void* Blob<Dtype>::packed_cpu_data() const {
+  CHECK(packed_data_) << "Blob is not packed";
+  return packed_data_->cpu_data();
+}
+
+template <typename Dtype>
+const float* Blob<Dtype>::packed_cpu_scales() const {
+  CHECK(packed_scales_) << "Blob is not packed in INT8";
+  return static_cast<const float*>(packed_scales_->cpu_data());
+}
+
+template <> bool Blob<unsigned int>::data_packed() const { return false; }
+template <> bool Blob<int>::data_packed() const { return false; }
+
+template <typename Dtype>
+bool Blob<Dtype>::data_packed() const {
+  return packed_data_ && data_->head() == SyncedMemory::UNINITIALIZED;
+}
+
+template <> const unsigned int* Blob<unsigned int>::unpacked_cpu_data(
+    SyncedMemory* buffer) const {
+  return cpu_data();
+}
+
+template <> const int* Blob<int>::unpacked_cpu_data(
+    SyncedMemory* buffer) const {
+  return cpu_data();
+}
+
+template <typename Dtype>
+const Dtype* Blob<Dtype>::unpacked_cpu_data(SyncedMemory* buffer) const {
+  CHECK(data_);
+  if (!data_packed()) {
+    return cpu_data();
+  }
+  CHECK_GE(buffer->size(), count_ * sizeof(Dtype));
+  Dtype* data = static_cast<Dtype*>(buffer->mutable_cpu_data());
+  UnpackTo(data);
+  return data;
+}
+
+template <> void Blob<unsigned int>::UnpackData() const {}
+template <> void Blob<int>::UnpackData() const {}
+
+template <typename Dtype>
+void Blob<Dtype>::UnpackData() const {
+  if (data_packed()) {
+    UnpackTo(static_cast<Dtype*>(data_->mutable_cpu_data()));
+  }
+}
+
+template <> void Blob<unsigned int>::UnpackTo(const int offset,
+    const int count, unsigned int* data) const {
+  NOT_IMPLEMENTED;
+}
+
+template <> void Blob<int>::UnpackTo(const int offset, const int count,
+    int* data) const {
+  NOT_IMPLEMENTED;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::UnpackTo(const int offset, const int count,
+    Dtype* data) const {
+  CHECK(packed_data_) << "Blob is not packed";
+  CHECK_GE(offset, 0);
+  CHECK_LE(offset + count, count_);
+  if (count == 0) { return; }
+  if (storage_precision_ == INT8) {
+    const int slices = packed_scales_->size() / sizeof(float);
+    const int slice_size = count_ / slices;
+    CHECK_EQ(offset % slice_size, 0) << "Partial slice of INT8 data";
+    CHECK_EQ(count % slice_size, 0) << "Partial slice of INT8 data";
+    caffe_cpu_dequantize_slices(count / slice_size, slice_size,
+        static_cast<const int8_t*>(packed_data_->cpu_data()) + offset,
+        static_cast<const float*>(packed_scales_->cpu_data()) +
+        offset / slice_size, data);
+  } else {
+    caffe_cpu_unpack(count, static_cast<const uint16_t*>(
+        packed_data_->cpu_data()) + offset, storage_precision_, data);
+  }
+}
+
+template <typename Dtype>
+void Blob<Dtype>::UnpackTo(Dtype* data) const {
+  UnpackTo(0, count_, data);
+}
+
+template <typename Dtype>
+void Blob<Dtype>::Unpack() {
+  UnpackData();
+  packed_data_.reset();
+  packed_scales_.reset();
+  storage_precision_ = NATIVE;
+}
+
+template <> void Blob<unsigned int>::ReorderChannelBlock(const int block) {
+  NOT_IMPLEMENTED;
+}
+
+template <> void Blob<int>::ReorderChannelBlock(const int block) {
+  NOT_IMPLEMENTED;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::ReorderChannelBlock(const int block) {
+  if (block == channel_block_) { return; }
+  CHECK_EQ(num_axes(), 4) << "Only 4D blobs have a blocked layout.";
+  CHECK_GE(block, 0);
+  CHECK_EQ(channels() % std::max(block, 1), 0)
+      << "The channels must be divisible by the channel block.";
+  const int spatial_dim = count(2);
+  // Reorder in place, through scratch memory from the caching host allocator,
+  // as data_ may be shared with other blobs (see Net's memory plan).
+  void* scratch;
+  bool scratch_use_cuda, scratch_use_pool;
+  CaffeMallocHost(&scratch, count_ * sizeof(Dtype), &scratch_use_cuda,
+      &scratch_use_pool);
+  Dtype* scratch_data = static_cast<Dtype*>(scratch);
+  Dtype* data = mutable_cpu_data();
+  if (channel_block_ && block) {
+    // Go through NCHW from one channel block to another.
+    nchwc_to_nchw_cpu(num(), channels(), spatial_dim, channel_block_, data,
+        scratch_data);
+    nchw_to_nchwc_cpu(num(), channels(), spatial_dim, block, scratch_data,
+        data);
+  } else {
+    if (block) {
+      nchw_to_nchwc_cpu(num(), channels(), spatial_dim, block, data,
+          scratch_data);
+    } else {
+      nchwc_to_nchw_cpu(num(), channels(), spatial_dim, channel_block_, data,
+          scratch_data);
+    }
+    caffe_copy(count_, scratch_data, data);
+  }
+  CaffeFreeHost(scratch, count_ * sizeof(Dtype), scratch_use_cuda,
+      scratch_use_pool);
+  channel_block_ = block;
 }
 
 // The "update" method is used for parameter blobs in a Net, which are stored
@@ -152,10 +384,23 @@ template <> void Blob<int>::Update() { NOT_IMPLEMENTED; }
 
 template <typename Dtype>
 void Blob<Dtype>::Update() {
+  CHECK(diff_) << "Blob has no diff";
+  Unpack();
   // We will perform update based on where the data is located.
   switch (data_->head()) {
   case SyncedMemory::HEAD_AT_CPU:
     // perform computation on CPU
+    if (diff_rows_) {
+      // The diff is zero but for the rows written.
+      const int row_size = count(1);
+      const Dtype* diff = static_cast<const Dtype*>(diff_->cpu_data());
+      Dtype* data = static_cast<Dtype*>(data_->mutable_cpu_data());
+      for (int i = 0; i < diff_rows_->size(); ++i) {
+        const int offset = diff_rows_->row(i) * row_size;
+        caffe_axpy<Dtype>(row_size, Dtype(-1), diff + offset, data + offset);
+      }
+      break;
+    }
     caffe_axpy<Dtype>(count_, Dtype(-1),
         static_cast<const Dtype*>(diff_->cpu_data()),
         static_cast<Dtype*>(data_->mutable_cpu_data()));
@@ -189,6 +434,7 @@ template <> int Blob<int>::asum_data() const {
 template <typename Dtype>
 Dtype Blob<Dtype>::asum_data() const {
   if (!data_) { return 0; }
+  UnpackData();
   switch (data_->head()) {
   case SyncedMemory::HEAD_AT_CPU:
     return caffe_cpu_asum(count_, cpu_data());
@@ -261,6 +507,7 @@ Dtype Blob<Dtype>::sumsq_data() const {
   Dtype sumsq;
   const Dtype* data;
   if (!data_) { return 0; }
+  UnpackData();
   switch (data_->head()) {
   case SyncedMemory::HEAD_AT_CPU:
     data = cpu_data();
@@ -332,6 +579,7 @@ template <typename Dtype>
 void Blob<Dtype>::scale_data(Dtype scale_factor) {
   Dtype* data;
   if (!data_) { return; }
+  Unpack();
   switch (data_->head()) {
   case SyncedMemory::HEAD_AT_CPU:
     data = mutable_cpu_data();
@@ -421,20 +669,16 @@ void Blob<Dtype>::CopyFrom(const Blob& source, bool copy_diff, bool reshape) {
   switch (Caffe::mode()) {
   case Caffe::GPU:
     if (copy_diff) {
-      caffe_copy(count_, source.gpu_diff(),
-          static_cast<Dtype*>(diff_->mutable_gpu_data()));
+      caffe_copy(count_, source.gpu_diff(), mutable_gpu_diff());
     } else {
-      caffe_copy(count_, source.gpu_data(),
-          static_cast<Dtype*>(data_->mutable_gpu_data()));
+      caffe_copy(count_, source.gpu_data(), mutable_gpu_data());
     }
     break;
   case Caffe::CPU:
     if (copy_diff) {
-      caffe_copy(count_, source.cpu_diff(),
-          static_cast<Dtype*>(diff_->mutable_cpu_data()));
+      caffe_copy(count_, source.cpu_diff(), mutable_cpu_diff());
     } else {
-      caffe_copy(count_, source.cpu_data(),
-          static_cast<Dtype*>(data_->mutable_cpu_data()));
+      caffe_copy(count_, source.cpu_data(), mutable_cpu_data());
     }
     break;
   default:
@@ -478,6 +722,10 @@ void Blob<Dtype>::FromProto(const BlobProto& proto, bool reshape) {
       data_vec[i] = proto.data(i);
     }
   }
+  // The diffs of a blob without one, as in a forward-only net, are dropped.
+  if (diff_disabled_) {
+    return;
+  }
   if (proto.double_diff_size() > 0) {
     CHECK_EQ(count_, proto.double_diff_size());
     Dtype* diff_vec = mutable_cpu_diff();
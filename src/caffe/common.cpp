@@ -1,10 +1,12 @@
 #include <boost/thread.hpp>
 #include <glog/logging.h>
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <ctime>
 
 #include "caffe/common.hpp"
+#include "caffe/util/parallel.hpp"
 #include "caffe/util/rng.hpp"
 
 namespace caffe {
@@ -49,11 +51,45 @@ void GlobalInit(int* pargc, char*** pargv) {
   ::google::InstallFailureSignalHandler();
 }
 
+void Caffe::set_host_alignment(size_t alignment) {
+  CHECK_GE(alignment, sizeof(void*)) << "host alignment is too small";
+  CHECK_EQ(alignment & (alignment - 1), 0)
+      << "host alignment must be a power of two";
+  Get().host_alignment_ = alignment;
+}
+
+static int num_cores() {
+  return std::max(1u, boost::thread::hardware_concurrency());
+}
+
+// All the cores, unless OpenMP is told otherwise.
+static int default_num_threads() {
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return num_cores();
+#endif
+}
+
+void Caffe::set_num_threads(int threads) {
+  CHECK_GE(threads, 0) << "the number of threads cannot be negative";
+  if (threads == 0) {
+    threads = num_cores();
+  }
+  Get().num_threads_ = threads;
+#ifdef _OPENMP
+  // For the loops which use OpenMP directly.
+  omp_set_num_threads(threads);
+#endif
+  caffe_set_blas_num_threads(threads);
+}
+
 #ifdef CPU_ONLY  // CPU-only Caffe.
 
 Caffe::Caffe()
     : random_generator_(), mode_(Caffe::CPU),
-      solver_count_(1), root_solver_(true) { }
+      solver_count_(1), root_solver_(true), host_alignment_(64),
+      host_huge_pages_(false), num_threads_(default_num_threads()) { }
 
 Caffe::~Caffe() { }
 
@@ -97,7 +133,9 @@ void* Caffe::RNG::generator() {
 
 Caffe::Caffe()
     : cublas_handle_(NULL), curand_generator_(NULL), random_generator_(),
-    mode_(Caffe::CPU), solver_count_(1), root_solver_(true) {
+    mode_(Caffe::CPU), solver_count_(1), root_solver_(true),
+    host_alignment_(64), host_huge_pages_(false),
+    num_threads_(default_num_threads()) {
   // Try to create a cublas handler, and report an error if failed (but we will
   // keep the program running as one might just want to run CPU code).
   if (cublasCreate(&cublas_handle_) != CUBLAS_STATUS_SUCCESS) {
@@ -29,17 +29,22 @@ void InternalThread::StartInternalThread() {
   int rand_seed = caffe_rng_rand();
   int solver_count = Caffe::solver_count();
   bool root_solver = Caffe::root_solver();
+  size_t host_alignment = Caffe::host_alignment();
+  bool host_huge_pages = Caffe::host_huge_pages();
+  int num_threads = Caffe::num_threads();
 
   try {
     thread_.reset(new boost::thread(&InternalThread::entry, this, device, mode,
-          rand_seed, solver_count, root_solver));
+          rand_seed, solver_count, root_solver, host_alignment,
+          host_huge_pages, num_threads));
   } catch (std::exception& e) {
     LOG(FATAL) << "Thread exception: " << e.what();
   }
 }
 
 void InternalThread::entry(int device, Caffe::Brew mode, int rand_seed,
-    int solver_count, bool root_solver) {
+    int solver_count, bool root_solver, size_t host_alignment,
+    bool host_huge_pages, int num_threads) {
 #ifndef CPU_ONLY
   CUDA_CHECK(cudaSetDevice(device));
 #endif
@@ -47,6 +52,9 @@ void InternalThread::entry(int device, Caffe::Brew mode, int rand_seed,
   Caffe::set_random_seed(rand_seed);
   Caffe::set_solver_count(solver_count);
   Caffe::set_root_solver(root_solver);
+  Caffe::set_host_alignment(host_alignment);
+  Caffe::set_host_huge_pages(host_huge_pages);
+  Caffe::set_num_threads(num_threads);
 
   InternalThreadEntry();
 }
@@ -1,4 +1,7 @@
 #include <boost/thread.hpp>
+#include <map>
+
+#include "caffe/filler.hpp"
 #include "caffe/layer.hpp"
 
 namespace caffe {
@@ -22,6 +25,27 @@ void Layer<Dtype>::Unlock() {
   }
 }
 
+template <typename Dtype>
+void Layer<Dtype>::FillParam(const int param_id,
+    const FillerParameter& filler_param) {
+  if (defer_fill_) {
+    deferred_fillers_[param_id] = filler_param;
+    return;
+  }
+  shared_ptr<Filler<Dtype> > filler(GetFiller<Dtype>(filler_param));
+  filler->Fill(blobs_[param_id].get());
+}
+
+template <typename Dtype>
+void Layer<Dtype>::FillDeferredParams() {
+  for (std::map<int, FillerParameter>::iterator it = deferred_fillers_.begin();
+       it != deferred_fillers_.end(); ++it) {
+    shared_ptr<Filler<Dtype> > filler(GetFiller<Dtype>(it->second));
+    filler->Fill(blobs_[it->first].get());
+  }
+  deferred_fillers_.clear();
+}
+
 INSTANTIATE_CLASS(Layer);
 
 }  // namespace caffe
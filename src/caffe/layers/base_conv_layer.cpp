@@ -1,10 +1,19 @@
 #include <algorithm>
+#include <cmath>
+#include <sstream>
 #include <vector>
 
-#include "caffe/filler.hpp"
 #include "caffe/layers/base_conv_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/conv_autotune.hpp"
+#include "caffe/util/direct_conv.hpp"
+#include "caffe/util/fft.hpp"
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/nchwc.hpp"
+#include "caffe/util/parallel.hpp"
+#include "caffe/util/quantize.hpp"
+#include "caffe/util/winograd.hpp"
 
 namespace caffe {
 
@@ -165,21 +174,75 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     // Initialize and fill the weights:
     // output channels x input channels per-group x kernel height x kernel width
     this->blobs_[0].reset(new Blob<Dtype>(weight_shape));
-    shared_ptr<Filler<Dtype> > weight_filler(GetFiller<Dtype>(
-        this->layer_param_.convolution_param().weight_filler()));
-    weight_filler->Fill(this->blobs_[0].get());
+    this->FillParam(0,
+        this->layer_param_.convolution_param().weight_filler());
     // If necessary, initialize and fill the biases.
     if (bias_term_) {
       this->blobs_[1].reset(new Blob<Dtype>(bias_shape));
-      shared_ptr<Filler<Dtype> > bias_filler(GetFiller<Dtype>(
-          this->layer_param_.convolution_param().bias_filler()));
-      bias_filler->Fill(this->blobs_[1].get());
+      this->FillParam(1,
+          this->layer_param_.convolution_param().bias_filler());
     }
   }
   kernel_dim_ = this->blobs_[0]->count(1);
   weight_offset_ = conv_out_channels_ * kernel_dim_ / group_;
   // Propagate gradients to the parameters (as directed by backward pass).
   this->param_propagate_down_.resize(this->blobs_.size(), true);
+  // Select the direct algorithm for 2D convolution with groups of few
+  // channels, and the Winograd algorithm for 3x3 convolution with stride 1
+  // and groups of many channels. Otherwise, Reshape chooses between GEMM and
+  // FFT for each input shape. AUTOTUNE selects the algorithm by benchmark
+  // for each input shape.
+  const int kDirectMaxGroupChannels = 4;
+  // The transforms of the tiles only pay off over GEMMs of many channels.
+  const int kWinogradMinGroupChannels = 128;
+  switch (conv_param.algorithm()) {
+  case ConvolutionParameter_Algorithm_AUTO:
+    if (algorithm_applies(ConvolutionParameter_Algorithm_DIRECT) &&
+        !force_nd_im2col_ && group_ > 1 &&
+        conv_in_channels_ / group_ <= kDirectMaxGroupChannels) {
+      algorithm_ = ConvolutionParameter_Algorithm_DIRECT;
+    } else if (algorithm_applies(ConvolutionParameter_Algorithm_WINOGRAD_2X2)
+        && !force_nd_im2col_ &&
+        conv_in_channels_ / group_ >= kWinogradMinGroupChannels &&
+        conv_out_channels_ / group_ >= kWinogradMinGroupChannels) {
+      algorithm_ = ConvolutionParameter_Algorithm_WINOGRAD_2X2;
+    } else {
+      algorithm_ = ConvolutionParameter_Algorithm_GEMM;
+    }
+    break;
+  case ConvolutionParameter_Algorithm_AUTOTUNE:
+    algorithm_ = ConvolutionParameter_Algorithm_GEMM;
+    break;
+  case ConvolutionParameter_Algorithm_DIRECT:
+    CHECK(algorithm_applies(conv_param.algorithm()))
+        << "Direct convolution requires 2D convolution.";
+    algorithm_ = conv_param.algorithm();
+    break;
+  case ConvolutionParameter_Algorithm_WINOGRAD_2X2:
+  case ConvolutionParameter_Algorithm_WINOGRAD_4X4:
+    CHECK(algorithm_applies(conv_param.algorithm()))
+        << "Winograd convolution requires 2D 3x3 kernels "
+        << "with stride 1 and no dilation.";
+    algorithm_ = conv_param.algorithm();
+    break;
+  case ConvolutionParameter_Algorithm_FFT:
+    CHECK(algorithm_applies(conv_param.algorithm()))
+        << "FFT convolution requires 2D convolution.";
+    algorithm_ = conv_param.algorithm();
+    break;
+  case ConvolutionParameter_Algorithm_GEMM:
+    algorithm_ = conv_param.algorithm();
+    break;
+  default:
+    LOG(FATAL) << "Unknown convolution algorithm.";
+  }
+  fft_h_ = 0;
+  fft_w_ = 0;
+  fft_weights_memory_.reset();
+  winograd_weights_memory_.reset();
+  nchwc_weights_memory_.reset();
+  use_sparse_weights_ = false;
+  autotuned_shape_.clear();
 }
 
 template <typename Dtype>
@@ -243,6 +306,41 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   top_dim_ = top[0]->count(channel_axis_);
   num_kernels_im2col_ = conv_in_channels_ * conv_out_spatial_dim_;
   num_kernels_col2im_ = reverse_dimensions() ? top_dim_ : bottom_dim_;
+  // Lower as many images together as requested, and as fit in the limit on
+  // the batched column and output buffers.
+  const ConvolutionParameter& conv_param =
+      this->layer_param_.convolution_param();
+  const size_t batch_image_size = sizeof(Dtype) * conv_out_spatial_dim_ *
+      (kernel_dim_ * group_ + conv_out_channels_);
+  im2col_batch_ = conv_param.im2col_batch_size() == 0 ? num_ :
+      std::min<int>(conv_param.im2col_batch_size(), num_);
+  if (batch_image_size > 0) {
+    im2col_batch_ = std::min<uint64_t>(im2col_batch_,
+        conv_param.col_buffer_limit() / batch_image_size);
+  }
+  im2col_batch_ = std::max(im2col_batch_, 1);
+  if (im2col_batch_ > 1) {
+    vector<int> batch_shape(2, im2col_batch_ * conv_out_spatial_dim_);
+    batch_shape[0] = kernel_dim_ * group_;
+    batch_col_buffer_.Reshape(batch_shape);
+    batch_shape[0] = conv_out_channels_;
+    batch_output_buffer_.Reshape(batch_shape);
+  }
+  if (conv_param.algorithm() == ConvolutionParameter_Algorithm_AUTOTUNE &&
+      Caffe::mode() == Caffe::CPU && autotuned_shape_ != *bottom_shape_) {
+    autotune_algorithm();
+  } else if (conv_param.algorithm() == ConvolutionParameter_Algorithm_AUTO &&
+      (algorithm_ == ConvolutionParameter_Algorithm_GEMM ||
+      algorithm_ == ConvolutionParameter_Algorithm_FFT)) {
+    // GEMM runs closer to the peak of the CPU than the FFT algorithm, which
+    // has to save much of the arithmetic to be faster.
+    const double kFFTMargin = 4;
+    set_algorithm(!force_nd_im2col_ && fft_preferred(kFFTMargin) ?
+        ConvolutionParameter_Algorithm_FFT :
+        ConvolutionParameter_Algorithm_GEMM);
+  } else {
+    set_algorithm(algorithm_);
+  }
   // Set up the all ones "bias multiplier" for adding biases by BLAS
   out_spatial_dim_ = top[0]->count(first_spatial_axis);
   if (bias_term_) {
@@ -253,6 +351,293 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+bool BaseConvolutionLayer<Dtype>::algorithm_applies(
+    const ConvolutionParameter_Algorithm algorithm) {
+  if (algorithm == ConvolutionParameter_Algorithm_GEMM) {
+    return true;
+  }
+  if (reverse_dimensions() || num_spatial_axes_ != 2) {
+    return false;
+  }
+  if (algorithm == ConvolutionParameter_Algorithm_DIRECT ||
+      algorithm == ConvolutionParameter_Algorithm_FFT) {
+    return true;
+  }
+  for (int i = 0; i < num_spatial_axes_; ++i) {
+    if (kernel_shape_.cpu_data()[i] != 3 || stride_.cpu_data()[i] != 1 ||
+        dilation_.cpu_data()[i] != 1) {
+      return false;
+    }
+  }
+  return algorithm == ConvolutionParameter_Algorithm_WINOGRAD_2X2 ||
+      algorithm == ConvolutionParameter_Algorithm_WINOGRAD_4X4;
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::set_algorithm(
+    const ConvolutionParameter_Algorithm algorithm) {
+  algorithm_ = algorithm;
+  const int winograd_tile = winograd_tile_;
+  switch (algorithm) {
+  case ConvolutionParameter_Algorithm_WINOGRAD_2X2:
+    winograd_tile_ = 2;
+    break;
+  case ConvolutionParameter_Algorithm_WINOGRAD_4X4:
+    winograd_tile_ = 4;
+    break;
+  default:
+    winograd_tile_ = 0;
+  }
+  if (winograd_tile_ != winograd_tile) {
+    winograd_weights_memory_.reset();
+  }
+  if (winograd_tile_) {
+    if (!winograd_input_buffer_) {
+      winograd_input_buffer_.reset(new Blob<Dtype>());
+      winograd_output_buffer_.reset(new Blob<Dtype>());
+      winograd_weight_buffer_.reset(new Blob<Dtype>());
+    }
+    const int alpha = winograd_tile_ + 2;
+    winograd_tiles_h_ = (output_shape_[0] + winograd_tile_ - 1) /
+        winograd_tile_;
+    winograd_tiles_w_ = (output_shape_[1] + winograd_tile_ - 1) /
+        winograd_tile_;
+    vector<int> winograd_shape(3, alpha * alpha);
+    winograd_shape[1] = conv_in_channels_;
+    winograd_shape[2] = winograd_tiles_h_ * winograd_tiles_w_;
+    winograd_input_buffer_->Reshape(winograd_shape);
+    winograd_shape[1] = conv_out_channels_;
+    winograd_output_buffer_->Reshape(winograd_shape);
+    winograd_shape[2] = conv_in_channels_ / group_;
+    winograd_weight_buffer_->Reshape(winograd_shape);
+  } else {
+    // The buffers of the algorithms not set are freed, such as those which
+    // autotune_algorithm reshaped to time the candidates.
+    winograd_input_buffer_.reset();
+    winograd_output_buffer_.reset();
+    winograd_weight_buffer_.reset();
+  }
+  if (algorithm == ConvolutionParameter_Algorithm_FFT) {
+    if (!fft_input_buffer_) {
+      fft_input_buffer_.reset(new Blob<Dtype>());
+      fft_output_buffer_.reset(new Blob<Dtype>());
+      fft_weight_buffer_.reset(new Blob<Dtype>());
+    }
+    // The padded input fits in the FFT grid, so that the circular
+    // correlation does not wrap around.
+    const int fft_h = fft_size(conv_input_shape_.cpu_data()[1] +
+        2 * pad_.cpu_data()[0]);
+    const int fft_w = fft_size(conv_input_shape_.cpu_data()[2] +
+        2 * pad_.cpu_data()[1]);
+    if (fft_h != fft_h_ || fft_w != fft_w_) {
+      fft_weights_memory_.reset();
+    }
+    fft_h_ = fft_h;
+    fft_w_ = fft_w;
+    vector<int> fft_shape(2, 2 * fft_spectrum_size(fft_h_, fft_w_));
+    fft_shape[0] = conv_in_channels_;
+    fft_input_buffer_->Reshape(fft_shape);
+    fft_shape[0] = conv_out_channels_;
+    fft_output_buffer_->Reshape(fft_shape);
+    fft_shape[0] = conv_out_channels_ * conv_in_channels_ / group_;
+    fft_weight_buffer_->Reshape(fft_shape);
+  } else {
+    fft_input_buffer_.reset();
+    fft_output_buffer_.reset();
+    fft_weight_buffer_.reset();
+    fft_weights_memory_.reset();
+  }
+}
+
+template <typename Dtype>
+bool BaseConvolutionLayer<Dtype>::fft_preferred(const double margin) {
+  if (!algorithm_applies(ConvolutionParameter_Algorithm_FFT)) {
+    return false;
+  }
+  const int fft_h = fft_size(conv_input_shape_.cpu_data()[1] +
+      2 * pad_.cpu_data()[0]);
+  const int fft_w = fft_size(conv_input_shape_.cpu_data()[2] +
+      2 * pad_.cpu_data()[1]);
+  const double spectrum_size = fft_spectrum_size(fft_h, fft_w);
+  const double filters = conv_out_channels_ * (conv_in_channels_ / group_);
+  if (2 * spectrum_size * filters * sizeof(Dtype) >
+      this->layer_param_.convolution_param().col_buffer_limit()) {
+    return false;
+  }
+  // Count about 5 N log2(N) operations per transform of N points, 8 per
+  // complex multiply-add of the spectra, and 2 per multiply-add of GEMM.
+  // The weights are transformed for every pass when training.
+  const double points = static_cast<double>(fft_h) * fft_w;
+  const double transform = 5 * points * std::log(points) / std::log(2.);
+  double fft = num_ * ((conv_in_channels_ + conv_out_channels_) * transform
+      + 8 * filters * spectrum_size);
+  if (this->phase_ == TRAIN) {
+    fft += filters * transform;
+  }
+  const double gemm = 2. * num_ * conv_out_channels_ * kernel_dim_ *
+      conv_out_spatial_dim_;
+  return margin * fft < gemm;
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::autotune_algorithm() {
+  autotuned_shape_ = *bottom_shape_;
+  // F(4x4, 3x3) is left out for its rounding error.
+  vector<ConvolutionParameter_Algorithm> candidates(1,
+      ConvolutionParameter_Algorithm_GEMM);
+  if (algorithm_applies(ConvolutionParameter_Algorithm_DIRECT)) {
+    candidates.push_back(ConvolutionParameter_Algorithm_DIRECT);
+  }
+  if (algorithm_applies(ConvolutionParameter_Algorithm_WINOGRAD_2X2)) {
+    candidates.push_back(ConvolutionParameter_Algorithm_WINOGRAD_2X2);
+  }
+  // FFT is only timed where it may be competitive.
+  if (fft_preferred(1)) {
+    candidates.push_back(ConvolutionParameter_Algorithm_FFT);
+  }
+  if (candidates.size() == 1) {
+    set_algorithm(candidates[0]);
+    return;
+  }
+  std::ostringstream key;
+  key << "bottom";
+  for (int i = 0; i < bottom_shape_->size(); ++i) {
+    key << " " << (*bottom_shape_)[i];
+  }
+  key << " output " << num_output_ << " kernel";
+  for (int i = 0; i < num_spatial_axes_; ++i) {
+    key << " " << kernel_shape_.cpu_data()[i];
+  }
+  key << " stride";
+  for (int i = 0; i < num_spatial_axes_; ++i) {
+    key << " " << stride_.cpu_data()[i];
+  }
+  key << " pad";
+  for (int i = 0; i < num_spatial_axes_; ++i) {
+    key << " " << pad_.cpu_data()[i];
+  }
+  key << " dilation";
+  for (int i = 0; i < num_spatial_axes_; ++i) {
+    key << " " << dilation_.cpu_data()[i];
+  }
+  key << " group " << group_ << " im2col_batch " << im2col_batch_ << " "
+      << Phase_Name(this->phase_) << " dtype " << sizeof(Dtype) << " "
+      << ConvAutotuneCache::MachineKey();
+  ConvolutionParameter_Algorithm algorithm;
+  if (ConvAutotuneCache::Lookup(key.str(), &algorithm) &&
+      std::find(candidates.begin(), candidates.end(), algorithm) !=
+      candidates.end()) {
+    set_algorithm(algorithm);
+    return;
+  }
+  // Time the forward pass, and the backward pass when training, on scratch
+  // blobs: the best of a few runs after a warm-up run.
+  const int kAutotuneRuns = 3;
+  Blob<Dtype> input(vector<int>(1, num_ * bottom_dim_));
+  Blob<Dtype> output(vector<int>(1, num_ * top_dim_));
+  Blob<Dtype> weights(this->blobs_[0]->shape());
+  caffe_set(input.count(), Dtype(1), input.mutable_cpu_data());
+  caffe_set(output.count(), Dtype(1), output.mutable_cpu_diff());
+  caffe_set(weights.count(), Dtype(1), weights.mutable_cpu_data());
+  CPUTimer timer;
+  float best_time = 0;
+  for (int i = 0; i < candidates.size(); ++i) {
+    set_algorithm(candidates[i]);
+    float time = 0;
+    for (int run = 0; run <= kAutotuneRuns; ++run) {
+      timer.Start();
+      forward_cpu_conv(input.cpu_data(), weights.cpu_data(),
+          output.mutable_cpu_data());
+      if (this->phase_ == TRAIN) {
+        weight_cpu_conv(input.cpu_data(), output.cpu_diff(),
+            weights.mutable_cpu_diff());
+        backward_cpu_conv(output.cpu_diff(), weights.cpu_data(),
+            input.mutable_cpu_diff());
+      }
+      timer.Stop();
+      if (run == 1 || (run > 1 && timer.MicroSeconds() < time)) {
+        time = timer.MicroSeconds();
+      }
+    }
+    if (i == 0 || time < best_time) {
+      best_time = time;
+      algorithm = candidates[i];
+    }
+  }
+  LOG(INFO) << "Autotuned convolution " << this->layer_param_.name()
+      << " to " << ConvolutionParameter_Algorithm_Name(algorithm);
+  ConvAutotuneCache::Insert(key.str(), algorithm);
+  set_algorithm(algorithm);
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_conv(const Dtype* input,
+    const Dtype* weights, Dtype* output) {
+  switch (use_sparse_weights_ ? ConvolutionParameter_Algorithm_GEMM :
+      algorithm_) {
+  case ConvolutionParameter_Algorithm_DIRECT:
+    forward_cpu_direct(input, weights, output);
+    break;
+  case ConvolutionParameter_Algorithm_WINOGRAD_2X2:
+  case ConvolutionParameter_Algorithm_WINOGRAD_4X4:
+    forward_cpu_winograd(input, weights, output);
+    break;
+  case ConvolutionParameter_Algorithm_FFT:
+    forward_cpu_fft(input, weights, output);
+    break;
+  default:
+    for (int n = 0; n < num_; n += im2col_batch_) {
+      forward_cpu_gemm_batch(input + n * bottom_dim_, weights,
+          output + n * top_dim_, std::min(im2col_batch_, num_ - n));
+    }
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::backward_cpu_conv(const Dtype* output,
+    const Dtype* weights, Dtype* input) {
+  switch (algorithm_) {
+  case ConvolutionParameter_Algorithm_DIRECT:
+    backward_cpu_direct(output, weights, input);
+    break;
+  case ConvolutionParameter_Algorithm_WINOGRAD_2X2:
+  case ConvolutionParameter_Algorithm_WINOGRAD_4X4:
+    backward_cpu_winograd(output, weights, input);
+    break;
+  case ConvolutionParameter_Algorithm_FFT:
+    backward_cpu_fft(output, weights, input);
+    break;
+  default:
+    for (int n = 0; n < num_; ++n) {
+      backward_cpu_gemm(output + n * top_dim_, weights,
+          input + n * bottom_dim_);
+    }
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::weight_cpu_conv(const Dtype* input,
+    const Dtype* output, Dtype* weights) {
+  switch (algorithm_) {
+  case ConvolutionParameter_Algorithm_DIRECT:
+    weight_cpu_direct(input, output, weights);
+    break;
+  case ConvolutionParameter_Algorithm_WINOGRAD_2X2:
+  case ConvolutionParameter_Algorithm_WINOGRAD_4X4:
+    weight_cpu_winograd(input, output, weights);
+    break;
+  case ConvolutionParameter_Algorithm_FFT:
+    weight_cpu_fft(input, output, weights);
+    break;
+  default:
+    for (int n = 0; n < num_; n += im2col_batch_) {
+      weight_cpu_gemm_batch(input + n * bottom_dim_, output + n * top_dim_,
+          weights, std::min(im2col_batch_, num_ - n));
+    }
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
     const Dtype* weights, Dtype* output, bool skip_im2col) {
@@ -264,10 +649,621 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
     col_buff = col_buffer_.cpu_data();
   }
   for (int g = 0; g < group_; ++g) {
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
-        group_, conv_out_spatial_dim_, kernel_dim_,
-        (Dtype)1., weights + weight_offset_ * g, col_buff + col_offset_ * g,
-        (Dtype)0., output + output_offset_ * g);
+    forward_cpu_gemm_group(g, weights, col_buff + col_offset_ * g,
+        conv_out_spatial_dim_, output + output_offset_ * g);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm_group(const int g,
+    const Dtype* weights, const Dtype* col_buff, const int spatial_dim,
+    Dtype* output) {
+  const int group_out_channels = conv_out_channels_ / group_;
+  if (use_sparse_weights_) {
+    sparse_weights_.MultiplyDense(group_out_channels * g,
+        group_out_channels * (g + 1), spatial_dim, col_buff, output);
+    return;
+  }
+  if (weights) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, group_out_channels,
+        spatial_dim, kernel_dim_, (Dtype)1., weights + weight_offset_ * g,
+        col_buff, (Dtype)0., output);
+    return;
+  }
+  // Packed weights are unpacked a panel of output channels at a time, each
+  // multiplied while it is in cache.
+  const int panel_rows = PackedWeights<Dtype>::panel_rows(kernel_dim_);
+  for (int o = 0; o < group_out_channels; o += panel_rows) {
+    const int rows = std::min(panel_rows, group_out_channels - o);
+    const int row = group_out_channels * g + o;
+    const Dtype* panel = packed_weights_.Panel(*this->blobs_[0], kernel_dim_,
+        row, row + rows);
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, rows, spatial_dim,
+        kernel_dim_, (Dtype)1., panel, col_buff, (Dtype)0.,
+        output + o * spatial_dim);
+  }
+}
+
+template <typename Dtype>
+const Dtype* BaseConvolutionLayer<Dtype>::forward_cpu_weights() {
+  const Blob<Dtype>& weights = *this->blobs_[0];
+  return weights.data_packed() ? NULL : weights.cpu_data();
+}
+
+template <typename Dtype>
+bool BaseConvolutionLayer<Dtype>::update_sparse_weights() {
+  use_sparse_weights_ = sparse_weights_.Update(*this->blobs_[0],
+      conv_out_channels_,
+      this->layer_param_.convolution_param().sparse_weight_threshold());
+  return use_sparse_weights_;
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::winograd_transform_weights(
+    const Dtype* weights) {
+  Blob<Dtype>& weight_blob = *this->blobs_[0];
+  const bool own_weights = this->own_weights(weights);
+  if (own_weights && winograd_weights_memory_ == weight_blob.data() &&
+      winograd_weights_version_ == weight_blob.data()->version()) {
+    return;
+  }
+  // Packed weights are unpacked only for as long as they are transformed.
+  SyncedMemory unpacked(weight_blob.count() * sizeof(Dtype));
+  if (!weights) {
+    weights = weight_blob.unpacked_cpu_data(&unpacked);
+  }
+  winograd_filter_transform_cpu(winograd_tile_, weights,
+      conv_out_channels_ * conv_in_channels_ / group_,
+      winograd_weight_buffer_->mutable_cpu_data());
+  if (own_weights) {
+    winograd_weights_memory_ = weight_blob.data();
+    winograd_weights_version_ = weight_blob.data()->version();
+  } else {
+    winograd_weights_memory_.reset();
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_winograd(const Dtype* input,
+    const Dtype* weights, Dtype* output) {
+  const int alpha = winograd_tile_ + 2;
+  const int tiles = winograd_tiles_h_ * winograd_tiles_w_;
+  const int in_channels = conv_in_channels_ / group_;
+  const int out_channels = conv_out_channels_ / group_;
+  winograd_transform_weights(weights);
+  const Dtype* filter_tile = winograd_weight_buffer_->cpu_data();
+  Dtype* input_tile = winograd_input_buffer_->mutable_cpu_data();
+  Dtype* output_tile = winograd_output_buffer_->mutable_cpu_data();
+  for (int n = 0; n < num_; ++n) {
+    winograd_input_transform_cpu(winograd_tile_, input + n * bottom_dim_,
+        conv_in_channels_, conv_input_shape_.cpu_data()[1],
+        conv_input_shape_.cpu_data()[2], pad_.cpu_data()[0],
+        pad_.cpu_data()[1], winograd_tiles_h_, winograd_tiles_w_, input_tile);
+    // Each element of the transform multiplies the weights by the inputs.
+    for (int x = 0; x < alpha * alpha; ++x) {
+      for (int g = 0; g < group_; ++g) {
+        caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, out_channels, tiles,
+            in_channels, (Dtype)1.,
+            filter_tile + (x * conv_out_channels_ + g * out_channels) *
+            in_channels,
+            input_tile + (x * conv_in_channels_ + g * in_channels) * tiles,
+            (Dtype)0.,
+            output_tile + (x * conv_out_channels_ + g * out_channels) * tiles);
+      }
+    }
+    winograd_output_transform_cpu(winograd_tile_, output_tile,
+        conv_out_channels_, output_shape_[0], output_shape_[1],
+        winograd_tiles_h_, winograd_tiles_w_, output + n * top_dim_);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::backward_cpu_winograd(const Dtype* output,
+    const Dtype* weights, Dtype* input) {
+  const int alpha = winograd_tile_ + 2;
+  const int tiles = winograd_tiles_h_ * winograd_tiles_w_;
+  const int in_channels = conv_in_channels_ / group_;
+  const int out_channels = conv_out_channels_ / group_;
+  winograd_transform_weights(weights);
+  const Dtype* filter_tile = winograd_weight_buffer_->cpu_data();
+  Dtype* input_tile = winograd_input_buffer_->mutable_cpu_data();
+  Dtype* output_tile = winograd_output_buffer_->mutable_cpu_data();
+  for (int n = 0; n < num_; ++n) {
+    winograd_output_transform_backward_cpu(winograd_tile_,
+        output + n * top_dim_, conv_out_channels_, output_shape_[0],
+        output_shape_[1], winograd_tiles_h_, winograd_tiles_w_, output_tile);
+    for (int x = 0; x < alpha * alpha; ++x) {
+      for (int g = 0; g < group_; ++g) {
+        caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, in_channels, tiles,
+            out_channels, (Dtype)1.,
+            filter_tile + (x * conv_out_channels_ + g * out_channels) *
+            in_channels,
+            output_tile + (x * conv_out_channels_ + g * out_channels) * tiles,
+            (Dtype)0.,
+            input_tile + (x * conv_in_channels_ + g * in_channels) * tiles);
+      }
+    }
+    winograd_input_transform_backward_cpu(winograd_tile_, input_tile,
+        conv_in_channels_, conv_input_shape_.cpu_data()[1],
+        conv_input_shape_.cpu_data()[2], pad_.cpu_data()[0],
+        pad_.cpu_data()[1], winograd_tiles_h_, winograd_tiles_w_,
+        input + n * bottom_dim_);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::weight_cpu_winograd(const Dtype* input,
+    const Dtype* output, Dtype* weights) {
+  const int alpha = winograd_tile_ + 2;
+  const int tiles = winograd_tiles_h_ * winograd_tiles_w_;
+  const int in_channels = conv_in_channels_ / group_;
+  const int out_channels = conv_out_channels_ / group_;
+  Dtype* filter_tile_diff = winograd_weight_buffer_->mutable_cpu_diff();
+  Dtype* input_tile = winograd_input_buffer_->mutable_cpu_data();
+  Dtype* output_tile = winograd_output_buffer_->mutable_cpu_data();
+  caffe_set(winograd_weight_buffer_->count(), Dtype(0), filter_tile_diff);
+  for (int n = 0; n < num_; ++n) {
+    winograd_input_transform_cpu(winograd_tile_, input + n * bottom_dim_,
+        conv_in_channels_, conv_input_shape_.cpu_data()[1],
+        conv_input_shape_.cpu_data()[2], pad_.cpu_data()[0],
+        pad_.cpu_data()[1], winograd_tiles_h_, winograd_tiles_w_, input_tile);
+    winograd_output_transform_backward_cpu(winograd_tile_,
+        output + n * top_dim_, conv_out_channels_, output_shape_[0],
+        output_shape_[1], winograd_tiles_h_, winograd_tiles_w_, output_tile);
+    for (int x = 0; x < alpha * alpha; ++x) {
+      for (int g = 0; g < group_; ++g) {
+        caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, out_channels,
+            in_channels, tiles, (Dtype)1.,
+            output_tile + (x * conv_out_channels_ + g * out_channels) * tiles,
+            input_tile + (x * conv_in_channels_ + g * in_channels) * tiles,
+            (Dtype)1.,
+            filter_tile_diff + (x * conv_out_channels_ + g * out_channels) *
+            in_channels);
+      }
+    }
+  }
+  // The transforms are linear, so the gradients of all images are
+  // transformed back at once.
+  winograd_filter_transform_backward_cpu(winograd_tile_, filter_tile_diff,
+      conv_out_channels_ * in_channels, weights);
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_direct(const Dtype* input,
+    const Dtype* weights, Dtype* output) {
+  // Packed weights are unpacked for the pass only.
+  SyncedMemory unpacked(this->blobs_[0]->count() * sizeof(Dtype));
+  if (!weights) {
+    weights = this->blobs_[0]->unpacked_cpu_data(&unpacked);
+  }
+  for (int n = 0; n < num_; ++n) {
+    conv_direct_cpu(input + n * bottom_dim_, conv_in_channels_,
+        conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+        weights, conv_out_channels_, group_,
+        kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1],
+        dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+        output + n * top_dim_);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::backward_cpu_direct(const Dtype* output,
+    const Dtype* weights, Dtype* input) {
+  for (int n = 0; n < num_; ++n) {
+    conv_direct_backward_cpu(output + n * top_dim_, conv_in_channels_,
+        conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+        weights, conv_out_channels_, group_,
+        kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1],
+        dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+        input + n * bottom_dim_);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::weight_cpu_direct(const Dtype* input,
+    const Dtype* output, Dtype* weights) {
+  for (int n = 0; n < num_; ++n) {
+    conv_direct_weight_cpu(input + n * bottom_dim_, output + n * top_dim_,
+        conv_in_channels_, conv_input_shape_.cpu_data()[1],
+        conv_input_shape_.cpu_data()[2], conv_out_channels_, group_,
+        kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1],
+        dilation_.cpu_data()[0], dilation_.cpu_data()[1], weights);
+  }
+}
+
+template <typename Dtype>
+bool BaseConvolutionLayer<Dtype>::own_weights(const Dtype* weights) {
+  const Blob<Dtype>& weight_blob = *this->blobs_[0];
+  return !weights || (!weight_blob.data_packed() &&
+      weights == weight_blob.cpu_data());
+}
+
+// The loops of the FFT algorithm run over images, channels or filters whose
+// spectra are computed apart from each other, split over the threads.
+
+// Transforms count images of image_size values each, placed in the grid
+// alike, into consecutive spectra.
+template <typename Dtype>
+class FFTForwardImages {
+ public:
+  FFTForwardImages(const Dtype* data, const int image_size, const int height,
+      const int width, const int offset_h, const int offset_w,
+      const int step_h, const int step_w, const int fft_h, const int fft_w,
+      Dtype* spectra)
+      : data_(data), image_size_(image_size), height_(height), width_(width),
+        offset_h_(offset_h), offset_w_(offset_w), step_h_(step_h),
+        step_w_(step_w), fft_h_(fft_h), fft_w_(fft_w), spectra_(spectra) {}
+
+  void operator()(const int begin, const int end) const {
+    const int spectrum_size = fft_spectrum_size(fft_h_, fft_w_);
+    for (int i = begin; i < end; ++i) {
+      fft2d_forward_cpu(data_ + i * image_size_, height_, width_, offset_h_,
+          offset_w_, step_h_, step_w_, fft_h_, fft_w_,
+          spectra_ + 2 * i * spectrum_size);
+    }
+  }
+
+ private:
+  const Dtype* data_;
+  const int image_size_, height_, width_, offset_h_, offset_w_, step_h_,
+      step_w_, fft_h_, fft_w_;
+  Dtype* spectra_;
+};
+
+// Each output is the correlation of the inputs of its group with its
+// filters, read at the stride.
+template <typename Dtype>
+class FFTCorrelateOutputs {
+ public:
+  FFTCorrelateOutputs(const Dtype* input_spectra,
+      const Dtype* weight_spectra, const int in_channels,
+      const int out_channels, const int fft_h, const int fft_w,
+      const int output_h, const int output_w, const int stride_h,
+      const int stride_w, Dtype* output_spectra, Dtype* output)
+      : input_spectra_(input_spectra), weight_spectra_(weight_spectra),
+        in_channels_(in_channels), out_channels_(out_channels), fft_h_(fft_h),
+        fft_w_(fft_w), output_h_(output_h), output_w_(output_w),
+        stride_h_(stride_h), stride_w_(stride_w),
+        output_spectra_(output_spectra), output_(output) {}
+
+  void operator()(const int begin, const int end) const {
+    const int spectrum_size = fft_spectrum_size(fft_h_, fft_w_);
+    for (int o = begin; o < end; ++o) {
+      const int g = o / out_channels_;
+      Dtype* output_spectrum = output_spectra_ + 2 * o * spectrum_size;
+      caffe_set(2 * spectrum_size, Dtype(0), output_spectrum);
+      for (int c = 0; c < in_channels_; ++c) {
+        fft_multiply_add_cpu(spectrum_size,
+            input_spectra_ + 2 * (g * in_channels_ + c) * spectrum_size,
+            weight_spectra_ + 2 * (o * in_channels_ + c) * spectrum_size,
+            true, output_spectrum);
+      }
+      fft2d_inverse_cpu(output_spectrum, fft_h_, fft_w_, output_h_,
+          output_w_, 0, 0, stride_h_, stride_w_,
+          output_ + o * output_h_ * output_w_);
+    }
+  }
+
+ private:
+  const Dtype* input_spectra_;
+  const Dtype* weight_spectra_;
+  const int in_channels_, out_channels_, fft_h_, fft_w_, output_h_,
+      output_w_, stride_h_, stride_w_;
+  Dtype* output_spectra_;
+  Dtype* output_;
+};
+
+// The gradient of each input is the convolution of the gradients of the
+// outputs of its group with their filters, read inside the padding.
+template <typename Dtype>
+class FFTConvolveInputs {
+ public:
+  FFTConvolveInputs(const Dtype* output_spectra, const Dtype* weight_spectra,
+      const int in_channels, const int out_channels, const int fft_h,
+      const int fft_w, const int height, const int width, const int pad_h,
+      const int pad_w, Dtype* input_spectra, Dtype* input)
+      : output_spectra_(output_spectra), weight_spectra_(weight_spectra),
+        in_channels_(in_channels), out_channels_(out_channels), fft_h_(fft_h),
+        fft_w_(fft_w), height_(height), width_(width), pad_h_(pad_h),
+        pad_w_(pad_w), input_spectra_(input_spectra), input_(input) {}
+
+  void operator()(const int begin, const int end) const {
+    const int spectrum_size = fft_spectrum_size(fft_h_, fft_w_);
+    for (int c = begin; c < end; ++c) {
+      const int g = c / in_channels_;
+      Dtype* input_spectrum = input_spectra_ + 2 * c * spectrum_size;
+      caffe_set(2 * spectrum_size, Dtype(0), input_spectrum);
+      for (int o = g * out_channels_; o < (g + 1) * out_channels_; ++o) {
+        fft_multiply_add_cpu(spectrum_size,
+            output_spectra_ + 2 * o * spectrum_size,
+            weight_spectra_ + 2 * (o * in_channels_ + c % in_channels_) *
+            spectrum_size, false, input_spectrum);
+      }
+      fft2d_inverse_cpu(input_spectrum, fft_h_, fft_w_, height_, width_,
+          pad_h_, pad_w_, 1, 1, input_ + c * height_ * width_);
+    }
+  }
+
+ private:
+  const Dtype* output_spectra_;
+  const Dtype* weight_spectra_;
+  const int in_channels_, out_channels_, fft_h_, fft_w_, height_, width_,
+      pad_h_, pad_w_;
+  Dtype* input_spectra_;
+  Dtype* input_;
+};
+
+// The gradient of each filter is the correlation of the gradient of its
+// output with its inputs, accumulated in the spectra.
+template <typename Dtype>
+class FFTCorrelateFilters {
+ public:
+  FFTCorrelateFilters(const Dtype* input_spectra,
+      const Dtype* output_spectra, const int in_channels,
+      const int out_channels, const int spectrum_size,
+      Dtype* weight_spectra_diff)
+      : input_spectra_(input_spectra), output_spectra_(output_spectra),
+        in_channels_(in_channels), out_channels_(out_channels),
+        spectrum_size_(spectrum_size),
+        weight_spectra_diff_(weight_spectra_diff) {}
+
+  void operator()(const int begin, const int end) const {
+    for (int o = begin; o < end; ++o) {
+      const int g = o / out_channels_;
+      for (int c = 0; c < in_channels_; ++c) {
+        fft_multiply_add_cpu(spectrum_size_,
+            input_spectra_ + 2 * (g * in_channels_ + c) * spectrum_size_,
+            output_spectra_ + 2 * o * spectrum_size_, true,
+            weight_spectra_diff_ + 2 * (o * in_channels_ + c) *
+            spectrum_size_);
+      }
+    }
+  }
+
+ private:
+  const Dtype* input_spectra_;
+  const Dtype* output_spectra_;
+  const int in_channels_, out_channels_, spectrum_size_;
+  Dtype* weight_spectra_diff_;
+};
+
+// Transforms the gradients of the filters back, read at the dilation, and
+// accumulates them into the weight diff.
+template <typename Dtype>
+class FFTInverseFilters {
+ public:
+  FFTInverseFilters(const Dtype* weight_spectra_diff, const int fft_h,
+      const int fft_w, const int kernel_h, const int kernel_w,
+      const int dilation_h, const int dilation_w, Dtype* weights)
+      : weight_spectra_diff_(weight_spectra_diff), fft_h_(fft_h),
+        fft_w_(fft_w), kernel_h_(kernel_h), kernel_w_(kernel_w),
+        dilation_h_(dilation_h), dilation_w_(dilation_w), weights_(weights) {}
+
+  void operator()(const int begin, const int end) const {
+    const int spectrum_size = fft_spectrum_size(fft_h_, fft_w_);
+    const int kernel_size = kernel_h_ * kernel_w_;
+    vector<Dtype> filter_diff(kernel_size);
+    for (int f = begin; f < end; ++f) {
+      fft2d_inverse_cpu(weight_spectra_diff_ + 2 * f * spectrum_size, fft_h_,
+          fft_w_, kernel_h_, kernel_w_, 0, 0, dilation_h_, dilation_w_,
+          &filter_diff[0]);
+      for (int k = 0; k < kernel_size; ++k) {
+        weights_[f * kernel_size + k] += filter_diff[k];
+      }
+    }
+  }
+
+ private:
+  const Dtype* weight_spectra_diff_;
+  const int fft_h_, fft_w_, kernel_h_, kernel_w_, dilation_h_, dilation_w_;
+  Dtype* weights_;
+};
+
+// About the operations of a transform of the fft_h x fft_w grid, 5 N log2(N)
+// for N points, for the grain of the loops.
+static int fft_transform_work(const int fft_h, const int fft_w) {
+  const double points = static_cast<double>(fft_h) * fft_w;
+  return static_cast<int>(5 * points * std::log(points) / std::log(2.));
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::fft_transform_weights(const Dtype* weights) {
+  Blob<Dtype>& weight_blob = *this->blobs_[0];
+  const bool own_weights = this->own_weights(weights);
+  if (own_weights && fft_weights_memory_ == weight_blob.data() &&
+      fft_weights_version_ == weight_blob.data()->version()) {
+    return;
+  }
+  // Packed weights are unpacked only for as long as they are transformed.
+  SyncedMemory unpacked(weight_blob.count() * sizeof(Dtype));
+  if (!weights) {
+    weights = weight_blob.unpacked_cpu_data(&unpacked);
+  }
+  const int kernel_h = kernel_shape_.cpu_data()[0];
+  const int kernel_w = kernel_shape_.cpu_data()[1];
+  const int dilation_h = dilation_.cpu_data()[0];
+  const int dilation_w = dilation_.cpu_data()[1];
+  const int filters = conv_out_channels_ * conv_in_channels_ / group_;
+  parallel_for(filters, FFTForwardImages<Dtype>(weights, kernel_h * kernel_w,
+      kernel_h, kernel_w, 0, 0, dilation_h, dilation_w, fft_h_, fft_w_,
+      fft_weight_buffer_->mutable_cpu_data()),
+      parallel_grain(fft_transform_work(fft_h_, fft_w_)));
+  if (own_weights) {
+    fft_weights_memory_ = weight_blob.data();
+    fft_weights_version_ = weight_blob.data()->version();
+  } else {
+    fft_weights_memory_.reset();
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_fft(const Dtype* input,
+    const Dtype* weights, Dtype* output) {
+  const int height = conv_input_shape_.cpu_data()[1];
+  const int width = conv_input_shape_.cpu_data()[2];
+  const int in_channels = conv_in_channels_ / group_;
+  const int out_channels = conv_out_channels_ / group_;
+  const int spectrum_size = fft_spectrum_size(fft_h_, fft_w_);
+  const int pad_h = pad_.cpu_data()[0];
+  const int pad_w = pad_.cpu_data()[1];
+  const int stride_h = stride_.cpu_data()[0];
+  const int stride_w = stride_.cpu_data()[1];
+  fft_transform_weights(weights);
+  const Dtype* weight_spectra = fft_weight_buffer_->cpu_data();
+  Dtype* input_spectra = fft_input_buffer_->mutable_cpu_data();
+  Dtype* output_spectra = fft_output_buffer_->mutable_cpu_data();
+  const int transform_work = fft_transform_work(fft_h_, fft_w_);
+  for (int n = 0; n < num_; ++n) {
+    parallel_for(conv_in_channels_, FFTForwardImages<Dtype>(
+        input + n * bottom_dim_, height * width, height, width, pad_h, pad_w,
+        1, 1, fft_h_, fft_w_, input_spectra), parallel_grain(transform_work));
+    parallel_for(conv_out_channels_, FFTCorrelateOutputs<Dtype>(
+        input_spectra, weight_spectra, in_channels, out_channels, fft_h_,
+        fft_w_, output_shape_[0], output_shape_[1], stride_h, stride_w,
+        output_spectra, output + n * top_dim_),
+        parallel_grain(8 * in_channels * spectrum_size + transform_work));
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::backward_cpu_fft(const Dtype* output,
+    const Dtype* weights, Dtype* input) {
+  const int height = conv_input_shape_.cpu_data()[1];
+  const int width = conv_input_shape_.cpu_data()[2];
+  const int in_channels = conv_in_channels_ / group_;
+  const int out_channels = conv_out_channels_ / group_;
+  const int spectrum_size = fft_spectrum_size(fft_h_, fft_w_);
+  const int pad_h = pad_.cpu_data()[0];
+  const int pad_w = pad_.cpu_data()[1];
+  const int stride_h = stride_.cpu_data()[0];
+  const int stride_w = stride_.cpu_data()[1];
+  fft_transform_weights(weights);
+  const Dtype* weight_spectra = fft_weight_buffer_->cpu_data();
+  Dtype* input_spectra = fft_input_buffer_->mutable_cpu_data();
+  Dtype* output_spectra = fft_output_buffer_->mutable_cpu_data();
+  const int transform_work = fft_transform_work(fft_h_, fft_w_);
+  for (int n = 0; n < num_; ++n) {
+    parallel_for(conv_out_channels_, FFTForwardImages<Dtype>(
+        output + n * top_dim_, conv_out_spatial_dim_, output_shape_[0],
+        output_shape_[1], 0, 0, stride_h, stride_w, fft_h_, fft_w_,
+        output_spectra), parallel_grain(transform_work));
+    parallel_for(conv_in_channels_, FFTConvolveInputs<Dtype>(output_spectra,
+        weight_spectra, in_channels, out_channels, fft_h_, fft_w_, height,
+        width, pad_h, pad_w, input_spectra, input + n * bottom_dim_),
+        parallel_grain(8 * out_channels * spectrum_size + transform_work));
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::weight_cpu_fft(const Dtype* input,
+    const Dtype* output, Dtype* weights) {
+  const int height = conv_input_shape_.cpu_data()[1];
+  const int width = conv_input_shape_.cpu_data()[2];
+  const int kernel_h = kernel_shape_.cpu_data()[0];
+  const int kernel_w = kernel_shape_.cpu_data()[1];
+  const int in_channels = conv_in_channels_ / group_;
+  const int out_channels = conv_out_channels_ / group_;
+  const int spectrum_size = fft_spectrum_size(fft_h_, fft_w_);
+  const int pad_h = pad_.cpu_data()[0];
+  const int pad_w = pad_.cpu_data()[1];
+  const int stride_h = stride_.cpu_data()[0];
+  const int stride_w = stride_.cpu_data()[1];
+  const int dilation_h = dilation_.cpu_data()[0];
+  const int dilation_w = dilation_.cpu_data()[1];
+  Dtype* weight_spectra_diff = fft_weight_buffer_->mutable_cpu_diff();
+  Dtype* input_spectra = fft_input_buffer_->mutable_cpu_data();
+  Dtype* output_spectra = fft_output_buffer_->mutable_cpu_data();
+  caffe_set(fft_weight_buffer_->count(), Dtype(0), weight_spectra_diff);
+  const int transform_work = fft_transform_work(fft_h_, fft_w_);
+  for (int n = 0; n < num_; ++n) {
+    parallel_for(conv_in_channels_, FFTForwardImages<Dtype>(
+        input + n * bottom_dim_, height * width, height, width, pad_h, pad_w,
+        1, 1, fft_h_, fft_w_, input_spectra), parallel_grain(transform_work));
+    parallel_for(conv_out_channels_, FFTForwardImages<Dtype>(
+        output + n * top_dim_, conv_out_spatial_dim_, output_shape_[0],
+        output_shape_[1], 0, 0, stride_h, stride_w, fft_h_, fft_w_,
+        output_spectra), parallel_grain(transform_work));
+    parallel_for(conv_out_channels_, FFTCorrelateFilters<Dtype>(
+        input_spectra, output_spectra, in_channels, out_channels,
+        spectrum_size, weight_spectra_diff),
+        parallel_grain(8 * in_channels * spectrum_size));
+  }
+  // The transform is linear, so the gradients of all images are
+  // transformed back at once.
+  parallel_for(conv_out_channels_ * in_channels, FFTInverseFilters<Dtype>(
+      weight_spectra_diff, fft_h_, fft_w_, kernel_h, kernel_w, dilation_h,
+      dilation_w, weights), parallel_grain(transform_work));
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_nchwc(const Dtype* input,
+    const Dtype* bias, Dtype* output, const int block) {
+  const int height = conv_input_shape_.cpu_data()[1];
+  const int width = conv_input_shape_.cpu_data()[2];
+  // The weights are only reordered again once they change.
+  Blob<Dtype>& weight_blob = *this->blobs_[0];
+  if (nchwc_weights_memory_ != weight_blob.data() ||
+      nchwc_weights_version_ != weight_blob.data()->version() ||
+      nchwc_weights_block_ != block) {
+    // Packed weights are unpacked only for as long as they are reordered.
+    SyncedMemory unpacked(weight_blob.count() * sizeof(Dtype));
+    nchwc_weight_buffer_.Reshape(weight_blob.shape());
+    conv_weights_to_nchwc_cpu(weight_blob.unpacked_cpu_data(&unpacked),
+        conv_out_channels_, conv_in_channels_, kernel_shape_.cpu_data()[0],
+        kernel_shape_.cpu_data()[1], block,
+        nchwc_weight_buffer_.mutable_cpu_data());
+    nchwc_weights_memory_ = weight_blob.data();
+    nchwc_weights_version_ = weight_blob.data()->version();
+    nchwc_weights_block_ = block;
+  }
+  const Dtype* nchwc_weights = nchwc_weight_buffer_.cpu_data();
+  for (int n = 0; n < num_; ++n) {
+    Dtype* image_output = output + n * top_dim_;
+    conv_nchwc_cpu(input + n * bottom_dim_, conv_in_channels_, height, width,
+        nchwc_weights, conv_out_channels_,
+        kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1],
+        dilation_.cpu_data()[0], dilation_.cpu_data()[1], block,
+        image_output);
+    if (!bias) { continue; }
+    for (int b = 0; b < num_output_ / block; ++b) {
+      const Dtype* block_bias = bias + b * block;
+      Dtype* block_output = image_output + b * out_spatial_dim_ * block;
+      for (int i = 0; i < out_spatial_dim_; ++i) {
+        for (int c = 0; c < block; ++c) {
+          block_output[i * block + c] += block_bias[c];
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm_int8(const int8_t* input,
+    const int8_t* weights, const Dtype* output_scales, Dtype* output,
+    int8_t* col_buff, int32_t* accum) {
+  const int8_t* col = input;
+  if (!is_1x1_) {
+    conv_im2col_cpu(input, col_buff);
+    col = col_buff;
+  }
+  for (int g = 0; g < group_; ++g) {
+    caffe_cpu_gemm_int8(CblasNoTrans, conv_out_channels_ / group_,
+        conv_out_spatial_dim_, kernel_dim_, weights + weight_offset_ * g,
+        col + col_offset_ * g, accum + output_offset_ * g);
+  }
+  for (int c = 0; c < conv_out_channels_; ++c) {
+    const int offset = c * conv_out_spatial_dim_;
+    for (int i = 0; i < conv_out_spatial_dim_; ++i) {
+      output[offset + i] = accum[offset + i] * output_scales[c];
+    }
   }
 }
 
@@ -320,6 +1316,100 @@ void BaseConvolutionLayer<Dtype>::backward_cpu_bias(Dtype* bias,
       input, bias_multiplier_.cpu_data(), 1., bias);
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::conv_im2col_batch_cpu(const Dtype* data,
+    const int batch) {
+  const int input_dim = reverse_dimensions() ? top_dim_ : bottom_dim_;
+  const int batch_spatial_dim = batch * conv_out_spatial_dim_;
+  Dtype* batch_col_buff = batch_col_buffer_.mutable_cpu_data();
+  for (int n = 0; n < batch; ++n) {
+    // The input of a 1x1 convolution is its own column buffer.
+    const Dtype* col_buff = data + n * input_dim;
+    if (!is_1x1_) {
+      conv_im2col_cpu(col_buff, col_buffer_.mutable_cpu_data());
+      col_buff = col_buffer_.cpu_data();
+    }
+    for (int i = 0; i < kernel_dim_ * group_; ++i) {
+      caffe_copy(conv_out_spatial_dim_, col_buff + i * conv_out_spatial_dim_,
+          batch_col_buff + i * batch_spatial_dim + n * conv_out_spatial_dim_);
+    }
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::gather_output_batch_cpu(
+    const Dtype* output, const int batch) {
+  const int output_dim = conv_out_channels_ * conv_out_spatial_dim_;
+  const int batch_spatial_dim = batch * conv_out_spatial_dim_;
+  Dtype* batch_output = batch_output_buffer_.mutable_cpu_data();
+  for (int n = 0; n < batch; ++n) {
+    for (int c = 0; c < conv_out_channels_; ++c) {
+      caffe_copy(conv_out_spatial_dim_,
+          output + n * output_dim + c * conv_out_spatial_dim_,
+          batch_output + c * batch_spatial_dim + n * conv_out_spatial_dim_);
+    }
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::scatter_output_batch_cpu(Dtype* output,
+    const int batch) {
+  const int output_dim = conv_out_channels_ * conv_out_spatial_dim_;
+  const int batch_spatial_dim = batch * conv_out_spatial_dim_;
+  const Dtype* batch_output = batch_output_buffer_.cpu_data();
+  for (int n = 0; n < batch; ++n) {
+    for (int c = 0; c < conv_out_channels_; ++c) {
+      caffe_copy(conv_out_spatial_dim_,
+          batch_output + c * batch_spatial_dim + n * conv_out_spatial_dim_,
+          output + n * output_dim + c * conv_out_spatial_dim_);
+    }
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm_batch(const Dtype* input,
+    const Dtype* weights, Dtype* output, const int batch) {
+  if (batch == 1) {
+    forward_cpu_gemm(input, weights, output);
+    return;
+  }
+  CHECK_LE(batch, im2col_batch_);
+  conv_im2col_batch_cpu(input, batch);
+  const int batch_spatial_dim = batch * conv_out_spatial_dim_;
+  const Dtype* batch_col_buff = batch_col_buffer_.cpu_data();
+  Dtype* batch_output = batch_output_buffer_.mutable_cpu_data();
+  for (int g = 0; g < group_; ++g) {
+    forward_cpu_gemm_group(g, weights,
+        batch_col_buff + kernel_dim_ * batch_spatial_dim * g,
+        batch_spatial_dim,
+        batch_output + conv_out_channels_ / group_ * batch_spatial_dim * g);
+  }
+  scatter_output_batch_cpu(output, batch);
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::weight_cpu_gemm_batch(const Dtype* input,
+    const Dtype* output, Dtype* weights, const int batch) {
+  if (batch == 1) {
+    weight_cpu_gemm(input, output, weights);
+    return;
+  }
+  CHECK_LE(batch, im2col_batch_);
+  conv_im2col_batch_cpu(input, batch);
+  gather_output_batch_cpu(output, batch);
+  const int batch_spatial_dim = batch * conv_out_spatial_dim_;
+  const Dtype* batch_col_buff = batch_col_buffer_.cpu_data();
+  const Dtype* batch_output = batch_output_buffer_.cpu_data();
+  for (int g = 0; g < group_; ++g) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels_ / group_,
+        kernel_dim_, batch_spatial_dim,
+        (Dtype)1., batch_output + conv_out_channels_ / group_ *
+        batch_spatial_dim * g,
+        batch_col_buff + kernel_dim_ * batch_spatial_dim * g,
+        (Dtype)1., weights + weight_offset_ * g);
+  }
+}
+
 #ifndef CPU_ONLY
 
 template <typename Dtype>
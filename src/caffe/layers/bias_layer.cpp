@@ -1,6 +1,5 @@
 #include <vector>
 
-#include "caffe/filler.hpp"
 #include "caffe/layers/bias_layer.hpp"
 #include "caffe/util/math_functions.hpp"
 
@@ -30,8 +29,7 @@ void BiasLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
         (num_axes == -1) ? bottom[0]->shape().end() : (shape_start + num_axes);
     vector<int> bias_shape(shape_start, shape_end);
     this->blobs_[0].reset(new Blob<Dtype>(bias_shape));
-    shared_ptr<Filler<Dtype> > filler(GetFiller<Dtype>(param.filler()));
-    filler->Fill(this->blobs_[0].get());
+    this->FillParam(0, param.filler());
   }
   this->param_propagate_down_.resize(this->blobs_.size(), true);
 }
@@ -24,7 +24,9 @@ void DeconvolutionLayer<Dtype>::compute_output_shape() {
 template <typename Dtype>
 void DeconvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
-  const Dtype* weight = this->blobs_[0]->cpu_data();
+  // Packed weights are unpacked for the pass only.
+  SyncedMemory unpacked(this->blobs_[0]->count() * sizeof(Dtype));
+  const Dtype* weight = this->blobs_[0]->unpacked_cpu_data(&unpacked);
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
@@ -2,6 +2,7 @@
 #include <vector>
 
 #include "caffe/layers/elu_layer.hpp"
+#include "caffe/util/fast_math.hpp"
 
 namespace caffe {
 
@@ -12,6 +13,10 @@ void ELULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
   Dtype alpha = this->layer_param_.elu_param().alpha();
+  if (this->layer_param_.math_accuracy() == FAST) {
+    caffe_cpu_fast_elu(count, alpha, bottom_data, top_data);
+    return;
+  }
   for (int i = 0; i < count; ++i) {
     top_data[i] = std::max(bottom_data[i], Dtype(0))
         + alpha * (exp(std::min(bottom_data[i], Dtype(0))) - Dtype(1));
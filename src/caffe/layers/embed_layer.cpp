@@ -1,8 +1,9 @@
+#include <algorithm>
 #include <vector>
 
-#include "caffe/filler.hpp"
 #include "caffe/layers/embed_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/parallel.hpp"
 
 namespace caffe {
 
@@ -30,16 +31,12 @@ void EmbedLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     weight_shape[1] = N_;
     this->blobs_[0].reset(new Blob<Dtype>(weight_shape));
     // fill the weights
-    shared_ptr<Filler<Dtype> > weight_filler(GetFiller<Dtype>(
-        this->layer_param_.embed_param().weight_filler()));
-    weight_filler->Fill(this->blobs_[0].get());
+    this->FillParam(0, this->layer_param_.embed_param().weight_filler());
     // If necessary, initialize and fill the bias term
     if (bias_term_) {
       vector<int> bias_shape(1, N_);
       this->blobs_[1].reset(new Blob<Dtype>(bias_shape));
-      shared_ptr<Filler<Dtype> > bias_filler(GetFiller<Dtype>(
-          this->layer_param_.embed_param().bias_filler()));
-      bias_filler->Fill(this->blobs_[1].get());
+      this->FillParam(1, this->layer_param_.embed_param().bias_filler());
     }
   }  // parameter initialization
   this->param_propagate_down_.resize(this->blobs_.size(), true);
@@ -61,25 +58,48 @@ void EmbedLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+// Copies the rows of the weights picked by a range of the inputs, and adds
+// the bias to them.
+template <typename Dtype>
+class EmbedForward {
+ public:
+  EmbedForward(const int N, const int K, const Dtype* bottom_data,
+      const Dtype* weight, const Dtype* bias, Dtype* top_data)
+      : N_(N), K_(K), bottom_data_(bottom_data), weight_(weight), bias_(bias),
+        top_data_(top_data) {}
+
+  void operator()(const int begin, const int end) const {
+    int index;
+    for (int n = begin; n < end; ++n) {
+      index = static_cast<int>(bottom_data_[n]);
+      DCHECK_GE(index, 0);
+      DCHECK_LT(index, K_);
+      DCHECK_EQ(static_cast<Dtype>(index), bottom_data_[n])
+          << "non-integer input";
+      if (bias_) {
+        caffe_add(N_, weight_ + index * N_, bias_, top_data_ + n * N_);
+      } else {
+        std::copy(weight_ + index * N_, weight_ + (index + 1) * N_,
+            top_data_ + n * N_);
+      }
+    }
+  }
+
+ private:
+  const int N_, K_;
+  const Dtype* bottom_data_;
+  const Dtype* weight_;
+  const Dtype* bias_;
+  Dtype* top_data_;
+};
+
 template <typename Dtype>
 void EmbedLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  const Dtype* weight = this->blobs_[0]->cpu_data();
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  int index;
-  for (int n = 0; n < M_; ++n) {
-    index = static_cast<int>(bottom_data[n]);
-    DCHECK_GE(index, 0);
-    DCHECK_LT(index, K_);
-    DCHECK_EQ(static_cast<Dtype>(index), bottom_data[n]) << "non-integer input";
-    caffe_copy(N_, weight + index * N_, top_data + n * N_);
-  }
-  if (bias_term_) {
-    const Dtype* bias = this->blobs_[1]->cpu_data();
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, Dtype(1),
-        bias_multiplier_.cpu_data(), bias, Dtype(1), top_data);
-  }
+  const Dtype* bias = bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  parallel_for(M_, EmbedForward<Dtype>(N_, K_, bottom[0]->cpu_data(),
+      this->blobs_[0]->cpu_data(), bias, top[0]->mutable_cpu_data()),
+      parallel_grain(N_));
 }
 
 template <typename Dtype>
@@ -99,6 +119,7 @@ void EmbedLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       DCHECK_EQ(static_cast<Dtype>(index), bottom_data[n])
           << "non-integer input";
       caffe_axpy(N_, Dtype(1), top_diff + n * N_, weight_diff + index * N_);
+      this->blobs_[0]->mark_diff_row(index);
     }
   }
   if (bias_term_ && this->param_propagate_down_[1]) {
@@ -6,7 +6,9 @@ TODO:
   :: don't forget to update hdf5_daa_layer.cu accordingly
 - add ability to shuffle filenames if flag is set
 */
+#include <climits>
 #include <fstream>  // NOLINT(readability/streams)
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -22,6 +24,13 @@ namespace caffe {
 template <typename Dtype>
 HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() { }
 
+// The integer up to which every integer is exact in Dtype.
+template <typename Dtype>
+static int max_exact_index() {
+  const int digits = std::numeric_limits<Dtype>::digits;
+  return digits < 31 ? 1 << digits : INT_MAX;
+}
+
 // Load data and label from HDF5 filename into the class property blobs.
 template <typename Dtype>
 void HDF5DataLayer<Dtype>::LoadHDF5FileData(const char* filename) {
@@ -33,14 +42,39 @@ void HDF5DataLayer<Dtype>::LoadHDF5FileData(const char* filename) {
 
   int top_size = this->layer_param_.top_size();
   hdf_blobs_.resize(top_size);
+  hdf_index_blobs_.resize(top_size);
 
   const int MIN_DATA_DIM = 1;
   const int MAX_DATA_DIM = INT_MAX;
 
   for (int i = 0; i < top_size; ++i) {
     hdf_blobs_[i] = shared_ptr<Blob<Dtype> >(new Blob<Dtype>());
-    hdf5_load_nd_dataset(file_id, this->layer_param_.top(i).c_str(),
-        MIN_DATA_DIM, MAX_DATA_DIM, hdf_blobs_[i].get());
+    // The datasets of groups, as those of sparse matrices, are found in
+    // their group.
+    const string& name = this->layer_param_.top(i);
+    const size_t slash = name.rfind('/');
+    hid_t group_id = file_id;
+    if (slash != string::npos) {
+      group_id = H5Gopen2(file_id, name.substr(0, slash).c_str(),
+          H5P_DEFAULT);
+      CHECK_GE(group_id, 0) << "Failed to open HDF5 group "
+          << name.substr(0, slash);
+    }
+    const bool index = csr_values_top_[i] >= 0 || (csr_offsets_top_[i] >= 0
+        && csr_columns_top_[csr_offsets_top_[i]] == i);
+    if (index) {
+      hdf_index_blobs_[i].reset(new Blob<int>());
+      hdf5_load_nd_dataset(group_id, name.substr(slash + 1).c_str(),
+          MIN_DATA_DIM, MAX_DATA_DIM, hdf_index_blobs_[i].get());
+      hdf_blobs_[i]->Reshape(hdf_index_blobs_[i]->shape());
+    } else {
+      hdf_index_blobs_[i].reset();
+      hdf5_load_nd_dataset(group_id, name.substr(slash + 1).c_str(),
+          MIN_DATA_DIM, MAX_DATA_DIM, hdf_blobs_[i].get());
+    }
+    if (group_id != file_id) {
+      H5Gclose(group_id);
+    }
   }
 
   herr_t status = H5Fclose(file_id);
@@ -48,23 +82,47 @@ void HDF5DataLayer<Dtype>::LoadHDF5FileData(const char* filename) {
 
   // MinTopBlobs==1 guarantees at least one top blob
   CHECK_GE(hdf_blobs_[0]->num_axes(), 1) << "Input must have at least 1 axis.";
-  const int num = hdf_blobs_[0]->shape(0);
-  for (int i = 1; i < top_size; ++i) {
-    CHECK_EQ(hdf_blobs_[i]->shape(0), num);
+  // The rows of a sparse matrix are one less than its row offsets; its
+  // values and columns are one per nonzero.
+  int num = -1;
+  for (int i = 0; i < top_size; ++i) {
+    if (csr_offsets_top_[i] >= 0) { continue; }
+    int rows = hdf_blobs_[i]->shape(0);
+    if (csr_values_top_[i] >= 0) {
+      CHECK_EQ(hdf_blobs_[i]->num_axes(), 1)
+          << this->layer_param_.top(i) << " must be a vector.";
+      CHECK_GE(rows, 1) << this->layer_param_.top(i)
+          << " must end with the count of nonzeros.";
+      const int nonzeros = hdf_index_blobs_[i]->cpu_data()[rows - 1];
+      CHECK_EQ(hdf_blobs_[csr_values_top_[i]]->count(), nonzeros);
+      CHECK_EQ(hdf_blobs_[csr_columns_top_[i]]->count(), nonzeros);
+      const int* columns = hdf_index_blobs_[csr_columns_top_[i]]->cpu_data();
+      const int kMaxExactIndex = max_exact_index<Dtype>();
+      for (int j = 0; j < nonzeros; ++j) {
+        CHECK(columns[j] >= 0 && columns[j] <= kMaxExactIndex)
+            << "Column " << columns[j] << " of " << this->layer_param_.top(i)
+            << " is not exact in Dtype.";
+      }
+      --rows;
+    }
+    if (num < 0) {
+      num = rows;
+    } else {
+      CHECK_EQ(rows, num);
+    }
   }
   // Default to identity permutation.
   data_permutation_.clear();
-  data_permutation_.resize(hdf_blobs_[0]->shape(0));
-  for (int i = 0; i < hdf_blobs_[0]->shape(0); i++)
+  data_permutation_.resize(num);
+  for (int i = 0; i < num; i++)
     data_permutation_[i] = i;
 
   // Shuffle if needed.
   if (this->layer_param_.hdf5_data_param().shuffle()) {
     std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
-    DLOG(INFO) << "Successully loaded " << hdf_blobs_[0]->shape(0)
-               << " rows (shuffled)";
+    DLOG(INFO) << "Successully loaded " << num << " rows (shuffled)";
   } else {
-    DLOG(INFO) << "Successully loaded " << hdf_blobs_[0]->shape(0) << " rows";
+    DLOG(INFO) << "Successully loaded " << num << " rows";
   }
 }
 
@@ -106,15 +164,52 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     std::random_shuffle(file_permutation_.begin(), file_permutation_.end());
   }
 
+  // Find the tops of the sparse matrices by the names of their row offsets.
+  const int top_size = this->layer_param_.top_size();
+  csr_values_top_.assign(top_size, -1);
+  csr_columns_top_.assign(top_size, -1);
+  csr_offsets_top_.assign(top_size, -1);
+  csr_batch_.resize(top_size);
+  const string kOffsets = "/indptr";
+  for (int i = 0; i < top_size; ++i) {
+    const string& name = this->layer_param_.top(i);
+    if (name.size() <= kOffsets.size() ||
+        name.compare(name.size() - kOffsets.size(), kOffsets.size(),
+            kOffsets) != 0) {
+      continue;
+    }
+    const string matrix = name.substr(0, name.size() - kOffsets.size());
+    for (int j = 0; j < top_size; ++j) {
+      if (this->layer_param_.top(j) == matrix + "/data") {
+        csr_values_top_[i] = j;
+      } else if (this->layer_param_.top(j) == matrix + "/indices") {
+        csr_columns_top_[i] = j;
+      }
+    }
+    CHECK_GE(csr_values_top_[i], 0) << "Sparse matrix " << matrix
+        << " lacks its values top " << matrix << "/data.";
+    CHECK_GE(csr_columns_top_[i], 0) << "Sparse matrix " << matrix
+        << " lacks its columns top " << matrix << "/indices.";
+    csr_offsets_top_[csr_values_top_[i]] = i;
+    csr_offsets_top_[csr_columns_top_[i]] = i;
+  }
+
   // Load the first HDF5 file and initialize the line counter.
   LoadHDF5FileData(hdf_filenames_[file_permutation_[current_file_]].c_str());
   current_row_ = 0;
 
   // Reshape blobs.
   const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
-  const int top_size = this->layer_param_.top_size();
   vector<int> top_shape;
   for (int i = 0; i < top_size; ++i) {
+    if (csr_offsets_top_[i] >= 0) {
+      // The nonzeros of a batch are only known once it is read.
+      top[i]->Reshape(vector<int>(1, 0));
+      continue;
+    } else if (csr_values_top_[i] >= 0) {
+      top[i]->Reshape(vector<int>(1, batch_size + 1));
+      continue;
+    }
     top_shape.resize(hdf_blobs_[i]->num_axes());
     top_shape[0] = batch_size;
     for (int j = 1; j < top_shape.size(); ++j) {
@@ -128,8 +223,15 @@ template <typename Dtype>
 void HDF5DataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
+  const int top_size = this->layer_param_.top_size();
+  for (int j = 0; j < top_size; ++j) {
+    csr_batch_[j].clear();
+    if (csr_values_top_[j] >= 0) {
+      csr_batch_[j].push_back(0);
+    }
+  }
   for (int i = 0; i < batch_size; ++i, ++current_row_) {
-    if (current_row_ == hdf_blobs_[0]->shape(0)) {
+    if (current_row_ == data_permutation_.size()) {
       if (num_files_ > 1) {
         ++current_file_;
         if (current_file_ == num_files_) {
@@ -147,13 +249,45 @@ void HDF5DataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       if (this->layer_param_.hdf5_data_param().shuffle())
         std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
     }
-    for (int j = 0; j < this->layer_param_.top_size(); ++j) {
+    for (int j = 0; j < top_size; ++j) {
+      if (csr_offsets_top_[j] >= 0) {
+        continue;
+      } else if (csr_values_top_[j] >= 0) {
+        // The nonzeros of the row, gathered as the rows of the batch may
+        // come from several files.
+        const int* offsets = hdf_index_blobs_[j]->cpu_data();
+        const int row = data_permutation_[current_row_];
+        const int begin = offsets[row];
+        const int end = offsets[row + 1];
+        const int values_top = csr_values_top_[j];
+        const int columns_top = csr_columns_top_[j];
+        const Dtype* values = hdf_blobs_[values_top]->cpu_data();
+        const int* columns = hdf_index_blobs_[columns_top]->cpu_data();
+        csr_batch_[values_top].insert(csr_batch_[values_top].end(),
+            values + begin, values + end);
+        csr_batch_[columns_top].insert(csr_batch_[columns_top].end(),
+            columns + begin, columns + end);
+        CHECK_LE(static_cast<int>(csr_batch_[values_top].size()),
+            max_exact_index<Dtype>())
+            << "The nonzeros of a batch of " << this->layer_param_.top(j)
+            << " are not exact in Dtype.";
+        csr_batch_[j].push_back(csr_batch_[values_top].size());
+        continue;
+      }
       int data_dim = top[j]->count() / top[j]->shape(0);
       caffe_copy(data_dim,
           &hdf_blobs_[j]->cpu_data()[data_permutation_[current_row_]
             * data_dim], &top[j]->mutable_cpu_data()[i * data_dim]);
     }
   }
+  for (int j = 0; j < top_size; ++j) {
+    if (csr_values_top_[j] < 0 && csr_offsets_top_[j] < 0) { continue; }
+    const int count = csr_batch_[j].size();
+    top[j]->Reshape(vector<int>(1, count));
+    if (count > 0) {
+      caffe_copy(count, &csr_batch_[j][0], top[j]->mutable_cpu_data());
+    }
+  }
 }
 
 #ifdef CPU_ONLY
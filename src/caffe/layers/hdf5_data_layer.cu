@@ -16,9 +16,16 @@ namespace caffe {
 template <typename Dtype>
 void HDF5DataLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  // The nonzeros of sparse matrices are gathered on the CPU.
+  for (int j = 0; j < csr_offsets_top_.size(); ++j) {
+    if (csr_offsets_top_[j] >= 0) {
+      Forward_cpu(bottom, top);
+      return;
+    }
+  }
   const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
   for (int i = 0; i < batch_size; ++i, ++current_row_) {
-    if (current_row_ == hdf_blobs_[0]->shape(0)) {
+    if (current_row_ == data_permutation_.size()) {
       if (num_files_ > 1) {
         current_file_ += 1;
         if (current_file_ == num_files_) {
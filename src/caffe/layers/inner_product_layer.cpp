@@ -1,6 +1,8 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <vector>
 
-#include "caffe/filler.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
 #include "caffe/util/math_functions.hpp"
 
@@ -12,12 +14,24 @@ void InnerProductLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   const int num_output = this->layer_param_.inner_product_param().num_output();
   bias_term_ = this->layer_param_.inner_product_param().bias_term();
   N_ = num_output;
-  const int axis = bottom[0]->CanonicalAxisIndex(
-      this->layer_param_.inner_product_param().axis());
-  // Dimensions starting from "axis" are "flattened" into a single
-  // length K_ vector. For example, if bottom[0]'s shape is (N, C, H, W),
-  // and axis == 1, N inner products with dimension CHW are performed.
-  K_ = bottom[0]->count(axis);
+  sparse_input_ = this->layer_param_.inner_product_param().input_dim() > 0;
+  if (sparse_input_) {
+    CHECK_EQ(bottom.size(), 3) << "A sparse input takes the values, columns "
+        << "and row offsets bottoms.";
+    K_ = this->layer_param_.inner_product_param().input_dim();
+    // The columns bottom must hold every column exactly.
+    CHECK_LE(K_, std::ldexp(1.0, std::numeric_limits<Dtype>::digits))
+        << "input_dim is too large for the columns to be exact in Dtype.";
+  } else {
+    CHECK_EQ(bottom.size(), 1) << "Only a sparse input (see input_dim) "
+        << "takes several bottoms.";
+    const int axis = bottom[0]->CanonicalAxisIndex(
+        this->layer_param_.inner_product_param().axis());
+    // Dimensions starting from "axis" are "flattened" into a single
+    // length K_ vector. For example, if bottom[0]'s shape is (N, C, H, W),
+    // and axis == 1, N inner products with dimension CHW are performed.
+    K_ = bottom[0]->count(axis);
+  }
   // Check if we need to set up the weights
   if (this->blobs_.size() > 0) {
     LOG(INFO) << "Skipping parameter initialization";
@@ -33,16 +47,14 @@ void InnerProductLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     weight_shape[1] = K_;
     this->blobs_[0].reset(new Blob<Dtype>(weight_shape));
     // fill the weights
-    shared_ptr<Filler<Dtype> > weight_filler(GetFiller<Dtype>(
-        this->layer_param_.inner_product_param().weight_filler()));
-    weight_filler->Fill(this->blobs_[0].get());
+    this->FillParam(0,
+        this->layer_param_.inner_product_param().weight_filler());
     // If necessary, intiialize and fill the bias term
     if (bias_term_) {
       vector<int> bias_shape(1, N_);
       this->blobs_[1].reset(new Blob<Dtype>(bias_shape));
-      shared_ptr<Filler<Dtype> > bias_filler(GetFiller<Dtype>(
-          this->layer_param_.inner_product_param().bias_filler()));
-      bias_filler->Fill(this->blobs_[1].get());
+      this->FillParam(1,
+          this->layer_param_.inner_product_param().bias_filler());
     }
   }  // parameter initialization
   this->param_propagate_down_.resize(this->blobs_.size(), true);
@@ -51,21 +63,35 @@ void InnerProductLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void InnerProductLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
-  // Figure out the dimensions
-  const int axis = bottom[0]->CanonicalAxisIndex(
-      this->layer_param_.inner_product_param().axis());
-  const int new_K = bottom[0]->count(axis);
-  CHECK_EQ(K_, new_K)
-      << "Input size incompatible with inner product parameters.";
-  // The first "axis" dimensions are independent inner products; the total
-  // number of these is M_, the product over these dimensions.
-  M_ = bottom[0]->count(0, axis);
-  // The top shape will be the bottom shape with the flattened axes dropped,
-  // and replaced by a single axis with dimension num_output (N_).
-  vector<int> top_shape = bottom[0]->shape();
-  top_shape.resize(axis + 1);
-  top_shape[axis] = N_;
-  top[0]->Reshape(top_shape);
+  if (sparse_input_) {
+    // A sparse input has a row per offset but the last.
+    CHECK_EQ(bottom[2]->num_axes(), 1) << "The row offsets must be a vector.";
+    CHECK_GE(bottom[2]->count(), 1) << "The row offsets end with the count "
+        << "of nonzeros.";
+    CHECK_EQ(bottom[0]->count(), bottom[1]->count())
+        << "Each nonzero takes a value and a column.";
+    M_ = bottom[2]->count() - 1;
+    vector<int> top_shape(2);
+    top_shape[0] = M_;
+    top_shape[1] = N_;
+    top[0]->Reshape(top_shape);
+  } else {
+    // Figure out the dimensions
+    const int axis = bottom[0]->CanonicalAxisIndex(
+        this->layer_param_.inner_product_param().axis());
+    const int new_K = bottom[0]->count(axis);
+    CHECK_EQ(K_, new_K)
+        << "Input size incompatible with inner product parameters.";
+    // The first "axis" dimensions are independent inner products; the total
+    // number of these is M_, the product over these dimensions.
+    M_ = bottom[0]->count(0, axis);
+    // The top shape will be the bottom shape with the flattened axes
+    // dropped, and replaced by a single axis with dimension num_output (N_).
+    vector<int> top_shape = bottom[0]->shape();
+    top_shape.resize(axis + 1);
+    top_shape[axis] = N_;
+    top[0]->Reshape(top_shape);
+  }
   // Set up the bias multiplier
   if (bias_term_) {
     vector<int> bias_shape(1, M_);
@@ -74,14 +100,67 @@ void InnerProductLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+void InnerProductLayer<Dtype>::ReadSparseInput(
+    const vector<Blob<Dtype>*>& bottom) {
+  const Dtype* offsets = bottom[2]->cpu_data();
+  csr_offsets_.resize(M_ + 1);
+  csr_offsets_[0] = static_cast<int>(offsets[0]);
+  CHECK_EQ(csr_offsets_[0], 0) << "The row offsets must start at 0.";
+  for (int i = 1; i <= M_; ++i) {
+    csr_offsets_[i] = static_cast<int>(offsets[i]);
+    CHECK_GE(csr_offsets_[i], csr_offsets_[i - 1])
+        << "The row offsets must not decrease.";
+  }
+  const int nonzeros = bottom[0]->count();
+  CHECK_EQ(csr_offsets_[M_], nonzeros)
+      << "The row offsets must end with the count of nonzeros.";
+  csr_columns_.resize(nonzeros);
+  // Nothing is allocated for a batch of zeros.
+  const Dtype* columns = nonzeros ? bottom[1]->cpu_data() : NULL;
+  for (int i = 0; i < nonzeros; ++i) {
+    csr_columns_[i] = static_cast<int>(columns[i]);
+    CHECK_GE(csr_columns_[i], 0) << "Column out of range.";
+    CHECK_LT(csr_columns_[i], K_) << "Column out of range.";
+  }
+}
+
 template <typename Dtype>
 void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
-  const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  const Dtype* weight = this->blobs_[0]->cpu_data();
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M_, N_, K_, (Dtype)1.,
-      bottom_data, weight, (Dtype)0., top_data);
+  if (sparse_input_) {
+    ReadSparseInput(bottom);
+    // Packed weights are unpacked for the pass only.
+    SyncedMemory unpacked(this->blobs_[0]->count() * sizeof(Dtype));
+    const Dtype* weight = this->blobs_[0]->unpacked_cpu_data(&unpacked);
+    caffe_cpu_csrmm_nt(M_, N_, K_, &csr_offsets_[0],
+        csr_columns_.empty() ? NULL : &csr_columns_[0],
+        csr_columns_.empty() ? NULL : bottom[0]->cpu_data(), weight,
+        top_data);
+  } else if (sparse_weights_.Update(*this->blobs_[0], N_,
+      this->layer_param_.inner_product_param().sparse_weight_threshold())) {
+    // Pruned weights are multiplied without their zeros; they are
+    // compressed again only once they change.
+    sparse_weights_.MultiplyDenseTransposed(M_, K_, bottom[0]->cpu_data(),
+        top_data);
+  } else if (this->blobs_[0]->data_packed()) {
+    // Packed weights are unpacked a panel of outputs at a time, each
+    // multiplied while it is in cache.
+    const int panel_rows = PackedWeights<Dtype>::panel_rows(K_);
+    for (int n = 0; n < N_; n += panel_rows) {
+      const int rows = std::min(panel_rows, N_ - n);
+      const Dtype* weight = packed_weights_.Panel(*this->blobs_[0], K_, n,
+          n + rows);
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M_, rows, K_,
+          (Dtype)1., bottom[0]->cpu_data(), weight, (Dtype)0., top_data + n,
+          N_);
+    }
+  } else {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M_, N_, K_, (Dtype)1.,
+        bottom[0]->cpu_data(), this->blobs_[0]->cpu_data(), (Dtype)0.,
+        top_data);
+  }
   if (bias_term_) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
         bias_multiplier_.cpu_data(),
@@ -93,6 +172,28 @@ template <typename Dtype>
 void InnerProductLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
+  if (sparse_input_) {
+    CHECK(!propagate_down[1] && !propagate_down[2]) << "Can't backpropagate "
+        << "to the columns and row offsets of a sparse input.";
+    const Dtype* top_diff = top[0]->cpu_diff();
+    const int* columns = csr_columns_.empty() ? NULL : &csr_columns_[0];
+    if (this->param_propagate_down_[0]) {
+      // Only the columns of the weights of the nonzeros are written.
+      caffe_cpu_csrmm_tn(M_, N_, K_, &csr_offsets_[0], columns,
+          columns ? bottom[0]->cpu_data() : NULL, top_diff,
+          this->blobs_[0]->mutable_cpu_diff());
+    }
+    if (bias_term_ && this->param_propagate_down_[1]) {
+      caffe_cpu_gemv<Dtype>(CblasTrans, M_, N_, (Dtype)1., top_diff,
+          bias_multiplier_.cpu_data(), (Dtype)1.,
+          this->blobs_[1]->mutable_cpu_diff());
+    }
+    if (propagate_down[0] && columns) {
+      caffe_cpu_csr_sddmm(M_, N_, K_, &csr_offsets_[0], columns, top_diff,
+          this->blobs_[0]->cpu_data(), bottom[0]->mutable_cpu_diff());
+    }
+    return;
+  }
   if (this->param_propagate_down_[0]) {
     const Dtype* top_diff = top[0]->cpu_diff();
     const Dtype* bottom_data = bottom[0]->cpu_data();
@@ -121,6 +222,5 @@ STUB_GPU(InnerProductLayer);
 #endif
 
 INSTANTIATE_CLASS(InnerProductLayer);
-REGISTER_LAYER_CLASS(InnerProduct);
 
 }  // namespace caffe
@@ -0,0 +1,58 @@
+#include <vector>
+
+#include "caffe/layers/int8_conv_layer.hpp"
+#include "caffe/util/quantize.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void Int8ConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  int col_count = 1;
+  for (int i = 0; i < this->col_buffer_shape_.size(); ++i) {
+    col_count *= this->col_buffer_shape_[i];
+  }
+  quantized_bottom_.resize(bottom[0]->count());
+  quantized_col_buffer_.resize(col_count);
+  accum_.resize(this->top_dim_);
+  output_scales_.resize(this->num_output_);
+}
+
+template <typename Dtype>
+void Int8ConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const Blob<Dtype>& weight_blob =
+      this->packed_weights_.Int8(*this->blobs_[0]);
+  const int8_t* weight =
+      static_cast<const int8_t*>(weight_blob.packed_cpu_data());
+  const float* weight_scales = weight_blob.packed_cpu_scales();
+  const QuantizationParameter& quantization_param =
+      this->layer_param_.quantization_param();
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    const Dtype input_scale = int8_scale(quantization_param.has_bottom_range()
+        ? Dtype(quantization_param.bottom_range())
+        : caffe_cpu_amax(bottom[i]->count(), bottom_data));
+    int8_t* quantized_data = &quantized_bottom_[0];
+    caffe_cpu_quantize(bottom[i]->count(), bottom_data, input_scale,
+        quantized_data);
+    for (int c = 0; c < this->num_output_; ++c) {
+      output_scales_[c] = input_scale * weight_scales[c];
+    }
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int n = 0; n < this->num_; ++n) {
+      this->forward_cpu_gemm_int8(quantized_data + n * this->bottom_dim_,
+          weight, &output_scales_[0], top_data + n * this->top_dim_,
+          &quantized_col_buffer_[0], &accum_[0]);
+      if (this->bias_term_) {
+        const Dtype* bias = this->blobs_[1]->cpu_data();
+        this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
+      }
+    }
+  }
+}
+
+INSTANTIATE_CLASS(Int8ConvolutionLayer);
+
+}  // namespace caffe
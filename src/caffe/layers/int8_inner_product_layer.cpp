@@ -0,0 +1,53 @@
+#include <vector>
+
+#include "caffe/layers/int8_inner_product_layer.hpp"
+#include "caffe/util/quantize.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void Int8InnerProductLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  InnerProductLayer<Dtype>::Reshape(bottom, top);
+  quantized_bottom_.resize(bottom[0]->count());
+  accum_.resize(this->M_ * this->N_);
+  output_scales_.resize(this->N_);
+}
+
+template <typename Dtype>
+void Int8InnerProductLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const Blob<Dtype>& weight_blob =
+      this->packed_weights_.Int8(*this->blobs_[0]);
+  const int8_t* weight =
+      static_cast<const int8_t*>(weight_blob.packed_cpu_data());
+  const float* weight_scales = weight_blob.packed_cpu_scales();
+  const QuantizationParameter& quantization_param =
+      this->layer_param_.quantization_param();
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  const Dtype input_scale = int8_scale(quantization_param.has_bottom_range()
+      ? Dtype(quantization_param.bottom_range())
+      : caffe_cpu_amax(bottom[0]->count(), bottom_data));
+  caffe_cpu_quantize(bottom[0]->count(), bottom_data, input_scale,
+      &quantized_bottom_[0]);
+  int32_t* accum_data = &accum_[0];
+  caffe_cpu_gemm_int8(CblasTrans, this->M_, this->N_, this->K_,
+      &quantized_bottom_[0], weight, accum_data);
+  // Scale the int32 products back to Dtype and add the bias.
+  for (int n = 0; n < this->N_; ++n) {
+    output_scales_[n] = input_scale * weight_scales[n];
+  }
+  const Dtype* bias = this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  for (int m = 0; m < this->M_; ++m) {
+    for (int n = 0; n < this->N_; ++n) {
+      const int index = m * this->N_ + n;
+      top_data[index] = accum_data[index] * output_scales_[n]
+          + (bias ? bias[n] : Dtype(0));
+    }
+  }
+}
+
+INSTANTIATE_CLASS(Int8InnerProductLayer);
+
+}  // namespace caffe
@@ -1,10 +1,14 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/lrn_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/parallel.hpp"
 
 namespace caffe {
 
+using std::min;
+
 template <typename Dtype>
 void LRNLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -104,51 +108,98 @@ void LRNLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+// The width of the tiles of the planes over which the cross-channel LRN
+// slides its window, so that the rows of a tile in the window stay in L1.
+const int kLRNTile = 256;
+
+// The cross-channel LRN of a range of the tiles of the images, each tile of
+// every channel at once. The scale of a channel is that of the previous one
+// plus the square of the channel entering the window, less that of the one
+// leaving it, and the output is computed from it while it is in cache.
 template <typename Dtype>
-void LRNLayer<Dtype>::CrossChannelForward_cpu(
-    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  Dtype* scale_data = scale_.mutable_cpu_data();
-  // start with the constant value
-  for (int i = 0; i < scale_.count(); ++i) {
-    scale_data[i] = k_;
-  }
-  Blob<Dtype> padded_square(1, channels_ + size_ - 1, height_, width_);
-  Dtype* padded_square_data = padded_square.mutable_cpu_data();
-  caffe_set(padded_square.count(), Dtype(0), padded_square_data);
-  Dtype alpha_over_size = alpha_ / size_;
-  // go through the images
-  for (int n = 0; n < num_; ++n) {
-    // compute the padded square
-    caffe_sqr(channels_ * height_ * width_,
-        bottom_data + bottom[0]->offset(n),
-        padded_square_data + padded_square.offset(0, pre_pad_));
-    // Create the first channel scale
-    for (int c = 0; c < size_; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c),
-          scale_data + scale_.offset(n, 0));
-    }
-    for (int c = 1; c < channels_; ++c) {
-      // copy previous scale
-      caffe_copy<Dtype>(height_ * width_,
-          scale_data + scale_.offset(n, c - 1),
-          scale_data + scale_.offset(n, c));
-      // add head
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c + size_ - 1),
-          scale_data + scale_.offset(n, c));
-      // subtract tail
-      caffe_axpy<Dtype>(height_ * width_, -alpha_over_size,
-          padded_square_data + padded_square.offset(0, c - 1),
-          scale_data + scale_.offset(n, c));
+class LRNCrossChannelForward {
+ public:
+  LRNCrossChannelForward(const int channels, const int spatial_dim,
+      const int size, const Dtype alpha, const Dtype beta, const Dtype k,
+      const Dtype* bottom, Dtype* scale, Dtype* top)
+      : channels_(channels), spatial_dim_(spatial_dim), size_(size),
+        alpha_(alpha), beta_(beta), k_(k), bottom_(bottom), scale_(scale),
+        top_(top) {}
+
+  void operator()(const int begin, const int end) const {
+    const int tiles = (spatial_dim_ + kLRNTile - 1) / kLRNTile;
+    const int pre_pad = (size_ - 1) / 2;
+    const Dtype alpha_over_size = alpha_ / size_;
+    for (int i = begin; i < end; ++i) {
+      const int offset = i / tiles * channels_ * spatial_dim_ +
+          i % tiles * kLRNTile;
+      const int tile = min(kLRNTile, spatial_dim_ - i % tiles * kLRNTile);
+      const Dtype* bottom = bottom_ + offset;
+      Dtype* scale = scale_ + offset;
+      Dtype* top = top_ + offset;
+      // The window of the channel 0 is [0, pre_pad].
+      for (int j = 0; j < tile; ++j) {
+        scale[j] = k_;
+      }
+      for (int c = 0; c < min(pre_pad + 1, channels_); ++c) {
+        const Dtype* head = bottom + c * spatial_dim_;
+        for (int j = 0; j < tile; ++j) {
+          scale[j] += alpha_over_size * head[j] * head[j];
+        }
+      }
+      for (int c = 0; c < channels_; ++c) {
+        Dtype* channel_scale = scale + c * spatial_dim_;
+        if (c > 0) {
+          const Dtype* previous = channel_scale - spatial_dim_;
+          const Dtype* head = c + pre_pad < channels_ ?
+              bottom + (c + pre_pad) * spatial_dim_ : NULL;
+          const Dtype* tail = c - pre_pad - 1 >= 0 ?
+              bottom + (c - pre_pad - 1) * spatial_dim_ : NULL;
+          if (head && tail) {
+            for (int j = 0; j < tile; ++j) {
+              channel_scale[j] = previous[j] +
+                  alpha_over_size * (head[j] * head[j] - tail[j] * tail[j]);
+            }
+          } else if (head) {
+            for (int j = 0; j < tile; ++j) {
+              channel_scale[j] = previous[j] +
+                  alpha_over_size * head[j] * head[j];
+            }
+          } else if (tail) {
+            for (int j = 0; j < tile; ++j) {
+              channel_scale[j] = previous[j] -
+                  alpha_over_size * tail[j] * tail[j];
+            }
+          } else {
+            for (int j = 0; j < tile; ++j) {
+              channel_scale[j] = previous[j];
+            }
+          }
+        }
+        Dtype* channel_top = top + c * spatial_dim_;
+        caffe_powx(tile, channel_scale, -beta_, channel_top);
+        caffe_mul(tile, channel_top, bottom + c * spatial_dim_, channel_top);
+      }
     }
   }
 
-  // In the end, compute output
-  caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, top_data);
-  caffe_mul<Dtype>(scale_.count(), top_data, bottom_data, top_data);
+ private:
+  const int channels_, spatial_dim_, size_;
+  const Dtype alpha_, beta_, k_;
+  const Dtype* bottom_;
+  Dtype* scale_;
+  Dtype* top_;
+};
+
+template <typename Dtype>
+void LRNLayer<Dtype>::CrossChannelForward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const int spatial_dim = height_ * width_;
+  const int tiles = (spatial_dim + kLRNTile - 1) / kLRNTile;
+  parallel_for(num_ * tiles, LRNCrossChannelForward<Dtype>(channels_,
+      spatial_dim, size_, alpha_, beta_, k_, bottom[0]->cpu_data(),
+      scale_.mutable_cpu_data(), top[0]->mutable_cpu_data()),
+      parallel_grain(channels_ * min(spatial_dim, kLRNTile) * size_));
 }
 
 template <typename Dtype>
@@ -176,59 +227,90 @@ void LRNLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
 }
 
+// The gradient of the cross-channel LRN of a range of the tiles, as
+// LRNCrossChannelForward: the sum of the ratios top_diff * top / scale over
+// the window slides along the channels in a tile on the stack, and the
+// bottom diff of a channel is computed from it at once.
 template <typename Dtype>
-void LRNLayer<Dtype>::CrossChannelBackward_cpu(
-    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
-    const vector<Blob<Dtype>*>& bottom) {
-  const Dtype* top_diff = top[0]->cpu_diff();
-  const Dtype* top_data = top[0]->cpu_data();
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  const Dtype* scale_data = scale_.cpu_data();
-  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-  Blob<Dtype> padded_ratio(1, channels_ + size_ - 1, height_, width_);
-  Blob<Dtype> accum_ratio(1, 1, height_, width_);
-  Dtype* padded_ratio_data = padded_ratio.mutable_cpu_data();
-  Dtype* accum_ratio_data = accum_ratio.mutable_cpu_data();
-  // We hack a little bit by using the diff() to store an additional result
-  Dtype* accum_ratio_times_bottom = accum_ratio.mutable_cpu_diff();
-  caffe_set(padded_ratio.count(), Dtype(0), padded_ratio_data);
-  Dtype cache_ratio_value = 2. * alpha_ * beta_ / size_;
-
-  caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, bottom_diff);
-  caffe_mul<Dtype>(scale_.count(), top_diff, bottom_diff, bottom_diff);
+class LRNCrossChannelBackward {
+ public:
+  LRNCrossChannelBackward(const int channels, const int spatial_dim,
+      const int size, const Dtype alpha, const Dtype beta,
+      const Dtype* bottom, const Dtype* scale, const Dtype* top,
+      const Dtype* top_diff, Dtype* bottom_diff)
+      : channels_(channels), spatial_dim_(spatial_dim), size_(size),
+        alpha_(alpha), beta_(beta), bottom_(bottom), scale_(scale),
+        top_(top), top_diff_(top_diff), bottom_diff_(bottom_diff) {}
 
-  // go through individual data
-  int inverse_pre_pad = size_ - (size_ + 1) / 2;
-  for (int n = 0; n < num_; ++n) {
-    int block_offset = scale_.offset(n);
-    // first, compute diff_i * y_i / s_i
-    caffe_mul<Dtype>(channels_ * height_ * width_,
-        top_diff + block_offset, top_data + block_offset,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad));
-    caffe_div<Dtype>(channels_ * height_ * width_,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad),
-        scale_data + block_offset,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad));
-    // Now, compute the accumulated ratios and the bottom diff
-    caffe_set(accum_ratio.count(), Dtype(0), accum_ratio_data);
-    for (int c = 0; c < size_ - 1; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, 1.,
-          padded_ratio_data + padded_ratio.offset(0, c), accum_ratio_data);
+  void operator()(const int begin, const int end) const {
+    const int tiles = (spatial_dim_ + kLRNTile - 1) / kLRNTile;
+    const int pre_pad = (size_ - 1) / 2;
+    const Dtype cache_ratio_value = 2. * alpha_ * beta_ / size_;
+    Dtype accum_ratio[kLRNTile];
+    for (int i = begin; i < end; ++i) {
+      const int offset = i / tiles * channels_ * spatial_dim_ +
+          i % tiles * kLRNTile;
+      const int tile = min(kLRNTile, spatial_dim_ - i % tiles * kLRNTile);
+      for (int j = 0; j < tile; ++j) {
+        accum_ratio[j] = 0;
+      }
+      for (int c = 0; c < min(pre_pad, channels_); ++c) {
+        AddRatio(offset + c * spatial_dim_, tile, Dtype(1), accum_ratio);
+      }
+      for (int c = 0; c < channels_; ++c) {
+        if (c + pre_pad < channels_) {
+          AddRatio(offset + (c + pre_pad) * spatial_dim_, tile, Dtype(1),
+              accum_ratio);
+        }
+        if (c - pre_pad - 1 >= 0) {
+          AddRatio(offset + (c - pre_pad - 1) * spatial_dim_, tile,
+              Dtype(-1), accum_ratio);
+        }
+        const int channel = offset + c * spatial_dim_;
+        const Dtype* bottom = bottom_ + channel;
+        const Dtype* top_diff = top_diff_ + channel;
+        Dtype* bottom_diff = bottom_diff_ + channel;
+        caffe_powx(tile, scale_ + channel, -beta_, bottom_diff);
+        for (int j = 0; j < tile; ++j) {
+          bottom_diff[j] = top_diff[j] * bottom_diff[j] -
+              cache_ratio_value * bottom[j] * accum_ratio[j];
+        }
+      }
     }
-    for (int c = 0; c < channels_; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, 1.,
-          padded_ratio_data + padded_ratio.offset(0, c + size_ - 1),
-          accum_ratio_data);
-      // compute bottom diff
-      caffe_mul<Dtype>(height_ * width_,
-          bottom_data + top[0]->offset(n, c),
-          accum_ratio_data, accum_ratio_times_bottom);
-      caffe_axpy<Dtype>(height_ * width_, -cache_ratio_value,
-          accum_ratio_times_bottom, bottom_diff + top[0]->offset(n, c));
-      caffe_axpy<Dtype>(height_ * width_, -1.,
-          padded_ratio_data + padded_ratio.offset(0, c), accum_ratio_data);
+  }
+
+ private:
+  // Adds sign * top_diff * top / scale of the tile at offset to accum_ratio.
+  void AddRatio(const int offset, const int tile, const Dtype sign,
+      Dtype* accum_ratio) const {
+    const Dtype* top_diff = top_diff_ + offset;
+    const Dtype* top = top_ + offset;
+    const Dtype* scale = scale_ + offset;
+    for (int j = 0; j < tile; ++j) {
+      accum_ratio[j] += sign * top_diff[j] * top[j] / scale[j];
     }
   }
+
+  const int channels_, spatial_dim_, size_;
+  const Dtype alpha_, beta_;
+  const Dtype* bottom_;
+  const Dtype* scale_;
+  const Dtype* top_;
+  const Dtype* top_diff_;
+  Dtype* bottom_diff_;
+};
+
+template <typename Dtype>
+void LRNLayer<Dtype>::CrossChannelBackward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  const int spatial_dim = height_ * width_;
+  const int tiles = (spatial_dim + kLRNTile - 1) / kLRNTile;
+  parallel_for(num_ * tiles, LRNCrossChannelBackward<Dtype>(channels_,
+      spatial_dim, size_, alpha_, beta_, bottom[0]->cpu_data(),
+      scale_.cpu_data(), top[0]->cpu_data(), top[0]->cpu_diff(),
+      bottom[0]->mutable_cpu_diff()),
+      parallel_grain(channels_ * min(spatial_dim, kLRNTile) * size_));
 }
 
 template <typename Dtype>
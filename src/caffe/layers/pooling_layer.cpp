@@ -4,6 +4,7 @@
 
 #include "caffe/layers/pooling_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/parallel.hpp"
 
 namespace caffe {
 
@@ -108,11 +109,20 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   if (top.size() > 1) {
     top[1]->ReshapeLike(*top[0]);
   }
-  // If max pooling, we will initialize the vector index part.
+  // If max pooling, we will initialize the vector index part: on the CPU,
+  // the offset of the max in its window in the smallest type which holds it,
+  // and on the GPU, its index in the channel.
   if (this->layer_param_.pooling_param().pool() ==
       PoolingParameter_PoolMethod_MAX && top.size() == 1) {
     max_idx_.Reshape(bottom[0]->num(), channels_, pooled_height_,
         pooled_width_);
+    const int window_size = kernel_h_ * kernel_w_;
+    max_window_idx_size_ = window_size <= 1 << 8 ? sizeof(uint8_t) :
+        window_size <= 1 << 16 ? sizeof(uint16_t) : sizeof(int);
+    const size_t size = max_idx_.count() * max_window_idx_size_;
+    if (!max_window_idx_ || max_window_idx_->size() != size) {
+      max_window_idx_.reset(new SyncedMemory(size));
+    }
   }
   // If stochastic pooling, we will initialize the random index part.
   if (this->layer_param_.pooling_param().pool() ==
@@ -122,108 +132,435 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
-// TODO(Yangqing): Is there a faster way to do pooling in the channel-first
-// case?
+// The windows of the pooling of a channel.
+struct PoolingWindows {
+  int height, width, pooled_height, pooled_width;
+  int kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w;
+  // The outputs [ph_begin, ph_end) x [pw_begin, pw_end) pool windows which
+  // lie inside the input, which the kernels of the square windows of
+  // stride 2 below pool, 2x2 or 3x3 as in most nets (square_kernel).
+  int ph_begin, ph_end, pw_begin, pw_end;
+  int square_kernel;
+};
+
+// The first and the end of the outputs of windows inside the input.
+static void pooling_interior(const int size, const int pooled_size,
+    const int kernel, const int stride, const int pad, int* begin,
+    int* end) {
+  *begin = min((pad + stride - 1) / stride, pooled_size);
+  *end = size + pad >= kernel ?
+      min((size + pad - kernel) / stride + 1, pooled_size) : 0;
+  *end = max(*end, *begin);
+}
+
+// Max pooling of the window of (ph, pw), whose mask is the offset of the
+// max in the window, the first one of equal values.
+template <typename Dtype, typename Index>
+static inline void max_pool_window(const PoolingWindows& p,
+    const Dtype* bottom, const int ph, const int pw, Dtype* top,
+    Index* mask) {
+  const int hstart = ph * p.stride_h - p.pad_h;
+  const int wstart = pw * p.stride_w - p.pad_w;
+  const int hend = min(hstart + p.kernel_h, p.height);
+  const int wend = min(wstart + p.kernel_w, p.width);
+  const int h0 = max(hstart, 0);
+  const int w0 = max(wstart, 0);
+  Dtype value = bottom[h0 * p.width + w0];
+  int offset = (h0 - hstart) * p.kernel_w + w0 - wstart;
+  for (int h = h0; h < hend; ++h) {
+    for (int w = w0; w < wend; ++w) {
+      if (bottom[h * p.width + w] > value) {
+        value = bottom[h * p.width + w];
+        offset = (h - hstart) * p.kernel_w + w - wstart;
+      }
+    }
+  }
+  const int pool_index = ph * p.pooled_width + pw;
+  top[pool_index] = value;
+  mask[pool_index] = static_cast<Index>(offset);
+}
+
+// Max pooling of the outputs [begin, end) of a row of K x K windows of
+// stride S, which start at the input row `bottom` and at the column
+// pw S - pad_w. The loop is unrolled and branch-free, so it vectorizes.
+template <typename Dtype, typename Index, int K, int S>
+static void max_pool_row(const Dtype* bottom, const int width,
+    const int pad_w, const int begin, const int end, Dtype* top,
+    Index* mask) {
+  for (int pw = begin; pw < end; ++pw) {
+    const Dtype* window = bottom + pw * S - pad_w;
+    Dtype value = window[0];
+    Index offset = 0;
+    for (int kh = 0; kh < K; ++kh) {
+      for (int kw = (kh ? 0 : 1); kw < K; ++kw) {
+        const Dtype x = window[kh * width + kw];
+        const bool greater = x > value;
+        value = greater ? x : value;
+        offset = greater ? static_cast<Index>(kh * K + kw) : offset;
+      }
+    }
+    top[pw] = value;
+    mask[pw] = offset;
+  }
+}
+
+template <typename Dtype, typename Index>
+static void max_pool_plane(const PoolingWindows& p, const Dtype* bottom,
+    Dtype* top, Index* mask) {
+  for (int ph = 0; ph < p.pooled_height; ++ph) {
+    int interior_begin = p.pooled_width;
+    int interior_end = p.pooled_width;
+    if (p.square_kernel && ph >= p.ph_begin && ph < p.ph_end) {
+      interior_begin = p.pw_begin;
+      interior_end = p.pw_end;
+      const Dtype* row = bottom + (ph * 2 - p.pad_h) * p.width;
+      Dtype* top_row = top + ph * p.pooled_width;
+      Index* mask_row = mask + ph * p.pooled_width;
+      if (p.square_kernel == 2) {
+        max_pool_row<Dtype, Index, 2, 2>(row, p.width, p.pad_w,
+            interior_begin, interior_end, top_row, mask_row);
+      } else {
+        max_pool_row<Dtype, Index, 3, 2>(row, p.width, p.pad_w,
+            interior_begin, interior_end, top_row, mask_row);
+      }
+    }
+    for (int pw = 0; pw < interior_begin; ++pw) {
+      max_pool_window(p, bottom, ph, pw, top, mask);
+    }
+    for (int pw = interior_end; pw < p.pooled_width; ++pw) {
+      max_pool_window(p, bottom, ph, pw, top, mask);
+    }
+  }
+}
+
+// Average pooling of the window of (ph, pw), over its size with the
+// padding.
+template <typename Dtype>
+static inline void ave_pool_window(const PoolingWindows& p,
+    const Dtype* bottom, const int ph, const int pw, Dtype* top) {
+  int hstart = ph * p.stride_h - p.pad_h;
+  int wstart = pw * p.stride_w - p.pad_w;
+  int hend = min(hstart + p.kernel_h, p.height + p.pad_h);
+  int wend = min(wstart + p.kernel_w, p.width + p.pad_w);
+  const int pool_size = (hend - hstart) * (wend - wstart);
+  hstart = max(hstart, 0);
+  wstart = max(wstart, 0);
+  hend = min(hend, p.height);
+  wend = min(wend, p.width);
+  Dtype sum = 0;
+  for (int h = hstart; h < hend; ++h) {
+    for (int w = wstart; w < wend; ++w) {
+      sum += bottom[h * p.width + w];
+    }
+  }
+  top[ph * p.pooled_width + pw] = sum / pool_size;
+}
+
+// Average pooling of a row of K x K windows of stride S, as max_pool_row.
+template <typename Dtype, int K, int S>
+static void ave_pool_row(const Dtype* bottom, const int width,
+    const int pad_w, const int begin, const int end, Dtype* top) {
+  for (int pw = begin; pw < end; ++pw) {
+    const Dtype* window = bottom + pw * S - pad_w;
+    Dtype sum = 0;
+    for (int kh = 0; kh < K; ++kh) {
+      for (int kw = 0; kw < K; ++kw) {
+        sum += window[kh * width + kw];
+      }
+    }
+    top[pw] = sum / (K * K);
+  }
+}
+
+template <typename Dtype>
+static void ave_pool_plane(const PoolingWindows& p, const Dtype* bottom,
+    Dtype* top) {
+  for (int ph = 0; ph < p.pooled_height; ++ph) {
+    int interior_begin = p.pooled_width;
+    int interior_end = p.pooled_width;
+    if (p.square_kernel && ph >= p.ph_begin && ph < p.ph_end) {
+      interior_begin = p.pw_begin;
+      interior_end = p.pw_end;
+      const Dtype* row = bottom + (ph * 2 - p.pad_h) * p.width;
+      Dtype* top_row = top + ph * p.pooled_width;
+      if (p.square_kernel == 2) {
+        ave_pool_row<Dtype, 2, 2>(row, p.width, p.pad_w, interior_begin,
+            interior_end, top_row);
+      } else {
+        ave_pool_row<Dtype, 3, 2>(row, p.width, p.pad_w, interior_begin,
+            interior_end, top_row);
+      }
+    }
+    for (int pw = 0; pw < interior_begin; ++pw) {
+      ave_pool_window(p, bottom, ph, pw, top);
+    }
+    for (int pw = interior_end; pw < p.pooled_width; ++pw) {
+      ave_pool_window(p, bottom, ph, pw, top);
+    }
+  }
+}
+
+// The index in its channel of the input at the offset of the window of
+// (ph, pw).
+static inline int pooling_input_index(const PoolingWindows& p,
+    const int ph, const int pw, const int offset) {
+  const int h = ph * p.stride_h - p.pad_h + offset / p.kernel_w;
+  const int w = pw * p.stride_w - p.pad_w + offset % p.kernel_w;
+  return h * p.width + w;
+}
+
+// Pools a range of the channels, by MAX with the mask (of window offsets, or
+// of input indices for the mask top) or by AVE.
+template <typename Dtype, typename Index>
+class PoolingChannels {
+ public:
+  PoolingChannels(const PoolingWindows& p, const bool max_pool,
+      const bool top_mask, const Dtype* bottom, Dtype* top, Index* mask)
+      : p_(p), max_pool_(max_pool), top_mask_(top_mask), bottom_(bottom),
+        top_(top), mask_(mask) {}
+
+  void operator()(const int begin, const int end) const {
+    const int bottom_dim = p_.height * p_.width;
+    const int top_dim = p_.pooled_height * p_.pooled_width;
+    for (int c = begin; c < end; ++c) {
+      const Dtype* bottom = bottom_ + c * bottom_dim;
+      Dtype* top = top_ + c * top_dim;
+      if (!max_pool_) {
+        ave_pool_plane(p_, bottom, top);
+        continue;
+      }
+      Index* mask = mask_ + c * top_dim;
+      max_pool_plane(p_, bottom, top, mask);
+      if (top_mask_) {
+        for (int ph = 0; ph < p_.pooled_height; ++ph) {
+          for (int pw = 0; pw < p_.pooled_width; ++pw) {
+            const int index = ph * p_.pooled_width + pw;
+            mask[index] = static_cast<Index>(pooling_input_index(p_, ph, pw,
+                static_cast<int>(mask[index])));
+          }
+        }
+      }
+    }
+  }
+
+ private:
+  const PoolingWindows& p_;
+  const bool max_pool_, top_mask_;
+  const Dtype* bottom_;
+  Dtype* top_;
+  Index* mask_;
+};
+
+// Back-propagates a range of the channels.
+template <typename Dtype, typename Index>
+class PoolingChannelsBackward {
+ public:
+  PoolingChannelsBackward(const PoolingWindows& p, const bool max_pool,
+      const bool top_mask, const Dtype* top_diff, const Index* mask,
+      Dtype* bottom_diff)
+      : p_(p), max_pool_(max_pool), top_mask_(top_mask), top_diff_(top_diff),
+        mask_(mask), bottom_diff_(bottom_diff) {}
+
+  void operator()(const int begin, const int end) const {
+    const int bottom_dim = p_.height * p_.width;
+    const int top_dim = p_.pooled_height * p_.pooled_width;
+    for (int c = begin; c < end; ++c) {
+      const Dtype* top_diff = top_diff_ + c * top_dim;
+      Dtype* bottom_diff = bottom_diff_ + c * bottom_dim;
+      caffe_set(bottom_dim, Dtype(0), bottom_diff);
+      for (int ph = 0; ph < p_.pooled_height; ++ph) {
+        for (int pw = 0; pw < p_.pooled_width; ++pw) {
+          const int index = ph * p_.pooled_width + pw;
+          if (max_pool_) {
+            const int mask = static_cast<int>(mask_[c * top_dim + index]);
+            bottom_diff[top_mask_ ? mask :
+                pooling_input_index(p_, ph, pw, mask)] += top_diff[index];
+            continue;
+          }
+          int hstart = ph * p_.stride_h - p_.pad_h;
+          int wstart = pw * p_.stride_w - p_.pad_w;
+          int hend = min(hstart + p_.kernel_h, p_.height + p_.pad_h);
+          int wend = min(wstart + p_.kernel_w, p_.width + p_.pad_w);
+          int pool_size = (hend - hstart) * (wend - wstart);
+          hstart = max(hstart, 0);
+          wstart = max(wstart, 0);
+          hend = min(hend, p_.height);
+          wend = min(wend, p_.width);
+          for (int h = hstart; h < hend; ++h) {
+            for (int w = wstart; w < wend; ++w) {
+              bottom_diff[h * p_.width + w] += top_diff[index] / pool_size;
+            }
+          }
+        }
+      }
+    }
+  }
+
+ private:
+  const PoolingWindows& p_;
+  const bool max_pool_, top_mask_;
+  const Dtype* top_diff_;
+  const Index* mask_;
+  Dtype* bottom_diff_;
+};
+
+template <typename Dtype>
+PoolingWindows PoolingLayer<Dtype>::windows() const {
+  PoolingWindows p;
+  p.height = height_;
+  p.width = width_;
+  p.pooled_height = pooled_height_;
+  p.pooled_width = pooled_width_;
+  p.kernel_h = kernel_h_;
+  p.kernel_w = kernel_w_;
+  p.stride_h = stride_h_;
+  p.stride_w = stride_w_;
+  p.pad_h = pad_h_;
+  p.pad_w = pad_w_;
+  pooling_interior(height_, pooled_height_, kernel_h_, stride_h_, pad_h_,
+      &p.ph_begin, &p.ph_end);
+  pooling_interior(width_, pooled_width_, kernel_w_, stride_w_, pad_w_,
+      &p.pw_begin, &p.pw_end);
+  p.square_kernel = kernel_h_ == kernel_w_ && stride_h_ == 2 &&
+      stride_w_ == 2 && (kernel_h_ == 2 || kernel_h_ == 3) ? kernel_h_ : 0;
+  return p;
+}
+
+template <typename Dtype, typename Index>
+static void pool_channels_cpu(const PoolingWindows& p, const bool max_pool,
+    const bool top_mask, const Dtype* bottom, Dtype* top, Index* mask,
+    const int channels) {
+  parallel_for(channels, PoolingChannels<Dtype, Index>(p, max_pool,
+      top_mask, bottom, top, mask), parallel_grain(p.pooled_height *
+      p.pooled_width * p.kernel_h * p.kernel_w));
+}
+
+template <typename Dtype, typename Index>
+static void unpool_channels_cpu(const PoolingWindows& p,
+    const bool max_pool, const bool top_mask, const Dtype* top_diff,
+    const Index* mask, Dtype* bottom_diff, const int channels) {
+  parallel_for(channels, PoolingChannelsBackward<Dtype, Index>(p, max_pool,
+      top_mask, top_diff, mask, bottom_diff), parallel_grain(
+      p.pooled_height * p.pooled_width * (max_pool ? 1 :
+      p.kernel_h * p.kernel_w) + p.height * p.width));
+}
+
 template <typename Dtype>
 void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  if (bottom[0]->channel_block()) {
+    ForwardNCHWc_cpu(bottom, top);
+    return;
+  }
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  const int top_count = top[0]->count();
-  // We'll output the mask to top[1] if it's of size >1.
-  const bool use_top_mask = top.size() > 1;
-  int* mask = NULL;  // suppress warnings about uninitalized variables
-  Dtype* top_mask = NULL;
-  // Different pooling methods. We explicitly do the switch outside the for
-  // loop to save time, although this results in more code.
+  const int channels = bottom[0]->num() * channels_;
+  const PoolingWindows p = windows();
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
-    // Initialize
-    if (use_top_mask) {
-      top_mask = top[1]->mutable_cpu_data();
-      caffe_set(top_count, Dtype(-1), top_mask);
+    // We'll output the mask to top[1] if it's of size >1.
+    if (top.size() > 1) {
+      pool_channels_cpu(p, true, true, bottom_data, top_data,
+          top[1]->mutable_cpu_data(), channels);
+    } else if (max_window_idx_size_ == sizeof(uint8_t)) {
+      pool_channels_cpu(p, true, false, bottom_data, top_data,
+          static_cast<uint8_t*>(max_window_idx_->mutable_cpu_data()),
+          channels);
+    } else if (max_window_idx_size_ == sizeof(uint16_t)) {
+      pool_channels_cpu(p, true, false, bottom_data, top_data,
+          static_cast<uint16_t*>(max_window_idx_->mutable_cpu_data()),
+          channels);
     } else {
-      mask = max_idx_.mutable_cpu_data();
-      caffe_set(top_count, -1, mask);
+      pool_channels_cpu(p, true, false, bottom_data, top_data,
+          static_cast<int*>(max_window_idx_->mutable_cpu_data()), channels);
     }
-    caffe_set(top_count, Dtype(-FLT_MAX), top_data);
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_);
-            int wend = min(wstart + kernel_w_, width_);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            const int pool_index = ph * pooled_width_ + pw;
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                const int index = h * width_ + w;
-                if (bottom_data[index] > top_data[pool_index]) {
-                  top_data[pool_index] = bottom_data[index];
-                  if (use_top_mask) {
-                    top_mask[pool_index] = static_cast<Dtype>(index);
-                  } else {
-                    mask[pool_index] = index;
-                  }
+    break;
+  case PoolingParameter_PoolMethod_AVE:
+    pool_channels_cpu(p, false, false, bottom_data, top_data,
+        static_cast<int*>(NULL), channels);
+    break;
+  case PoolingParameter_PoolMethod_STOCHASTIC:
+    NOT_IMPLEMENTED;
+    break;
+  default:
+    LOG(FATAL) << "Unknown pooling method.";
+  }
+}
+
+// Pools the blocks of a range of blocks of channels.
+template <typename Dtype>
+class PoolingBlocks {
+ public:
+  PoolingBlocks(const PoolingWindows& p, const bool max_pool,
+      const int block, const Dtype* bottom, Dtype* top)
+      : p_(p), max_pool_(max_pool), block_(block), bottom_(bottom),
+        top_(top) {}
+
+  void operator()(const int begin, const int end) const {
+    const int block = block_;
+    for (int b = begin; b < end; ++b) {
+      const Dtype* bottom_data = bottom_ + b * p_.height * p_.width * block;
+      Dtype* top_data = top_ + b * p_.pooled_height * p_.pooled_width * block;
+      for (int ph = 0; ph < p_.pooled_height; ++ph) {
+        for (int pw = 0; pw < p_.pooled_width; ++pw) {
+          int hstart = ph * p_.stride_h - p_.pad_h;
+          int wstart = pw * p_.stride_w - p_.pad_w;
+          int hend = min(hstart + p_.kernel_h, p_.height + p_.pad_h);
+          int wend = min(wstart + p_.kernel_w, p_.width + p_.pad_w);
+          const int pool_size = (hend - hstart) * (wend - wstart);
+          hstart = max(hstart, 0);
+          wstart = max(wstart, 0);
+          hend = min(hend, p_.height);
+          wend = min(wend, p_.width);
+          Dtype* top_block = top_data + (ph * p_.pooled_width + pw) * block;
+          for (int c = 0; c < block; ++c) {
+            top_block[c] = max_pool_ ? Dtype(-FLT_MAX) : Dtype(0);
+          }
+          for (int h = hstart; h < hend; ++h) {
+            for (int w = wstart; w < wend; ++w) {
+              const Dtype* bottom_block =
+                  bottom_data + (h * p_.width + w) * block;
+              if (max_pool_) {
+                for (int c = 0; c < block; ++c) {
+                  top_block[c] = max(top_block[c], bottom_block[c]);
+                }
+              } else {
+                for (int c = 0; c < block; ++c) {
+                  top_block[c] += bottom_block[c];
                 }
               }
             }
           }
-        }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
-        }
-      }
-    }
-    break;
-  case PoolingParameter_PoolMethod_AVE:
-    for (int i = 0; i < top_count; ++i) {
-      top_data[i] = 0;
-    }
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_ + pad_h_);
-            int wend = min(wstart + kernel_w_, width_ + pad_w_);
-            int pool_size = (hend - hstart) * (wend - wstart);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            hend = min(hend, height_);
-            wend = min(wend, width_);
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                top_data[ph * pooled_width_ + pw] +=
-                    bottom_data[h * width_ + w];
-              }
+          if (!max_pool_) {
+            for (int c = 0; c < block; ++c) {
+              top_block[c] /= pool_size;
             }
-            top_data[ph * pooled_width_ + pw] /= pool_size;
           }
         }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
       }
     }
-    break;
-  case PoolingParameter_PoolMethod_STOCHASTIC:
-    NOT_IMPLEMENTED;
-    break;
-  default:
-    LOG(FATAL) << "Unknown pooling method.";
   }
+
+ private:
+  const PoolingWindows& p_;
+  const bool max_pool_;
+  const int block_;
+  const Dtype* bottom_;
+  Dtype* top_;
+};
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::ForwardNCHWc_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  const int block = bottom[0]->channel_block();
+  const bool max_pool = this->layer_param_.pooling_param().pool() ==
+      PoolingParameter_PoolMethod_MAX;
+  const PoolingWindows p = windows();
+  // Each block of channels is pooled like a channel of block-wide values.
+  const int blocks = bottom[0]->num() * channels_ / block;
+  parallel_for(blocks, PoolingBlocks<Dtype>(p, max_pool, block,
+      bottom[0]->cpu_data(), top[0]->mutable_cpu_data()), parallel_grain(
+      pooled_height_ * pooled_width_ * kernel_h_ * kernel_w_ * block));
 }
 
 template <typename Dtype>
@@ -234,69 +571,31 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
   const Dtype* top_diff = top[0]->cpu_diff();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-  // Different pooling methods. We explicitly do the switch outside the for
-  // loop to save time, although this results in more codes.
-  caffe_set(bottom[0]->count(), Dtype(0), bottom_diff);
-  // We'll output the mask to top[1] if it's of size >1.
-  const bool use_top_mask = top.size() > 1;
-  const int* mask = NULL;  // suppress warnings about uninitialized variables
-  const Dtype* top_mask = NULL;
+  const int channels = bottom[0]->num() * channels_;
+  const PoolingWindows p = windows();
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
-    // The main loop
-    if (use_top_mask) {
-      top_mask = top[1]->cpu_data();
+    // The mask top holds the indices of the inputs.
+    if (top.size() > 1) {
+      unpool_channels_cpu(p, true, true, top_diff, top[1]->cpu_data(),
+          bottom_diff, channels);
+    } else if (max_window_idx_size_ == sizeof(uint8_t)) {
+      unpool_channels_cpu(p, true, false, top_diff,
+          static_cast<const uint8_t*>(max_window_idx_->cpu_data()),
+          bottom_diff, channels);
+    } else if (max_window_idx_size_ == sizeof(uint16_t)) {
+      unpool_channels_cpu(p, true, false, top_diff,
+          static_cast<const uint16_t*>(max_window_idx_->cpu_data()),
+          bottom_diff, channels);
     } else {
-      mask = max_idx_.cpu_data();
-    }
-    for (int n = 0; n < top[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            const int index = ph * pooled_width_ + pw;
-            const int bottom_index =
-                use_top_mask ? top_mask[index] : mask[index];
-            bottom_diff[bottom_index] += top_diff[index];
-          }
-        }
-        bottom_diff += bottom[0]->offset(0, 1);
-        top_diff += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
-        }
-      }
+      unpool_channels_cpu(p, true, false, top_diff,
+          static_cast<const int*>(max_window_idx_->cpu_data()), bottom_diff,
+          channels);
     }
     break;
   case PoolingParameter_PoolMethod_AVE:
-    // The main loop
-    for (int n = 0; n < top[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_ + pad_h_);
-            int wend = min(wstart + kernel_w_, width_ + pad_w_);
-            int pool_size = (hend - hstart) * (wend - wstart);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            hend = min(hend, height_);
-            wend = min(wend, width_);
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                bottom_diff[h * width_ + w] +=
-                  top_diff[ph * pooled_width_ + pw] / pool_size;
-              }
-            }
-          }
-        }
-        // offset
-        bottom_diff += bottom[0]->offset(0, 1);
-        top_diff += top[0]->offset(0, 1);
-      }
-    }
+    unpool_channels_cpu(p, false, false, top_diff,
+        static_cast<const int*>(NULL), bottom_diff, channels);
     break;
   case PoolingParameter_PoolMethod_STOCHASTIC:
     NOT_IMPLEMENTED;
@@ -306,7 +605,6 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
 }
 
-
 #ifdef CPU_ONLY
 STUB_GPU(PoolingLayer);
 #endif
@@ -1,8 +1,6 @@
 #include <algorithm>
 #include <vector>
 
-#include "caffe/filler.hpp"
-
 #include "caffe/layers/neuron_layer.hpp"
 #include "caffe/layers/prelu_layer.hpp"
 
@@ -25,16 +23,12 @@ void PReLULayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     } else {
       this->blobs_[0].reset(new Blob<Dtype>(vector<int>(1, channels)));
     }
-    shared_ptr<Filler<Dtype> > filler;
-    if (prelu_param.has_filler()) {
-      filler.reset(GetFiller<Dtype>(prelu_param.filler()));
-    } else {
-      FillerParameter filler_param;
+    FillerParameter filler_param(prelu_param.filler());
+    if (!prelu_param.has_filler()) {
       filler_param.set_type("constant");
       filler_param.set_value(0.25);
-      filler.reset(GetFiller<Dtype>(filler_param));
     }
-    filler->Fill(this->blobs_[0].get());
+    this->FillParam(0, filler_param);
   }
   if (channel_shared_) {
     CHECK_EQ(this->blobs_[0]->count(), 1)
@@ -0,0 +1,348 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include "caffe/layers/sampled_softmax_loss_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/softmax.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void SampledSoftmaxLossLayer<Dtype>::LayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  LossLayer<Dtype>::LayerSetUp(bottom, top);
+  const InnerProductParameter& ip_param =
+      this->layer_param_.inner_product_param();
+  N_ = ip_param.num_output();
+  CHECK_GT(N_, 0) << "inner_product_param.num_output must be set.";
+  bias_term_ = ip_param.bias_term();
+  K_ = bottom[0]->count(bottom[0]->CanonicalAxisIndex(ip_param.axis()));
+  num_sampled_ = this->layer_param_.sampled_softmax_param().num_sampled();
+  CHECK_GT(num_sampled_, 0) << "num_sampled must be positive.";
+  has_ignore_label_ = this->layer_param_.loss_param().has_ignore_label();
+  if (has_ignore_label_) {
+    ignore_label_ = this->layer_param_.loss_param().ignore_label();
+  }
+  if (!this->layer_param_.loss_param().has_normalization() &&
+      this->layer_param_.loss_param().has_normalize()) {
+    normalization_ = this->layer_param_.loss_param().normalize() ?
+                     LossParameter_NormalizationMode_VALID :
+                     LossParameter_NormalizationMode_BATCH_SIZE;
+  } else {
+    normalization_ = this->layer_param_.loss_param().normalization();
+  }
+  // The weights and the bias of the InnerProductLayer.
+  if (this->blobs_.size() > 0) {
+    LOG(INFO) << "Skipping parameter initialization";
+    // The rows of the weights are read as those of the classes.
+    CHECK_EQ(2, this->blobs_[0]->num_axes());
+    CHECK_EQ(N_, this->blobs_[0]->shape(0))
+        << "The weights must have a row for each of the num_output classes.";
+    CHECK_EQ(K_, this->blobs_[0]->shape(1));
+  } else {
+    this->blobs_.resize(bias_term_ ? 2 : 1);
+    vector<int> weight_shape(2);
+    weight_shape[0] = N_;
+    weight_shape[1] = K_;
+    this->blobs_[0].reset(new Blob<Dtype>(weight_shape));
+    this->FillParam(0, ip_param.weight_filler());
+    if (bias_term_) {
+      vector<int> bias_shape(1, N_);
+      this->blobs_[1].reset(new Blob<Dtype>(bias_shape));
+      this->FillParam(1, ip_param.bias_filler());
+    }
+  }
+  this->param_propagate_down_.resize(this->blobs_.size(), true);
+  sampled_.resize(num_sampled_);
+  sampled_log_count_.resize(num_sampled_);
+  uniform_.resize(num_sampled_);
+  vector<int> sampled_weights_shape(2);
+  sampled_weights_shape[0] = num_sampled_;
+  sampled_weights_shape[1] = K_;
+  sampled_weights_.Reshape(sampled_weights_shape);
+}
+
+template <typename Dtype>
+void SampledSoftmaxLossLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  LossLayer<Dtype>::Reshape(bottom, top);
+  const int axis = bottom[0]->CanonicalAxisIndex(
+      this->layer_param_.inner_product_param().axis());
+  CHECK_EQ(K_, bottom[0]->count(axis))
+      << "Input size incompatible with inner product parameters.";
+  M_ = bottom[0]->count(0, axis);
+  CHECK_EQ(M_, bottom[1]->count())
+      << "Number of labels must match number of predictions.";
+  vector<int> logits_shape(2);
+  logits_shape[0] = M_;
+  logits_shape[1] = num_sampled_;
+  sampled_logits_.Reshape(logits_shape);
+  logits_shape[1] = this->phase_ == TRAIN ? 1 + num_sampled_ : N_;
+  logits_.Reshape(logits_shape);
+  log_norm_.Reshape(vector<int>(1, M_));
+}
+
+template <typename Dtype>
+Dtype SampledSoftmaxLossLayer<Dtype>::LogExpectedCount(const int k) const {
+  double probability = 1. / N_;
+  if (this->layer_param_.sampled_softmax_param().sampler() ==
+      SampledSoftmaxParameter_Sampler_LOG_UNIFORM) {
+    probability = log1p(1. / (k + 1)) / log(N_ + 1.);
+  }
+  return static_cast<Dtype>(log(num_sampled_ * probability));
+}
+
+template <typename Dtype>
+void SampledSoftmaxLossLayer<Dtype>::Sample() {
+  const bool log_uniform =
+      this->layer_param_.sampled_softmax_param().sampler() ==
+      SampledSoftmaxParameter_Sampler_LOG_UNIFORM;
+  caffe_rng_uniform(num_sampled_, 0., 1., &uniform_[0]);
+  for (int j = 0; j < num_sampled_; ++j) {
+    // The inverse of the distribution function of the sampler.
+    const int k = log_uniform ?
+        static_cast<int>(exp(uniform_[j] * log(N_ + 1.))) - 1 :
+        static_cast<int>(uniform_[j] * N_);
+    sampled_[j] = std::min(std::max(k, 0), N_ - 1);
+    sampled_log_count_[j] = LogExpectedCount(sampled_[j]);
+  }
+}
+
+template <typename Dtype>
+Dtype SampledSoftmaxLossLayer<Dtype>::get_normalizer(
+    const Dtype valid_count) const {
+  Dtype normalizer;
+  switch (normalization_) {
+    case LossParameter_NormalizationMode_FULL:
+    case LossParameter_NormalizationMode_BATCH_SIZE:
+      normalizer = Dtype(M_);
+      break;
+    case LossParameter_NormalizationMode_VALID:
+      normalizer = valid_count;
+      break;
+    case LossParameter_NormalizationMode_NONE:
+      normalizer = Dtype(1);
+      break;
+    default:
+      LOG(FATAL) << "Unknown normalization mode: "
+          << LossParameter_NormalizationMode_Name(normalization_);
+  }
+  return std::max(Dtype(1.0), normalizer);
+}
+
+// log(1 + e^x), without overflow.
+template <typename Dtype>
+static inline Dtype softplus(const Dtype x) {
+  return std::max(x, Dtype(0)) + log1p(exp(-std::fabs(x)));
+}
+
+template <typename Dtype>
+static inline Dtype sigmoid(const Dtype x) {
+  return 1. / (1. + exp(-x));
+}
+
+template <typename Dtype>
+Dtype SampledSoftmaxLossLayer<Dtype>::ForwardFull(const Dtype* bottom_data,
+    const Dtype* label) {
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  Dtype* logits = logits_.mutable_cpu_data();
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M_, N_, K_, (Dtype)1.,
+      bottom_data, weight, (Dtype)0., logits);
+  // The diff of log_norm_ keeps the logits of the labels.
+  Dtype* true_logits = log_norm_.mutable_cpu_diff();
+  for (int i = 0; i < M_; ++i) {
+    if (bias_term_) {
+      caffe_axpy<Dtype>(N_, Dtype(1), this->blobs_[1]->cpu_data(),
+          logits + i * N_);
+    }
+    const int label_value = static_cast<int>(label[i]);
+    true_logits[i] = has_ignore_label_ && label_value == ignore_label_ ?
+        Dtype(0) : logits[i * N_ + label_value];
+  }
+  caffe_cpu_softmax(M_, N_, 1, logits, logits, log_norm_.mutable_cpu_data(),
+      this->layer_param_.math_accuracy() == FAST);
+  const Dtype* log_norm = log_norm_.cpu_data();
+  Dtype loss = 0;
+  for (int i = 0; i < M_; ++i) {
+    const int label_value = static_cast<int>(label[i]);
+    if (has_ignore_label_ && label_value == ignore_label_) {
+      continue;
+    }
+    loss += log_norm[i] - true_logits[i];
+  }
+  return loss;
+}
+
+template <typename Dtype>
+void SampledSoftmaxLossLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  const Dtype* label = bottom[1]->cpu_data();
+  valid_count_ = 0;
+  for (int i = 0; i < M_; ++i) {
+    const int label_value = static_cast<int>(label[i]);
+    if (!has_ignore_label_ || label_value != ignore_label_) {
+      DCHECK_GE(label_value, 0);
+      DCHECK_LT(label_value, N_);
+      ++valid_count_;
+    }
+  }
+  if (this->phase_ != TRAIN) {
+    top[0]->mutable_cpu_data()[0] = ForwardFull(bottom_data, label) /
+        get_normalizer(valid_count_);
+    return;
+  }
+  // The logits of the sampled classes, from their rows of the weights.
+  Sample();
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  const Dtype* bias = bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  Dtype* sampled_weights = sampled_weights_.mutable_cpu_data();
+  for (int j = 0; j < num_sampled_; ++j) {
+    caffe_copy(K_, weight + sampled_[j] * K_, sampled_weights + j * K_);
+  }
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M_, num_sampled_, K_,
+      (Dtype)1., bottom_data, sampled_weights, (Dtype)0.,
+      sampled_logits_.mutable_cpu_data());
+  // The corrected logits of the true class and of the sampled ones; the
+  // accidental hits get no probability.
+  const bool remove_accidental_hits =
+      this->layer_param_.sampled_softmax_param().remove_accidental_hits();
+  const bool nce = this->layer_param_.sampled_softmax_param().loss() ==
+      SampledSoftmaxParameter_Loss_NCE;
+  const Dtype* sampled_logits = sampled_logits_.cpu_data();
+  const int dim = 1 + num_sampled_;
+  Dtype* logits = logits_.mutable_cpu_data();
+  Dtype* logits_diff = logits_.mutable_cpu_diff();
+  for (int i = 0; i < M_; ++i) {
+    const int label_value = static_cast<int>(label[i]);
+    const bool ignored = has_ignore_label_ && label_value == ignore_label_;
+    Dtype* row = logits + i * dim;
+    row[0] = ignored ? Dtype(0) : caffe_cpu_dot(K_, bottom_data + i * K_,
+        weight + label_value * K_) + (bias ? bias[label_value] : Dtype(0)) -
+        LogExpectedCount(label_value);
+    for (int j = 0; j < num_sampled_; ++j) {
+      row[1 + j] = sampled_logits[i * num_sampled_ + j] -
+          sampled_log_count_[j] + (bias ? bias[sampled_[j]] : Dtype(0));
+      if (remove_accidental_hits && sampled_[j] == label_value) {
+        row[1 + j] = -FLT_MAX;
+      }
+    }
+  }
+  // The loss, and in the diff of the logits its gradient.
+  Dtype loss = 0;
+  if (!nce) {
+    caffe_cpu_softmax(M_, dim, 1, logits, logits_diff,
+        log_norm_.mutable_cpu_data(),
+        this->layer_param_.math_accuracy() == FAST);
+  }
+  const Dtype* log_norm = log_norm_.cpu_data();
+  for (int i = 0; i < M_; ++i) {
+    const int label_value = static_cast<int>(label[i]);
+    const Dtype* row = logits + i * dim;
+    Dtype* row_diff = logits_diff + i * dim;
+    if (has_ignore_label_ && label_value == ignore_label_) {
+      caffe_set(dim, Dtype(0), row_diff);
+      continue;
+    }
+    if (!nce) {
+      // The gradient of the softmax loss is its prob less 1 at the label.
+      loss += log_norm[i] - row[0];
+      row_diff[0] -= 1;
+      continue;
+    }
+    // -log(sigmoid(z)) for the true class, and -log(1 - sigmoid(z)) for
+    // the sampled ones.
+    loss += softplus(-row[0]);
+    row_diff[0] = sigmoid(row[0]) - 1;
+    for (int j = 0; j < num_sampled_; ++j) {
+      if (remove_accidental_hits && sampled_[j] == label_value) {
+        row_diff[1 + j] = 0;
+        continue;
+      }
+      loss += softplus(row[1 + j]);
+      row_diff[1 + j] = sigmoid(row[1 + j]);
+    }
+  }
+  top[0]->mutable_cpu_data()[0] = loss / get_normalizer(valid_count_);
+}
+
+template <typename Dtype>
+void SampledSoftmaxLossLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  if (propagate_down[1]) {
+    LOG(FATAL) << this->type()
+               << " Layer cannot backpropagate to label inputs.";
+  }
+  CHECK_EQ(this->phase_, TRAIN) << this->type()
+      << " Layer backpropagates the sampled loss of the TRAIN phase only.";
+  const Dtype scale = top[0]->cpu_diff()[0] / get_normalizer(valid_count_);
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  const Dtype* label = bottom[1]->cpu_data();
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  const Dtype* logits_diff = logits_.cpu_diff();
+  const int dim = 1 + num_sampled_;
+  // The scaled gradients of the logits of the sampled classes.
+  Dtype* sampled_logits_diff = sampled_logits_.mutable_cpu_diff();
+  for (int i = 0; i < M_; ++i) {
+    caffe_cpu_scale(num_sampled_, scale, logits_diff + i * dim + 1,
+        sampled_logits_diff + i * num_sampled_);
+  }
+  if (this->param_propagate_down_[0]) {
+    // The rows of the sampled classes and of the true ones.
+    Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
+    Dtype* sampled_weights_diff = sampled_weights_.mutable_cpu_diff();
+    caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, num_sampled_, K_, M_,
+        (Dtype)1., sampled_logits_diff, bottom_data, (Dtype)0.,
+        sampled_weights_diff);
+    for (int j = 0; j < num_sampled_; ++j) {
+      caffe_axpy<Dtype>(K_, Dtype(1), sampled_weights_diff + j * K_,
+          weight_diff + sampled_[j] * K_);
+      this->blobs_[0]->mark_diff_row(sampled_[j]);
+    }
+    for (int i = 0; i < M_; ++i) {
+      const int label_value = static_cast<int>(label[i]);
+      if (!has_ignore_label_ || label_value != ignore_label_) {
+        caffe_axpy<Dtype>(K_, scale * logits_diff[i * dim],
+            bottom_data + i * K_, weight_diff + label_value * K_);
+        this->blobs_[0]->mark_diff_row(label_value);
+      }
+    }
+  }
+  if (bias_term_ && this->param_propagate_down_[1]) {
+    Dtype* bias_diff = this->blobs_[1]->mutable_cpu_diff();
+    for (int j = 0; j < num_sampled_; ++j) {
+      this->blobs_[1]->mark_diff_row(sampled_[j]);
+    }
+    for (int i = 0; i < M_; ++i) {
+      for (int j = 0; j < num_sampled_; ++j) {
+        bias_diff[sampled_[j]] += sampled_logits_diff[i * num_sampled_ + j];
+      }
+      const int label_value = static_cast<int>(label[i]);
+      if (!has_ignore_label_ || label_value != ignore_label_) {
+        bias_diff[label_value] += scale * logits_diff[i * dim];
+        this->blobs_[1]->mark_diff_row(label_value);
+      }
+    }
+  }
+  if (propagate_down[0]) {
+    Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, K_, num_sampled_,
+        (Dtype)1., sampled_logits_diff, sampled_weights_.cpu_data(),
+        (Dtype)0., bottom_diff);
+    for (int i = 0; i < M_; ++i) {
+      const int label_value = static_cast<int>(label[i]);
+      if (!has_ignore_label_ || label_value != ignore_label_) {
+        caffe_axpy<Dtype>(K_, scale * logits_diff[i * dim],
+            weight + label_value * K_, bottom_diff + i * K_);
+      }
+    }
+  }
+}
+
+INSTANTIATE_CLASS(SampledSoftmaxLossLayer);
+REGISTER_LAYER_CLASS(SampledSoftmaxLoss);
+
+}  // namespace caffe
@@ -1,7 +1,6 @@
 #include <algorithm>
 #include <vector>
 
-#include "caffe/filler.hpp"
 #include "caffe/layer_factory.hpp"
 #include "caffe/layers/scale_layer.hpp"
 #include "caffe/util/math_functions.hpp"
@@ -38,8 +37,7 @@ void ScaleLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       filler_param.set_type("constant");
       filler_param.set_value(1);
     }
-    shared_ptr<Filler<Dtype> > filler(GetFiller<Dtype>(filler_param));
-    filler->Fill(this->blobs_[0].get());
+    this->FillParam(0, filler_param);
   }
   if (param.bias_term()) {
     LayerParameter layer_param(this->layer_param_);
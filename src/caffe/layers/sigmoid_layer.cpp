@@ -2,6 +2,7 @@
 #include <vector>
 
 #include "caffe/layers/sigmoid_layer.hpp"
+#include "caffe/util/fast_math.hpp"
 
 namespace caffe {
 
@@ -16,6 +17,10 @@ void SigmoidLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
+  if (this->layer_param_.math_accuracy() == FAST) {
+    caffe_cpu_fast_sigmoid(count, bottom_data, top_data);
+    return;
+  }
   for (int i = 0; i < count; ++i) {
     top_data[i] = sigmoid(bottom_data[i]);
   }
@@ -4,6 +4,8 @@
 
 #include "caffe/layers/softmax_loss_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/parallel.hpp"
+#include "caffe/util/softmax.hpp"
 
 namespace caffe {
 
@@ -53,6 +55,9 @@ void SoftmaxWithLossLayer<Dtype>::Reshape(
     // softmax output
     top[1]->ReshapeLike(*bottom[0]);
   }
+  vector<int> log_norm_shape = bottom[0]->shape();
+  log_norm_shape[softmax_axis_] = 1;
+  log_norm_.Reshape(log_norm_shape);
 
   CHECK_EQ(bottom[1]->channels(), 1);
   if (bottom.size() == 3) {
@@ -96,15 +101,21 @@ Dtype SoftmaxWithLossLayer<Dtype>::get_normalizer(
 template <typename Dtype>
 void SoftmaxWithLossLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  // The forward pass computes the softmax prob values.
-  softmax_layer_->Forward(softmax_bottom_vec_, softmax_top_vec_);
-  const Dtype* prob_data = prob_.cpu_data();
+  // The forward pass computes the softmax prob values, and the logs of their
+  // normalizers, from which the log prob of the labels are exact.
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  caffe_cpu_softmax(outer_num_, bottom[0]->shape(softmax_axis_), inner_num_,
+      bottom_data, prob_.mutable_cpu_data(), log_norm_.mutable_cpu_data(),
+      this->layer_param_.math_accuracy() == FAST);
+  const Dtype* log_norm = log_norm_.cpu_data();
   const Dtype* label = bottom[1]->cpu_data();
   int dim = prob_.count() / outer_num_;
 
   const bool use_weights = bottom.size() == 3;
   const Dtype* weights = use_weights ? bottom[2]->cpu_data() : NULL;
   Dtype count = Dtype(0.0);
+  // The log of the prob clipped to FLT_MIN.
+  const Dtype min_log_prob = log(Dtype(FLT_MIN));
 
   Dtype loss = 0;
   for (int i = 0; i < outer_num_; ++i) {
@@ -119,8 +130,9 @@ void SoftmaxWithLossLayer<Dtype>::Forward_cpu(
 
       DCHECK_GE(label_value, 0);
       DCHECK_LT(label_value, prob_.shape(softmax_axis_));
-      loss -= weight_value * log(std::max(prob_data[i * dim + label_value * inner_num_ + j],
-            Dtype(FLT_MIN)));
+      loss -= weight_value * std::max(bottom_data[i * dim +
+          label_value * inner_num_ + j] - log_norm[i * inner_num_ + j],
+          min_log_prob);
       count += weight_value;
     }
   }
@@ -130,6 +142,63 @@ void SoftmaxWithLossLayer<Dtype>::Forward_cpu(
   }
 }
 
+// The gradient of a range of the outer indices, (prob - 1 at the label)
+// times the weight and the loss weight, or 0 for the ignored labels, in one
+// pass.
+template <typename Dtype>
+class SoftmaxLossBackward {
+ public:
+  SoftmaxLossBackward(const int channels, const int inner_num,
+      const Dtype* prob, const Dtype* label, const Dtype* weights,
+      const bool has_ignore_label, const int ignore_label,
+      const Dtype loss_weight, Dtype* bottom_diff)
+      : channels_(channels), inner_num_(inner_num), prob_(prob),
+        label_(label), weights_(weights), has_ignore_label_(has_ignore_label),
+        ignore_label_(ignore_label), loss_weight_(loss_weight),
+        bottom_diff_(bottom_diff) {}
+
+  void operator()(const int begin, const int end) const {
+    const int dim = channels_ * inner_num_;
+    for (int i = begin; i < end; ++i) {
+      const Dtype* prob = prob_ + i * dim;
+      Dtype* bottom_diff = bottom_diff_ + i * dim;
+      for (int c = 0; c < channels_; ++c) {
+        for (int j = 0; j < inner_num_; ++j) {
+          bottom_diff[c * inner_num_ + j] = prob[c * inner_num_ + j] *
+              scale(i * inner_num_ + j);
+        }
+      }
+      // The ignored labels need not be channels, and have no 1 to subtract.
+      for (int j = 0; j < inner_num_; ++j) {
+        const int label_value = static_cast<int>(label_[i * inner_num_ + j]);
+        if (has_ignore_label_ && label_value == ignore_label_) {
+          continue;
+        }
+        bottom_diff[label_value * inner_num_ + j] -=
+            scale(i * inner_num_ + j);
+      }
+    }
+  }
+
+ private:
+  Dtype scale(const int index) const {
+    const int label_value = static_cast<int>(label_[index]);
+    if (has_ignore_label_ && label_value == ignore_label_) {
+      return 0;
+    }
+    return weights_ ? weights_[index] * loss_weight_ : loss_weight_;
+  }
+
+  const int channels_, inner_num_;
+  const Dtype* prob_;
+  const Dtype* label_;
+  const Dtype* weights_;
+  const bool has_ignore_label_;
+  const int ignore_label_;
+  const Dtype loss_weight_;
+  Dtype* bottom_diff_;
+};
+
 template <typename Dtype>
 void SoftmaxWithLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
@@ -138,44 +207,24 @@ void SoftmaxWithLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                << " Layer cannot backpropagate to label inputs.";
   }
   if (propagate_down[0]) {
-    Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-    const Dtype* prob_data = prob_.cpu_data();
-    caffe_copy(prob_.count(), prob_data, bottom_diff);
     const Dtype* label = bottom[1]->cpu_data();
-    int dim = prob_.count() / outer_num_;
-
-    Dtype count = Dtype(0.0);
     const bool use_weights = bottom.size() == 3;
     const Dtype* weights = use_weights ? bottom[2]->cpu_data() : NULL;
-    const int num_channels = prob_.channels();
-
-    for (int i = 0; i < outer_num_; ++i) {
-      for (int j = 0; j < inner_num_; ++j) {
-        const int label_value = static_cast<int>(label[i * inner_num_ + j]);
-        if (has_ignore_label_ && label_value == ignore_label_) {
-          for (int c = 0; c < bottom[0]->shape(softmax_axis_); ++c) {
-            bottom_diff[i * dim + c * inner_num_ + j] = 0;
-          }
-        } else {
-          bottom_diff[i * dim + label_value * inner_num_ + j] -= 1;
-
-          if (use_weights) {
-            const Dtype weight_value = static_cast<Dtype>(weights[i * inner_num_ + j]);
-            for (int k = 0; k < num_channels; ++k) {
-              bottom_diff[i * dim + k * inner_num_ + j] *= weight_value;
-            }
-            count += weight_value;
-          }
-          else{
-            count += 1.0;
-          }
-        }
+    Dtype count = Dtype(0.0);
+    for (int i = 0; i < outer_num_ * inner_num_; ++i) {
+      const int label_value = static_cast<int>(label[i]);
+      if (!has_ignore_label_ || label_value != ignore_label_) {
+        count += use_weights ? weights[i] : Dtype(1);
       }
     }
     // Scale gradient
     Dtype loss_weight = top[0]->cpu_diff()[0] /
                         get_normalizer(normalization_, count);
-    caffe_scal(prob_.count(), loss_weight, bottom_diff);
+    const int channels = bottom[0]->shape(softmax_axis_);
+    parallel_for(outer_num_, SoftmaxLossBackward<Dtype>(channels, inner_num_,
+        prob_.cpu_data(), label, weights, has_ignore_label_, ignore_label_,
+        loss_weight, bottom[0]->mutable_cpu_diff()),
+        parallel_grain(channels * inner_num_));
   }
 }
 
@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "caffe/layers/tanh_layer.hpp"
+#include "caffe/util/fast_math.hpp"
 
 namespace caffe {
 
@@ -13,6 +14,10 @@ void TanHLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
+  if (this->layer_param_.math_accuracy() == FAST) {
+    caffe_cpu_fast_tanh(count, bottom_data, top_data);
+    return;
+  }
   for (int i = 0; i < count; ++i) {
     top_data[i] = tanh(bottom_data[i]);
   }
@@ -1,4 +1,9 @@
+#include <stdint.h>
+
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
 #include <map>
 #include <set>
 #include <string>
@@ -14,6 +19,7 @@
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/insert_splits.hpp"
+#include "caffe/util/mapped_file.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
@@ -87,6 +93,17 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     if (!param.layer(layer_id).has_phase()) {
       param.mutable_layer(layer_id)->set_phase(phase_);
     }
+    // Likewise the math accuracy.
+    if (!param.layer(layer_id).has_math_accuracy()) {
+      param.mutable_layer(layer_id)->set_math_accuracy(param.math_accuracy());
+    }
+    // And the convolution algorithm.
+    if (param.has_conv_algorithm() &&
+        param.layer(layer_id).has_convolution_param() &&
+        !param.layer(layer_id).convolution_param().has_algorithm()) {
+      param.mutable_layer(layer_id)->mutable_convolution_param()
+          ->set_algorithm(param.conv_algorithm());
+    }
     // Setup layer.
     const LayerParameter& layer_param = param.layer(layer_id);
     if (layer_param.propagate_down_size() > 0) {
@@ -145,6 +162,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
             << layer_param.name();
       }
     } else {
+      layers_[layer_id]->set_defer_fill(param.defer_fill());
       layers_[layer_id]->SetUp(bottom_vecs_[layer_id], top_vecs_[layer_id]);
     }
     LOG_IF(INFO, Caffe::root_solver())
@@ -279,7 +297,65 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     layer_names_index_[layer_names_[layer_id]] = layer_id;
   }
   ShareWeights();
+  fill_deferred_ = param.defer_fill();
   debug_info_ = param.debug_info();
+  forward_only_ = false;
+  if (param.forward_only()) {
+    if (phase_ == TEST && !param.force_backward()) {
+      DisableDiffs();
+    } else {
+      LOG_IF(WARNING, Caffe::root_solver())
+          << "Ignoring forward_only: only TEST phase nets without "
+          << "force_backward can do without diffs.";
+    }
+  }
+  param_storage_ = NATIVE;
+  if (param.param_storage() != NATIVE) {
+    if (phase_ == TEST) {
+      param_storage_ = param.param_storage();
+    } else {
+      LOG_IF(WARNING, Caffe::root_solver())
+          << "Ignoring param_storage: the parameters of TRAIN phase nets are "
+          << "updated in place.";
+    }
+  }
+  channel_block_ = 0;
+  if (param.channel_block()) {
+    if (phase_ == TEST && !param.force_backward()) {
+      channel_block_ = param.channel_block();
+      LOG_IF(WARNING, Caffe::root_solver() && channel_block_ != 16)
+          << "channel_block " << channel_block_ << " is not 16, the only "
+          << "block the convolutions compute in, so the activations are "
+          << "reordered to NCHW and back around each of them.";
+    } else {
+      LOG_IF(WARNING, Caffe::root_solver())
+          << "Ignoring channel_block: only forward-only (TEST phase) nets "
+          << "keep their activations in the blocked layout.";
+    }
+  }
+  // Count the diffs of the top blobs apart from their data.
+  diff_memory_used_ = 0;
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
+      if (!top_vecs_[layer_id][top_id]->diff_disabled()) {
+        diff_memory_used_ += top_vecs_[layer_id][top_id]->count();
+      }
+    }
+  }
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Memory required for diffs: " << diff_memory_used_ * sizeof(Dtype);
+  optimize_memory_ = false;
+  memory_planned_ = memory_used_;
+  blob_buffer_ids_.clear();
+  if (param.optimize_memory()) {
+    if (phase_ == TEST && !param.force_backward()) {
+      PlanMemory();
+    } else {
+      LOG_IF(WARNING, Caffe::root_solver())
+          << "Ignoring optimize_memory: only forward-only (TEST phase) nets "
+          << "can share activation memory.";
+    }
+  }
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 }
 
@@ -518,6 +594,8 @@ void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
     Blob<Dtype>* this_blob = layers_[layer_id]->blobs()[param_id].get();
     Blob<Dtype>* owner_blob =
         layers_[owner_layer_id]->blobs()[owner_param_id].get();
+    // The values come from the owner, filled or loaded.
+    layers_[layer_id]->CancelDeferredFill(param_id);
     const int param_size = layer_param.param_size();
     if (param_size > param_id && (layer_param.param(param_id).share_mode() ==
                                   ParamSpec_DimCheckMode_PERMISSIVE)) {
@@ -565,6 +643,12 @@ template <typename Dtype>
 Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   CHECK_GE(start, 0);
   CHECK_LT(end, layers_.size());
+  if (fill_deferred_) {
+    FillDeferredParams();
+  }
+  if (param_storage_ != NATIVE) {
+    PackParams();
+  }
   Dtype loss = 0;
   if (debug_info_) {
     for (int i = 0; i < net_input_blobs_.size(); ++i) {
@@ -573,13 +657,58 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   }
   for (int i = start; i <= end; ++i) {
     // LOG(ERROR) << "Forwarding " << layer_names_[i];
+    const int block = channel_block_ ? ReorderBottoms(i) : 0;
     Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
     loss += layer_loss;
+    if (channel_block_) {
+      for (int j = 0; j < top_vecs_[i].size(); ++j) {
+        top_vecs_[i][j]->set_channel_block(block);
+      }
+    }
     if (debug_info_) { ForwardDebugInfo(i); }
   }
+  if (channel_block_) {
+    // The caller reads the outputs and fills the inputs in NCHW.
+    for (int i = 0; i < net_input_blobs_.size(); ++i) {
+      ReorderChannelBlock(net_input_blobs_[i], 0);
+    }
+    for (int i = 0; i < net_output_blobs_.size(); ++i) {
+      ReorderChannelBlock(net_output_blobs_[i], 0);
+    }
+  }
   return loss;
 }
 
+template <typename Dtype>
+int Net<Dtype>::ReorderBottoms(const int layer_id) {
+  const vector<Blob<Dtype>*>& bottom = bottom_vecs_[layer_id];
+  int block = Caffe::mode() == Caffe::CPU ? channel_block_ : 0;
+  for (int i = 0; i < bottom.size() && block; ++i) {
+    if (bottom[i]->num_axes() != 4 || bottom[i]->channels() % block) {
+      block = 0;
+    }
+  }
+  if (block && (bottom.empty() ||
+      !layers_[layer_id]->SupportsChannelBlock(bottom, block))) {
+    block = 0;
+  }
+  for (int i = 0; i < bottom.size(); ++i) {
+    ReorderChannelBlock(bottom[i], block);
+  }
+  return block;
+}
+
+template <typename Dtype>
+void Net<Dtype>::ReorderChannelBlock(Blob<Dtype>* blob, const int block) {
+  if (blob->channel_block() == block) { return; }
+  blob->ReorderChannelBlock(block);
+  for (int i = 0; i < blobs_.size(); ++i) {
+    if (blobs_[i]->data() == blob->data()) {
+      blobs_[i]->set_channel_block(block);
+    }
+  }
+}
+
 template <typename Dtype>
 Dtype Net<Dtype>::ForwardFrom(int start) {
   return ForwardFromTo(start, layers_.size() - 1);
@@ -761,10 +890,39 @@ void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
           << source_blob->shape_string() << "; target param shape is "
           << target_blobs[j]->shape_string();
       target_blobs[j]->ShareData(*source_blob);
+      layers_[target_layer_id]->CancelDeferredFill(j);
     }
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::FillDeferredParams() {
+  for (int i = 0; i < layers_.size(); ++i) {
+    layers_[i]->FillDeferredParams();
+  }
+  fill_deferred_ = false;
+}
+
+template <typename Dtype>
+void Net<Dtype>::PackParams() {
+  bool packed = false;
+  for (int i = 0; i < params_.size(); ++i) {
+    if (param_owners_[i] >= 0 ||
+        params_[i]->storage_precision() == param_storage_) {
+      continue;
+    }
+    const int layer_id = param_layer_indices_[i].first;
+    const int param_id = param_layer_indices_[i].second;
+    if (!layers_[layer_id]->ReadsPackedParam(param_id)) { continue; }
+    params_[i]->Pack(param_storage_);
+    packed = true;
+  }
+  // The sharers still hold the unpacked data of their owners.
+  if (packed) {
+    ShareWeights();
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::BackwardFrom(int start) {
   BackwardFromTo(start, 0);
@@ -799,6 +957,218 @@ void Net<Dtype>::Reshape() {
   for (int i = 0; i < layers_.size(); ++i) {
     layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
   }
+  if (optimize_memory_) {
+    PlanMemory();
+  }
+}
+
+// Helpers for Net::PlanMemory: union-find over the blob ids, where each blob
+// points to another one sharing its buffer until reaching the buffer's root.
+static int FindBuffer(int blob_id, vector<int>* buffer_ids) {
+  while ((*buffer_ids)[blob_id] != blob_id) {
+    (*buffer_ids)[blob_id] = (*buffer_ids)[(*buffer_ids)[blob_id]];
+    blob_id = (*buffer_ids)[blob_id];
+  }
+  return blob_id;
+}
+
+static void MergeBuffers(const int blob_id, const int other_blob_id,
+    vector<int>* buffer_ids) {
+  const int root = FindBuffer(blob_id, buffer_ids);
+  const int other_root = FindBuffer(other_blob_id, buffer_ids);
+  (*buffer_ids)[std::max(root, other_root)] = std::min(root, other_root);
+}
+
+template <typename Dtype>
+void Net<Dtype>::PlanMemory() {
+  CHECK_EQ(phase_, TEST)
+      << "Activation memory can only be planned for forward-only nets.";
+  optimize_memory_ = true;
+  const int num_blobs = blobs_.size();
+  // Group the blobs into buffers by the data they share, either already or
+  // once a layer points its top at its bottom in Forward. This is only done
+  // once: after planning, unrelated blobs share memory as well.
+  if (blob_buffer_ids_.empty()) {
+    blob_buffer_ids_.resize(num_blobs);
+    for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+      blob_buffer_ids_[blob_id] = blob_id;
+    }
+    map<const SyncedMemory*, int> memory_to_blob;
+    for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+      if (blobs_[blob_id]->count() == 0) { continue; }
+      const SyncedMemory* memory = blobs_[blob_id]->data().get();
+      if (memory_to_blob.find(memory) == memory_to_blob.end()) {
+        memory_to_blob[memory] = blob_id;
+      } else {
+        MergeBuffers(blob_id, memory_to_blob[memory], &blob_buffer_ids_);
+      }
+    }
+    for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+      for (int top_id = 0; top_id < top_id_vecs_[layer_id].size(); ++top_id) {
+        if (layers_[layer_id]->SharesBottomData(top_id)) {
+          MergeBuffers(top_id_vecs_[layer_id][top_id],
+              bottom_id_vecs_[layer_id][0], &blob_buffer_ids_);
+        }
+      }
+    }
+    for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+      blob_buffer_ids_[blob_id] = FindBuffer(blob_id, &blob_buffer_ids_);
+    }
+    // Inputs are filled by the caller and outputs are read after Forward,
+    // so neither may be overwritten: pin their whole buffer. So are the tops
+    // a layer points at its own memory, which is not the region's to share.
+    set<int> pinned_buffers;
+    for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+      for (int top_id = 0; top_id < top_id_vecs_[layer_id].size(); ++top_id) {
+        if (layers_[layer_id]->SetsTopData(top_id)) {
+          pinned_buffers.insert(
+              blob_buffer_ids_[top_id_vecs_[layer_id][top_id]]);
+        }
+      }
+    }
+    for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+      pinned_buffers.insert(blob_buffer_ids_[net_input_blob_indices_[i]]);
+    }
+    for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+      pinned_buffers.insert(blob_buffer_ids_[net_output_blob_indices_[i]]);
+    }
+    for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+      if (pinned_buffers.count(blob_buffer_ids_[blob_id])) {
+        blob_buffer_ids_[blob_id] = -1;
+      }
+    }
+  }
+  // Find the live range [first, last] of layers touching each buffer, and
+  // the number of elements it has to hold.
+  vector<int> buffer_first(num_blobs, layers_.size());
+  vector<int> buffer_last(num_blobs, -1);
+  vector<size_t> buffer_count(num_blobs, 0);
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    vector<int> blob_ids(bottom_id_vecs_[layer_id]);
+    blob_ids.insert(blob_ids.end(), top_id_vecs_[layer_id].begin(),
+        top_id_vecs_[layer_id].end());
+    for (int i = 0; i < blob_ids.size(); ++i) {
+      const int buffer_id = blob_buffer_ids_[blob_ids[i]];
+      if (buffer_id < 0) { continue; }
+      buffer_first[buffer_id] = std::min(buffer_first[buffer_id], layer_id);
+      buffer_last[buffer_id] = std::max(buffer_last[buffer_id], layer_id);
+    }
+  }
+  // Like memory_used_, the planned memory excludes the net inputs; pinned
+  // blobs sharing data are only counted once.
+  set<int> input_blob_ids(net_input_blob_indices_.begin(),
+      net_input_blob_indices_.end());
+  map<const SyncedMemory*, size_t> pinned_counts;
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    const int buffer_id = blob_buffer_ids_[blob_id];
+    const size_t count = blobs_[blob_id]->count();
+    if (buffer_id >= 0) {
+      buffer_count[buffer_id] = std::max(buffer_count[buffer_id], count);
+    } else if (count > 0 && !input_blob_ids.count(blob_id)) {
+      size_t& pinned_count = pinned_counts[blobs_[blob_id]->data().get()];
+      pinned_count = std::max(pinned_count, count);
+    }
+  }
+  memory_planned_ = 0;
+  for (map<const SyncedMemory*, size_t>::const_iterator it =
+       pinned_counts.begin(); it != pinned_counts.end(); ++it) {
+    memory_planned_ += it->second;
+  }
+  // Assign the buffers to shared regions greedily in order of definition:
+  // a buffer reuses the best fitting region released by a buffer whose last
+  // use precedes its first use, growing the largest free region if none fits.
+  vector<pair<int, int> > buffers_by_first;
+  for (int buffer_id = 0; buffer_id < num_blobs; ++buffer_id) {
+    if (buffer_last[buffer_id] >= 0 && buffer_count[buffer_id] > 0) {
+      buffers_by_first.push_back(
+          make_pair(buffer_first[buffer_id], buffer_id));
+    }
+  }
+  std::sort(buffers_by_first.begin(), buffers_by_first.end());
+  vector<size_t> region_counts;
+  vector<int> buffer_regions(num_blobs, -1);
+  vector<int> live_buffers;
+  vector<int> free_regions;
+  for (int i = 0; i < buffers_by_first.size(); ++i) {
+    const int first = buffers_by_first[i].first;
+    const int buffer_id = buffers_by_first[i].second;
+    for (int j = live_buffers.size() - 1; j >= 0; --j) {
+      if (buffer_last[live_buffers[j]] < first) {
+        free_regions.push_back(buffer_regions[live_buffers[j]]);
+        live_buffers.erase(live_buffers.begin() + j);
+      }
+    }
+    const size_t count = buffer_count[buffer_id];
+    int best = -1;
+    for (int j = 0; j < free_regions.size(); ++j) {
+      if (best < 0) {
+        best = j;
+        continue;
+      }
+      const size_t region_count = region_counts[free_regions[j]];
+      const size_t best_count = region_counts[free_regions[best]];
+      const bool best_fits = best_count >= count;
+      if (region_count >= count ? (!best_fits || region_count < best_count)
+          : (!best_fits && region_count > best_count)) {
+        best = j;
+      }
+    }
+    if (best >= 0) {
+      buffer_regions[buffer_id] = free_regions[best];
+      free_regions.erase(free_regions.begin() + best);
+      region_counts[buffer_regions[buffer_id]] =
+          std::max(region_counts[buffer_regions[buffer_id]], count);
+    } else {
+      buffer_regions[buffer_id] = region_counts.size();
+      region_counts.push_back(count);
+    }
+    live_buffers.push_back(buffer_id);
+  }
+  vector<shared_ptr<SyncedMemory> > regions(region_counts.size());
+  for (int i = 0; i < region_counts.size(); ++i) {
+    regions[i].reset(new SyncedMemory(region_counts[i] * sizeof(Dtype)));
+    memory_planned_ += region_counts[i];
+  }
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    const int buffer_id = blob_buffer_ids_[blob_id];
+    if (buffer_id >= 0 && buffer_regions[buffer_id] >= 0) {
+      blobs_[blob_id]->ShareDataMemory(regions[buffer_regions[buffer_id]]);
+    }
+  }
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Memory required for data: " << memory_used_ * sizeof(Dtype)
+      << " (" << memory_planned_ * sizeof(Dtype) << " after planning "
+      << buffers_by_first.size() << " buffers into " << regions.size()
+      << " regions)";
+}
+
+template <typename Dtype>
+void Net<Dtype>::DisableDiffs() {
+  forward_only_ = true;
+  // Loss layers keep the diffs of their blobs: the tops hold the loss
+  // weights, and some losses use the bottoms as scratch in Forward.
+  vector<bool> keep_diff(blobs_.size(), false);
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    bool has_loss = false;
+    for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
+      has_loss |= (layers_[layer_id]->loss(top_id) != 0);
+    }
+    if (!has_loss) { continue; }
+    for (int i = 0; i < bottom_id_vecs_[layer_id].size(); ++i) {
+      keep_diff[bottom_id_vecs_[layer_id][i]] = true;
+    }
+    for (int i = 0; i < top_id_vecs_[layer_id].size(); ++i) {
+      keep_diff[top_id_vecs_[layer_id][i]] = true;
+    }
+  }
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    if (!keep_diff[blob_id]) {
+      blobs_[blob_id]->DisableDiff();
+    }
+  }
+  for (int i = 0; i < params_.size(); ++i) {
+    params_[i]->DisableDiff();
+  }
 }
 
 template <typename Dtype>
@@ -835,6 +1205,7 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
       }
       const bool kReshape = false;
       target_blobs[j]->FromProto(source_layer.blobs(j), kReshape);
+      layers_[target_layer_id]->CancelDeferredFill(j);
     }
   }
 }
@@ -844,6 +1215,9 @@ void Net<Dtype>::CopyTrainedLayersFrom(const string trained_filename) {
   if (trained_filename.size() >= 3 &&
       trained_filename.compare(trained_filename.size() - 3, 3, ".h5") == 0) {
     CopyTrainedLayersFromHDF5(trained_filename);
+  } else if (trained_filename.size() >= 5 &&
+      trained_filename.compare(trained_filename.size() - 5, 5, ".flat") == 0) {
+    CopyTrainedLayersFromFlat(trained_filename);
   } else {
     CopyTrainedLayersFromBinaryProto(trained_filename);
   }
@@ -900,6 +1274,7 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
       }
       hdf5_load_nd_dataset(layer_hid, dataset_name.c_str(), 0, kMaxBlobAxes,
           target_blobs[j].get());
+      layers_[target_layer_id]->CancelDeferredFill(j);
     }
     H5Gclose(layer_hid);
   }
@@ -907,6 +1282,93 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
   H5Fclose(file_hid);
 }
 
+// A flat weight file holds, in host byte order:
+//   a header: the magic "CAFFEFLT", and the uint32 version, size of Dtype
+//     and number of blobs;
+//   an index entry per blob: the uint32 length and the characters of its
+//     layer name, the uint32 index of the param in the layer, the uint32
+//     number of axes, the int32 axes and the uint64 offset of the data;
+//   the data of the blobs, each at an offset aligned to kFlatAlignment, so
+//     that a mapping of the file can be used as is.
+static const char kFlatMagic[] = "CAFFEFLT";
+static const size_t kFlatMagicSize = 8;
+static const uint32_t kFlatVersion = 1;
+static const size_t kFlatAlignment = 64;
+
+template <typename T>
+static void WriteFlatValue(std::ostream* output, T value) {
+  output->write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+static T ReadFlatValue(const MappedFile& file, size_t* offset) {
+  CHECK_LE(*offset + sizeof(T), file.size())
+      << "Truncated flat weight file " << file.filename();
+  T value;
+  memcpy(&value, file.data() + *offset, sizeof(value));
+  *offset += sizeof(value);
+  return value;
+}
+
+template <typename Dtype>
+void Net<Dtype>::CopyTrainedLayersFromFlat(const string trained_filename) {
+  shared_ptr<MappedFile> file(new MappedFile(trained_filename));
+  CHECK(file->size() >= kFlatMagicSize &&
+      memcmp(file->data(), kFlatMagic, kFlatMagicSize) == 0)
+      << trained_filename << " is not a flat weight file";
+  size_t offset = kFlatMagicSize;
+  const uint32_t version = ReadFlatValue<uint32_t>(*file, &offset);
+  CHECK_EQ(version, kFlatVersion)
+      << "Unsupported version of flat weight file " << trained_filename;
+  const uint32_t dtype_size = ReadFlatValue<uint32_t>(*file, &offset);
+  CHECK_EQ(dtype_size, sizeof(Dtype))
+      << "Flat weight file " << trained_filename
+      << " holds weights of a different type";
+  const uint32_t num_blobs = ReadFlatValue<uint32_t>(*file, &offset);
+  for (int i = 0; i < num_blobs; ++i) {
+    const uint32_t name_size = ReadFlatValue<uint32_t>(*file, &offset);
+    CHECK_LE(offset + name_size, file->size())
+        << "Truncated flat weight file " << trained_filename;
+    const string source_layer_name(file->data() + offset, name_size);
+    offset += name_size;
+    const uint32_t param_id = ReadFlatValue<uint32_t>(*file, &offset);
+    const uint32_t num_axes = ReadFlatValue<uint32_t>(*file, &offset);
+    CHECK_LE(num_axes, kMaxBlobAxes);
+    vector<int> shape(num_axes);
+    for (int j = 0; j < num_axes; ++j) {
+      shape[j] = ReadFlatValue<int32_t>(*file, &offset);
+    }
+    const uint64_t data_offset = ReadFlatValue<uint64_t>(*file, &offset);
+    if (!layer_names_index_.count(source_layer_name)) {
+      LOG(INFO) << "Ignoring source layer " << source_layer_name;
+      continue;
+    }
+    int target_layer_id = layer_names_index_[source_layer_name];
+    DLOG(INFO) << "Mapping source layer " << source_layer_name;
+    vector<shared_ptr<Blob<Dtype> > >& target_blobs =
+        layers_[target_layer_id]->blobs();
+    CHECK_LT(param_id, target_blobs.size())
+        << "Incompatible number of blobs for layer " << source_layer_name;
+    Blob<Dtype>* target_blob = target_blobs[param_id].get();
+    if (target_blob->shape() != shape) {
+      Blob<Dtype> source_blob(shape);
+      LOG(FATAL) << "Cannot copy param " << param_id << " weights from layer '"
+          << source_layer_name << "'; shape mismatch.  Source param shape is "
+          << source_blob.shape_string() << "; target param shape is "
+          << target_blob->shape_string() << ". "
+          << "To learn this layer's parameters from scratch rather than "
+          << "copying from a saved net, rename the layer.";
+    }
+    CHECK_EQ(data_offset % kFlatAlignment, 0)
+        << "Misaligned weights in flat weight file " << trained_filename;
+    CHECK_LE(data_offset + target_blob->count() * sizeof(Dtype), file->size())
+        << "Truncated flat weight file " << trained_filename;
+    // The blob may outlive the net, so its memory keeps the mapping alive.
+    target_blob->data()->set_cpu_data(file->data() + data_offset, file);
+    layers_[target_layer_id]->CancelDeferredFill(param_id);
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
   param->Clear();
@@ -979,6 +1441,72 @@ void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
   H5Fclose(file_hid);
 }
 
+template <typename Dtype>
+void Net<Dtype>::ToFlat(const string& filename) const {
+  // Only save params that own themselves, and lay out the index first to
+  // know where the data starts.
+  vector<pair<int, int> > entries;
+  size_t offset = kFlatMagicSize + 3 * sizeof(uint32_t);
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    for (int param_id = 0; param_id < layers_[layer_id]->blobs().size();
+         ++param_id) {
+      const int net_param_id = param_id_vecs_[layer_id][param_id];
+      if (param_owners_[net_param_id] != -1) {
+        continue;
+      }
+      entries.push_back(make_pair(layer_id, param_id));
+      offset += 3 * sizeof(uint32_t) + layer_names_[layer_id].size() +
+          params_[net_param_id]->num_axes() * sizeof(int32_t) +
+          sizeof(uint64_t);
+    }
+  }
+  vector<uint64_t> data_offsets(entries.size());
+  for (int i = 0; i < entries.size(); ++i) {
+    offset = (offset + kFlatAlignment - 1) / kFlatAlignment * kFlatAlignment;
+    data_offsets[i] = offset;
+    const Blob<Dtype>& blob =
+        *layers_[entries[i].first]->blobs()[entries[i].second];
+    offset += blob.count() * sizeof(Dtype);
+  }
+  // Write to a new file which then replaces the old one, as processes may
+  // have the old one mapped.
+  const string temp_filename = filename + ".tmp";
+  std::ofstream output(temp_filename.c_str(),
+      std::ios::out | std::ios::trunc | std::ios::binary);
+  CHECK(output.good())
+      << "Couldn't open " << temp_filename << " to save weights.";
+  output.write(kFlatMagic, kFlatMagicSize);
+  WriteFlatValue<uint32_t>(&output, kFlatVersion);
+  WriteFlatValue<uint32_t>(&output, sizeof(Dtype));
+  WriteFlatValue<uint32_t>(&output, entries.size());
+  for (int i = 0; i < entries.size(); ++i) {
+    const string& layer_name = layer_names_[entries[i].first];
+    const Blob<Dtype>& blob =
+        *layers_[entries[i].first]->blobs()[entries[i].second];
+    WriteFlatValue<uint32_t>(&output, layer_name.size());
+    output.write(layer_name.data(), layer_name.size());
+    WriteFlatValue<uint32_t>(&output, entries[i].second);
+    WriteFlatValue<uint32_t>(&output, blob.num_axes());
+    for (int j = 0; j < blob.num_axes(); ++j) {
+      WriteFlatValue<int32_t>(&output, blob.shape(j));
+    }
+    WriteFlatValue<uint64_t>(&output, data_offsets[i]);
+  }
+  for (int i = 0; i < entries.size(); ++i) {
+    const Blob<Dtype>& blob =
+        *layers_[entries[i].first]->blobs()[entries[i].second];
+    const size_t padding =
+        data_offsets[i] - static_cast<uint64_t>(output.tellp());
+    output.write(string(padding, '\0').data(), padding);
+    output.write(reinterpret_cast<const char*>(blob.cpu_data()),
+        blob.count() * sizeof(Dtype));
+  }
+  output.close();
+  CHECK(!output.fail()) << "Error saving weights to " << temp_filename << ".";
+  CHECK_EQ(std::rename(temp_filename.c_str(), filename.c_str()), 0)
+      << "Couldn't replace " << filename << " to save weights.";
+}
+
 template <typename Dtype>
 void Net<Dtype>::Update() {
   for (int i = 0; i < learnable_params_.size(); ++i) {
@@ -990,10 +1518,22 @@ template <typename Dtype>
 void Net<Dtype>::ClearParamDiffs() {
   for (int i = 0; i < learnable_params_.size(); ++i) {
     Blob<Dtype>* blob = learnable_params_[i];
+    // A forward-only net has no diffs to clear.
+    if (blob->diff_disabled()) { continue; }
+    RowSet* rows = blob->diff_rows();
     switch (Caffe::mode()) {
     case Caffe::CPU:
-      caffe_set(blob->count(), static_cast<Dtype>(0),
-                blob->mutable_cpu_diff());
+      if (rows) {
+        const int row_size = blob->count(1);
+        Dtype* diff = blob->mutable_cpu_diff();
+        for (int j = 0; j < rows->size(); ++j) {
+          caffe_set(row_size, static_cast<Dtype>(0),
+                    diff + rows->row(j) * row_size);
+        }
+      } else {
+        caffe_set(blob->count(), static_cast<Dtype>(0),
+                  blob->mutable_cpu_diff());
+      }
       break;
     case Caffe::GPU:
 #ifndef CPU_ONLY
@@ -1004,6 +1544,28 @@ void Net<Dtype>::ClearParamDiffs() {
 #endif
       break;
     }
+    if (rows) { rows->clear(); }
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::TrackParamDiffRows() {
+  vector<bool> row_sparse(learnable_params_.size(), true);
+  for (int i = 0; i < params_.size(); ++i) {
+    const pair<int, int>& index = param_layer_indices_[i];
+    if (!layers_[index.first]->RowSparseParamDiff(index.second)) {
+      row_sparse[learnable_param_ids_[i]] = false;
+    }
+  }
+  for (int i = 0; i < learnable_params_.size(); ++i) {
+    if (row_sparse[i] && !learnable_params_[i]->diff_rows()) {
+      learnable_params_[i]->TrackDiffRows();
+    }
+  }
+  // Share the rows along with the diffs.
+  for (int i = 0; i < params_.size(); ++i) {
+    if (param_owners_[i] < 0) { continue; }
+    params_[i]->ShareDiff(*params_[param_owners_[i]]);
   }
 }
 
@@ -101,6 +101,9 @@ void Solver<Dtype>::InitTrainNet() {
   net_state.MergeFrom(net_param.state());
   net_state.MergeFrom(param_.train_state());
   net_param.mutable_state()->CopyFrom(net_state);
+  // The nets of the other solvers get their weights from the root solver.
+  net_param.set_defer_fill(Caffe::root_solver() &&
+      (param_.defer_fill() || net_param.defer_fill()));
   if (Caffe::root_solver()) {
     net_.reset(new Net<Dtype>(net_param));
   } else {
@@ -178,6 +181,9 @@ void Solver<Dtype>::InitTestNets() {
       net_state.MergeFrom(param_.test_state(i));
     }
     net_params[i].mutable_state()->CopyFrom(net_state);
+    if (param_.defer_fill()) {
+      net_params[i].set_defer_fill(true);
+    }
     LOG(INFO)
         << "Creating test net (#" << i << ") specified by " << sources[i];
     if (Caffe::root_solver()) {
@@ -419,6 +425,9 @@ void Solver<Dtype>::Snapshot() {
   case caffe::SolverParameter_SnapshotFormat_HDF5:
     model_filename = SnapshotToHDF5();
     break;
+  case caffe::SolverParameter_SnapshotFormat_FLAT:
+    model_filename = SnapshotToFlat();
+    break;
   default:
     LOG(FATAL) << "Unsupported snapshot format.";
   }
@@ -468,6 +477,14 @@ string Solver<Dtype>::SnapshotToHDF5() {
   return model_filename;
 }
 
+template <typename Dtype>
+string Solver<Dtype>::SnapshotToFlat() {
+  string model_filename = SnapshotFilename(".caffemodel.flat");
+  LOG(INFO) << "Snapshotting to flat file " << model_filename;
+  net_->ToFlat(model_filename);
+  return model_filename;
+}
+
 template <typename Dtype>
 void Solver<Dtype>::Restore(const char* state_file) {
   CHECK(Caffe::root_solver());
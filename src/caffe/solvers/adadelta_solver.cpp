@@ -6,6 +6,8 @@ namespace caffe {
 
 template <typename Dtype>
 void AdaDeltaSolver<Dtype>::AdaDeltaPreSolve() {
+  CHECK(!this->param_.lazy_update())
+      << "Lazy updates cannot be used with AdaDelta.";
   // Add the extra history entries for AdaDelta after those from
   // SGDSolver::PreSolve
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
@@ -75,6 +75,9 @@ void SGDSolver<Dtype>::PreSolve() {
     update_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>(shape)));
     temp_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>(shape)));
   }
+  if (this->param_.lazy_update()) {
+    this->net_->TrackParamDiffRows();
+  }
 }
 
 template <typename Dtype>
@@ -82,9 +85,22 @@ void SGDSolver<Dtype>::ClipGradients() {
   const Dtype clip_gradients = this->param_.clip_gradients();
   if (clip_gradients < 0) { return; }
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+  // On the CPU the diffs of lazily updated params are read and scaled over
+  // the rows written only.
+  const bool cpu = Caffe::mode() == Caffe::CPU;
   Dtype sumsq_diff = 0;
   for (int i = 0; i < net_params.size(); ++i) {
-    sumsq_diff += net_params[i]->sumsq_diff();
+    if (cpu) {
+      int n;
+      const int spans = UpdateSpans(i, &n);
+      const Dtype* diff = net_params[i]->cpu_diff();
+      for (int j = 0; j < spans; ++j) {
+        const Dtype* span = diff + UpdateSpanOffset(i, j);
+        sumsq_diff += caffe_cpu_dot(n, span, span);
+      }
+    } else {
+      sumsq_diff += net_params[i]->sumsq_diff();
+    }
   }
   const Dtype l2norm_diff = std::sqrt(sumsq_diff);
   if (l2norm_diff > clip_gradients) {
@@ -93,11 +109,38 @@ void SGDSolver<Dtype>::ClipGradients() {
         << l2norm_diff << " > " << clip_gradients << ") "
         << "by scale factor " << scale_factor;
     for (int i = 0; i < net_params.size(); ++i) {
-      net_params[i]->scale_diff(scale_factor);
+      if (cpu) {
+        int n;
+        const int spans = UpdateSpans(i, &n);
+        Dtype* diff = net_params[i]->mutable_cpu_diff();
+        for (int j = 0; j < spans; ++j) {
+          caffe_scal(n, scale_factor, diff + UpdateSpanOffset(i, j));
+        }
+      } else {
+        net_params[i]->scale_diff(scale_factor);
+      }
     }
   }
 }
 
+template <typename Dtype>
+int SGDSolver<Dtype>::UpdateSpans(int param_id, int* span_size) const {
+  const Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  if (!param->diff_rows()) {
+    *span_size = param->count();
+    return 1;
+  }
+  *span_size = param->count(1);
+  return param->diff_rows()->size();
+}
+
+template <typename Dtype>
+int SGDSolver<Dtype>::UpdateSpanOffset(int param_id, int span) const {
+  const Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  return param->diff_rows() ?
+      param->diff_rows()->row(span) * param->count(1) : 0;
+}
+
 template <typename Dtype>
 void SGDSolver<Dtype>::ApplyUpdate() {
   CHECK(Caffe::root_solver());
@@ -123,8 +166,13 @@ void SGDSolver<Dtype>::Normalize(int param_id) {
   const Dtype accum_normalization = Dtype(1.) / this->param_.iter_size();
   switch (Caffe::mode()) {
   case Caffe::CPU: {
-    caffe_scal(net_params[param_id]->count(), accum_normalization,
-        net_params[param_id]->mutable_cpu_diff());
+    int n;
+    const int spans = UpdateSpans(param_id, &n);
+    Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+    for (int i = 0; i < spans; ++i) {
+      caffe_scal(n, accum_normalization,
+          diff + UpdateSpanOffset(param_id, i));
+    }
     break;
   }
   case Caffe::GPU: {
@@ -152,20 +200,23 @@ void SGDSolver<Dtype>::Regularize(int param_id) {
   switch (Caffe::mode()) {
   case Caffe::CPU: {
     if (local_decay) {
+      int n;
+      const int spans = UpdateSpans(param_id, &n);
+      const Dtype* data = net_params[param_id]->cpu_data();
+      Dtype* diff = net_params[param_id]->mutable_cpu_diff();
       if (regularization_type == "L2") {
         // add weight decay
-        caffe_axpy(net_params[param_id]->count(),
-            local_decay,
-            net_params[param_id]->cpu_data(),
-            net_params[param_id]->mutable_cpu_diff());
+        for (int i = 0; i < spans; ++i) {
+          const int offset = UpdateSpanOffset(param_id, i);
+          caffe_axpy(n, local_decay, data + offset, diff + offset);
+        }
       } else if (regularization_type == "L1") {
-        caffe_cpu_sign(net_params[param_id]->count(),
-            net_params[param_id]->cpu_data(),
-            temp_[param_id]->mutable_cpu_data());
-        caffe_axpy(net_params[param_id]->count(),
-            local_decay,
-            temp_[param_id]->cpu_data(),
-            net_params[param_id]->mutable_cpu_diff());
+        Dtype* sign = temp_[param_id]->mutable_cpu_data();
+        for (int i = 0; i < spans; ++i) {
+          const int offset = UpdateSpanOffset(param_id, i);
+          caffe_cpu_sign(n, data + offset, sign + offset);
+          caffe_axpy(n, local_decay, sign + offset, diff + offset);
+        }
       } else {
         LOG(FATAL) << "Unknown regularization type: " << regularization_type;
       }
@@ -218,12 +269,16 @@ void SGDSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   // Compute the update to history, then copy it to the parameter diff.
   switch (Caffe::mode()) {
   case Caffe::CPU: {
-    caffe_cpu_axpby(net_params[param_id]->count(), local_rate,
-              net_params[param_id]->cpu_diff(), momentum,
-              history_[param_id]->mutable_cpu_data());
-    caffe_copy(net_params[param_id]->count(),
-        history_[param_id]->cpu_data(),
-        net_params[param_id]->mutable_cpu_diff());
+    int n;
+    const int spans = UpdateSpans(param_id, &n);
+    Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+    Dtype* history = history_[param_id]->mutable_cpu_data();
+    for (int i = 0; i < spans; ++i) {
+      const int offset = UpdateSpanOffset(param_id, i);
+      caffe_cpu_axpby(n, local_rate, diff + offset, momentum,
+          history + offset);
+      caffe_copy(n, history + offset, diff + offset);
+    }
     break;
   }
   case Caffe::GPU: {
@@ -246,6 +301,7 @@ template <typename Dtype>
 void SGDSolver<Dtype>::SnapshotSolverState(const string& model_filename) {
   switch (this->param_.snapshot_format()) {
     case caffe::SolverParameter_SnapshotFormat_BINARYPROTO:
+    case caffe::SolverParameter_SnapshotFormat_FLAT:
       SnapshotSolverStateToBinaryProto(model_filename);
       break;
     case caffe::SolverParameter_SnapshotFormat_HDF5:
@@ -308,9 +364,7 @@ void SGDSolver<Dtype>::RestoreSolverStateFromBinaryProto(
   ReadProtoFromBinaryFile(state_file, &state);
   this->iter_ = state.iter();
   if (state.has_learned_net()) {
-    NetParameter net_param;
-    ReadNetParamsFromBinaryFileOrDie(state.learned_net().c_str(), &net_param);
-    this->net_->CopyTrainedLayersFrom(net_param);
+    this->net_->CopyTrainedLayersFrom(state.learned_net());
   }
   this->current_step_ = state.current_step();
   CHECK_EQ(state.history_size(), history_.size())
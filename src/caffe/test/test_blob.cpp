@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -5,6 +6,8 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/half.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -51,6 +54,122 @@ TYPED_TEST(BlobSimpleTest, TestReshape) {
   EXPECT_EQ(this->blob_->count(), 120);
 }
 
+TYPED_TEST(BlobSimpleTest, TestPack) {
+  Blob<TypeParam>* blob = this->blob_preshaped_;
+  TypeParam* data = blob->mutable_cpu_data();
+  for (int i = 0; i < blob->count(); ++i) {
+    data[i] = (i - 60) / TypeParam(7);
+  }
+  blob->Pack(FP16);
+  EXPECT_EQ(FP16, blob->storage_precision());
+  EXPECT_EQ(SyncedMemory::UNINITIALIZED, blob->data()->head());
+  // Reading through a buffer leaves the data packed.
+  SyncedMemory buffer(blob->count() * sizeof(TypeParam));
+  const TypeParam* unpacked = blob->unpacked_cpu_data(&buffer);
+  EXPECT_EQ(buffer.cpu_data(), unpacked);
+  EXPECT_EQ(SyncedMemory::UNINITIALIZED, blob->data()->head());
+  for (int i = 0; i < blob->count(); ++i) {
+    EXPECT_EQ(half_to_float(float_to_half((i - 60) / TypeParam(7))),
+        unpacked[i]);
+  }
+  // Reading the blob unpacks it for good, but it stays packed.
+  const TypeParam* cpu_data = blob->cpu_data();
+  for (int i = 0; i < blob->count(); ++i) {
+    EXPECT_EQ(unpacked[i], cpu_data[i]);
+  }
+  EXPECT_EQ(FP16, blob->storage_precision());
+  EXPECT_EQ(cpu_data, blob->unpacked_cpu_data(&buffer));
+  // Writing returns it to native storage.
+  blob->mutable_cpu_data();
+  EXPECT_EQ(NATIVE, blob->storage_precision());
+  blob->Pack(BF16);
+  blob->Pack(NATIVE);
+  EXPECT_EQ(NATIVE, blob->storage_precision());
+  for (int i = 0; i < blob->count(); ++i) {
+    EXPECT_EQ(bfloat16_to_float(float_to_bfloat16(unpacked[i])),
+        blob->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(BlobSimpleTest, TestPackInt8) {
+  Blob<TypeParam>* blob = this->blob_preshaped_;
+  TypeParam* data = blob->mutable_cpu_data();
+  for (int i = 0; i < blob->count(); ++i) {
+    data[i] = (i - 60) / TypeParam(7);
+  }
+  blob->Pack(INT8);
+  EXPECT_EQ(INT8, blob->storage_precision());
+  // Each slice along the first axis has the scale of its largest value.
+  const int slice_size = blob->count(1);
+  const int8_t* packed = static_cast<const int8_t*>(blob->packed_cpu_data());
+  const float* scales = blob->packed_cpu_scales();
+  for (int n = 0; n < blob->num(); ++n) {
+    const TypeParam amax = n == 0 ? TypeParam(60) / 7
+        : TypeParam(slice_size * blob->num() - 61) / 7;
+    EXPECT_NEAR(amax / 127, scales[n], 1e-6);
+  }
+  const TypeParam* cpu_data = blob->cpu_data();
+  for (int i = 0; i < blob->count(); ++i) {
+    const int n = i / slice_size;
+    EXPECT_LE(std::abs(static_cast<int>(packed[i])), 127);
+    EXPECT_NEAR((i - 60) / TypeParam(7), cpu_data[i], scales[n] / 2 + 1e-6);
+    EXPECT_NEAR(packed[i] * scales[n], cpu_data[i], 1e-6);
+  }
+  blob->mutable_cpu_data();
+  EXPECT_EQ(NATIVE, blob->storage_precision());
+}
+
+TYPED_TEST(BlobSimpleTest, TestUnpackRange) {
+  Blob<TypeParam>* blob = this->blob_preshaped_;
+  const int slice_size = blob->count(1);
+  vector<TypeParam> range(slice_size);
+  const StoragePrecision precisions[] = { FP16, INT8 };
+  for (int p = 0; p < 2; ++p) {
+    TypeParam* data = blob->mutable_cpu_data();
+    for (int i = 0; i < blob->count(); ++i) {
+      data[i] = (i - 60) / TypeParam(7);
+    }
+    blob->Pack(precisions[p]);
+    // A range of whole slices unpacks without unpacking the blob.
+    blob->UnpackTo(slice_size, slice_size, &range[0]);
+    EXPECT_TRUE(blob->data_packed());
+    const TypeParam* cpu_data = blob->cpu_data();
+    EXPECT_FALSE(blob->data_packed());
+    for (int i = 0; i < slice_size; ++i) {
+      EXPECT_EQ(cpu_data[slice_size + i], range[i]);
+    }
+  }
+}
+
+TYPED_TEST(BlobSimpleTest, TestReorderChannelBlock) {
+  Blob<TypeParam> blob(2, 8, 3, 5);
+  TypeParam* data = blob.mutable_cpu_data();
+  for (int i = 0; i < blob.count(); ++i) {
+    data[i] = i;
+  }
+  blob.ReorderChannelBlock(4);
+  EXPECT_EQ(4, blob.channel_block());
+  // The 4 channels of a block are contiguous at every position, in the same
+  // memory.
+  const TypeParam* blocked = blob.cpu_data();
+  EXPECT_EQ(data, blocked);
+  for (int n = 0; n < 2; ++n) {
+    for (int c = 0; c < 8; ++c) {
+      for (int i = 0; i < 15; ++i) {
+        EXPECT_EQ(((n * 8 + c) * 15 + i),
+            blocked[((n * 2 + c / 4) * 15 + i) * 4 + c % 4]);
+      }
+    }
+  }
+  blob.ReorderChannelBlock(8);
+  EXPECT_EQ(8, blob.channel_block());
+  blob.ReorderChannelBlock(0);
+  EXPECT_EQ(0, blob.channel_block());
+  for (int i = 0; i < blob.count(); ++i) {
+    EXPECT_EQ(i, blob.cpu_data()[i]);
+  }
+}
+
 TYPED_TEST(BlobSimpleTest, TestLegacyBlobProtoShapeEquals) {
   BlobProto blob_proto;
 
@@ -42,6 +42,16 @@ TEST_F(CommonTest, TestRandSeedCPU) {
   }
 }
 
+TEST_F(CommonTest, TestNumThreads) {
+  const int num_threads = Caffe::num_threads();
+  EXPECT_GE(num_threads, 1);
+  Caffe::set_num_threads(3);
+  EXPECT_EQ(3, Caffe::num_threads());
+  Caffe::set_num_threads(0);
+  EXPECT_GE(Caffe::num_threads(), 1);
+  Caffe::set_num_threads(num_threads);
+}
+
 #ifndef CPU_ONLY  // GPU Caffe singleton test.
 
 TEST_F(CommonTest, TestRandSeedGPU) {
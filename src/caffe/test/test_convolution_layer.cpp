@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -6,6 +9,11 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/util/conv_autotune.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/quantize.hpp"
+#include "caffe/util/sparse.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_conv_layer.hpp"
@@ -611,6 +619,9 @@ TYPED_TEST(ConvolutionLayerTest, TestNDAgainst2D) {
   convolution_param->set_group(6);
   convolution_param->set_kernel_h(kernel_h);
   convolution_param->set_kernel_w(kernel_w);
+  // Compare the im2col implementations, rather than the direct convolution
+  // of the 3 channels per group.
+  convolution_param->set_algorithm(ConvolutionParameter_Algorithm_GEMM);
   convolution_param->mutable_weight_filler()->set_type("gaussian");
   Blob<Dtype> weights;
   Blob<Dtype> top_diff;
@@ -811,6 +822,499 @@ TYPED_TEST(ConvolutionLayerTest, TestGradientGroup) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestBatchedIm2col) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Five images are lowered two at a time, the whole batch at once, or one
+  // at a time as the column buffers are limited to a byte.
+  Blob<Dtype> bottom(5, 4, 6, 5);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&bottom);
+  this->blob_bottom_vec_[0] = &bottom;
+  const int kernel_sizes[] = {3, 3, 1};
+  const int groups[] = {1, 2, 1};
+  for (int c = 0; c < 3; ++c) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(kernel_sizes[c]);
+    convolution_param->add_pad(kernel_sizes[c] / 2);
+    convolution_param->set_group(groups[c]);
+    convolution_param->set_num_output(6);
+    convolution_param->set_algorithm(ConvolutionParameter_Algorithm_GEMM);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    ConvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    Blob<Dtype> top_diff;
+    top_diff.ReshapeLike(*this->blob_top_);
+    filler.Fill(&top_diff);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    caffe_copy(top_diff.count(), top_diff.cpu_data(),
+        this->blob_top_->mutable_cpu_diff());
+    layer.Backward(this->blob_top_vec_, vector<bool>(1, true),
+        this->blob_bottom_vec_);
+    Blob<Dtype> top, bottom_diff;
+    top.CopyFrom(*this->blob_top_, false, true);
+    bottom_diff.CopyFrom(bottom, true, true);
+    const int batch_sizes[] = {2, 0, 0};
+    for (int b = 0; b < 3; ++b) {
+      convolution_param->set_im2col_batch_size(batch_sizes[b]);
+      if (b == 2) {
+        convolution_param->set_col_buffer_limit(1);
+      }
+      ConvolutionLayer<Dtype> batched_layer(layer_param);
+      batched_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int i = 0; i < layer.blobs().size(); ++i) {
+        batched_layer.blobs()[i]->CopyFrom(*layer.blobs()[i]);
+      }
+      batched_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int i = 0; i < top.count(); ++i) {
+        EXPECT_NEAR(top.cpu_data()[i], this->blob_top_->cpu_data()[i], 1e-4);
+      }
+      caffe_copy(top_diff.count(), top_diff.cpu_data(),
+          this->blob_top_->mutable_cpu_diff());
+      batched_layer.Backward(this->blob_top_vec_, vector<bool>(1, true),
+          this->blob_bottom_vec_);
+      for (int i = 0; i < bottom.count(); ++i) {
+        EXPECT_NEAR(bottom_diff.cpu_diff()[i], bottom.cpu_diff()[i], 1e-4);
+      }
+      for (int j = 0; j < layer.blobs().size(); ++j) {
+        const Blob<Dtype>& param = *layer.blobs()[j];
+        const Blob<Dtype>& batched_param = *batched_layer.blobs()[j];
+        for (int i = 0; i < param.count(); ++i) {
+          EXPECT_NEAR(param.cpu_diff()[i], batched_param.cpu_diff()[i], 1e-4);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestGradientBatchedIm2col) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  this->blob_bottom_vec_.push_back(this->blob_bottom_2_);
+  this->blob_top_vec_.push_back(this->blob_top_2_);
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(3);
+  convolution_param->set_group(3);
+  convolution_param->set_im2col_batch_size(0);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestWinogradConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  const ConvolutionParameter_Algorithm algorithms[] = {
+    ConvolutionParameter_Algorithm_WINOGRAD_2X2,
+    ConvolutionParameter_Algorithm_WINOGRAD_4X4
+  };
+  for (int a = 0; a < 2; ++a) {
+    for (int pad = 0; pad < 3; ++pad) {
+      // Also with groups, and with partial output tiles.
+      LayerParameter layer_param;
+      ConvolutionParameter* convolution_param =
+          layer_param.mutable_convolution_param();
+      convolution_param->add_kernel_size(3);
+      convolution_param->add_pad(pad);
+      convolution_param->set_num_output(3);
+      convolution_param->set_group(pad == 1 ? 3 : 1);
+      convolution_param->set_algorithm(algorithms[a]);
+      convolution_param->mutable_weight_filler()->set_type("gaussian");
+      convolution_param->mutable_bias_filler()->set_type("gaussian");
+      ConvolutionLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      caffe_conv(this->blob_bottom_, convolution_param, layer.blobs(),
+          this->MakeReferenceTop(this->blob_top_));
+      const Dtype* top_data = this->blob_top_->cpu_data();
+      const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+      for (int i = 0; i < this->blob_top_->count(); ++i) {
+        EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+      }
+    }
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestGradientWinograd) {
+  typedef typename TypeParam::Dtype Dtype;
+  const ConvolutionParameter_Algorithm algorithms[] = {
+    ConvolutionParameter_Algorithm_WINOGRAD_2X2,
+    ConvolutionParameter_Algorithm_WINOGRAD_4X4
+  };
+  this->blob_bottom_vec_.push_back(this->blob_bottom_2_);
+  this->blob_top_vec_.push_back(this->blob_top_2_);
+  for (int a = 0; a < 2; ++a) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(3);
+    convolution_param->add_pad(1);
+    convolution_param->set_num_output(3);
+    convolution_param->set_group(3);
+    convolution_param->set_algorithm(algorithms[a]);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    ConvolutionLayer<Dtype> layer(layer_param);
+    // The layer is linear, so a larger step estimates the gradient as well,
+    // while keeping the rounding of F(4x4, 3x3) in float from dominating.
+    GradientChecker<Dtype> checker(1e-1, 1e-3);
+    checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+        this->blob_top_vec_);
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestDirectConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Depthwise convolution with a channel multiplier of 2, and groups of two
+  // channels, with and without stride, padding and dilation.
+  Blob<Dtype> bottom(2, 4, 7, 5);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&bottom);
+  this->blob_bottom_vec_[0] = &bottom;
+  const int groups[] = {4, 4, 2};
+  const int strides[] = {1, 2, 1};
+  const int dilations[] = {1, 1, 2};
+  for (int c = 0; c < 3; ++c) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(3);
+    convolution_param->add_stride(strides[c]);
+    convolution_param->add_pad(c);
+    convolution_param->add_dilation(dilations[c]);
+    convolution_param->set_group(groups[c]);
+    convolution_param->set_num_output(8);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    ConvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    caffe_conv(&bottom, convolution_param, layer.blobs(),
+        this->MakeReferenceTop(this->blob_top_));
+    const Dtype* top_data = this->blob_top_->cpu_data();
+    const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestGradientDirect) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  this->blob_bottom_vec_.push_back(this->blob_bottom_2_);
+  this->blob_top_vec_.push_back(this->blob_top_2_);
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(3);
+  convolution_param->set_algorithm(ConvolutionParameter_Algorithm_DIRECT);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestFFTConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  Blob<Dtype> bottom(2, 4, 9, 7);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&bottom);
+  this->blob_bottom_vec_[0] = &bottom;
+  // With and without stride, padding, dilation and groups.
+  const int kernels[] = {5, 3, 7};
+  const int strides[] = {1, 2, 1};
+  const int dilations[] = {1, 1, 2};
+  const int groups[] = {1, 2, 1};
+  for (int c = 0; c < 3; ++c) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(kernels[c]);
+    convolution_param->add_stride(strides[c]);
+    convolution_param->add_pad(c + 1);
+    convolution_param->add_dilation(dilations[c]);
+    convolution_param->set_group(groups[c]);
+    convolution_param->set_num_output(6);
+    convolution_param->set_algorithm(ConvolutionParameter_Algorithm_FFT);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    ConvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    // The cached spectra of the weights are transformed again once the
+    // weights change.
+    for (int run = 0; run < 2; ++run) {
+      if (run == 1) {
+        caffe_scal(layer.blobs()[0]->count(), Dtype(-2),
+            layer.blobs()[0]->mutable_cpu_data());
+      }
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      caffe_conv(&bottom, convolution_param, layer.blobs(),
+          this->MakeReferenceTop(this->blob_top_));
+      const Dtype* top_data = this->blob_top_->cpu_data();
+      const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+      for (int i = 0; i < this->blob_top_->count(); ++i) {
+        EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+      }
+    }
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestGradientFFT) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int strides[] = {1, 2};
+  const int dilations[] = {1, 2};
+  for (int c = 0; c < 2; ++c) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(3);
+    convolution_param->add_stride(strides[c]);
+    convolution_param->add_pad(1);
+    convolution_param->add_dilation(dilations[c]);
+    convolution_param->set_num_output(2);
+    convolution_param->set_algorithm(ConvolutionParameter_Algorithm_FFT);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    ConvolutionLayer<Dtype> layer(layer_param);
+    GradientChecker<Dtype> checker(1e-2, 1e-3);
+    checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+        this->blob_top_vec_);
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestSparseConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  // One image at a time and the whole batch, with and without groups.
+  const int batch_sizes[] = {1, 0};
+  const int groups[] = {1, 3};
+  for (int c = 0; c < 2; ++c) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(3);
+    convolution_param->add_stride(2);
+    convolution_param->add_pad(1);
+    convolution_param->set_group(groups[c]);
+    convolution_param->set_num_output(6);
+    convolution_param->set_im2col_batch_size(batch_sizes[c]);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    ConvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    Blob<Dtype>* weights = layer.blobs()[0].get();
+    // Pruned to 90% zeros, and then dense again: the weights are compressed
+    // again once they change.
+    for (int run = 0; run < 2; ++run) {
+      Dtype* weight_data = weights->mutable_cpu_data();
+      for (int i = 0; i < weights->count(); ++i) {
+        if (run == 0 && i % 10) {
+          weight_data[i] = 0;
+        } else if (run == 1 && weight_data[i] == 0) {
+          weight_data[i] = Dtype(i % 7) / 7 - Dtype(0.5);
+        }
+      }
+      EXPECT_EQ(run == 0, caffe_cpu_sparsity(weights->count(),
+          weights->cpu_data()) >= 0.8);
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      caffe_conv(this->blob_bottom_, convolution_param, layer.blobs(),
+          this->MakeReferenceTop(this->blob_top_));
+      const Dtype* top_data = this->blob_top_->cpu_data();
+      const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+      for (int i = 0; i < this->blob_top_->count(); ++i) {
+        EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+      }
+    }
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestNCHWcConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  Blob<Dtype> bottom(2, 16, 7, 6);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&bottom);
+  Blob<Dtype> blocked_bottom;
+  blocked_bottom.CopyFrom(bottom, false, true);
+  blocked_bottom.ReorderChannelBlock(16);
+  this->blob_bottom_vec_[0] = &blocked_bottom;
+  // With and without stride, padding, dilation and bias.
+  const int strides[] = {1, 2, 1};
+  const int dilations[] = {1, 1, 2};
+  for (int c = 0; c < 3; ++c) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(3);
+    convolution_param->add_stride(strides[c]);
+    convolution_param->add_pad(c);
+    convolution_param->add_dilation(dilations[c]);
+    convolution_param->set_num_output(32);
+    convolution_param->set_bias_term(c != 2);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    ConvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    EXPECT_TRUE(layer.SupportsChannelBlock(this->blob_bottom_vec_, 16));
+    EXPECT_FALSE(layer.SupportsChannelBlock(this->blob_bottom_vec_, 8));
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    // The top is blocked like the bottom, as the net marks it.
+    this->blob_top_->set_channel_block(16);
+    this->blob_top_->ReorderChannelBlock(0);
+    caffe_conv(&bottom, convolution_param, layer.blobs(),
+        this->MakeReferenceTop(this->blob_top_));
+    const Dtype* top_data = this->blob_top_->cpu_data();
+    const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestAutotuneConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  string cache_filename;
+  MakeTempFilename(&cache_filename);
+  ConvAutotuneCache::set_path(cache_filename);
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(3);
+  convolution_param->set_group(3);
+  convolution_param->set_algorithm(ConvolutionParameter_Algorithm_AUTOTUNE);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  // The second layer reads the choice of the first back from the file.
+  for (int run = 0; run < 2; ++run) {
+    ConvAutotuneCache::Clear();
+    ConvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    caffe_conv(this->blob_bottom_, convolution_param, layer.blobs(),
+        this->MakeReferenceTop(this->blob_top_));
+    const Dtype* top_data = this->blob_top_->cpu_data();
+    const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+    }
+  }
+  ConvAutotuneCache::set_path("");
+  if (Caffe::mode() == Caffe::CPU) {
+    std::ifstream cache_file(cache_filename.c_str());
+    vector<string> lines;
+    string line;
+    while (std::getline(cache_file, line)) {
+      lines.push_back(line);
+    }
+    ASSERT_EQ(1, lines.size());
+    ConvolutionParameter_Algorithm algorithm;
+    EXPECT_TRUE(ConvolutionParameter_Algorithm_Parse(
+        lines[0].substr(lines[0].rfind(' ') + 1), &algorithm));
+    EXPECT_NE(string::npos, lines[0].find(ConvAutotuneCache::MachineKey()));
+    // A choice made with another number of threads is not reused.
+    const int threads = Caffe::num_threads();
+    Caffe::set_num_threads(threads + 1);
+    EXPECT_EQ(string::npos, lines[0].find(ConvAutotuneCache::MachineKey()));
+    Caffe::set_num_threads(threads);
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestGradientAutotune) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  this->blob_bottom_vec_.push_back(this->blob_bottom_2_);
+  this->blob_top_vec_.push_back(this->blob_top_2_);
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(3);
+  convolution_param->set_group(3);
+  convolution_param->set_algorithm(ConvolutionParameter_Algorithm_AUTOTUNE);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestInt8Convolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_2_);
+  this->blob_top_vec_.push_back(this->blob_top_2_);
+  LayerParameter layer_param;
+  layer_param.set_type("Convolution");
+  layer_param.set_phase(TEST);
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> top, top_2;
+  top.CopyFrom(*this->blob_top_, false, true);
+  top_2.CopyFrom(*this->blob_top_2_, false, true);
+  const Dtype weight_max =
+      caffe_cpu_amax(layer.blobs()[0]->count(), layer.blobs()[0]->cpu_data());
+  // Quantizing the bottom and the weights to int8 perturbs each of the
+  // 27 products by at most |bottom| |weight| / 127.
+  for (int bottom_range = 0; bottom_range < 2; ++bottom_range) {
+    Dtype bottom_max = std::max(
+        caffe_cpu_amax(this->blob_bottom_->count(),
+            this->blob_bottom_->cpu_data()),
+        caffe_cpu_amax(this->blob_bottom_2_->count(),
+            this->blob_bottom_2_->cpu_data()));
+    if (bottom_range) {
+      // A calibrated range beyond the bottom values, for both bottoms.
+      bottom_max *= 2;
+      layer_param.mutable_quantization_param()->set_bottom_range(bottom_max);
+    }
+    convolution_param->set_engine(ConvolutionParameter_Engine_INT8);
+    shared_ptr<Layer<Dtype> > int8_layer =
+        LayerRegistry<Dtype>::CreateLayer(layer_param);
+    int8_layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < layer.blobs().size(); ++i) {
+      int8_layer->blobs()[i]->CopyFrom(*layer.blobs()[i]);
+    }
+    int8_layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    // The weights are quantized into a copy, and saved as they are.
+    EXPECT_EQ(NATIVE, int8_layer->blobs()[0]->storage_precision());
+    for (int i = 0; i < layer.blobs()[0]->count(); ++i) {
+      EXPECT_EQ(layer.blobs()[0]->cpu_data()[i],
+          int8_layer->blobs()[0]->cpu_data()[i]);
+    }
+    const Dtype tolerance = 27 * bottom_max * weight_max / 127 * 1.01;
+    for (int i = 0; i < top.count(); ++i) {
+      EXPECT_NEAR(top.cpu_data()[i], this->blob_top_->cpu_data()[i],
+          tolerance);
+      EXPECT_NEAR(top_2.cpu_data()[i], this->blob_top_2_->cpu_data()[i],
+          tolerance);
+    }
+  }
+}
+
 #ifdef USE_CUDNN
 
 template <typename Dtype>
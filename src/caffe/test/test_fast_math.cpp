@@ -0,0 +1,111 @@
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/fast_math.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class FastMathTest : public ::testing::Test {
+ protected:
+  typedef void (*FastFunction)(const int n, const Dtype* x, Dtype* y);
+  typedef double (*ExactFunction)(const double x);
+
+  // Checks fast against exact over the whole float range, at every
+  // kStride-th float, with the infinities, the NaN and both zeros.
+  void CheckRange(FastFunction fast, ExactFunction exact) {
+    const uint64_t kStride = 257;
+    const int kChunk = 1 << 16;
+    const float inf = std::numeric_limits<float>::infinity();
+    const float special[] = {0.f, -0.f, inf, -inf,
+        std::numeric_limits<float>::quiet_NaN()};
+    vector<Dtype> x(special, special + 5);
+    worst_error_ = 0;
+    worst_x_ = 0;
+    for (uint64_t bits = 0; bits < (uint64_t(1) << 32); bits += kStride) {
+      const uint32_t pattern = static_cast<uint32_t>(bits);
+      float value;
+      std::memcpy(&value, &pattern, sizeof(value));
+      x.push_back(value);
+      if (x.size() == kChunk) {
+        CheckValues(fast, exact, x);
+        x.clear();
+      }
+    }
+    CheckValues(fast, exact, x);
+    EXPECT_LE(worst_error_, kFastMathRelativeError) << "at x = " << worst_x_;
+  }
+
+  // The relative error of y to the exact value rounded to Dtype, within
+  // that of FLT_MIN for the smaller ones; the infinities and the NaN have
+  // to be the same.
+  void CheckValues(FastFunction fast, ExactFunction exact,
+      const vector<Dtype>& x) {
+    if (x.empty()) {
+      return;
+    }
+    vector<Dtype> y(x.size());
+    fast(x.size(), &x[0], &y[0]);
+    for (int i = 0; i < x.size(); ++i) {
+      const Dtype expected = static_cast<Dtype>(exact(x[i]));
+      double error;
+      if (std::isnan(expected) || std::isinf(expected)) {
+        error = (std::isnan(expected) ? std::isnan(y[i]) : y[i] == expected) ?
+            0 : std::numeric_limits<double>::infinity();
+      } else {
+        error = std::fabs(static_cast<double>(y[i]) - expected) /
+            std::max<double>(std::fabs(expected),
+            std::numeric_limits<float>::min());
+        if (std::isnan(error)) {
+          error = std::numeric_limits<double>::infinity();
+        }
+      }
+      if (error > worst_error_) {
+        worst_error_ = error;
+        worst_x_ = x[i];
+      }
+    }
+  }
+
+  double worst_error_;
+  Dtype worst_x_;
+};
+
+TYPED_TEST_CASE(FastMathTest, TestDtypes);
+
+static double ExactExp(const double x) { return std::exp(x); }
+static double ExactSigmoid(const double x) { return 1. / (1. + std::exp(-x)); }
+static double ExactTanh(const double x) { return std::tanh(x); }
+static double ExactElu(const double x) { return x > 0 ? x : 0.5 * expm1(x); }
+
+template <typename Dtype>
+static void FastElu(const int n, const Dtype* x, Dtype* y) {
+  caffe_cpu_fast_elu(n, Dtype(0.5), x, y);
+}
+
+TYPED_TEST(FastMathTest, TestExp) {
+  this->CheckRange(caffe_cpu_fast_exp<TypeParam>, ExactExp);
+}
+
+TYPED_TEST(FastMathTest, TestSigmoid) {
+  this->CheckRange(caffe_cpu_fast_sigmoid<TypeParam>, ExactSigmoid);
+}
+
+TYPED_TEST(FastMathTest, TestTanh) {
+  this->CheckRange(caffe_cpu_fast_tanh<TypeParam>, ExactTanh);
+}
+
+TYPED_TEST(FastMathTest, TestElu) {
+  this->CheckRange(FastElu<TypeParam>, ExactElu);
+}
+
+}  // namespace caffe
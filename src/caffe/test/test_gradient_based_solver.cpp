@@ -1264,4 +1264,141 @@ TYPED_TEST(RMSPropSolverTest, TestSnapshotShare) {
   }
 }
 
+// The lazy updates of the rows of the embeddings of EmbedLayer.
+template <typename Dtype>
+class LazyUpdateSolverTest : public CPUDeviceTest<Dtype> {
+ protected:
+  // Trains an EmbedLayer of 10 rows, whose loss is the sum of the squares of
+  // its outputs, on the indices of indices_, one iteration per line, and
+  // returns its initial and final weights.
+  void Train(const string& type, const bool lazy_update,
+      const Dtype weight_decay, const Dtype momentum, Blob<Dtype>* initial,
+      Blob<Dtype>* final, const Dtype clip_gradients = -1) {
+    const string proto =
+        "net_param { "
+        "  name: 'EmbedNet' "
+        "  input: 'index' "
+        "  input_shape { dim: 4 } "
+        "  layer { "
+        "    name: 'embed' "
+        "    type: 'Embed' "
+        "    bottom: 'index' "
+        "    top: 'embed' "
+        "    embed_param { "
+        "      input_dim: 10 "
+        "      num_output: 3 "
+        "      bias_term: false "
+        "      weight_filler { type: 'gaussian' } "
+        "    } "
+        "  } "
+        "  layer { "
+        "    name: 'loss' "
+        "    type: 'Reduction' "
+        "    bottom: 'embed' "
+        "    top: 'loss' "
+        "    reduction_param { operation: SUMSQ } "
+        "    loss_weight: 1 "
+        "  } "
+        "} "
+        "base_lr: 0.1 "
+        "lr_policy: 'fixed' "
+        "iter_size: 2 "
+        "random_seed: 1701 "
+        "solver_mode: CPU ";
+    SolverParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    param.set_type(type);
+    param.set_lazy_update(lazy_update);
+    param.set_weight_decay(weight_decay);
+    param.set_momentum(momentum);
+    param.set_clip_gradients(clip_gradients);
+    shared_ptr<Solver<Dtype> > solver(
+        SolverRegistry<Dtype>::CreateSolver(param));
+    Blob<Dtype>* weights =
+        solver->net()->layer_by_name("embed")->blobs()[0].get();
+    EXPECT_EQ(lazy_update, weights->diff_rows() != NULL);
+    initial->CopyFrom(*weights, false, true);
+    Blob<Dtype>* index = solver->net()->input_blobs()[0];
+    for (int i = 0; i < indices_.size(); ++i) {
+      for (int j = 0; j < index->count(); ++j) {
+        index->mutable_cpu_data()[j] = indices_[i][j];
+      }
+      solver->Step(1);
+    }
+    final->CopyFrom(*weights, false, true);
+  }
+
+  // Checks that the lazy update of the rows embedded matches the dense one,
+  // and that it leaves the other rows alone.
+  void CheckLazyUpdate(const string& type, const Dtype weight_decay,
+      const Dtype momentum, const Dtype clip_gradients = -1) {
+    Blob<Dtype> initial, dense, lazy;
+    Train(type, false, weight_decay, momentum, &initial, &dense,
+        clip_gradients);
+    Train(type, true, weight_decay, momentum, &initial, &lazy,
+        clip_gradients);
+    vector<bool> embedded(initial.num(), false);
+    for (int i = 0; i < indices_.size(); ++i) {
+      for (int j = 0; j < indices_[i].size(); ++j) {
+        embedded[indices_[i][j]] = true;
+      }
+    }
+    const int dim = initial.count(1);
+    for (int i = 0; i < initial.count(); ++i) {
+      if (embedded[i / dim]) {
+        EXPECT_NEAR(dense.cpu_data()[i], lazy.cpu_data()[i], 1e-5);
+      } else {
+        EXPECT_EQ(initial.cpu_data()[i], lazy.cpu_data()[i]);
+      }
+    }
+  }
+
+  vector<vector<int> > indices_;
+};
+
+TYPED_TEST_CASE(LazyUpdateSolverTest, TestDtypes);
+
+TYPED_TEST(LazyUpdateSolverTest, TestSGDMomentumWeightDecay) {
+  const int indices[] = {1, 4, 4, 7};
+  for (int i = 0; i < 3; ++i) {
+    this->indices_.push_back(vector<int>(indices, indices + 4));
+  }
+  this->CheckLazyUpdate("SGD", 0.1, 0.9);
+}
+
+// Without weight decay the rows not embedded have no gradient, so the
+// lazy update clips the gradient by the same norm as the dense one.
+TYPED_TEST(LazyUpdateSolverTest, TestSGDMomentumClipGradients) {
+  const int indices[] = {1, 4, 4, 7};
+  for (int i = 0; i < 3; ++i) {
+    this->indices_.push_back(vector<int>(indices, indices + 4));
+  }
+  this->CheckLazyUpdate("SGD", 0, 0.9, 0.01);
+}
+
+TYPED_TEST(LazyUpdateSolverTest, TestAdamWeightDecay) {
+  const int indices[] = {1, 4, 4, 7};
+  for (int i = 0; i < 3; ++i) {
+    this->indices_.push_back(vector<int>(indices, indices + 4));
+  }
+  this->CheckLazyUpdate("Adam", 0.1, 0.9);
+}
+
+// Without weight decay, the lazy AdaGrad is the dense one, whichever rows
+// each iteration embeds.
+TYPED_TEST(LazyUpdateSolverTest, TestAdaGrad) {
+  typedef TypeParam Dtype;
+  const int indices[] = {1, 4, 4, 7, 0, 2, 4, 9, 7, 7, 3, 1};
+  for (int i = 0; i < 3; ++i) {
+    this->indices_.push_back(vector<int>(indices + 4 * i,
+        indices + 4 * (i + 1)));
+  }
+  Blob<Dtype> initial, dense, lazy;
+  this->Train("AdaGrad", false, 0, 0, &initial, &dense);
+  this->Train("AdaGrad", true, 0, 0, &initial, &lazy);
+  for (int i = 0; i < initial.count(); ++i) {
+    EXPECT_NEAR(dense.cpu_data()[i], lazy.cpu_data()[i], 1e-5);
+  }
+}
+
 }  // namespace caffe
@@ -0,0 +1,101 @@
+#include <stdint.h>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/half.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class HalfTest : public ::testing::Test {};
+
+TEST_F(HalfTest, TestFloatToHalf) {
+  EXPECT_EQ(0x0000, float_to_half(0.f));
+  EXPECT_EQ(0x8000, float_to_half(-0.f));
+  EXPECT_EQ(0x3c00, float_to_half(1.f));
+  EXPECT_EQ(0xc000, float_to_half(-2.f));
+  EXPECT_EQ(0x3555, float_to_half(1.f / 3));
+  // The largest half, and what rounds to it or beyond.
+  EXPECT_EQ(0x7bff, float_to_half(65504.f));
+  EXPECT_EQ(0x7bff, float_to_half(65519.f));
+  EXPECT_EQ(0x7c00, float_to_half(65520.f));
+  EXPECT_EQ(0xfc00, float_to_half(-1e10f));
+  // The smallest normal and subnormal halves.
+  EXPECT_EQ(0x0400, float_to_half(std::ldexp(1.f, -14)));
+  EXPECT_EQ(0x0001, float_to_half(std::ldexp(1.f, -24)));
+  EXPECT_EQ(0x0000, float_to_half(std::ldexp(1.f, -26)));
+  // Ties round to even.
+  EXPECT_EQ(0x3c00, float_to_half(1.f + std::ldexp(1.f, -11)));
+  EXPECT_EQ(0x3c02, float_to_half(1.f + 3 * std::ldexp(1.f, -11)));
+  EXPECT_EQ(0x0000, float_to_half(std::ldexp(1.f, -25)));
+  EXPECT_EQ(0x0002, float_to_half(3 * std::ldexp(1.f, -25)));
+  EXPECT_EQ(0x7c00, float_to_half(std::numeric_limits<float>::infinity()));
+  const uint16_t nan = float_to_half(std::numeric_limits<float>::quiet_NaN());
+  EXPECT_EQ(0x7c00, nan & 0x7c00);
+  EXPECT_NE(0, nan & 0x3ff);
+}
+
+TEST_F(HalfTest, TestHalfRoundTrip) {
+  for (uint32_t value = 0; value <= 0xffff; ++value) {
+    // Skip the NaNs.
+    if ((value & 0x7c00) == 0x7c00 && (value & 0x3ff)) { continue; }
+    EXPECT_EQ(value, float_to_half(half_to_float(value)));
+  }
+  EXPECT_EQ(1.f, half_to_float(0x3c00));
+  EXPECT_EQ(std::ldexp(1.f, -24), half_to_float(0x0001));
+  EXPECT_EQ(-65504.f, half_to_float(0xfbff));
+}
+
+TEST_F(HalfTest, TestBFloat16) {
+  EXPECT_EQ(0x3f80, float_to_bfloat16(1.f));
+  EXPECT_EQ(0xc000, float_to_bfloat16(-2.f));
+  EXPECT_EQ(0x3eab, float_to_bfloat16(1.f / 3));
+  // Ties round to even.
+  EXPECT_EQ(0x3f80, float_to_bfloat16(1.f + std::ldexp(1.f, -8)));
+  EXPECT_EQ(0x3f82, float_to_bfloat16(1.f + 3 * std::ldexp(1.f, -8)));
+  EXPECT_EQ(0x7f80,
+      float_to_bfloat16(std::numeric_limits<float>::infinity()));
+  EXPECT_EQ(0x7f80, float_to_bfloat16(std::numeric_limits<float>::max()));
+  const uint16_t nan =
+      float_to_bfloat16(std::numeric_limits<float>::quiet_NaN());
+  EXPECT_EQ(0x7f80, nan & 0x7f80);
+  EXPECT_NE(0, nan & 0x7f);
+  for (uint32_t value = 0; value <= 0xffff; ++value) {
+    if ((value & 0x7f80) == 0x7f80 && (value & 0x7f)) { continue; }
+    EXPECT_EQ(value, float_to_bfloat16(bfloat16_to_float(value)));
+  }
+}
+
+template <typename Dtype>
+class PackTest : public ::testing::Test {};
+
+TYPED_TEST_CASE(PackTest, TestDtypes);
+
+TYPED_TEST(PackTest, TestPackUnpack) {
+  const int n = 100;
+  vector<TypeParam> x(n);
+  for (int i = 0; i < n; ++i) {
+    x[i] = (i - 50) / TypeParam(7);
+  }
+  vector<uint16_t> packed(n);
+  vector<TypeParam> y(n);
+  caffe_cpu_pack(n, &x[0], FP16, &packed[0]);
+  caffe_cpu_unpack(n, &packed[0], FP16, &y[0]);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(float_to_half(x[i]), packed[i]);
+    EXPECT_NEAR(x[i], y[i], std::fabs(x[i]) * std::ldexp(1., -11));
+  }
+  caffe_cpu_pack(n, &x[0], BF16, &packed[0]);
+  caffe_cpu_unpack(n, &packed[0], BF16, &y[0]);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(float_to_bfloat16(x[i]), packed[i]);
+    EXPECT_NEAR(x[i], y[i], std::fabs(x[i]) * std::ldexp(1., -8));
+  }
+}
+
+}  // namespace caffe
@@ -1,7 +1,9 @@
+#include <fstream>  // NOLINT(readability/streams)
 #include <string>
 #include <vector>
 
 #include "hdf5.h"
+#include "hdf5_hl.h"
 
 #include "gtest/gtest.h"
 
@@ -9,6 +11,7 @@
 #include "caffe/common.hpp"
 #include "caffe/layers/hdf5_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/io.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -133,4 +136,73 @@ TYPED_TEST(HDF5DataLayerTest, TestRead) {
   }
 }
 
+TYPED_TEST(HDF5DataLayerTest, TestReadSparse) {
+  typedef typename TypeParam::Dtype Dtype;
+  // A file of 3 rows of a sparse matrix of 6 columns, the second of them
+  // empty, in the groups and datasets of scipy.sparse.csr_matrix, and of
+  // labels.
+  string hdf5_filename, source_filename;
+  MakeTempFilename(&hdf5_filename);
+  MakeTempFilename(&source_filename);
+  const float values[] = {2, -1, 3, 0.5, 1.5};
+  const int columns[] = {1, 4, 0, 5, 2};
+  const int offsets[] = {0, 2, 2, 5};
+  const float labels[] = {0, 1, 2};
+  hid_t file_id = H5Fcreate(hdf5_filename.c_str(), H5F_ACC_TRUNC,
+      H5P_DEFAULT, H5P_DEFAULT);
+  ASSERT_GE(file_id, 0);
+  hid_t group_id = H5Gcreate2(file_id, "features", H5P_DEFAULT, H5P_DEFAULT,
+      H5P_DEFAULT);
+  ASSERT_GE(group_id, 0);
+  hsize_t dims[1] = {5};
+  ASSERT_GE(H5LTmake_dataset_float(group_id, "data", 1, dims, values), 0);
+  ASSERT_GE(H5LTmake_dataset_int(group_id, "indices", 1, dims, columns), 0);
+  dims[0] = 4;
+  ASSERT_GE(H5LTmake_dataset_int(group_id, "indptr", 1, dims, offsets), 0);
+  H5Gclose(group_id);
+  dims[0] = 3;
+  ASSERT_GE(H5LTmake_dataset_float(file_id, "label", 1, dims, labels), 0);
+  H5Fclose(file_id);
+  std::ofstream source(source_filename.c_str());
+  source << hdf5_filename << std::endl;
+  source.close();
+
+  LayerParameter param;
+  param.add_top("features/data");
+  param.add_top("features/indices");
+  param.add_top("features/indptr");
+  param.add_top("label");
+  param.mutable_hdf5_data_param()->set_batch_size(2);
+  param.mutable_hdf5_data_param()->set_source(source_filename);
+  Blob<Dtype> blob_values, blob_columns, blob_offsets;
+  vector<Blob<Dtype>*> top_vec;
+  top_vec.push_back(&blob_values);
+  top_vec.push_back(&blob_columns);
+  top_vec.push_back(&blob_offsets);
+  top_vec.push_back(this->blob_top_label_);
+  HDF5DataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, top_vec);
+  EXPECT_EQ(3, blob_offsets.count());
+
+  // The batches are rows 0 and 1, then 2 and 0 again.
+  const int batch_rows[] = {0, 1, 2, 0};
+  for (int batch = 0; batch < 2; ++batch) {
+    layer.Forward(this->blob_bottom_vec_, top_vec);
+    ASSERT_EQ(3, blob_offsets.count());
+    EXPECT_EQ(0, blob_offsets.cpu_data()[0]);
+    int nonzeros = 0;
+    for (int i = 0; i < 2; ++i) {
+      const int row = batch_rows[batch * 2 + i];
+      EXPECT_EQ(row, this->blob_top_label_->cpu_data()[i]);
+      for (int j = offsets[row]; j < offsets[row + 1]; ++j, ++nonzeros) {
+        EXPECT_EQ(values[j], blob_values.cpu_data()[nonzeros]);
+        EXPECT_EQ(columns[j], blob_columns.cpu_data()[nonzeros]);
+      }
+      EXPECT_EQ(nonzeros, blob_offsets.cpu_data()[i + 1]);
+    }
+    EXPECT_EQ(nonzeros, blob_values.count());
+    EXPECT_EQ(nonzeros, blob_columns.count());
+  }
+}
+
 }  // namespace caffe
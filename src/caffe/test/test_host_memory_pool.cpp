@@ -0,0 +1,200 @@
+#include <stdint.h>
+#include <boost/thread.hpp>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/host_memory_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class HostMemoryPoolTest : public ::testing::Test {
+ protected:
+  HostMemoryPoolTest()
+      : enabled_(HostMemoryPool::enabled()),
+        per_thread_(HostMemoryPool::per_thread()),
+        max_cached_bytes_(HostMemoryPool::max_cached_bytes()),
+        host_alignment_(Caffe::host_alignment()),
+        host_huge_pages_(Caffe::host_huge_pages()) {
+    HostMemoryPool::set_enabled(true);
+    HostMemoryPool::set_per_thread(false);
+    HostMemoryPool::Trim();
+  }
+  virtual ~HostMemoryPoolTest() {
+    HostMemoryPool::Trim();
+    HostMemoryPool::set_enabled(enabled_);
+    HostMemoryPool::set_per_thread(per_thread_);
+    HostMemoryPool::set_max_cached_bytes(max_cached_bytes_);
+    Caffe::set_host_alignment(host_alignment_);
+    Caffe::set_host_huge_pages(host_huge_pages_);
+  }
+
+  static bool IsAligned(const void* ptr, size_t alignment) {
+    return reinterpret_cast<uintptr_t>(ptr) % alignment == 0;
+  }
+
+  bool enabled_;
+  bool per_thread_;
+  size_t max_cached_bytes_;
+  size_t host_alignment_;
+  bool host_huge_pages_;
+};
+
+TEST_F(HostMemoryPoolTest, TestSizeClass) {
+  EXPECT_EQ(64, HostMemoryPool::SizeClass(1));
+  EXPECT_EQ(64, HostMemoryPool::SizeClass(64));
+  EXPECT_EQ(80, HostMemoryPool::SizeClass(65));
+  EXPECT_EQ(112, HostMemoryPool::SizeClass(100));
+  EXPECT_EQ(128, HostMemoryPool::SizeClass(128));
+  EXPECT_EQ(160, HostMemoryPool::SizeClass(129));
+  for (size_t size = 1; size < 100000; size = size * 3 + 1) {
+    const size_t size_class = HostMemoryPool::SizeClass(size);
+    EXPECT_GE(size_class, size);
+    EXPECT_LE(size_class, size + size / 4 + 64);
+    EXPECT_EQ(size_class, HostMemoryPool::SizeClass(size_class));
+  }
+}
+
+TEST_F(HostMemoryPoolTest, TestReuse) {
+  const HostMemoryPool::Stats before = HostMemoryPool::GetStats();
+  void* ptr = HostMemoryPool::Allocate(1000);
+  HostMemoryPool::Free(ptr, 1000);
+  // Any size of the same class reuses the block.
+  void* reused = HostMemoryPool::Allocate(1010);
+  EXPECT_EQ(ptr, reused);
+  const HostMemoryPool::Stats after = HostMemoryPool::GetStats();
+  EXPECT_EQ(before.misses + 1, after.misses);
+  EXPECT_EQ(before.hits + 1, after.hits);
+  EXPECT_EQ(before.bytes_in_use + HostMemoryPool::SizeClass(1000),
+            after.bytes_in_use);
+  EXPECT_EQ(0, after.bytes_cached);
+  HostMemoryPool::Free(reused, 1010);
+  EXPECT_EQ(before.bytes_in_use, HostMemoryPool::GetStats().bytes_in_use);
+}
+
+TEST_F(HostMemoryPoolTest, TestTrim) {
+  void* ptr = HostMemoryPool::Allocate(4096);
+  HostMemoryPool::Free(ptr, 4096);
+  EXPECT_EQ(4096, HostMemoryPool::GetStats().bytes_cached);
+  HostMemoryPool::Trim();
+  EXPECT_EQ(0, HostMemoryPool::GetStats().bytes_cached);
+}
+
+TEST_F(HostMemoryPoolTest, TestMaxCachedBytes) {
+  HostMemoryPool::set_max_cached_bytes(4096);
+  void* ptr = HostMemoryPool::Allocate(4096);
+  void* other_ptr = HostMemoryPool::Allocate(4096);
+  HostMemoryPool::Free(ptr, 4096);
+  HostMemoryPool::Free(other_ptr, 4096);
+  EXPECT_EQ(4096, HostMemoryPool::GetStats().bytes_cached);
+}
+
+TEST_F(HostMemoryPoolTest, TestSyncedMemory) {
+  const HostMemoryPool::Stats before = HostMemoryPool::GetStats();
+  {
+    SyncedMemory mem(1000);
+    EXPECT_TRUE(mem.mutable_cpu_data());
+  }
+  {
+    // The memory is zeroed on allocation even when it comes from the pool.
+    SyncedMemory mem(1000);
+    const char* data = static_cast<const char*>(mem.cpu_data());
+    for (int i = 0; i < mem.size(); ++i) {
+      EXPECT_EQ(0, data[i]);
+    }
+  }
+  const HostMemoryPool::Stats after = HostMemoryPool::GetStats();
+  EXPECT_EQ(before.misses + 1, after.misses);
+  EXPECT_EQ(before.hits + 1, after.hits);
+}
+
+TEST_F(HostMemoryPoolTest, TestDisabled) {
+  shared_ptr<SyncedMemory> pooled_mem(new SyncedMemory(1000));
+  EXPECT_TRUE(pooled_mem->mutable_cpu_data());
+  HostMemoryPool::set_enabled(false);
+  const HostMemoryPool::Stats before = HostMemoryPool::GetStats();
+  {
+    SyncedMemory mem(1000);
+    EXPECT_TRUE(mem.mutable_cpu_data());
+  }
+  const HostMemoryPool::Stats after = HostMemoryPool::GetStats();
+  EXPECT_EQ(before.misses, after.misses);
+  EXPECT_EQ(before.hits, after.hits);
+  EXPECT_EQ(0, after.bytes_cached);
+  // Memory allocated while the pool was enabled still goes back to it.
+  pooled_mem.reset();
+  EXPECT_EQ(HostMemoryPool::SizeClass(1000),
+            HostMemoryPool::GetStats().bytes_cached);
+}
+
+TEST_F(HostMemoryPoolTest, TestAlignment) {
+  EXPECT_EQ(64, Caffe::host_alignment());
+  EXPECT_FALSE(Caffe::host_huge_pages());
+  for (size_t size = 1; size < 100000; size = size * 3 + 1) {
+    void* ptr = HostMemoryPool::Allocate(size);
+    EXPECT_TRUE(IsAligned(ptr, 64));
+    HostMemoryPool::Free(ptr, size);
+  }
+  HostMemoryPool::set_enabled(false);
+  SyncedMemory mem(1000);
+  EXPECT_TRUE(IsAligned(mem.cpu_data(), 64));
+}
+
+TEST_F(HostMemoryPoolTest, TestRealignCachedBlock) {
+  Caffe::set_host_alignment(16);
+  // Keep allocating until a block is found which is not 4096-aligned.
+  vector<void*> ptrs;
+  do {
+    ptrs.push_back(HostMemoryPool::Allocate(1000));
+  } while (IsAligned(ptrs.back(), 4096));
+  for (int i = 0; i < ptrs.size(); ++i) {
+    HostMemoryPool::Free(ptrs[i], 1000);
+  }
+  Caffe::set_host_alignment(4096);
+  const HostMemoryPool::Stats before = HostMemoryPool::GetStats();
+  for (int i = 0; i < ptrs.size(); ++i) {
+    ptrs[i] = HostMemoryPool::Allocate(1000);
+    EXPECT_TRUE(IsAligned(ptrs[i], 4096));
+  }
+  const HostMemoryPool::Stats after = HostMemoryPool::GetStats();
+  EXPECT_GE(after.misses, before.misses + 1);
+  for (int i = 0; i < ptrs.size(); ++i) {
+    HostMemoryPool::Free(ptrs[i], 1000);
+  }
+}
+
+TEST_F(HostMemoryPoolTest, TestHugePages) {
+  Caffe::set_host_huge_pages(true);
+  EXPECT_EQ(64, HostAlignment(kHugePageSize - 1));
+  EXPECT_EQ(kHugePageSize, HostAlignment(kHugePageSize));
+  SyncedMemory small_mem(1000);
+  EXPECT_TRUE(IsAligned(small_mem.cpu_data(), 64));
+  SyncedMemory large_mem(3 * kHugePageSize);
+  EXPECT_TRUE(IsAligned(large_mem.cpu_data(), kHugePageSize));
+}
+
+static void AllocateAndFree(size_t size, void** ptr) {
+  *ptr = HostMemoryPool::Allocate(size);
+  HostMemoryPool::Free(*ptr, size);
+}
+
+TEST_F(HostMemoryPoolTest, TestPerThread) {
+  HostMemoryPool::set_per_thread(true);
+  void* ptr = NULL;
+  boost::thread thread(AllocateAndFree, 2048, &ptr);
+  thread.join();
+  // The exiting thread releases its cache, so its block is not reused here.
+  EXPECT_EQ(0, HostMemoryPool::GetStats().bytes_cached);
+  const HostMemoryPool::Stats before = HostMemoryPool::GetStats();
+  void* other_ptr = NULL;
+  AllocateAndFree(2048, &other_ptr);
+  AllocateAndFree(2048, &other_ptr);
+  const HostMemoryPool::Stats after = HostMemoryPool::GetStats();
+  EXPECT_EQ(before.misses + 1, after.misses);
+  EXPECT_EQ(before.hits + 1, after.hits);
+}
+
+}  // namespace caffe
@@ -143,6 +143,92 @@ TYPED_TEST(Im2colLayerTest, TestDilatedGradientForceND) {
                                   this->blob_top_vec_);
 }
 
+TYPED_TEST(Im2colLayerTest, TestForward3D) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  vector<int> bottom_shape;
+  bottom_shape.push_back(2);
+  bottom_shape.push_back(3);
+  bottom_shape.push_back(4);
+  bottom_shape.push_back(5);
+  bottom_shape.push_back(6);
+  this->blob_bottom_->Reshape(bottom_shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  // A different stride, padding and dilation along each axis.
+  const int stride[] = {1, 2, 1};
+  const int pad[] = {1, 0, 2};
+  const int dilation[] = {1, 1, 2};
+  convolution_param->add_kernel_size(3);
+  for (int i = 0; i < 3; ++i) {
+    convolution_param->add_stride(stride[i]);
+    convolution_param->add_pad(pad[i]);
+    convolution_param->add_dilation(dilation[i]);
+  }
+  Im2colLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_EQ(5, this->blob_top_->num_axes());
+  EXPECT_EQ(81, this->blob_top_->shape(1));
+  const Dtype* top_data = this->blob_top_->cpu_data();
+  vector<int> top_index(5);
+  vector<int> bottom_index(5);
+  for (top_index[0] = 0; top_index[0] < 2; ++top_index[0]) {
+    for (top_index[1] = 0; top_index[1] < 81; ++top_index[1]) {
+      const int kernel[] = {top_index[1] / 9 % 3, top_index[1] / 3 % 3,
+          top_index[1] % 3};
+      bottom_index[0] = top_index[0];
+      bottom_index[1] = top_index[1] / 27;
+      for (top_index[2] = 0; top_index[2] < this->blob_top_->shape(2);
+          ++top_index[2]) {
+        for (top_index[3] = 0; top_index[3] < this->blob_top_->shape(3);
+            ++top_index[3]) {
+          for (top_index[4] = 0; top_index[4] < this->blob_top_->shape(4);
+              ++top_index[4]) {
+            bool is_padding = false;
+            for (int i = 0; i < 3; ++i) {
+              bottom_index[2 + i] = top_index[2 + i] * stride[i] - pad[i] +
+                  kernel[i] * dilation[i];
+              is_padding |= bottom_index[2 + i] < 0 ||
+                  bottom_index[2 + i] >= bottom_shape[2 + i];
+            }
+            const Dtype expected = is_padding ? Dtype(0) :
+                this->blob_bottom_->data_at(bottom_index);
+            EXPECT_EQ(expected, top_data[this->blob_top_->offset(top_index)]);
+          }
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(Im2colLayerTest, TestGradient3D) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  vector<int> bottom_shape;
+  bottom_shape.push_back(1);
+  bottom_shape.push_back(2);
+  bottom_shape.push_back(3);
+  bottom_shape.push_back(4);
+  bottom_shape.push_back(3);
+  this->blob_bottom_->Reshape(bottom_shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  convolution_param->add_kernel_size(2);
+  convolution_param->add_stride(2);
+  convolution_param->add_pad(1);
+  Im2colLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
 TYPED_TEST(Im2colLayerTest, TestRect) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
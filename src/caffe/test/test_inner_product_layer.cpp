@@ -6,6 +6,8 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/quantize.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -34,12 +36,42 @@ class InnerProductLayerTest : public MultiDeviceTest<TypeParam> {
     delete blob_bottom_;
     delete blob_bottom_nobatch_;
     delete blob_top_;
+    for (int i = 0; i < sparse_bottom_vec_.size(); ++i) {
+      delete sparse_bottom_vec_[i];
+    }
+  }
+  // Zeroes most of blob_bottom_, and holds its 2 x 60 matrix in compressed
+  // sparse row form in sparse_bottom_vec_.
+  void MakeSparseBottom() {
+    Dtype* data = blob_bottom_->mutable_cpu_data();
+    vector<Dtype> values, columns, offsets(1, 0);
+    for (int i = 0; i < 2; ++i) {
+      for (int j = 0; j < 60; ++j) {
+        if ((i + j) % 7 != 0) {
+          data[i * 60 + j] = 0;
+        } else {
+          values.push_back(data[i * 60 + j]);
+          columns.push_back(j);
+        }
+      }
+      offsets.push_back(values.size());
+    }
+    const Dtype* csr[] = {&values[0], &columns[0], &offsets[0]};
+    const int counts[] = {static_cast<int>(values.size()),
+        static_cast<int>(columns.size()), static_cast<int>(offsets.size())};
+    for (int i = 0; i < 3; ++i) {
+      Blob<Dtype>* blob = new Blob<Dtype>(vector<int>(1, counts[i]));
+      caffe_copy(counts[i], csr[i], blob->mutable_cpu_data());
+      sparse_bottom_vec_.push_back(blob);
+    }
   }
+
   Blob<Dtype>* const blob_bottom_;
   Blob<Dtype>* const blob_bottom_nobatch_;
   Blob<Dtype>* const blob_top_;
   vector<Blob<Dtype>*> blob_bottom_vec_;
   vector<Blob<Dtype>*> blob_top_vec_;
+  vector<Blob<Dtype>*> sparse_bottom_vec_;
 };
 
 TYPED_TEST_CASE(InnerProductLayerTest, TestDtypesAndDevices);
@@ -122,6 +154,123 @@ TYPED_TEST(InnerProductLayerTest, TestForwardNoBatch) {
   }
 }
 
+TYPED_TEST(InnerProductLayerTest, TestSparseForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  LayerParameter layer_param;
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->mutable_weight_filler()->set_type("gaussian");
+  inner_product_param->mutable_bias_filler()->set_type("gaussian");
+  inner_product_param->set_sparse_weight_threshold(2);
+  InnerProductLayer<Dtype> dense_layer(layer_param);
+  dense_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype>* weights = dense_layer.blobs()[0].get();
+  // Pruned to 90% zeros.
+  Dtype* weight_data = weights->mutable_cpu_data();
+  for (int i = 0; i < weights->count(); ++i) {
+    if (i % 10) {
+      weight_data[i] = 0;
+    }
+  }
+  inner_product_param->set_sparse_weight_threshold(0.8);
+  InnerProductLayer<Dtype> sparse_layer(layer_param);
+  sparse_layer.blobs() = dense_layer.blobs();
+  sparse_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> dense_top;
+  vector<Blob<Dtype>*> dense_top_vec(1, &dense_top);
+  dense_layer.Reshape(this->blob_bottom_vec_, dense_top_vec);
+  // The weights are compressed again once they change.
+  for (int run = 0; run < 2; ++run) {
+    if (run == 1) {
+      caffe_scal(weights->count(), Dtype(-2), weights->mutable_cpu_data());
+    }
+    dense_layer.Forward(this->blob_bottom_vec_, dense_top_vec);
+    sparse_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    const Dtype* top_data = this->blob_top_->cpu_data();
+    const Dtype* dense_top_data = dense_top.cpu_data();
+    for (int i = 0; i < dense_top.count(); ++i) {
+      EXPECT_NEAR(top_data[i], dense_top_data[i], 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(InnerProductLayerTest, TestInt8Forward) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  LayerParameter layer_param;
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->mutable_weight_filler()->set_type("gaussian");
+  inner_product_param->mutable_bias_filler()->set_type("gaussian");
+  InnerProductLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> top;
+  top.CopyFrom(*this->blob_top_, false, true);
+  layer_param.set_type("InnerProduct");
+  inner_product_param->set_engine(InnerProductParameter_Engine_INT8);
+  shared_ptr<Layer<Dtype> > int8_layer =
+      LayerRegistry<Dtype>::CreateLayer(layer_param);
+  int8_layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < layer.blobs().size(); ++i) {
+    int8_layer->blobs()[i]->CopyFrom(*layer.blobs()[i]);
+  }
+  int8_layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // The weights are quantized into a copy, and stay in Dtype for the solver.
+  EXPECT_EQ(NATIVE, int8_layer->blobs()[0]->storage_precision());
+  // Quantizing the bottom and the weights to int8 perturbs each of the
+  // 60 products by at most |bottom| |weight| / 127.
+  const Dtype tolerance = 60 * caffe_cpu_amax(this->blob_bottom_->count(),
+      this->blob_bottom_->cpu_data()) * caffe_cpu_amax(
+      layer.blobs()[0]->count(), layer.blobs()[0]->cpu_data()) / 127 * 1.01;
+  for (int i = 0; i < top.count(); ++i) {
+    EXPECT_NEAR(top.cpu_data()[i], this->blob_top_->cpu_data()[i], tolerance);
+  }
+  // The copy is quantized again once the weights are written to: negating
+  // them and the bias negates the top.
+  top.CopyFrom(*this->blob_top_);
+  for (int i = 0; i < int8_layer->blobs().size(); ++i) {
+    Blob<Dtype>* blob = int8_layer->blobs()[i].get();
+    caffe_scal(blob->count(), Dtype(-1), blob->mutable_cpu_data());
+  }
+  int8_layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < top.count(); ++i) {
+    EXPECT_EQ(-top.cpu_data()[i], this->blob_top_->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(InnerProductLayerTest, TestForwardPackedWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  LayerParameter layer_param;
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  // Enough outputs for the packed weights to span several panels.
+  inner_product_param->set_num_output(1200);
+  inner_product_param->mutable_weight_filler()->set_type("gaussian");
+  inner_product_param->mutable_bias_filler()->set_type("gaussian");
+  InnerProductLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype>* weights = layer.blobs()[0].get();
+  weights->Pack(FP16);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  if (Caffe::mode() == Caffe::CPU) {
+    EXPECT_TRUE(weights->data_packed());
+  }
+  Blob<Dtype> top;
+  top.CopyFrom(*this->blob_top_, false, true);
+  // The same weights, unpacked into the blob.
+  weights->cpu_data();
+  EXPECT_FALSE(weights->data_packed());
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < top.count(); ++i) {
+    EXPECT_NEAR(top.cpu_data()[i], this->blob_top_->cpu_data()[i], 1e-4);
+  }
+}
+
 TYPED_TEST(InnerProductLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   this->blob_bottom_vec_.push_back(this->blob_bottom_);
@@ -148,4 +297,47 @@ TYPED_TEST(InnerProductLayerTest, TestGradient) {
   }
 }
 
+TYPED_TEST(InnerProductLayerTest, TestForwardSparseInput) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->MakeSparseBottom();
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  LayerParameter layer_param;
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->mutable_weight_filler()->set_type("uniform");
+  inner_product_param->mutable_bias_filler()->set_type("uniform");
+  InnerProductLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // The same product, of the nonzeros only.
+  inner_product_param->set_input_dim(60);
+  InnerProductLayer<Dtype> sparse_layer(layer_param);
+  sparse_layer.blobs() = layer.blobs();
+  Blob<Dtype> top;
+  vector<Blob<Dtype>*> top_vec(1, &top);
+  sparse_layer.SetUp(this->sparse_bottom_vec_, top_vec);
+  ASSERT_TRUE(top.shape() == this->blob_top_->shape());
+  sparse_layer.Forward(this->sparse_bottom_vec_, top_vec);
+  for (int i = 0; i < top.count(); ++i) {
+    EXPECT_NEAR(this->blob_top_->cpu_data()[i], top.cpu_data()[i], 1e-5);
+  }
+}
+
+TYPED_TEST(InnerProductLayerTest, TestGradientSparseInput) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->MakeSparseBottom();
+  LayerParameter layer_param;
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->set_input_dim(60);
+  inner_product_param->mutable_weight_filler()->set_type("gaussian");
+  inner_product_param->mutable_bias_filler()->set_type("gaussian");
+  InnerProductLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->sparse_bottom_vec_,
+      this->blob_top_vec_, 0);
+}
+
 }  // namespace caffe
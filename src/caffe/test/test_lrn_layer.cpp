@@ -7,6 +7,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/lrn_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_lcn_layer.hpp"
@@ -201,6 +202,66 @@ TYPED_TEST(LRNLayerTest, TestGradientAcrossChannelsLargeRegion) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(LRNLayerTest, TestForwardBackwardAcrossChannelsTiles) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Planes of more than one tile, the last one partial.
+  this->blob_bottom_->Reshape(2, 7, 17, 17);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  LRNLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> top_reference;
+  this->ReferenceLRNForward(*(this->blob_bottom_), layer_param,
+      &top_reference);
+  for (int i = 0; i < this->blob_bottom_->count(); ++i) {
+    EXPECT_NEAR(this->blob_top_->cpu_data()[i], top_reference.cpu_data()[i],
+                this->epsilon_);
+  }
+  filler.Fill(this->blob_top_);
+  caffe_copy(this->blob_top_->count(), this->blob_top_->cpu_data(),
+      this->blob_top_->mutable_cpu_diff());
+  caffe_copy(top_reference.count(), top_reference.cpu_data(),
+      this->blob_top_->mutable_cpu_data());
+  vector<bool> propagate_down(1, true);
+  layer.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+  // The gradient of x_c (1 + alpha / size sum x_c'^2)^-beta, with the sum
+  // over the window of c.
+  const Dtype alpha = layer_param.lrn_param().alpha();
+  const Dtype beta = layer_param.lrn_param().beta();
+  const int size = layer_param.lrn_param().local_size();
+  const int channels = this->blob_bottom_->channels();
+  const Blob<Dtype>& bottom = *this->blob_bottom_;
+  const Blob<Dtype>& top = *this->blob_top_;
+  for (int n = 0; n < bottom.num(); ++n) {
+    for (int c = 0; c < channels; ++c) {
+      for (int h = 0; h < bottom.height(); ++h) {
+        for (int w = 0; w < bottom.width(); ++w) {
+          Dtype diff = 0;
+          for (int o = max(c - size / 2, 0);
+               o < min(c + size / 2 + 1, channels); ++o) {
+            Dtype scale = 1;
+            for (int i = max(o - size / 2, 0);
+                 i < min(o + size / 2 + 1, channels); ++i) {
+              scale += alpha / size * bottom.data_at(n, i, h, w) *
+                  bottom.data_at(n, i, h, w);
+            }
+            diff -= top.diff_at(n, o, h, w) * 2 * alpha * beta / size *
+                bottom.data_at(n, o, h, w) * bottom.data_at(n, c, h, w) *
+                pow(scale, -beta - 1);
+            if (o == c) {
+              diff += top.diff_at(n, o, h, w) * pow(scale, -beta);
+            }
+          }
+          EXPECT_NEAR(bottom.diff_at(n, c, h, w), diff, this->epsilon_);
+        }
+      }
+    }
+  }
+}
+
 TYPED_TEST(LRNLayerTest, TestSetupWithinChannel) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
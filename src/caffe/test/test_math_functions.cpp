@@ -1,6 +1,8 @@
 #include <stdint.h>  // for uint32_t & uint64_t
 #include <time.h>
 #include <cmath>  // for std::fabs
+#include <limits>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -119,6 +121,94 @@ TYPED_TEST(CPUMathFunctionsTest, TestCopy) {
   }
 }
 
+TYPED_TEST(CPUMathFunctionsTest, TestExp) {
+  const int n = this->blob_bottom_->count();
+  TypeParam* x = this->blob_bottom_->mutable_cpu_data();
+  // Spread over the range where exp neither overflows nor underflows.
+  caffe_scal<TypeParam>(n, TypeParam(15), x);
+  caffe_exp<TypeParam>(n, x, this->blob_bottom_->mutable_cpu_diff());
+  const TypeParam* y = this->blob_bottom_->cpu_diff();
+  for (int i = 0; i < n; ++i) {
+    const TypeParam expected = std::exp(x[i]);
+    EXPECT_NEAR(y[i], expected, expected * 1e-6);
+  }
+  const TypeParam inf = std::numeric_limits<TypeParam>::infinity();
+  const TypeParam special[] = {0, -inf, inf, 1000, -1000};
+  const TypeParam expected[] = {1, 0, inf, inf, 0};
+  TypeParam result[5];
+  caffe_exp<TypeParam>(5, special, result);
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(expected[i], result[i]);
+  }
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestLog) {
+  const int n = this->blob_bottom_->count();
+  TypeParam* x = this->blob_bottom_->mutable_cpu_data();
+  caffe_abs<TypeParam>(n, x, x);
+  caffe_log<TypeParam>(n, x, this->blob_bottom_->mutable_cpu_diff());
+  const TypeParam* y = this->blob_bottom_->cpu_diff();
+  for (int i = 0; i < n; ++i) {
+    const TypeParam expected = std::log(x[i]);
+    EXPECT_NEAR(y[i], expected, std::fabs(expected) * 1e-6 + 1e-7);
+  }
+  const TypeParam inf = std::numeric_limits<TypeParam>::infinity();
+  const TypeParam special[] = {1, 0, inf,
+      std::numeric_limits<TypeParam>::denorm_min()};
+  const TypeParam expected[] = {0, -inf, inf,
+      std::log(std::numeric_limits<TypeParam>::denorm_min())};
+  TypeParam result[4];
+  caffe_log<TypeParam>(4, special, result);
+  EXPECT_EQ(expected[0], result[0]);
+  EXPECT_EQ(expected[1], result[1]);
+  EXPECT_EQ(expected[2], result[2]);
+  EXPECT_NEAR(expected[3], result[3], 1e-4);
+  TypeParam negative = -1;
+  caffe_log<TypeParam>(1, &negative, result);
+  EXPECT_TRUE(std::isnan(result[0]));
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestPowx) {
+  const int n = this->blob_bottom_->count();
+  const TypeParam* x = this->blob_bottom_->cpu_data();
+  // Negative bases with integer exponents, and zero.
+  this->blob_bottom_->mutable_cpu_data()[0] = 0;
+  const TypeParam exponents[] = {0.75, -0.75, 2, 3, 0};
+  for (int e = 0; e < 5; ++e) {
+    const TypeParam b = exponents[e];
+    caffe_powx<TypeParam>(n, x, b, this->blob_bottom_->mutable_cpu_diff());
+    const TypeParam* y = this->blob_bottom_->cpu_diff();
+    for (int i = 0; i < n; ++i) {
+      const TypeParam expected = std::pow(x[i], b);
+      if (std::isnan(expected)) {
+        EXPECT_TRUE(std::isnan(y[i]));
+      } else if (std::isinf(expected)) {
+        EXPECT_EQ(expected, y[i]);
+      } else {
+        EXPECT_NEAR(y[i], expected, std::fabs(expected) * 1e-5);
+      }
+    }
+  }
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestAxpby) {
+  const int n = this->blob_bottom_->count();
+  const TypeParam* x = this->blob_bottom_->cpu_data();
+  const TypeParam* y = this->blob_top_->cpu_data();
+  const TypeParam betas[] = {0.9, 0};
+  for (int k = 0; k < 2; ++k) {
+    vector<TypeParam> expected(n);
+    for (int i = 0; i < n; ++i) {
+      expected[i] = TypeParam(0.5) * x[i] + betas[k] * y[i];
+    }
+    caffe_cpu_axpby<TypeParam>(n, TypeParam(0.5), x, betas[k],
+        this->blob_top_->mutable_cpu_data());
+    for (int i = 0; i < n; ++i) {
+      EXPECT_NEAR(expected[i], y[i], 1e-5);
+    }
+  }
+}
+
 #ifndef CPU_ONLY
 
 template <typename Dtype>
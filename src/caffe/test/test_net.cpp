@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <string>
 #include <utility>
 #include <vector>
@@ -8,7 +10,10 @@
 
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/layers/memory_data_layer.hpp"
 #include "caffe/net.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -713,6 +718,98 @@ class NetTest : public MultiDeviceTest<TypeParam> {
     InitNetFromProtoString(proto);
   }
 
+  virtual void InitMemoryPlanNet(const bool optimize_memory,
+      const bool forward_only = false) {
+    string proto =
+        "name: 'MemoryPlanNetwork' "
+        "input: 'data' "
+        "input_shape { dim: 2 dim: 3 dim: 8 dim: 8 } "
+        "layer { "
+        "  name: 'conv1' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv1' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu1' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv1' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'conv2' "
+        "  type: 'Convolution' "
+        "  bottom: 'conv1' "
+        "  top: 'conv2' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv3' "
+        "  type: 'Convolution' "
+        "  bottom: 'conv2' "
+        "  top: 'conv3' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'sum' "
+        "  type: 'Eltwise' "
+        "  bottom: 'conv2' "
+        "  bottom: 'conv3' "
+        "  top: 'sum' "
+        "} "
+        "layer { "
+        "  name: 'flatten' "
+        "  type: 'Flatten' "
+        "  bottom: 'sum' "
+        "  top: 'flat' "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'flat' "
+        "  top: 'ip' "
+        "  inner_product_param { "
+        "    num_output: 5 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} ";
+    if (optimize_memory) {
+      proto += "optimize_memory: true ";
+    }
+    if (forward_only) {
+      proto += "forward_only: true ";
+    }
+    InitNetFromProtoString(proto);
+  }
+
   int seed_;
   shared_ptr<Net<Dtype> > net_;
 };
@@ -1226,6 +1323,89 @@ TYPED_TEST(NetTest, TestSharedWeightsResume) {
   }
 }
 
+TYPED_TEST(NetTest, TestFlatWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitDiffDataSharedWeightsNet();
+  vector<Blob<Dtype>*> bottom;
+  this->net_->ForwardBackward(bottom);
+  this->net_->Update();
+  Blob<Dtype>* ip1_weights = this->net_->layers()[1]->blobs()[0].get();
+  Blob<Dtype> shared_params;
+  shared_params.CopyFrom(*ip1_weights, false, true);
+  const int count = ip1_weights->count();
+  string filename;
+  MakeTempFilename(&filename);
+  filename += ".flat";
+  this->net_->ToFlat(filename);
+
+  // Reinitialize the net with other weights and load the flat file.
+  Caffe::set_random_seed(this->seed_ + 1);
+  this->InitDiffDataSharedWeightsNet();
+  this->net_->CopyTrainedLayersFrom(filename);
+  ip1_weights = this->net_->layers()[1]->blobs()[0].get();
+  Blob<Dtype>* ip2_weights = this->net_->layers()[2]->blobs()[0].get();
+  // The weights are used in place, and are still shared.
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(ip1_weights->cpu_data()) % 64);
+  EXPECT_EQ(ip1_weights->cpu_data(), ip2_weights->cpu_data());
+  for (int i = 0; i < count; ++i) {
+    EXPECT_EQ(shared_params.cpu_data()[i], ip1_weights->cpu_data()[i]);
+  }
+  // Updating the weights leaves the file alone.
+  this->net_->ForwardBackward(bottom);
+  this->net_->Update();
+  this->InitDiffDataSharedWeightsNet();
+  this->net_->CopyTrainedLayersFrom(filename);
+  ip1_weights = this->net_->layers()[1]->blobs()[0].get();
+  for (int i = 0; i < count; ++i) {
+    EXPECT_EQ(shared_params.cpu_data()[i], ip1_weights->cpu_data()[i]);
+  }
+  // The weights keep the file mapped after the net is gone.
+  shared_ptr<Blob<Dtype> > weights = this->net_->layers()[1]->blobs()[0];
+  this->net_.reset();
+  for (int i = 0; i < count; ++i) {
+    EXPECT_EQ(shared_params.cpu_data()[i], weights->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestDeferFill) {
+  typedef typename TypeParam::Dtype Dtype;
+  const bool kBiasTerm = true;
+  this->InitUnsharedWeightsNet(NULL, NULL, false, kBiasTerm);
+  NetParameter trained_param;
+  this->net_->ToProto(&trained_param);
+  // Define the same net, deferring its fillers, and trained weights for all
+  // of its layers but innerproduct2.
+  NetParameter net_param(trained_param);
+  net_param.set_defer_fill(true);
+  NetParameter weights_param;
+  for (int i = 0; i < trained_param.layer_size(); ++i) {
+    net_param.mutable_layer(i)->clear_blobs();
+    if (trained_param.layer(i).name() != "innerproduct2") {
+      weights_param.add_layer()->CopyFrom(trained_param.layer(i));
+    }
+  }
+  Net<Dtype> net(net_param);
+  shared_ptr<Layer<Dtype> > ip1 = net.layer_by_name("innerproduct1");
+  shared_ptr<Layer<Dtype> > ip2 = net.layer_by_name("innerproduct2");
+  EXPECT_TRUE(ip1->fill_deferred(0));
+  EXPECT_TRUE(ip1->fill_deferred(1));
+  net.CopyTrainedLayersFrom(weights_param);
+  EXPECT_FALSE(ip1->fill_deferred(0));
+  EXPECT_FALSE(ip1->fill_deferred(1));
+  const Blob<Dtype>* trained_weights =
+      this->net_->layer_by_name("innerproduct1")->blobs()[0].get();
+  for (int i = 0; i < trained_weights->count(); ++i) {
+    EXPECT_EQ(trained_weights->cpu_data()[i], ip1->blobs()[0]->cpu_data()[i]);
+  }
+  // The weights of innerproduct2 are not even allocated before Forward.
+  EXPECT_TRUE(ip2->fill_deferred(0));
+  EXPECT_EQ(SyncedMemory::UNINITIALIZED, ip2->blobs()[0]->data()->head());
+  net.ForwardPrefilled();
+  EXPECT_FALSE(ip2->fill_deferred(0));
+  EXPECT_GT(ip2->blobs()[0]->asum_data(), 0);
+}
+
 TYPED_TEST(NetTest, TestParamPropagateDown) {
   typedef typename TypeParam::Dtype Dtype;
   vector<Blob<Dtype>*> bottom;
@@ -2379,4 +2559,494 @@ TYPED_TEST(NetTest, TestSkipPropagateDown) {
   }
 }
 
+TYPED_TEST(NetTest, TestOptimizeMemory) {
+  typedef typename TypeParam::Dtype Dtype;
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> input1(2, 3, 8, 8);
+  Blob<Dtype> input2(5, 3, 8, 8);
+  filler.Fill(&input1);
+  filler.Fill(&input2);
+  // Run the same net with and without memory planning on two batch sizes.
+  vector<shared_ptr<Blob<Dtype> > > outputs(4);
+  size_t memory_used = 0;
+  for (int optimize = 0; optimize <= 1; ++optimize) {
+    Caffe::set_random_seed(this->seed_);
+    this->InitMemoryPlanNet(optimize);
+    if (optimize) {
+      EXPECT_EQ(memory_used, this->net_->memory_used());
+      EXPECT_LT(this->net_->memory_planned(), memory_used);
+    } else {
+      memory_used = this->net_->memory_used();
+      EXPECT_EQ(memory_used, this->net_->memory_planned());
+    }
+    for (int i = 0; i < 2; ++i) {
+      const Blob<Dtype>& input = i ? input2 : input1;
+      Blob<Dtype>* input_blob = this->net_->input_blobs()[0];
+      input_blob->ReshapeLike(input);
+      this->net_->Reshape();
+      caffe_copy(input.count(), input.cpu_data(),
+          input_blob->mutable_cpu_data());
+      this->net_->ForwardPrefilled();
+      outputs[optimize * 2 + i].reset(new Blob<Dtype>());
+      outputs[optimize * 2 + i]->CopyFrom(*this->net_->output_blobs()[0],
+          false, true);
+    }
+  }
+  for (int i = 0; i < 2; ++i) {
+    const Blob<Dtype>& expected = *outputs[i];
+    const Blob<Dtype>& actual = *outputs[2 + i];
+    ASSERT_EQ(expected.count(), actual.count());
+    for (int j = 0; j < expected.count(); ++j) {
+      EXPECT_EQ(expected.cpu_data()[j], actual.cpu_data()[j]);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestOptimizeMemoryDataLayer) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The MemoryData tops point at the caller's arrays, which the blobs
+  // planned after them must not write to.
+  const string proto =
+      "name: 'MemoryDataPlanNetwork' "
+      "optimize_memory: true "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'MemoryData' "
+      "  top: 'data' "
+      "  top: 'label' "
+      "  memory_data_param { "
+      "    batch_size: 2 channels: 3 height: 8 width: 8 "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "  convolution_param { "
+      "    num_output: 4 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  bottom: 'conv1' "
+      "  top: 'conv2' "
+      "  convolution_param { "
+      "    num_output: 4 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv3' "
+      "  type: 'Convolution' "
+      "  bottom: 'conv2' "
+      "  top: 'conv3' "
+      "  convolution_param { "
+      "    num_output: 4 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'conv3' "
+      "  top: 'ip' "
+      "  inner_product_param { "
+      "    num_output: 5 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  Blob<Dtype> data(4, 3, 8, 8);
+  Blob<Dtype> labels(4, 1, 1, 1);
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&data);
+  filler.Fill(&labels);
+  Blob<Dtype> input;
+  input.CopyFrom(data, false, true);
+  shared_ptr<MemoryDataLayer<Dtype> > layer =
+      boost::static_pointer_cast<MemoryDataLayer<Dtype> >(
+          this->net_->layer_by_name("data"));
+  layer->Reset(input.mutable_cpu_data(), labels.mutable_cpu_data(), 4);
+  for (int i = 0; i < 2; ++i) {
+    this->net_->ForwardPrefilled();
+  }
+  for (int i = 0; i < data.count(); ++i) {
+    EXPECT_EQ(data.cpu_data()[i], input.cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestForwardOnly) {
+  typedef typename TypeParam::Dtype Dtype;
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> input(2, 3, 8, 8);
+  filler.Fill(&input);
+  vector<shared_ptr<Blob<Dtype> > > outputs(2);
+  vector<size_t> memory_used(2);
+  for (int forward_only = 0; forward_only <= 1; ++forward_only) {
+    Caffe::set_random_seed(this->seed_);
+    this->InitMemoryPlanNet(false, forward_only);
+    EXPECT_EQ(forward_only, this->net_->forward_only());
+    memory_used[forward_only] = this->net_->memory_used() +
+        this->net_->diff_memory_used();
+    Blob<Dtype>* input_blob = this->net_->input_blobs()[0];
+    caffe_copy(input.count(), input.cpu_data(),
+        input_blob->mutable_cpu_data());
+    this->net_->ForwardPrefilled();
+    outputs[forward_only].reset(new Blob<Dtype>());
+    outputs[forward_only]->CopyFrom(*this->net_->output_blobs()[0],
+        false, true);
+  }
+  // Without loss layers, the diffs take as much memory as the data.
+  EXPECT_EQ(memory_used[0], 2 * memory_used[1]);
+  const vector<shared_ptr<Blob<Dtype> > >& blobs = this->net_->blobs();
+  for (int i = 0; i < blobs.size(); ++i) {
+    EXPECT_TRUE(blobs[i]->diff_disabled());
+    EXPECT_EQ(0, blobs[i]->asum_diff());
+  }
+  const vector<shared_ptr<Blob<Dtype> > >& params = this->net_->params();
+  for (int i = 0; i < params.size(); ++i) {
+    EXPECT_TRUE(params[i]->diff_disabled());
+  }
+  ASSERT_EQ(outputs[0]->count(), outputs[1]->count());
+  for (int i = 0; i < outputs[0]->count(); ++i) {
+    EXPECT_EQ(outputs[0]->cpu_data()[i], outputs[1]->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestForwardOnlyLoss) {
+  typedef typename TypeParam::Dtype Dtype;
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      "name: 'ForwardOnlyLossNetwork' "
+      "forward_only: true "
+      "state { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 5 dim: 2 } "
+      "    shape { dim: 5 } "
+      "    data_filler { type: 'gaussian' std: 1 } "
+      "    data_filler { type: 'constant' value: 1 } "
+      "  } "
+      "  top: 'data' "
+      "  top: 'label' "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { "
+      "    num_output: 2 "
+      "    weight_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "  bottom: 'data' "
+      "  top: 'ip' "
+      "} "
+      "layer { "
+      "  name: 'reshape' "
+      "  type: 'Reshape' "
+      "  reshape_param { shape { dim: 0 dim: -1 } } "
+      "  bottom: 'ip' "
+      "  top: 'reshaped' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'HingeLoss' "
+      "  bottom: 'reshaped' "
+      "  bottom: 'label' "
+      "  top: 'loss' "
+      "} ", &param));
+  Net<Dtype> net(param);
+  // The loss layer keeps the diffs of its blobs, which HingeLoss uses as
+  // scratch, even where Reshape shares the diff of a blob without one.
+  EXPECT_TRUE(net.blob_by_name("data")->diff_disabled());
+  EXPECT_TRUE(net.blob_by_name("ip")->diff_disabled());
+  EXPECT_FALSE(net.blob_by_name("reshaped")->diff_disabled());
+  EXPECT_FALSE(net.blob_by_name("loss")->diff_disabled());
+  net.Reshape();
+  Dtype loss;
+  net.ForwardPrefilled(&loss);
+  EXPECT_GT(loss, 0);
+  // Trained weights with diffs load without them.
+  NetParameter trained_param(param);
+  trained_param.set_forward_only(false);
+  Net<Dtype> trained_net(trained_param);
+  trained_net.ToProto(&trained_param, true);
+  net.CopyTrainedLayersFrom(trained_param);
+  EXPECT_TRUE(net.layer_by_name("ip")->blobs()[0]->diff_disabled());
+}
+
+TYPED_TEST(NetTest, TestParamStorage) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string proto =
+      "name: 'ParamStorageNetwork' "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 3 dim: 6 dim: 6 } "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "  param { name: 'convweights' } "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    algorithm: DIRECT "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "    bias_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv2' "
+      "  param { name: 'convweights' } "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    bias_term: false "
+      "    algorithm: WINOGRAD_2X2 "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'conv1' "
+      "  top: 'ip' "
+      "  inner_product_param { "
+      "    num_output: 5 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "} ";
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> input(2, 3, 6, 6);
+  filler.Fill(&input);
+  const StoragePrecision precisions[] = {NATIVE, FP16, BF16};
+  // The relative precision of the packed weights
+  const Dtype epsilons[] = {0, 1e-3, 1e-2};
+  // The packed weights are read by DIRECT, Winograd and GEMM.
+  const char* output_names[] = {"conv2", "ip"};
+  vector<shared_ptr<Blob<Dtype> > > outputs[2];
+  for (int i = 0; i < 3; ++i) {
+    Caffe::set_random_seed(this->seed_);
+    this->InitNetFromProtoString(proto + "param_storage: " +
+        StoragePrecision_Name(precisions[i]));
+    EXPECT_EQ(precisions[i], this->net_->param_storage());
+    Blob<Dtype>* input_blob = this->net_->input_blobs()[0];
+    caffe_copy(input.count(), input.cpu_data(),
+        input_blob->mutable_cpu_data());
+    this->net_->ForwardPrefilled();
+    for (int k = 0; k < 2; ++k) {
+      outputs[k].push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      outputs[k][i]->CopyFrom(*this->net_->blob_by_name(output_names[k]),
+          false, true);
+    }
+    const vector<shared_ptr<Blob<Dtype> > >& conv1_blobs =
+        this->net_->layer_by_name("conv1")->blobs();
+    const vector<shared_ptr<Blob<Dtype> > >& conv2_blobs =
+        this->net_->layer_by_name("conv2")->blobs();
+    const vector<shared_ptr<Blob<Dtype> > >& ip_blobs =
+        this->net_->layer_by_name("ip")->blobs();
+    EXPECT_EQ(precisions[i], conv1_blobs[0]->storage_precision());
+    EXPECT_EQ(precisions[i], conv2_blobs[0]->storage_precision());
+    EXPECT_EQ(precisions[i], ip_blobs[0]->storage_precision());
+    // The biases are read unpacked.
+    EXPECT_EQ(NATIVE, conv1_blobs[1]->storage_precision());
+    EXPECT_EQ(NATIVE, ip_blobs[1]->storage_precision());
+    if (precisions[i] != NATIVE && Caffe::mode() == Caffe::CPU) {
+      // The weights are only held packed.
+      EXPECT_EQ(SyncedMemory::UNINITIALIZED,
+          conv1_blobs[0]->data()->head());
+      EXPECT_EQ(SyncedMemory::UNINITIALIZED, ip_blobs[0]->data()->head());
+    }
+    for (int k = 0; k < 2; ++k) {
+      ASSERT_EQ(outputs[k][0]->count(), outputs[k][i]->count());
+      for (int j = 0; j < outputs[k][0]->count(); ++j) {
+        const Dtype expected = outputs[k][0]->cpu_data()[j];
+        EXPECT_NEAR(expected, outputs[k][i]->cpu_data()[j],
+            epsilons[i] * std::max(Dtype(1), std::fabs(expected)));
+      }
+    }
+    // Weights written to are packed again by the next Forward.
+    caffe_scal(ip_blobs[0]->count(), Dtype(2),
+        ip_blobs[0]->mutable_cpu_data());
+    EXPECT_EQ(NATIVE, ip_blobs[0]->storage_precision());
+    this->net_->ForwardPrefilled();
+    EXPECT_EQ(precisions[i], ip_blobs[0]->storage_precision());
+  }
+}
+
+TYPED_TEST(NetTest, TestChannelBlock) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string proto =
+      "name: 'ChannelBlockNetwork' "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 8 dim: 6 dim: 6 } "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "  convolution_param { "
+      "    num_output: 16 "
+      "    kernel_size: 3 "
+      "    pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "    bias_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'pool1' "
+      "  type: 'Pooling' "
+      "  bottom: 'conv1' "
+      "  top: 'pool1' "
+      "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  bottom: 'pool1' "
+      "  top: 'conv2' "
+      "  convolution_param { "
+      "    num_output: 16 "
+      "    kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'sum' "
+      "  type: 'Eltwise' "
+      "  bottom: 'pool1' "
+      "  bottom: 'conv2' "
+      "  top: 'sum' "
+      "} "
+      "layer { "
+      "  name: 'concat' "
+      "  type: 'Concat' "
+      "  bottom: 'pool1' "
+      "  bottom: 'sum' "
+      "  top: 'concat' "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'concat' "
+      "  top: 'ip' "
+      "  inner_product_param { "
+      "    num_output: 5 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'pool2' "
+      "  type: 'Pooling' "
+      "  bottom: 'concat' "
+      "  top: 'pool2' "
+      "  pooling_param { pool: AVE kernel_size: 3 } "
+      "} ";
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> input(2, 8, 6, 6);
+  filler.Fill(&input);
+  const char* output_names[] = {"ip", "pool2"};
+  const int blocks[] = {0, 16};
+  vector<shared_ptr<Blob<Dtype> > > outputs[2];
+  for (int b = 0; b < 2; ++b) {
+    Caffe::set_random_seed(this->seed_);
+    this->InitNetFromProtoString(proto + "channel_block: " +
+        format_int(blocks[b]));
+    EXPECT_EQ(blocks[b], this->net_->channel_block());
+    Blob<Dtype>* input_blob = this->net_->input_blobs()[0];
+    caffe_copy(input.count(), input.cpu_data(),
+        input_blob->mutable_cpu_data());
+    this->net_->ForwardPrefilled();
+    for (int i = 0; i < 2; ++i) {
+      outputs[b].push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      outputs[b][i]->CopyFrom(*this->net_->blob_by_name(output_names[i]),
+          false, true);
+      // The outputs are in NCHW.
+      EXPECT_EQ(0, this->net_->blob_by_name(output_names[i])->channel_block());
+    }
+    if (Caffe::mode() == Caffe::CPU) {
+      EXPECT_EQ(blocks[b], this->net_->blob_by_name("sum")->channel_block());
+    }
+  }
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_EQ(outputs[0][i]->count(), outputs[1][i]->count());
+    for (int j = 0; j < outputs[0][i]->count(); ++j) {
+      EXPECT_NEAR(outputs[0][i]->cpu_data()[j], outputs[1][i]->cpu_data()[j],
+          1e-4);
+    }
+  }
+  // Nets that train keep NCHW.
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto +
+      "channel_block: 16 force_backward: true", &param));
+  Net<Dtype> train_net(param);
+  EXPECT_EQ(0, train_net.channel_block());
+}
+
+TYPED_TEST(NetTest, TestConvAlgorithm) {
+  const string proto =
+      "name: 'ConvAlgorithmNetwork' "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 3 dim: 6 dim: 6 } "
+      "conv_algorithm: GEMM "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  bottom: 'conv1' "
+      "  top: 'conv2' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    algorithm: WINOGRAD_2X2 "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv2' "
+      "  top: 'conv2' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  // The layers without their own algorithm take the net's.
+  EXPECT_EQ(ConvolutionParameter_Algorithm_GEMM, this->net_->layer_by_name(
+      "conv1")->layer_param().convolution_param().algorithm());
+  EXPECT_EQ(ConvolutionParameter_Algorithm_WINOGRAD_2X2,
+      this->net_->layer_by_name("conv2")->layer_param()
+          .convolution_param().algorithm());
+  EXPECT_FALSE(this->net_->layer_by_name("relu")->layer_param()
+      .has_convolution_param());
+}
+
 }  // namespace caffe
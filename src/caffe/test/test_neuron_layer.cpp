@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "google/protobuf/text_format.h"
@@ -335,6 +336,42 @@ TYPED_TEST(NeuronLayerTest, TestSigmoid) {
   }
 }
 
+TYPED_TEST(NeuronLayerTest, TestFastMathAccuracy) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_elu_param()->set_alpha(0.5);
+  LayerParameter fast_layer_param(layer_param);
+  fast_layer_param.set_math_accuracy(FAST);
+  vector<shared_ptr<Layer<Dtype> > > layers, fast_layers;
+  layers.push_back(shared_ptr<Layer<Dtype> >(
+      new SigmoidLayer<Dtype>(layer_param)));
+  fast_layers.push_back(shared_ptr<Layer<Dtype> >(
+      new SigmoidLayer<Dtype>(fast_layer_param)));
+  layers.push_back(shared_ptr<Layer<Dtype> >(
+      new TanHLayer<Dtype>(layer_param)));
+  fast_layers.push_back(shared_ptr<Layer<Dtype> >(
+      new TanHLayer<Dtype>(fast_layer_param)));
+  layers.push_back(shared_ptr<Layer<Dtype> >(
+      new ELULayer<Dtype>(layer_param)));
+  fast_layers.push_back(shared_ptr<Layer<Dtype> >(
+      new ELULayer<Dtype>(fast_layer_param)));
+  // The exact ELU loses the digits of exp(x) - 1 near 0, hence the absolute
+  // error allowed.
+  Blob<Dtype> top;
+  for (int l = 0; l < layers.size(); ++l) {
+    layers[l]->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layers[l]->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    top.CopyFrom(*this->blob_top_, false, true);
+    fast_layers[l]->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    fast_layers[l]->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < top.count(); ++i) {
+      EXPECT_NEAR(this->blob_top_->cpu_data()[i], top.cpu_data()[i],
+          (std::fabs(top.cpu_data()[i]) + 1) * 1e-6)
+          << fast_layers[l]->type();
+    }
+  }
+}
+
 TYPED_TEST(NeuronLayerTest, TestSigmoidGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -0,0 +1,100 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/parallel.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ParallelTest : public ::testing::Test {
+ protected:
+  ParallelTest() : num_threads_(Caffe::num_threads()) {}
+  virtual ~ParallelTest() { Caffe::set_num_threads(num_threads_); }
+
+  const int num_threads_;
+};
+
+// Counts the calls of each item, and records the ranges.
+class CountItems {
+ public:
+  CountItems(vector<int>* counts, vector<int>* range_sizes)
+      : counts_(counts), range_sizes_(range_sizes) {}
+
+  void operator()(const int begin, const int end) const {
+    EXPECT_LT(begin, end);
+    for (int i = begin; i < end; ++i) {
+      ++(*counts_)[i];
+    }
+    // Each range writes at its beginning, so threads never share an item.
+    (*range_sizes_)[begin] = end - begin;
+  }
+
+ private:
+  vector<int>* counts_;
+  vector<int>* range_sizes_;
+};
+
+TEST_F(ParallelTest, TestCoversRange) {
+  const int sizes[] = {0, 1, 7, 1000, 100003};
+  const int grains[] = {1, 3, 1000};
+  Caffe::set_num_threads(4);
+  for (int s = 0; s < 5; ++s) {
+    for (int g = 0; g < 3; ++g) {
+      const int n = sizes[s];
+      vector<int> counts(n, 0), range_sizes(n, 0);
+      parallel_for(n, CountItems(&counts, &range_sizes), grains[g]);
+      int ranges = 0;
+      for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(1, counts[i]) << "n = " << n << ", item " << i;
+        if (range_sizes[i]) {
+          ++ranges;
+          // Ranges shorter than the grain only when one covers everything.
+          EXPECT_TRUE(range_sizes[i] >= grains[g] || range_sizes[i] == n);
+        }
+      }
+      EXPECT_EQ(n ? parallel_threads(n, grains[g]) : 0, ranges);
+    }
+  }
+}
+
+TEST_F(ParallelTest, TestThreads) {
+  Caffe::set_num_threads(4);
+  EXPECT_EQ(1, parallel_threads(10, 100));
+  EXPECT_EQ(1, parallel_threads(0, 1));
+  Caffe::set_num_threads(1);
+  EXPECT_EQ(1, parallel_threads(1000000, 1));
+#ifdef _OPENMP
+  Caffe::set_num_threads(4);
+  EXPECT_EQ(2, parallel_threads(200, 100));
+  EXPECT_EQ(4, parallel_threads(1000000, 1));
+#endif
+}
+
+// Records the threads of loops inside the ranges of another.
+class NestedThreads {
+ public:
+  explicit NestedThreads(vector<int>* threads) : threads_(threads) {}
+
+  void operator()(const int begin, const int end) const {
+    for (int i = begin; i < end; ++i) {
+      (*threads_)[i] = parallel_threads(1000000, 1);
+    }
+  }
+
+ private:
+  vector<int>* threads_;
+};
+
+TEST_F(ParallelTest, TestNested) {
+  Caffe::set_num_threads(4);
+  vector<int> threads(8, 0);
+  parallel_for(threads.size(), NestedThreads(&threads));
+  for (int i = 0; i < threads.size(); ++i) {
+    EXPECT_EQ(1, threads[i]);
+  }
+}
+
+}  // namespace caffe
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cfloat>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -6,6 +8,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/pooling_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_pooling_layer.hpp"
@@ -475,6 +478,113 @@ TYPED_TEST(PoolingLayerTest, TestGradientMax) {
   }
 }
 
+// The unrolled kernels of 2x2 and 3x3 windows of stride 2, whose windows at
+// the borders are pooled as others, and the masks of large windows.
+TYPED_TEST(PoolingLayerTest, TestForwardBackwardKernels) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int kernels[][3] = {{2, 2, 0}, {2, 2, 1}, {3, 2, 0}, {3, 2, 1},
+      {17, 1, 0}};
+  const PoolingParameter_PoolMethod methods[] = {
+      PoolingParameter_PoolMethod_MAX, PoolingParameter_PoolMethod_AVE};
+  this->blob_bottom_->Reshape(2, 3, 19, 18);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  const int height = this->blob_bottom_->height();
+  const int width = this->blob_bottom_->width();
+  for (int k = 0; k < 5; ++k) {
+    for (int m = 0; m < 2; ++m) {
+      for (int top_mask = 0; top_mask <= (m == 0); ++top_mask) {
+        const int kernel = kernels[k][0];
+        const int stride = kernels[k][1];
+        const int pad = kernels[k][2];
+        LayerParameter layer_param;
+        PoolingParameter* pooling_param =
+            layer_param.mutable_pooling_param();
+        pooling_param->set_kernel_size(kernel);
+        pooling_param->set_stride(stride);
+        pooling_param->set_pad(pad);
+        pooling_param->set_pool(methods[m]);
+        this->blob_top_vec_.resize(1);
+        if (top_mask) {
+          this->blob_top_vec_.push_back(this->blob_top_mask_);
+        }
+        PoolingLayer<Dtype> layer(layer_param);
+        layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+        layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+        const int pooled_height = this->blob_top_->height();
+        const int pooled_width = this->blob_top_->width();
+        Blob<Dtype> bottom_diff;
+        bottom_diff.ReshapeLike(*this->blob_bottom_);
+        caffe_set(bottom_diff.count(), Dtype(0),
+            bottom_diff.mutable_cpu_data());
+        Dtype* top_diff = this->blob_top_->mutable_cpu_diff();
+        for (int i = 0; i < this->blob_top_->count(); ++i) {
+          top_diff[i] = i % 7 + 1;
+        }
+        for (int c = 0; c < 6; ++c) {
+          const Dtype* bottom = this->blob_bottom_->cpu_data() +
+              c * height * width;
+          Dtype* expected_diff = bottom_diff.mutable_cpu_data() +
+              c * height * width;
+          for (int ph = 0; ph < pooled_height; ++ph) {
+            for (int pw = 0; pw < pooled_width; ++pw) {
+              const int hstart = ph * stride - pad;
+              const int wstart = pw * stride - pad;
+              const int pool_size =
+                  (std::min(hstart + kernel, height + pad) - hstart) *
+                  (std::min(wstart + kernel, width + pad) - wstart);
+              const int top_index = (c * pooled_height + ph) *
+                  pooled_width + pw;
+              Dtype expected = m == 0 ? Dtype(-FLT_MAX) : Dtype(0);
+              int argmax = -1;
+              for (int h = std::max(hstart, 0);
+                   h < std::min(hstart + kernel, height); ++h) {
+                for (int w = std::max(wstart, 0);
+                     w < std::min(wstart + kernel, width); ++w) {
+                  if (m == 1) {
+                    expected += bottom[h * width + w];
+                  } else if (bottom[h * width + w] > expected) {
+                    expected = bottom[h * width + w];
+                    argmax = h * width + w;
+                  }
+                }
+              }
+              if (m == 1) {
+                expected /= pool_size;
+                for (int h = std::max(hstart, 0);
+                     h < std::min(hstart + kernel, height); ++h) {
+                  for (int w = std::max(wstart, 0);
+                       w < std::min(wstart + kernel, width); ++w) {
+                    expected_diff[h * width + w] +=
+                        top_diff[top_index] / pool_size;
+                  }
+                }
+              } else {
+                expected_diff[argmax] += top_diff[top_index];
+                if (top_mask) {
+                  EXPECT_EQ(argmax, this->blob_top_mask_->cpu_data()[
+                      top_index]);
+                }
+              }
+              EXPECT_NEAR(expected, this->blob_top_->cpu_data()[top_index],
+                  1e-5) << "kernel " << kernel << " pad " << pad;
+            }
+          }
+        }
+        vector<bool> propagate_down(1, true);
+        layer.Backward(this->blob_top_vec_, propagate_down,
+            this->blob_bottom_vec_);
+        for (int i = 0; i < bottom_diff.count(); ++i) {
+          EXPECT_NEAR(bottom_diff.cpu_data()[i],
+              this->blob_bottom_->cpu_diff()[i], 1e-5)
+              << "kernel " << kernel << " pad " << pad;
+        }
+      }
+    }
+  }
+}
+
 TYPED_TEST(PoolingLayerTest, TestForwardMaxPadded) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -609,6 +719,51 @@ TYPED_TEST(PoolingLayerTest, TestGradientAvePadded) {
   }
 }
 
+TYPED_TEST(PoolingLayerTest, TestForwardNCHWc) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  Blob<Dtype> bottom(2, 8, 7, 6);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&bottom);
+  Blob<Dtype> blocked_bottom;
+  blocked_bottom.CopyFrom(bottom, false, true);
+  blocked_bottom.ReorderChannelBlock(4);
+  vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+  vector<Blob<Dtype>*> blocked_bottom_vec(1, &blocked_bottom);
+  Blob<Dtype> blocked_top;
+  vector<Blob<Dtype>*> blocked_top_vec(1, &blocked_top);
+  const PoolingParameter_PoolMethod methods[] = {
+    PoolingParameter_PoolMethod_MAX, PoolingParameter_PoolMethod_AVE
+  };
+  for (int m = 0; m < 2; ++m) {
+    for (int pad = 0; pad <= 1; ++pad) {
+      LayerParameter layer_param;
+      PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+      pooling_param->set_kernel_size(3);
+      pooling_param->set_stride(2);
+      pooling_param->set_pad(pad);
+      pooling_param->set_pool(methods[m]);
+      PoolingLayer<Dtype> layer(layer_param);
+      layer.SetUp(bottom_vec, this->blob_top_vec_);
+      layer.Forward(bottom_vec, this->blob_top_vec_);
+      PoolingLayer<Dtype> blocked_layer(layer_param);
+      blocked_layer.SetUp(blocked_bottom_vec, blocked_top_vec);
+      EXPECT_TRUE(blocked_layer.SupportsChannelBlock(blocked_bottom_vec, 4));
+      blocked_layer.Forward(blocked_bottom_vec, blocked_top_vec);
+      blocked_top.set_channel_block(4);
+      blocked_top.ReorderChannelBlock(0);
+      ASSERT_EQ(this->blob_top_->count(), blocked_top.count());
+      for (int i = 0; i < blocked_top.count(); ++i) {
+        EXPECT_NEAR(this->blob_top_->cpu_data()[i], blocked_top.cpu_data()[i],
+            1e-6);
+      }
+    }
+  }
+}
+
 #ifdef USE_CUDNN
 template <typename Dtype>
 class CuDNNPoolingLayerTest : public GPUDeviceTest<Dtype> {
@@ -0,0 +1,78 @@
+#include <stdint.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/quantize.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class QuantizeTest : public ::testing::Test {};
+
+TYPED_TEST_CASE(QuantizeTest, TestDtypes);
+
+TYPED_TEST(QuantizeTest, TestQuantize) {
+  const TypeParam x[] = {0, 0.5, -0.5, 1.49, 1.51, -126.6, 127, 200, -1000};
+  const int8_t expected[] = {0, 1, -1, 1, 2, -127, 127, 127, -127};
+  const int n = sizeof(x) / sizeof(x[0]);
+  int8_t y[n];
+  caffe_cpu_quantize(n, x, TypeParam(1), y);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(expected[i], y[i]);
+  }
+  EXPECT_EQ(TypeParam(1000), caffe_cpu_amax(n, x));
+  EXPECT_EQ(TypeParam(2), int8_scale(TypeParam(254)));
+  EXPECT_EQ(TypeParam(1), int8_scale(TypeParam(0)));
+  TypeParam z[n];
+  caffe_cpu_dequantize(n, y, TypeParam(0.5), z);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(TypeParam(y[i]) / 2, z[i]);
+  }
+}
+
+class GemmInt8Test : public ::testing::Test {
+ protected:
+  // Compares both forms of caffe_cpu_gemm_int8 with the plain products.
+  void CheckGemm(const int M, const int N, const int K) {
+    vector<int8_t> A(M * K), B(K * N), B_trans(N * K);
+    for (int i = 0; i < M * K; ++i) {
+      A[i] = static_cast<int8_t>((i * 37) % 255 - 127);
+    }
+    for (int k = 0; k < K; ++k) {
+      for (int j = 0; j < N; ++j) {
+        B[k * N + j] = B_trans[j * K + k] =
+            static_cast<int8_t>(((k * N + j) * 53) % 255 - 127);
+      }
+    }
+    vector<int32_t> C(M * N), C_trans(M * N);
+    caffe_cpu_gemm_int8(CblasNoTrans, M, N, K, &A[0], &B[0], &C[0]);
+    caffe_cpu_gemm_int8(CblasTrans, M, N, K, &A[0], &B_trans[0],
+        &C_trans[0]);
+    for (int i = 0; i < M; ++i) {
+      for (int j = 0; j < N; ++j) {
+        int32_t sum = 0;
+        for (int k = 0; k < K; ++k) {
+          sum += A[i * K + k] * B[k * N + j];
+        }
+        EXPECT_EQ(sum, C[i * N + j]);
+        EXPECT_EQ(sum, C_trans[i * N + j]);
+      }
+    }
+  }
+};
+
+TEST_F(GemmInt8Test, TestGemm) {
+  // Odd sizes exercise the remainders of the unrolled loops.
+  CheckGemm(3, 5, 7);
+}
+
+TEST_F(GemmInt8Test, TestGemmBlocks) {
+  // Several blocks of B along both N and K, the last ones partial.
+  CheckGemm(3, 300, 600);
+}
+
+}  // namespace caffe
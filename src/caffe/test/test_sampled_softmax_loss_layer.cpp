@@ -0,0 +1,136 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/layers/sampled_softmax_loss_layer.hpp"
+#include "caffe/layers/softmax_loss_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class SampledSoftmaxLossLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  SampledSoftmaxLossLayerTest()
+      : blob_bottom_data_(new Blob<Dtype>(6, 4, 1, 1)),
+        blob_bottom_label_(new Blob<Dtype>(6, 1, 1, 1)),
+        blob_top_loss_(new Blob<Dtype>()) {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_data_);
+    blob_bottom_vec_.push_back(blob_bottom_data_);
+    for (int i = 0; i < blob_bottom_label_->count(); ++i) {
+      blob_bottom_label_->mutable_cpu_data()[i] = caffe_rng_rand() % 20;
+    }
+    blob_bottom_vec_.push_back(blob_bottom_label_);
+    blob_top_vec_.push_back(blob_top_loss_);
+  }
+  virtual ~SampledSoftmaxLossLayerTest() {
+    delete blob_bottom_data_;
+    delete blob_bottom_label_;
+    delete blob_top_loss_;
+  }
+
+  LayerParameter layer_param(const SampledSoftmaxParameter_Loss loss) {
+    LayerParameter layer_param;
+    InnerProductParameter* ip_param =
+        layer_param.mutable_inner_product_param();
+    ip_param->set_num_output(20);
+    ip_param->mutable_weight_filler()->set_type("gaussian");
+    ip_param->mutable_bias_filler()->set_type("gaussian");
+    layer_param.mutable_sampled_softmax_param()->set_num_sampled(8);
+    layer_param.mutable_sampled_softmax_param()->set_loss(loss);
+    return layer_param;
+  }
+
+  Blob<Dtype>* const blob_bottom_data_;
+  Blob<Dtype>* const blob_bottom_label_;
+  Blob<Dtype>* const blob_top_loss_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(SampledSoftmaxLossLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(SampledSoftmaxLossLayerTest, TestSetUp) {
+  typedef typename TypeParam::Dtype Dtype;
+  SampledSoftmaxLossLayer<Dtype> layer(
+      this->layer_param(SampledSoftmaxParameter_Loss_SOFTMAX));
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_EQ(layer.blobs().size(), 2);
+  EXPECT_EQ(layer.blobs()[0]->num(), 20);
+  EXPECT_EQ(layer.blobs()[0]->channels(), 4);
+  EXPECT_EQ(layer.blobs()[1]->count(), 20);
+  EXPECT_EQ(this->blob_top_loss_->num_axes(), 0);
+}
+
+// In the TEST phase, the loss is that of an InnerProductLayer with the same
+// weights followed by a SoftmaxWithLossLayer.
+TYPED_TEST(SampledSoftmaxLossLayerTest, TestForwardTestPhase) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param =
+      this->layer_param(SampledSoftmaxParameter_Loss_SOFTMAX);
+  layer_param.set_phase(TEST);
+  SampledSoftmaxLossLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype loss = this->blob_top_loss_->cpu_data()[0];
+  InnerProductLayer<Dtype> ip_layer(layer_param);
+  Blob<Dtype> ip_top;
+  vector<Blob<Dtype>*> ip_top_vec(1, &ip_top);
+  ip_layer.blobs() = layer.blobs();
+  ip_layer.SetUp(vector<Blob<Dtype>*>(1, this->blob_bottom_data_),
+      ip_top_vec);
+  ip_layer.Forward(vector<Blob<Dtype>*>(1, this->blob_bottom_data_),
+      ip_top_vec);
+  SoftmaxWithLossLayer<Dtype> softmax_loss_layer(layer_param);
+  vector<Blob<Dtype>*> softmax_bottom_vec;
+  softmax_bottom_vec.push_back(&ip_top);
+  softmax_bottom_vec.push_back(this->blob_bottom_label_);
+  softmax_loss_layer.SetUp(softmax_bottom_vec, this->blob_top_vec_);
+  softmax_loss_layer.Forward(softmax_bottom_vec, this->blob_top_vec_);
+  EXPECT_NEAR(loss, this->blob_top_loss_->cpu_data()[0], 1e-5);
+}
+
+TYPED_TEST(SampledSoftmaxLossLayerTest, TestGradientSoftmax) {
+  typedef typename TypeParam::Dtype Dtype;
+  SampledSoftmaxLossLayer<Dtype> layer(
+      this->layer_param(SampledSoftmaxParameter_Loss_SOFTMAX));
+  GradientChecker<Dtype> checker(1e-2, 1e-2, 1701);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+}
+
+TYPED_TEST(SampledSoftmaxLossLayerTest, TestGradientNCE) {
+  typedef typename TypeParam::Dtype Dtype;
+  SampledSoftmaxLossLayer<Dtype> layer(
+      this->layer_param(SampledSoftmaxParameter_Loss_NCE));
+  GradientChecker<Dtype> checker(1e-2, 1e-2, 1701);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+}
+
+TYPED_TEST(SampledSoftmaxLossLayerTest, TestGradientUniformIgnoreLabel) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param =
+      this->layer_param(SampledSoftmaxParameter_Loss_SOFTMAX);
+  layer_param.mutable_sampled_softmax_param()->set_sampler(
+      SampledSoftmaxParameter_Sampler_UNIFORM);
+  layer_param.mutable_loss_param()->set_ignore_label(-1);
+  this->blob_bottom_label_->mutable_cpu_data()[2] = -1;
+  SampledSoftmaxLossLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2, 1701);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+}
+
+}  // namespace caffe
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cmath>
 #include <vector>
 
@@ -7,6 +8,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/softmax_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_softmax_layer.hpp"
@@ -74,6 +76,24 @@ TYPED_TEST(SoftmaxLayerTest, TestForward) {
   }
 }
 
+TYPED_TEST(SoftmaxLayerTest, TestForwardFastMath) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  SoftmaxLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> top;
+  top.CopyFrom(*this->blob_top_, false, true);
+  layer_param.set_math_accuracy(FAST);
+  SoftmaxLayer<Dtype> fast_layer(layer_param);
+  fast_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  fast_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < top.count(); ++i) {
+    EXPECT_NEAR(this->blob_top_->cpu_data()[i], top.cpu_data()[i],
+        top.cpu_data()[i] * 1e-5);
+  }
+}
+
 TYPED_TEST(SoftmaxLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -83,6 +103,57 @@ TYPED_TEST(SoftmaxLayerTest, TestGradient) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(SoftmaxLayerTest, TestForwardBackwardShapes) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Rows of many channels, and planes of more than one tile.
+  const int shapes[][4] = {{3, 1000, 1, 1}, {2, 5, 17, 17}};
+  for (int s = 0; s < 2; ++s) {
+    this->blob_bottom_->Reshape(shapes[s][0], shapes[s][1], shapes[s][2],
+        shapes[s][3]);
+    FillerParameter filler_param;
+    filler_param.set_std(5);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    LayerParameter layer_param;
+    SoftmaxLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    filler.Fill(this->blob_top_);
+    caffe_copy(this->blob_top_->count(), this->blob_top_->cpu_data(),
+        this->blob_top_->mutable_cpu_diff());
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    vector<bool> propagate_down(1, true);
+    layer.Backward(this->blob_top_vec_, propagate_down,
+        this->blob_bottom_vec_);
+    const Blob<Dtype>& bottom = *this->blob_bottom_;
+    const Blob<Dtype>& top = *this->blob_top_;
+    for (int n = 0; n < bottom.num(); ++n) {
+      for (int h = 0; h < bottom.height(); ++h) {
+        for (int w = 0; w < bottom.width(); ++w) {
+          double max_value = bottom.data_at(n, 0, h, w);
+          for (int c = 1; c < bottom.channels(); ++c) {
+            max_value = std::max<double>(max_value, bottom.data_at(n, c, h, w));
+          }
+          double sum = 0;
+          double dot = 0;
+          for (int c = 0; c < bottom.channels(); ++c) {
+            sum += exp(bottom.data_at(n, c, h, w) - max_value);
+            dot += top.diff_at(n, c, h, w) * top.data_at(n, c, h, w);
+          }
+          for (int c = 0; c < bottom.channels(); ++c) {
+            const double prob = exp(bottom.data_at(n, c, h, w) - max_value) /
+                sum;
+            EXPECT_NEAR(top.data_at(n, c, h, w), prob, 1e-5 * prob + 1e-20);
+            EXPECT_NEAR(bottom.diff_at(n, c, h, w),
+                top.data_at(n, c, h, w) * (top.diff_at(n, c, h, w) - dot),
+                1e-5);
+          }
+        }
+      }
+    }
+  }
+}
+
 #ifdef USE_CUDNN
 template <typename Dtype>
 class CuDNNSoftmaxLayerTest : public GPUDeviceTest<Dtype> {
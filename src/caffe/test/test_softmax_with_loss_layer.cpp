@@ -95,6 +95,41 @@ TYPED_TEST(SoftmaxWithLossLayerTest, TestGradientIgnoreLabel) {
       this->blob_top_vec_, 0);
 }
 
+TYPED_TEST(SoftmaxWithLossLayerTest, TestBackwardIgnoreLabelNotChannel) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  // The ignored label is not one of the 5 channels, as the 255 of the
+  // unlabeled pixels in segmentation.
+  layer_param.mutable_loss_param()->set_ignore_label(255);
+  Dtype* label = this->blob_bottom_label_->mutable_cpu_data();
+  for (int i = 0; i < this->blob_bottom_label_->count(); i += 3) {
+    label[i] = 255;
+  }
+  SoftmaxWithLossLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  this->blob_top_loss_->mutable_cpu_diff()[0] = 1;
+  vector<bool> propagate_down(2, false);
+  propagate_down[0] = true;
+  layer.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+  // The gradient is 0 at the ignored labels, and sums to 0 over the
+  // channels of the others.
+  const Dtype* bottom_diff = this->blob_bottom_data_->cpu_diff();
+  const int inner_num = 6;
+  for (int i = 0; i < this->blob_bottom_label_->count(); ++i) {
+    const int n = i / inner_num, j = i % inner_num;
+    Dtype sum = 0;
+    for (int c = 0; c < 5; ++c) {
+      const Dtype diff = bottom_diff[(n * 5 + c) * inner_num + j];
+      if (i % 3 == 0) {
+        EXPECT_EQ(0, diff);
+      }
+      sum += diff;
+    }
+    EXPECT_NEAR(0, sum, 1e-6);
+  }
+}
+
 TYPED_TEST(SoftmaxWithLossLayerTest, TestGradientUnnormalized) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
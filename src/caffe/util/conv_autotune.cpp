@@ -0,0 +1,110 @@
+#include <boost/thread.hpp>
+#include <fstream>  // NOLINT(readability/streams)
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "caffe/util/conv_autotune.hpp"
+
+namespace caffe {
+
+// The cache and the file it was read from, shared by all the threads.
+static boost::mutex autotune_mutex_;
+static string autotune_path_;
+static bool autotune_loaded_ = false;
+static std::map<string, ConvolutionParameter_Algorithm> autotune_entries_;
+
+// Read the entries of the file, if any; the caller holds the mutex.
+static void LoadEntries() {
+  autotune_loaded_ = true;
+  if (autotune_path_.empty()) {
+    return;
+  }
+  std::ifstream file(autotune_path_.c_str());
+  string line;
+  while (std::getline(file, line)) {
+    const size_t separator = line.rfind(' ');
+    ConvolutionParameter_Algorithm algorithm;
+    if (separator == string::npos || !ConvolutionParameter_Algorithm_Parse(
+        line.substr(separator + 1), &algorithm)) {
+      LOG(WARNING) << "Skipping malformed line of the convolution autotuning "
+          << "cache " << autotune_path_ << ": " << line;
+      continue;
+    }
+    autotune_entries_[line.substr(0, separator)] = algorithm;
+  }
+}
+
+bool ConvAutotuneCache::Lookup(const string& key,
+    ConvolutionParameter_Algorithm* algorithm) {
+  boost::mutex::scoped_lock lock(autotune_mutex_);
+  if (!autotune_loaded_) {
+    LoadEntries();
+  }
+  std::map<string, ConvolutionParameter_Algorithm>::const_iterator it =
+      autotune_entries_.find(key);
+  if (it == autotune_entries_.end()) {
+    return false;
+  }
+  *algorithm = it->second;
+  return true;
+}
+
+void ConvAutotuneCache::Insert(const string& key,
+    const ConvolutionParameter_Algorithm algorithm) {
+  boost::mutex::scoped_lock lock(autotune_mutex_);
+  if (!autotune_loaded_) {
+    LoadEntries();
+  }
+  autotune_entries_[key] = algorithm;
+  if (autotune_path_.empty()) {
+    return;
+  }
+  std::ofstream file(autotune_path_.c_str(), std::ios::app);
+  file << key << " " << ConvolutionParameter_Algorithm_Name(algorithm)
+      << std::endl;
+  if (!file) {
+    LOG(WARNING) << "Cannot write the convolution autotuning cache "
+        << autotune_path_;
+  }
+}
+
+void ConvAutotuneCache::Clear() {
+  boost::mutex::scoped_lock lock(autotune_mutex_);
+  autotune_entries_.clear();
+  autotune_loaded_ = false;
+}
+
+string ConvAutotuneCache::MachineKey() {
+  string cpu = "unknown";
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.compare(0, 10, "model name") == 0) {
+      const size_t colon = line.find(':');
+      if (colon != string::npos && colon + 2 < line.size()) {
+        cpu = line.substr(colon + 2);
+      }
+      break;
+    }
+  }
+  std::ostringstream key;
+  key << "threads " << Caffe::num_threads() << " cpu " << cpu;
+  return key.str();
+}
+
+string ConvAutotuneCache::path() {
+  boost::mutex::scoped_lock lock(autotune_mutex_);
+  return autotune_path_;
+}
+
+void ConvAutotuneCache::set_path(const string& path) {
+  boost::mutex::scoped_lock lock(autotune_mutex_);
+  if (path != autotune_path_) {
+    autotune_path_ = path;
+    autotune_entries_.clear();
+    autotune_loaded_ = false;
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,194 @@
+#include <algorithm>
+
+#include "caffe/util/direct_conv.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// Computes the range [begin, end) of the outputs whose input at a kernel
+// offset lies within [0, input), i.e., not in the padding.
+inline void direct_conv_range(const int input, const int output,
+    const int pad, const int stride, const int offset, int* begin,
+    int* end) {
+  const int low = pad - offset;
+  const int high = input - 1 + pad - offset;
+  *begin = low <= 0 ? 0 : (low + stride - 1) / stride;
+  *end = high < 0 ? 0 : std::min(output, high / stride + 1);
+  *end = std::max(*begin, *end);
+}
+
+template <typename Dtype>
+void conv_direct_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const Dtype* weights,
+    const int num_output, const int group, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    Dtype* data_out) {
+  const int output_h = (height + 2 * pad_h -
+      (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+  const int output_w = (width + 2 * pad_w -
+      (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+  const int group_channels = channels / group;
+  const int group_output = num_output / group;
+  caffe_set(num_output * output_h * output_w, Dtype(0), data_out);
+  for (int o = 0; o < num_output; ++o) {
+    Dtype* out = data_out + o * output_h * output_w;
+    const int first_channel = (o / group_output) * group_channels;
+    for (int c = 0; c < group_channels; ++c) {
+      const Dtype* im = data_im + (first_channel + c) * height * width;
+      const Dtype* weight = weights + (o * group_channels + c) * kernel_h *
+          kernel_w;
+      for (int kh = 0; kh < kernel_h; ++kh) {
+        int h_begin, h_end;
+        direct_conv_range(height, output_h, pad_h, stride_h, kh * dilation_h,
+            &h_begin, &h_end);
+        for (int kw = 0; kw < kernel_w; ++kw) {
+          int w_begin, w_end;
+          direct_conv_range(width, output_w, pad_w, stride_w, kw * dilation_w,
+              &w_begin, &w_end);
+          const int w_offset = kw * dilation_w - pad_w;
+          const Dtype value = weight[kh * kernel_w + kw];
+          for (int h = h_begin; h < h_end; ++h) {
+            const Dtype* in_row = im + (h * stride_h - pad_h + kh * dilation_h)
+                * width;
+            Dtype* out_row = out + h * output_w;
+            for (int w = w_begin; w < w_end; ++w) {
+              out_row[w] += value * in_row[w * stride_w + w_offset];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+template void conv_direct_cpu<float>(const float* data_im,
+    const int channels, const int height, const int width,
+    const float* weights, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, float* data_out);
+template void conv_direct_cpu<double>(const double* data_im,
+    const int channels, const int height, const int width,
+    const double* weights, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, double* data_out);
+
+template <typename Dtype>
+void conv_direct_backward_cpu(const Dtype* data_out, const int channels,
+    const int height, const int width, const Dtype* weights,
+    const int num_output, const int group, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    Dtype* data_im) {
+  const int output_h = (height + 2 * pad_h -
+      (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+  const int output_w = (width + 2 * pad_w -
+      (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+  const int group_channels = channels / group;
+  const int group_output = num_output / group;
+  caffe_set(channels * height * width, Dtype(0), data_im);
+  for (int o = 0; o < num_output; ++o) {
+    const Dtype* out = data_out + o * output_h * output_w;
+    const int first_channel = (o / group_output) * group_channels;
+    for (int c = 0; c < group_channels; ++c) {
+      Dtype* im = data_im + (first_channel + c) * height * width;
+      const Dtype* weight = weights + (o * group_channels + c) * kernel_h *
+          kernel_w;
+      for (int kh = 0; kh < kernel_h; ++kh) {
+        int h_begin, h_end;
+        direct_conv_range(height, output_h, pad_h, stride_h, kh * dilation_h,
+            &h_begin, &h_end);
+        for (int kw = 0; kw < kernel_w; ++kw) {
+          int w_begin, w_end;
+          direct_conv_range(width, output_w, pad_w, stride_w, kw * dilation_w,
+              &w_begin, &w_end);
+          const int w_offset = kw * dilation_w - pad_w;
+          const Dtype value = weight[kh * kernel_w + kw];
+          for (int h = h_begin; h < h_end; ++h) {
+            Dtype* in_row = im + (h * stride_h - pad_h + kh * dilation_h)
+                * width;
+            const Dtype* out_row = out + h * output_w;
+            for (int w = w_begin; w < w_end; ++w) {
+              in_row[w * stride_w + w_offset] += value * out_row[w];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+template void conv_direct_backward_cpu<float>(const float* data_out,
+    const int channels, const int height, const int width,
+    const float* weights, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, float* data_im);
+template void conv_direct_backward_cpu<double>(const double* data_out,
+    const int channels, const int height, const int width,
+    const double* weights, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, double* data_im);
+
+template <typename Dtype>
+void conv_direct_weight_cpu(const Dtype* data_im, const Dtype* data_out,
+    const int channels, const int height, const int width,
+    const int num_output, const int group, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    Dtype* weights) {
+  const int output_h = (height + 2 * pad_h -
+      (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+  const int output_w = (width + 2 * pad_w -
+      (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+  const int group_channels = channels / group;
+  const int group_output = num_output / group;
+  for (int o = 0; o < num_output; ++o) {
+    const Dtype* out = data_out + o * output_h * output_w;
+    const int first_channel = (o / group_output) * group_channels;
+    for (int c = 0; c < group_channels; ++c) {
+      const Dtype* im = data_im + (first_channel + c) * height * width;
+      Dtype* weight = weights + (o * group_channels + c) * kernel_h *
+          kernel_w;
+      for (int kh = 0; kh < kernel_h; ++kh) {
+        int h_begin, h_end;
+        direct_conv_range(height, output_h, pad_h, stride_h, kh * dilation_h,
+            &h_begin, &h_end);
+        for (int kw = 0; kw < kernel_w; ++kw) {
+          int w_begin, w_end;
+          direct_conv_range(width, output_w, pad_w, stride_w, kw * dilation_w,
+              &w_begin, &w_end);
+          const int w_offset = kw * dilation_w - pad_w;
+          Dtype sum = 0;
+          for (int h = h_begin; h < h_end; ++h) {
+            const Dtype* in_row = im + (h * stride_h - pad_h + kh * dilation_h)
+                * width;
+            const Dtype* out_row = out + h * output_w;
+            for (int w = w_begin; w < w_end; ++w) {
+              sum += out_row[w] * in_row[w * stride_w + w_offset];
+            }
+          }
+          weight[kh * kernel_w + kw] += sum;
+        }
+      }
+    }
+  }
+}
+
+template void conv_direct_weight_cpu<float>(const float* data_im,
+    const float* data_out, const int channels, const int height,
+    const int width, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, float* weights);
+template void conv_direct_weight_cpu<double>(const double* data_im,
+    const double* data_out, const int channels, const int height,
+    const int width, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, double* weights);
+
+}  // namespace caffe
@@ -0,0 +1,110 @@
+#include <cmath>
+
+#include "caffe/common.hpp"
+#include "caffe/util/fast_math.hpp"
+#include "caffe/util/simd.hpp"
+
+namespace caffe {
+
+// The float kernels are built on the exp and expm1 of simd.hpp, which are
+// within 1 ulp; each adds no more than a division and an addition.
+
+// 1 / (1 + e^-|x|), and e^-|x| / (1 + e^-|x|) for the negative x, which does
+// not round to 1 - 1 for them.
+static inline float fast_sigmoid(const float x) {
+  const float e = simd_exp(-simd_abs(x));
+  const float s = 1.0f / (1.0f + e);
+  return simd_select(x < 0, e * s, s);
+}
+
+// tanh(|x|) = -(e^-2|x| - 1) / (e^-2|x| + 1), which is exact near 0 by
+// expm1.
+static inline float fast_tanh(const float x) {
+  const float e = simd_expm1(-2.0f * simd_abs(x));
+  return simd_copysign(-e / (2.0f + e), x);
+}
+
+static inline float fast_elu(const float x, const float alpha) {
+  return simd_select(x > 0, x, alpha * simd_expm1(x));
+}
+
+CAFFE_SIMD_CLONES static void fast_exp_kernel(const int n, const float* x,
+    float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = simd_exp(x[i]);
+  }
+}
+
+CAFFE_SIMD_CLONES static void fast_sigmoid_kernel(const int n,
+    const float* x, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = fast_sigmoid(x[i]);
+  }
+}
+
+CAFFE_SIMD_CLONES static void fast_tanh_kernel(const int n, const float* x,
+    float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = fast_tanh(x[i]);
+  }
+}
+
+CAFFE_SIMD_CLONES static void fast_elu_kernel(const int n, const float alpha,
+    const float* x, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = fast_elu(x[i], alpha);
+  }
+}
+
+template <>
+void caffe_cpu_fast_exp<float>(const int n, const float* x, float* y) {
+  fast_exp_kernel(n, x, y);
+}
+
+template <>
+void caffe_cpu_fast_exp<double>(const int n, const double* x, double* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::exp(x[i]);
+  }
+}
+
+template <>
+void caffe_cpu_fast_sigmoid<float>(const int n, const float* x, float* y) {
+  fast_sigmoid_kernel(n, x, y);
+}
+
+template <>
+void caffe_cpu_fast_sigmoid<double>(const int n, const double* x,
+    double* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = 1. / (1. + std::exp(-x[i]));
+  }
+}
+
+template <>
+void caffe_cpu_fast_tanh<float>(const int n, const float* x, float* y) {
+  fast_tanh_kernel(n, x, y);
+}
+
+template <>
+void caffe_cpu_fast_tanh<double>(const int n, const double* x, double* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::tanh(x[i]);
+  }
+}
+
+template <>
+void caffe_cpu_fast_elu<float>(const int n, const float alpha,
+    const float* x, float* y) {
+  fast_elu_kernel(n, alpha, x, y);
+}
+
+template <>
+void caffe_cpu_fast_elu<double>(const int n, const double alpha,
+    const double* x, double* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = x[i] > 0 ? x[i] : alpha * expm1(x[i]);
+  }
+}
+
+}  // namespace caffe
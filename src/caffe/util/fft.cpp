@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/fft.hpp"
+
+namespace caffe {
+
+int fft_size(const int n) {
+  int size = 1;
+  while (size < n) {
+    size <<= 1;
+  }
+  return size;
+}
+
+// The twiddle factors exp(-2 pi i k / n) of a transform of n points, for
+// k < n / 2.
+template <typename Dtype>
+static void fft_twiddles(const int n, vector<Dtype>* cos_table,
+    vector<Dtype>* sin_table) {
+  cos_table->resize(std::max(n / 2, 1));
+  sin_table->resize(std::max(n / 2, 1));
+  for (int k = 0; k < n / 2; ++k) {
+    const double angle = -2 * M_PI * k / n;
+    (*cos_table)[k] = std::cos(angle);
+    (*sin_table)[k] = std::sin(angle);
+  }
+}
+
+// Transforms count interleaved sequences of n points in place, point i of
+// sequence t at i * count + t, so that the butterflies vectorize across the
+// sequences. The inverse transform is not scaled.
+template <typename Dtype>
+static void fft_interleaved(const int n, const int count, const bool inverse,
+    const vector<Dtype>& cos_table, const vector<Dtype>& sin_table,
+    Dtype* re, Dtype* im) {
+  for (int i = 1, j = 0; i < n; ++i) {
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      std::swap_ranges(re + i * count, re + (i + 1) * count, re + j * count);
+      std::swap_ranges(im + i * count, im + (i + 1) * count, im + j * count);
+    }
+  }
+  const Dtype sign = inverse ? -1 : 1;
+  for (int half = 1; half < n; half <<= 1) {
+    const int table_step = n / (2 * half);
+    for (int start = 0; start < n; start += 2 * half) {
+      for (int k = 0; k < half; ++k) {
+        const Dtype wr = cos_table[k * table_step];
+        const Dtype wi = sign * sin_table[k * table_step];
+        Dtype* re0 = re + (start + k) * count;
+        Dtype* im0 = im + (start + k) * count;
+        Dtype* re1 = re0 + half * count;
+        Dtype* im1 = im0 + half * count;
+        for (int t = 0; t < count; ++t) {
+          const Dtype tr = re1[t] * wr - im1[t] * wi;
+          const Dtype ti = re1[t] * wi + im1[t] * wr;
+          re1[t] = re0[t] - tr;
+          im1[t] = im0[t] - ti;
+          re0[t] += tr;
+          im0[t] += ti;
+        }
+      }
+    }
+  }
+}
+
+// Both passes run on interleaved sequences: the rows are transformed in a
+// transposed fft_w x fft_h grid, which is then transposed into the half
+// spectrum for the columns.
+template <typename Dtype>
+void fft2d_forward_cpu(const Dtype* data, const int height, const int width,
+    const int offset_h, const int offset_w, const int step_h,
+    const int step_w, const int fft_h, const int fft_w, Dtype* spectrum) {
+  const int half_w = fft_w / 2 + 1;
+  const int spectrum_size = fft_spectrum_size(fft_h, fft_w);
+  vector<Dtype> grid_re(fft_w * fft_h, Dtype(0));
+  vector<Dtype> grid_im(fft_w * fft_h, Dtype(0));
+  for (int i = 0; i < height; ++i) {
+    const int r = offset_h + i * step_h;
+    DCHECK_LT(r, fft_h);
+    for (int j = 0; j < width; ++j) {
+      grid_re[(offset_w + j * step_w) * fft_h + r] = data[i * width + j];
+    }
+  }
+  vector<Dtype> cos_table, sin_table;
+  fft_twiddles(fft_w, &cos_table, &sin_table);
+  fft_interleaved(fft_w, fft_h, false, cos_table, sin_table, &grid_re[0],
+      &grid_im[0]);
+  Dtype* spectrum_re = spectrum;
+  Dtype* spectrum_im = spectrum + spectrum_size;
+  for (int r = 0; r < fft_h; ++r) {
+    for (int k = 0; k < half_w; ++k) {
+      spectrum_re[r * half_w + k] = grid_re[k * fft_h + r];
+      spectrum_im[r * half_w + k] = grid_im[k * fft_h + r];
+    }
+  }
+  fft_twiddles(fft_h, &cos_table, &sin_table);
+  fft_interleaved(fft_h, half_w, false, cos_table, sin_table, spectrum_re,
+      spectrum_im);
+}
+
+template void fft2d_forward_cpu<float>(const float* data, const int height,
+    const int width, const int offset_h, const int offset_w, const int step_h,
+    const int step_w, const int fft_h, const int fft_w, float* spectrum);
+template void fft2d_forward_cpu<double>(const double* data, const int height,
+    const int width, const int offset_h, const int offset_w, const int step_h,
+    const int step_w, const int fft_h, const int fft_w, double* spectrum);
+
+template <typename Dtype>
+void fft2d_inverse_cpu(const Dtype* spectrum, const int fft_h,
+    const int fft_w, const int height, const int width, const int offset_h,
+    const int offset_w, const int step_h, const int step_w, Dtype* data) {
+  const int half_w = fft_w / 2 + 1;
+  const int spectrum_size = fft_spectrum_size(fft_h, fft_w);
+  vector<Dtype> columns_re(spectrum, spectrum + spectrum_size);
+  vector<Dtype> columns_im(spectrum + spectrum_size,
+      spectrum + 2 * spectrum_size);
+  vector<Dtype> cos_table, sin_table;
+  fft_twiddles(fft_h, &cos_table, &sin_table);
+  fft_interleaved(fft_h, half_w, true, cos_table, sin_table, &columns_re[0],
+      &columns_im[0]);
+  // The spectrum of each row is conjugate symmetric, as the rows are real.
+  vector<Dtype> grid_re(fft_w * fft_h);
+  vector<Dtype> grid_im(fft_w * fft_h);
+  for (int r = 0; r < fft_h; ++r) {
+    for (int k = 0; k < half_w; ++k) {
+      grid_re[k * fft_h + r] = columns_re[r * half_w + k];
+      grid_im[k * fft_h + r] = columns_im[r * half_w + k];
+    }
+    for (int k = half_w; k < fft_w; ++k) {
+      grid_re[k * fft_h + r] = columns_re[r * half_w + fft_w - k];
+      grid_im[k * fft_h + r] = -columns_im[r * half_w + fft_w - k];
+    }
+  }
+  fft_twiddles(fft_w, &cos_table, &sin_table);
+  fft_interleaved(fft_w, fft_h, true, cos_table, sin_table, &grid_re[0],
+      &grid_im[0]);
+  const Dtype scale = Dtype(1) / (fft_h * fft_w);
+  for (int i = 0; i < height; ++i) {
+    const int r = offset_h + i * step_h;
+    DCHECK_LT(r, fft_h);
+    for (int j = 0; j < width; ++j) {
+      data[i * width + j] = grid_re[(offset_w + j * step_w) * fft_h + r] *
+          scale;
+    }
+  }
+}
+
+template void fft2d_inverse_cpu<float>(const float* spectrum, const int fft_h,
+    const int fft_w, const int height, const int width, const int offset_h,
+    const int offset_w, const int step_h, const int step_w, float* data);
+template void fft2d_inverse_cpu<double>(const double* spectrum,
+    const int fft_h, const int fft_w, const int height, const int width,
+    const int offset_h, const int offset_w, const int step_h,
+    const int step_w, double* data);
+
+template <typename Dtype>
+void fft_multiply_add_cpu(const int spectrum_size, const Dtype* a,
+    const Dtype* b, const bool conjugate_b, Dtype* c) {
+  const Dtype* a_re = a;
+  const Dtype* a_im = a + spectrum_size;
+  const Dtype* b_re = b;
+  const Dtype* b_im = b + spectrum_size;
+  Dtype* c_re = c;
+  Dtype* c_im = c + spectrum_size;
+  if (conjugate_b) {
+    for (int i = 0; i < spectrum_size; ++i) {
+      c_re[i] += a_re[i] * b_re[i] + a_im[i] * b_im[i];
+      c_im[i] += a_im[i] * b_re[i] - a_re[i] * b_im[i];
+    }
+  } else {
+    for (int i = 0; i < spectrum_size; ++i) {
+      c_re[i] += a_re[i] * b_re[i] - a_im[i] * b_im[i];
+      c_im[i] += a_re[i] * b_im[i] + a_im[i] * b_re[i];
+    }
+  }
+}
+
+template void fft_multiply_add_cpu<float>(const int spectrum_size,
+    const float* a, const float* b, const bool conjugate_b, float* c);
+template void fft_multiply_add_cpu<double>(const int spectrum_size,
+    const double* a, const double* b, const bool conjugate_b, double* c);
+
+}  // namespace caffe
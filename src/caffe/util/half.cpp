@@ -0,0 +1,138 @@
+#include <cstring>
+
+#include "caffe/common.hpp"
+#include "caffe/util/half.hpp"
+
+namespace caffe {
+
+static inline uint32_t float_bits(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static inline float bits_float(uint32_t bits) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Shifts mantissa right, rounding to nearest even.
+static inline uint32_t round_shift(uint32_t mantissa, int shift) {
+  const uint32_t result = mantissa >> shift;
+  const uint32_t rest = mantissa & ((1u << shift) - 1);
+  const uint32_t halfway = 1u << (shift - 1);
+  return result + (rest > halfway || (rest == halfway && (result & 1)));
+}
+
+uint16_t float_to_half(float value) {
+  const uint32_t bits = float_bits(value);
+  const uint32_t sign = (bits >> 16) & 0x8000;
+  const uint32_t abs = bits & 0x7fffffff;
+  if (abs >= 0x7f800000) {
+    // Infinity, or NaN which stays quiet.
+    return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+  }
+  if (abs >= 0x47800000) {
+    // At least 2^16, beyond the largest half.
+    return sign | 0x7c00;
+  }
+  const int exponent = abs >> 23;
+  if (exponent < 113) {
+    // Below 2^-14, a subnormal half in units of 2^-24.
+    const int shift = 126 - exponent;
+    if (shift > 24) {
+      return sign;
+    }
+    return sign | round_shift((abs & 0x7fffff) | 0x800000, shift);
+  }
+  // Rebias the exponent from 127 to 15; a carry out of the mantissa rounds
+  // up to the next exponent, or to infinity.
+  return sign | round_shift(abs - 0x38000000, 13);
+}
+
+float half_to_float(uint16_t value) {
+  const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+  uint32_t exponent = (value >> 10) & 0x1f;
+  uint32_t mantissa = value & 0x3ff;
+  if (exponent == 0x1f) {
+    return bits_float(sign | 0x7f800000 | (mantissa << 13));
+  }
+  if (exponent == 0) {
+    if (mantissa == 0) {
+      return bits_float(sign);
+    }
+    // Normalize the subnormal.
+    exponent = 113;
+    while (!(mantissa & 0x400)) {
+      mantissa <<= 1;
+      --exponent;
+    }
+    return bits_float(sign | (exponent << 23) | ((mantissa & 0x3ff) << 13));
+  }
+  return bits_float(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+uint16_t float_to_bfloat16(float value) {
+  const uint32_t bits = float_bits(value);
+  if ((bits & 0x7fffffff) > 0x7f800000) {
+    return (bits >> 16) | 0x40;
+  }
+  return (bits + 0x7fff + ((bits >> 16) & 1)) >> 16;
+}
+
+float bfloat16_to_float(uint16_t value) {
+  return bits_float(static_cast<uint32_t>(value) << 16);
+}
+
+template <typename Dtype>
+void caffe_cpu_pack(const int n, const Dtype* x,
+    const StoragePrecision precision, uint16_t* y) {
+  switch (precision) {
+  case FP16:
+    for (int i = 0; i < n; ++i) {
+      y[i] = float_to_half(static_cast<float>(x[i]));
+    }
+    break;
+  case BF16:
+    for (int i = 0; i < n; ++i) {
+      y[i] = float_to_bfloat16(static_cast<float>(x[i]));
+    }
+    break;
+  default:
+    LOG(FATAL) << "Unknown 16-bit storage precision: "
+        << StoragePrecision_Name(precision);
+  }
+}
+
+template void caffe_cpu_pack<float>(const int n, const float* x,
+    const StoragePrecision precision, uint16_t* y);
+template void caffe_cpu_pack<double>(const int n, const double* x,
+    const StoragePrecision precision, uint16_t* y);
+
+template <typename Dtype>
+void caffe_cpu_unpack(const int n, const uint16_t* x,
+    const StoragePrecision precision, Dtype* y) {
+  switch (precision) {
+  case FP16:
+    for (int i = 0; i < n; ++i) {
+      y[i] = half_to_float(x[i]);
+    }
+    break;
+  case BF16:
+    for (int i = 0; i < n; ++i) {
+      y[i] = bfloat16_to_float(x[i]);
+    }
+    break;
+  default:
+    LOG(FATAL) << "Unknown 16-bit storage precision: "
+        << StoragePrecision_Name(precision);
+  }
+}
+
+template void caffe_cpu_unpack<float>(const int n, const uint16_t* x,
+    const StoragePrecision precision, float* y);
+template void caffe_cpu_unpack<double>(const int n, const uint16_t* x,
+    const StoragePrecision precision, double* y);
+
+}  // namespace caffe
@@ -0,0 +1,227 @@
+#include <stdint.h>
+#include <sys/mman.h>
+#include <boost/thread.hpp>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "caffe/util/host_memory_pool.hpp"
+
+namespace caffe {
+
+// Settings shared by all the caches.
+static bool pool_enabled_ = true;
+static bool pool_per_thread_ = false;
+static size_t pool_max_cached_bytes_ = size_t(1) << 30;
+
+class HostMemoryPool::Cache {
+ public:
+  Cache()
+      : hits_(0), misses_(0), bytes_allocated_(0), bytes_freed_(0),
+        bytes_cached_(0) {
+    Registry& registry = GetRegistry();
+    boost::mutex::scoped_lock lock(registry.mutex);
+    registry.caches.insert(this);
+  }
+  ~Cache() {
+    {
+      // Keep the counters of the exiting thread in the totals.
+      Registry& registry = GetRegistry();
+      boost::mutex::scoped_lock lock(registry.mutex);
+      registry.caches.erase(this);
+      registry.retired.hits += hits_;
+      registry.retired.misses += misses_;
+      registry.retired_bytes_allocated += bytes_allocated_;
+      registry.retired_bytes_freed += bytes_freed_;
+    }
+    Trim();
+  }
+
+  void* Allocate(size_t size) {
+    const size_t size_class = SizeClass(size);
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      bytes_allocated_ += size_class;
+      vector<void*>& blocks = free_blocks_[size_class];
+      if (!blocks.empty()) {
+        void* ptr = blocks.back();
+        blocks.pop_back();
+        bytes_cached_ -= size_class;
+        // The block may predate a change of the alignment settings.
+        if (reinterpret_cast<uintptr_t>(ptr) % HostAlignment(size_class)
+            == 0) {
+          ++hits_;
+          return ptr;
+        }
+        free(ptr);
+      }
+      ++misses_;
+    }
+    return AlignedMallocHost(size_class);
+  }
+
+  void Free(void* ptr, size_t size) {
+    const size_t size_class = SizeClass(size);
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      bytes_freed_ += size_class;
+      if (bytes_cached_ + size_class <= pool_max_cached_bytes_) {
+        free_blocks_[size_class].push_back(ptr);
+        bytes_cached_ += size_class;
+        return;
+      }
+    }
+    free(ptr);
+  }
+
+  void Trim() {
+    map<size_t, vector<void*> > blocks;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      blocks.swap(free_blocks_);
+      bytes_cached_ = 0;
+    }
+    for (map<size_t, vector<void*> >::iterator it = blocks.begin();
+         it != blocks.end(); ++it) {
+      for (int i = 0; i < it->second.size(); ++i) {
+        free(it->second[i]);
+      }
+    }
+  }
+
+  void AddStats(Stats* stats, size_t* bytes_allocated, size_t* bytes_freed) {
+    boost::mutex::scoped_lock lock(mutex_);
+    stats->hits += hits_;
+    stats->misses += misses_;
+    stats->bytes_cached += bytes_cached_;
+    *bytes_allocated += bytes_allocated_;
+    *bytes_freed += bytes_freed_;
+  }
+
+  // All the live caches, and the counters of those already destroyed.
+  struct Registry {
+    Registry() : retired_bytes_allocated(0), retired_bytes_freed(0) {}
+    boost::mutex mutex;
+    set<Cache*> caches;
+    Stats retired;
+    size_t retired_bytes_allocated;
+    size_t retired_bytes_freed;
+  };
+
+  static Registry& GetRegistry() {
+    // Never destroyed, as thread caches may outlive static destruction.
+    static Registry* registry = new Registry();
+    return *registry;
+  }
+
+ private:
+  boost::mutex mutex_;
+  map<size_t, vector<void*> > free_blocks_;
+  size_t hits_;
+  size_t misses_;
+  size_t bytes_allocated_;
+  size_t bytes_freed_;
+  size_t bytes_cached_;
+};
+
+size_t HostAlignment(size_t size) {
+  if (Caffe::host_huge_pages() && size >= kHugePageSize) {
+    return kHugePageSize;
+  }
+  return Caffe::host_alignment();
+}
+
+void* AlignedMallocHost(size_t size) {
+  const size_t alignment = HostAlignment(size);
+  void* ptr = NULL;
+  const int error = posix_memalign(&ptr, alignment, size);
+  CHECK_EQ(error, 0) << "host allocation of size " << size
+      << " with alignment " << alignment << " failed";
+#ifdef MADV_HUGEPAGE
+  if (alignment == kHugePageSize) {
+    // Only a hint: the kernel may lack transparent huge page support.
+    madvise(ptr, size / kHugePageSize * kHugePageSize, MADV_HUGEPAGE);
+  }
+#endif
+  return ptr;
+}
+
+HostMemoryPool::Cache* HostMemoryPool::GetCache() {
+  // Never destroyed, like the registry; a thread's cache is destroyed when
+  // the thread exits.
+  static boost::thread_specific_ptr<Cache>* thread_cache =
+      new boost::thread_specific_ptr<Cache>();
+  static Cache* shared_cache = new Cache();
+  if (pool_per_thread_) {
+    if (!thread_cache->get()) {
+      thread_cache->reset(new Cache());
+    }
+    return thread_cache->get();
+  }
+  return shared_cache;
+}
+
+void* HostMemoryPool::Allocate(size_t size) {
+  return GetCache()->Allocate(size);
+}
+
+void HostMemoryPool::Free(void* ptr, size_t size) {
+  GetCache()->Free(ptr, size);
+}
+
+void HostMemoryPool::Trim() {
+  Cache::Registry& registry = Cache::GetRegistry();
+  boost::mutex::scoped_lock lock(registry.mutex);
+  for (set<Cache*>::iterator it = registry.caches.begin();
+       it != registry.caches.end(); ++it) {
+    (*it)->Trim();
+  }
+}
+
+HostMemoryPool::Stats HostMemoryPool::GetStats() {
+  Cache::Registry& registry = Cache::GetRegistry();
+  boost::mutex::scoped_lock lock(registry.mutex);
+  Stats stats = registry.retired;
+  size_t bytes_allocated = registry.retired_bytes_allocated;
+  size_t bytes_freed = registry.retired_bytes_freed;
+  for (set<Cache*>::iterator it = registry.caches.begin();
+       it != registry.caches.end(); ++it) {
+    (*it)->AddStats(&stats, &bytes_allocated, &bytes_freed);
+  }
+  stats.bytes_in_use = bytes_allocated - bytes_freed;
+  return stats;
+}
+
+size_t HostMemoryPool::SizeClass(size_t size) {
+  const size_t kMinSizeClass = 64;
+  if (size <= kMinSizeClass) {
+    return kMinSizeClass;
+  }
+  // Round up to a multiple of a quarter of the largest power of two below
+  // size, which bounds the waste to 25%.
+  size_t power = kMinSizeClass;
+  while (power * 2 < size) {
+    power *= 2;
+  }
+  const size_t step = power / 4;
+  return (size + step - 1) / step * step;
+}
+
+bool HostMemoryPool::enabled() { return pool_enabled_; }
+
+void HostMemoryPool::set_enabled(bool enabled) { pool_enabled_ = enabled; }
+
+bool HostMemoryPool::per_thread() { return pool_per_thread_; }
+
+void HostMemoryPool::set_per_thread(bool per_thread) {
+  pool_per_thread_ = per_thread;
+}
+
+size_t HostMemoryPool::max_cached_bytes() { return pool_max_cached_bytes_; }
+
+void HostMemoryPool::set_max_cached_bytes(size_t max_cached_bytes) {
+  pool_max_cached_bytes_ = max_cached_bytes;
+}
+
+}  // namespace caffe
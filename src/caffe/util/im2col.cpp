@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstring>
 #include <vector>
 
 #include "caffe/util/im2col.hpp"
@@ -5,6 +7,10 @@
 
 namespace caffe {
 
+// Column buffers of fewer values are filled by a single thread, as the
+// threads would cost more than they save.
+const int kIm2colParallelSize = 1 << 15;
+
 // Function uses casting from int to unsigned to compare if value of
 // parameter a is greater or equal to zero and lower than value of
 // parameter b. The b parameter is of type signed and is always positive,
@@ -15,6 +21,50 @@ inline bool is_a_ge_zero_and_a_lt_b(int a, int b) {
   return static_cast<unsigned>(a) < static_cast<unsigned>(b);
 }
 
+// Computes the range [begin, end) of the outputs whose input at a kernel
+// offset lies within [0, input), i.e., not in the padding.
+inline void im2col_range(const int input, const int output, const int pad,
+    const int stride, const int offset, int* begin, int* end) {
+  const int low = pad - offset;
+  const int high = input - 1 + pad - offset;
+  *begin = low <= 0 ? 0 : std::min(output, (low + stride - 1) / stride);
+  *end = high < 0 ? 0 : std::min(output, high / stride + 1);
+  *end = std::max(*begin, *end);
+}
+
+// Fill a row of output_w columns from a row of the image, with zeros in the
+// padding outside [begin, end); stride 1 reduces to a contiguous copy.
+template <typename Dtype>
+inline void im2col_row(const Dtype* im_row, const int offset,
+    const int stride, const int begin, const int end, const int output_w,
+    Dtype* col) {
+  std::fill(col, col + begin, Dtype(0));
+  if (stride == 1) {
+    memcpy(col + begin, im_row + offset + begin, (end - begin) * sizeof(Dtype));
+  } else {
+    for (int i = begin; i < end; ++i) {
+      col[i] = im_row[offset + i * stride];
+    }
+  }
+  std::fill(col + end, col + output_w, Dtype(0));
+}
+
+// Accumulate a row of columns within [begin, end) into a row of the image.
+template <typename Dtype>
+inline void col2im_row(const Dtype* col, const int offset, const int stride,
+    const int begin, const int end, Dtype* im_row) {
+  if (stride == 1) {
+    Dtype* im = im_row + offset;
+    for (int i = begin; i < end; ++i) {
+      im[i] += col[i];
+    }
+  } else {
+    for (int i = begin; i < end; ++i) {
+      im_row[offset + i * stride] += col[i];
+    }
+  }
+}
+
 template <typename Dtype>
 void im2col_cpu(const Dtype* data_im, const int channels,
     const int height, const int width, const int kernel_h, const int kernel_w,
@@ -27,29 +77,32 @@ void im2col_cpu(const Dtype* data_im, const int channels,
   const int output_w = (width + 2 * pad_w -
     (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
   const int channel_size = height * width;
-  for (int channel = channels; channel--; data_im += channel_size) {
-    for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
-      for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
-        int input_row = -pad_h + kernel_row * dilation_h;
-        for (int output_rows = output_h; output_rows; output_rows--) {
-          if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
-            for (int output_cols = output_w; output_cols; output_cols--) {
-              *(data_col++) = 0;
-            }
-          } else {
-            int input_col = -pad_w + kernel_col * dilation_w;
-            for (int output_col = output_w; output_col; output_col--) {
-              if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
-                *(data_col++) = data_im[input_row * width + input_col];
-              } else {
-                *(data_col++) = 0;
-              }
-              input_col += stride_w;
-            }
-          }
-          input_row += stride_h;
-        }
+  const int kernel_size = kernel_h * kernel_w;
+  const int rows = channels * kernel_size;
+  const int row_size = output_h * output_w;
+  // Each row of the columns, of a channel at a kernel offset, is independent.
+#ifdef _OPENMP
+  #pragma omp parallel for if (rows * row_size >= kIm2colParallelSize)
+#endif
+  for (int row = 0; row < rows; ++row) {
+    const int kernel_row = row % kernel_size / kernel_w;
+    const int kernel_col = row % kernel_w;
+    const Dtype* im = data_im + row / kernel_size * channel_size;
+    Dtype* col = data_col + row * row_size;
+    const int offset_h = kernel_row * dilation_h - pad_h;
+    const int offset_w = kernel_col * dilation_w - pad_w;
+    int begin, end;
+    im2col_range(width, output_w, pad_w, stride_w, kernel_col * dilation_w,
+        &begin, &end);
+    for (int output_row = 0; output_row < output_h; ++output_row) {
+      const int input_row = offset_h + output_row * stride_h;
+      if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
+        std::fill(col, col + output_w, Dtype(0));
+      } else {
+        im2col_row(im + input_row * width, offset_w, stride_w, begin, end,
+            output_w, col);
       }
+      col += output_w;
     }
   }
 }
@@ -65,76 +118,169 @@ template void im2col_cpu<double>(const double* data_im, const int channels,
     const int pad_h, const int pad_w, const int stride_h,
     const int stride_w, const int dilation_h, const int dilation_w,
     double* data_col);
+// for the quantized inputs of the INT8 engine
+template void im2col_cpu<int8_t>(const int8_t* data_im, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    int8_t* data_col);
 
 template <typename Dtype>
 inline void im2col_nd_core_cpu(const Dtype* data_input, const bool im2col,
     const int num_spatial_axes, const int* im_shape, const int* col_shape,
     const int* kernel_shape, const int* pad, const int* stride,
     const int* dilation, Dtype* data_output) {
-  if (!im2col) {
-    int im_size = im_shape[0];
-    for (int i = 0; i < num_spatial_axes; ++i) {
-      im_size *= im_shape[1 + i];
-    }
-    caffe_set(im_size, Dtype(0), data_output);
-  }
   int kernel_size = 1;
   for (int i = 0; i < num_spatial_axes; ++i) {
     kernel_size *= kernel_shape[i];
   }
+  int col_size = col_shape[0];
+  for (int i = 0; i < num_spatial_axes; ++i) {
+    col_size *= col_shape[1 + i];
+  }
   const int channels_col = col_shape[0];
-  vector<int> d_offset(num_spatial_axes, 0);
-  vector<int> d_iter(num_spatial_axes, 0);
-  for (int c_col = 0; c_col < channels_col; ++c_col) {
-    // Loop over spatial axes in reverse order to compute a per-axis offset.
-    int offset = c_col;
-    for (int d_i = num_spatial_axes - 1; d_i >= 0; --d_i) {
-      if (d_i < num_spatial_axes - 1) {
-        offset /= kernel_shape[d_i + 1];
+  // im2col fills each channel of the columns independently, and col2im
+  // accumulates the kernel_size channels of the columns of an image channel
+  // into that channel only.
+  const int num_tasks = im2col ? channels_col : im_shape[0];
+  const int task_channels = im2col ? 1 : kernel_size;
+#ifdef _OPENMP
+  #pragma omp parallel for if (col_size >= kIm2colParallelSize)
+#endif
+  for (int task = 0; task < num_tasks; ++task) {
+    if (!im2col) {
+      int im_channel_size = 1;
+      for (int i = 0; i < num_spatial_axes; ++i) {
+        im_channel_size *= im_shape[1 + i];
       }
-      d_offset[d_i] = offset % kernel_shape[d_i];
+      caffe_set(im_channel_size, Dtype(0),
+          data_output + task * im_channel_size);
     }
-    for (bool incremented = true; incremented; ) {
-      // Loop over spatial axes in forward order to compute the indices in the
-      // image and column, and whether the index lies in the padding.
-      int index_col = c_col;
-      int index_im = c_col / kernel_size;
-      bool is_padding = false;
-      for (int d_i = 0; d_i < num_spatial_axes; ++d_i) {
-        const int d = d_iter[d_i];
-        const int d_im = d * stride[d_i] - pad[d_i] +
-            d_offset[d_i] * dilation[d_i];
-        is_padding |= d_im < 0 || d_im >= im_shape[d_i + 1];
-        index_col *= col_shape[d_i + 1];
-        index_col += d;
-        index_im *= im_shape[d_i + 1];
-        index_im += d_im;
-      }
-      if (im2col) {
-        if (is_padding) {
-          data_output[index_col] = 0;
-        } else {
-          data_output[index_col] = data_input[index_im];
+    vector<int> d_offset(num_spatial_axes, 0);
+    vector<int> d_iter(num_spatial_axes, 0);
+    for (int c_col = task * task_channels;
+        c_col < (task + 1) * task_channels; ++c_col) {
+      // Loop over spatial axes in reverse order to compute a per-axis offset.
+      int offset = c_col;
+      for (int d_i = num_spatial_axes - 1; d_i >= 0; --d_i) {
+        if (d_i < num_spatial_axes - 1) {
+          offset /= kernel_shape[d_i + 1];
         }
-      } else if (!is_padding) {  // col2im
-        data_output[index_im] += data_input[index_col];
+        d_offset[d_i] = offset % kernel_shape[d_i];
       }
-      // Loop over spatial axes in reverse order to choose an index,
-      // like counting.
-      incremented = false;
-      for (int d_i = num_spatial_axes - 1; d_i >= 0; --d_i) {
-        const int d_max = col_shape[d_i + 1];
-        DCHECK_LT(d_iter[d_i], d_max);
-        if (d_iter[d_i] == d_max - 1) {
-          d_iter[d_i] = 0;
-        } else {  // d_iter[d_i] < d_max - 1
-          ++d_iter[d_i];
-          incremented = true;
-          break;
+      for (bool incremented = true; incremented; ) {
+        // Loop over spatial axes in forward order to compute the indices in
+        // the image and column, and whether the index lies in the padding.
+        int index_col = c_col;
+        int index_im = c_col / kernel_size;
+        bool is_padding = false;
+        for (int d_i = 0; d_i < num_spatial_axes; ++d_i) {
+          const int d = d_iter[d_i];
+          const int d_im = d * stride[d_i] - pad[d_i] +
+              d_offset[d_i] * dilation[d_i];
+          is_padding |= d_im < 0 || d_im >= im_shape[d_i + 1];
+          index_col *= col_shape[d_i + 1];
+          index_col += d;
+          index_im *= im_shape[d_i + 1];
+          index_im += d_im;
+        }
+        if (im2col) {
+          if (is_padding) {
+            data_output[index_col] = 0;
+          } else {
+            data_output[index_col] = data_input[index_im];
+          }
+        } else if (!is_padding) {  // col2im
+          data_output[index_im] += data_input[index_col];
+        }
+        // Loop over spatial axes in reverse order to choose an index,
+        // like counting.
+        incremented = false;
+        for (int d_i = num_spatial_axes - 1; d_i >= 0; --d_i) {
+          const int d_max = col_shape[d_i + 1];
+          DCHECK_LT(d_iter[d_i], d_max);
+          if (d_iter[d_i] == d_max - 1) {
+            d_iter[d_i] = 0;
+          } else {  // d_iter[d_i] < d_max - 1
+            ++d_iter[d_i];
+            incremented = true;
+            break;
+          }
+        }
+      }  // while(incremented) {
+    }  // for (int c_col = ...; c_col < ...; ++c_col) {
+  }  // for (int task = 0; task < num_tasks; ++task) {
+}
+
+// The 3D counterpart of im2col_cpu and col2im_cpu, by rows of the columns
+// rather than by index walk as im2col_nd_core_cpu.
+template <typename Dtype>
+inline void im2col_3d_core_cpu(const Dtype* data_input, const bool im2col,
+    const int* im_shape, const int* col_shape, const int* kernel_shape,
+    const int* pad, const int* stride, const int* dilation,
+    Dtype* data_output) {
+  const int channels = im_shape[0];
+  const int depth = im_shape[1];
+  const int height = im_shape[2];
+  const int width = im_shape[3];
+  const int output_d = col_shape[1];
+  const int output_h = col_shape[2];
+  const int output_w = col_shape[3];
+  const int channel_size = depth * height * width;
+  const int kernel_size = kernel_shape[0] * kernel_shape[1] * kernel_shape[2];
+  const int row_size = output_d * output_h * output_w;
+  // As in im2col_nd_core_cpu, a task is a channel of the columns for
+  // im2col, and of the image for col2im.
+  const int num_tasks = im2col ? channels * kernel_size : channels;
+  const int task_channels = im2col ? 1 : kernel_size;
+#ifdef _OPENMP
+  #pragma omp parallel for \
+      if (channels * kernel_size * row_size >= kIm2colParallelSize)
+#endif
+  for (int task = 0; task < num_tasks; ++task) {
+    if (!im2col) {
+      std::fill(data_output + task * channel_size,
+          data_output + (task + 1) * channel_size, Dtype(0));
+    }
+    for (int c_col = task * task_channels;
+        c_col < (task + 1) * task_channels; ++c_col) {
+      const int kernel_d = c_col % kernel_size /
+          (kernel_shape[1] * kernel_shape[2]);
+      const int kernel_h = c_col % (kernel_shape[1] * kernel_shape[2]) /
+          kernel_shape[2];
+      const int kernel_w = c_col % kernel_shape[2];
+      const int offset_d = kernel_d * dilation[0] - pad[0];
+      const int offset_h = kernel_h * dilation[1] - pad[1];
+      const int offset_w = kernel_w * dilation[2] - pad[2];
+      int begin, end;
+      im2col_range(width, output_w, pad[2], stride[2],
+          kernel_w * dilation[2], &begin, &end);
+      const int channel_offset = c_col / kernel_size * channel_size;
+      const Dtype* col_input = data_input + c_col * row_size;
+      Dtype* col_output = data_output + c_col * row_size;
+      for (int d = 0; d < output_d; ++d) {
+        const int input_d = offset_d + d * stride[0];
+        for (int h = 0; h < output_h; ++h) {
+          const int input_h = offset_h + h * stride[1];
+          const int col_offset = (d * output_h + h) * output_w;
+          const bool is_padding = !is_a_ge_zero_and_a_lt_b(input_d, depth) ||
+              !is_a_ge_zero_and_a_lt_b(input_h, height);
+          const int im_offset = channel_offset +
+              (input_d * height + input_h) * width;
+          if (im2col && is_padding) {
+            std::fill(col_output + col_offset,
+                col_output + col_offset + output_w, Dtype(0));
+          } else if (im2col) {
+            im2col_row(data_input + im_offset, offset_w, stride[2], begin,
+                end, output_w, col_output + col_offset);
+          } else if (!is_padding) {
+            col2im_row(col_input + col_offset, offset_w, stride[2], begin,
+                end, data_output + im_offset);
+          }
         }
       }
-    }  // while(incremented) {
-  }  // for (int c = 0; c < channels_col; ++c) {
+    }
+  }
 }
 
 template <typename Dtype>
@@ -143,6 +289,11 @@ void im2col_nd_cpu(const Dtype* data_im, const int num_spatial_axes,
     const int* kernel_shape, const int* pad, const int* stride,
     const int* dilation, Dtype* data_col) {
   const bool kIm2Col = true;
+  if (num_spatial_axes == 3) {
+    im2col_3d_core_cpu(data_im, kIm2Col, im_shape, col_shape, kernel_shape,
+        pad, stride, dilation, data_col);
+    return;
+  }
   im2col_nd_core_cpu(data_im, kIm2Col, num_spatial_axes, im_shape, col_shape,
                   kernel_shape, pad, stride, dilation, data_col);
 }
@@ -158,6 +309,11 @@ template void im2col_nd_cpu<double>(const double* data_im,
     const int* im_shape, const int* col_shape,
     const int* kernel_shape, const int* pad, const int* stride,
     const int* dilation, double* data_col);
+template void im2col_nd_cpu<int8_t>(const int8_t* data_im,
+    const int num_spatial_axes,
+    const int* im_shape, const int* col_shape,
+    const int* kernel_shape, const int* pad, const int* stride,
+    const int* dilation, int8_t* data_col);
 
 template <typename Dtype>
 void col2im_cpu(const Dtype* data_col, const int channels,
@@ -166,30 +322,36 @@ void col2im_cpu(const Dtype* data_col, const int channels,
     const int stride_h, const int stride_w,
     const int dilation_h, const int dilation_w,
     Dtype* data_im) {
-  caffe_set(height * width * channels, Dtype(0), data_im);
   const int output_h = (height + 2 * pad_h -
     (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
   const int output_w = (width + 2 * pad_w -
     (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
   const int channel_size = height * width;
-  for (int channel = channels; channel--; data_im += channel_size) {
-    for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
-      for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
-        int input_row = -pad_h + kernel_row * dilation_h;
-        for (int output_rows = output_h; output_rows; output_rows--) {
-          if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
-            data_col += output_w;
-          } else {
-            int input_col = -pad_w + kernel_col * dilation_w;
-            for (int output_col = output_w; output_col; output_col--) {
-              if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
-                data_im[input_row * width + input_col] += *data_col;
-              }
-              data_col++;
-              input_col += stride_w;
-            }
+  const int kernel_size = kernel_h * kernel_w;
+  const int row_size = output_h * output_w;
+  // The rows of the columns of a channel accumulate into its image only.
+#ifdef _OPENMP
+  #pragma omp parallel for \
+      if (channels * kernel_size * row_size >= kIm2colParallelSize)
+#endif
+  for (int channel = 0; channel < channels; ++channel) {
+    Dtype* im = data_im + channel * channel_size;
+    const Dtype* col = data_col + channel * kernel_size * row_size;
+    std::fill(im, im + channel_size, Dtype(0));
+    for (int kernel_row = 0; kernel_row < kernel_h; ++kernel_row) {
+      for (int kernel_col = 0; kernel_col < kernel_w; ++kernel_col) {
+        const int offset_h = kernel_row * dilation_h - pad_h;
+        const int offset_w = kernel_col * dilation_w - pad_w;
+        int begin, end;
+        im2col_range(width, output_w, pad_w, stride_w,
+            kernel_col * dilation_w, &begin, &end);
+        for (int output_row = 0; output_row < output_h; ++output_row) {
+          const int input_row = offset_h + output_row * stride_h;
+          if (is_a_ge_zero_and_a_lt_b(input_row, height)) {
+            col2im_row(col, offset_w, stride_w, begin, end,
+                im + input_row * width);
           }
-          input_row += stride_h;
+          col += output_w;
         }
       }
     }
@@ -214,6 +376,11 @@ void col2im_nd_cpu(const Dtype* data_col, const int num_spatial_axes,
     const int* kernel_shape, const int* pad, const int* stride,
     const int* dilation, Dtype* data_im) {
   const bool kIm2Col = false;
+  if (num_spatial_axes == 3) {
+    im2col_3d_core_cpu(data_col, kIm2Col, im_shape, col_shape, kernel_shape,
+        pad, stride, dilation, data_im);
+    return;
+  }
   im2col_nd_core_cpu(data_col, kIm2Col, num_spatial_axes, im_shape, col_shape,
                      kernel_shape, pad, stride, dilation, data_im);
 }
@@ -6,6 +6,7 @@
 #include "caffe/common.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/simd.hpp"
 
 namespace caffe {
 
@@ -31,6 +32,28 @@ void caffe_cpu_gemm<double>(const CBLAS_TRANSPOSE TransA,
       ldb, beta, C, N);
 }
 
+template<>
+void caffe_cpu_gemm<float>(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const float alpha, const float* A, const float* B, const float beta,
+    float* C, const int ldc) {
+  int lda = (TransA == CblasNoTrans) ? K : M;
+  int ldb = (TransB == CblasNoTrans) ? N : K;
+  cblas_sgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B,
+      ldb, beta, C, ldc);
+}
+
+template<>
+void caffe_cpu_gemm<double>(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const double alpha, const double* A, const double* B, const double beta,
+    double* C, const int ldc) {
+  int lda = (TransA == CblasNoTrans) ? K : M;
+  int ldb = (TransB == CblasNoTrans) ? N : K;
+  cblas_dgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B,
+      ldb, beta, C, ldc);
+}
+
 template <>
 void caffe_cpu_gemv<float>(const CBLAS_TRANSPOSE TransA, const int M,
     const int N, const float alpha, const float* A, const float* x,
@@ -65,6 +88,7 @@ void caffe_set(const int N, const Dtype alpha, Dtype* Y) {
 }
 
 template void caffe_set<int>(const int N, const int alpha, int* Y);
+template void caffe_set<int8_t>(const int N, const int8_t alpha, int8_t* Y);
 template void caffe_set<float>(const int N, const float alpha, float* Y);
 template void caffe_set<double>(const int N, const double alpha, double* Y);
 
@@ -358,18 +382,70 @@ double caffe_cpu_asum<double>(const int n, const double* x) {
   return cblas_dasum(n, x, 1);
 }
 
+// A simple way to define the elementwise functions, built for several
+// instruction sets (see CAFFE_SIMD_CLONES). The operation should be in the
+// form e.g. y[i] = std::fabs(x[i])
+#define DEFINE_CAFFE_CPU_UNARY_FUNC(name, operation) \
+  template <typename Dtype> \
+  static inline void name##_kernel(const int n, const Dtype* x, Dtype* y) { \
+    for (int i = 0; i < n; ++i) { \
+      operation; \
+    } \
+  } \
+  CAFFE_SIMD_CLONES static void name##_kernel_float(const int n, \
+      const float* x, float* y) { \
+    name##_kernel(n, x, y); \
+  } \
+  CAFFE_SIMD_CLONES static void name##_kernel_double(const int n, \
+      const double* x, double* y) { \
+    name##_kernel(n, x, y); \
+  } \
+  template <> \
+  void caffe_cpu_##name<float>(const int n, const float* x, float* y) { \
+    CHECK_GT(n, 0); CHECK(x); CHECK(y); \
+    name##_kernel_float(n, x, y); \
+  } \
+  template <> \
+  void caffe_cpu_##name<double>(const int n, const double* x, double* y) { \
+    CHECK_GT(n, 0); CHECK(x); CHECK(y); \
+    name##_kernel_double(n, x, y); \
+  }
+
+DEFINE_CAFFE_CPU_UNARY_FUNC(sign, y[i] = caffe_sign<Dtype>(x[i]));
+// The extra parens are needed because CUDA < 6.5 defines signbit as a macro.
+DEFINE_CAFFE_CPU_UNARY_FUNC(sgnbit,
+    y[i] = static_cast<bool>((std::signbit)(x[i])));
+DEFINE_CAFFE_CPU_UNARY_FUNC(fabs, y[i] = std::fabs(x[i]));
+
+// y = alpha x in one pass rather than a copy and a scal.
+template <typename Dtype>
+static inline void scale_kernel(const int n, const Dtype alpha,
+    const Dtype* x, Dtype* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = alpha * x[i];
+  }
+}
+
+CAFFE_SIMD_CLONES static void scale_kernel_float(const int n,
+    const float alpha, const float* x, float* y) {
+  scale_kernel(n, alpha, x, y);
+}
+
+CAFFE_SIMD_CLONES static void scale_kernel_double(const int n,
+    const double alpha, const double* x, double* y) {
+  scale_kernel(n, alpha, x, y);
+}
+
 template <>
 void caffe_cpu_scale<float>(const int n, const float alpha, const float *x,
                             float* y) {
-  cblas_scopy(n, x, 1, y, 1);
-  cblas_sscal(n, alpha, y, 1);
+  scale_kernel_float(n, alpha, x, y);
 }
 
 template <>
 void caffe_cpu_scale<double>(const int n, const double alpha, const double *x,
                              double* y) {
-  cblas_dcopy(n, x, 1, y, 1);
-  cblas_dscal(n, alpha, y, 1);
+  scale_kernel_double(n, alpha, x, y);
 }
 
 }  // namespace caffe
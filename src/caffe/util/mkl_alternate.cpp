@@ -0,0 +1,145 @@
+#ifndef USE_MKL
+
+#include <cmath>
+#include <limits>
+
+#include "caffe/common.hpp"
+#include "caffe/util/mkl_alternate.hpp"
+#include "caffe/util/simd.hpp"
+
+// The loops below have branch-free bodies so that the compiler vectorizes
+// them in every clone of CAFFE_SIMD_CLONES, with the float exp and log of
+// simd.hpp; the double ones call libm.
+
+static inline float vsl_exp(const float x) {
+  return caffe::simd_exp(x);
+}
+
+static inline double vsl_exp(const double x) {
+  return std::exp(x);
+}
+
+static inline float vsl_log(const float x) {
+  return caffe::simd_log(x);
+}
+
+static inline double vsl_log(const double x) {
+  return std::log(x);
+}
+
+// A simple way to define the vsl unary functions. The operation should
+// be in the form e.g. y[i] = sqrt(a[i])
+#define DEFINE_VSL_UNARY_FUNC(name, operation) \
+  template<typename Dtype> \
+  static inline void v##name(const int n, const Dtype* a, Dtype* y) { \
+    for (int i = 0; i < n; ++i) { operation; } \
+  } \
+  CAFFE_SIMD_CLONES void vs##name(const int n, const float* a, float* y) { \
+    CHECK_GT(n, 0); CHECK(a); CHECK(y); \
+    v##name<float>(n, a, y); \
+  } \
+  CAFFE_SIMD_CLONES void vd##name(const int n, const double* a, \
+      double* y) { \
+    CHECK_GT(n, 0); CHECK(a); CHECK(y); \
+    v##name<double>(n, a, y); \
+  }
+
+DEFINE_VSL_UNARY_FUNC(Sqr, y[i] = a[i] * a[i]);
+DEFINE_VSL_UNARY_FUNC(Exp, y[i] = vsl_exp(a[i]));
+DEFINE_VSL_UNARY_FUNC(Ln, y[i] = vsl_log(a[i]));
+DEFINE_VSL_UNARY_FUNC(Abs, y[i] = std::fabs(a[i]));
+
+// pow(a, b) is exp(b log(a)) if every a is positive and finite, as they
+// mostly are, or else left to libm; a may be y, so it is checked first.
+CAFFE_SIMD_CLONES void vsPowx(const int n, const float* a, const float b,
+    float* y) {
+  CHECK_GT(n, 0); CHECK(a); CHECK(y);
+  if (b == 2) {
+    vSqr<float>(n, a, y);
+    return;
+  }
+  int special = 0;
+  for (int i = 0; i < n; ++i) {
+    special += !(a[i] > 0) | (a[i] == std::numeric_limits<float>::infinity());
+  }
+  if (special) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = std::pow(a[i], b);
+    }
+    return;
+  }
+  for (int i = 0; i < n; ++i) {
+    y[i] = vsl_exp(b * vsl_log(a[i]));
+  }
+}
+
+void vdPowx(const int n, const double* a, const double b, double* y) {
+  CHECK_GT(n, 0); CHECK(a); CHECK(y);
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::pow(a[i], b);
+  }
+}
+
+// A simple way to define the vsl binary functions. The operation should
+// be in the form e.g. y[i] = a[i] + b[i]
+#define DEFINE_VSL_BINARY_FUNC(name, operation) \
+  template<typename Dtype> \
+  static inline void v##name(const int n, const Dtype* a, const Dtype* b, \
+      Dtype* y) { \
+    for (int i = 0; i < n; ++i) { operation; } \
+  } \
+  CAFFE_SIMD_CLONES void vs##name(const int n, const float* a, \
+      const float* b, float* y) { \
+    CHECK_GT(n, 0); CHECK(a); CHECK(b); CHECK(y); \
+    v##name<float>(n, a, b, y); \
+  } \
+  CAFFE_SIMD_CLONES void vd##name(const int n, const double* a, \
+      const double* b, double* y) { \
+    CHECK_GT(n, 0); CHECK(a); CHECK(b); CHECK(y); \
+    v##name<double>(n, a, b, y); \
+  }
+
+DEFINE_VSL_BINARY_FUNC(Add, y[i] = a[i] + b[i]);
+DEFINE_VSL_BINARY_FUNC(Sub, y[i] = a[i] - b[i]);
+DEFINE_VSL_BINARY_FUNC(Mul, y[i] = a[i] * b[i]);
+DEFINE_VSL_BINARY_FUNC(Div, y[i] = a[i] / b[i]);
+
+// Y = alpha X + beta Y in one pass, where Y is only written for beta = 0, as
+// by scal; other increments take the two BLAS passes.
+template <typename Dtype>
+static inline void vaxpby(const int n, const Dtype alpha, const Dtype* x,
+    const Dtype beta, Dtype* y) {
+  if (beta == 0) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = alpha * x[i];
+    }
+  } else {
+    for (int i = 0; i < n; ++i) {
+      y[i] = alpha * x[i] + beta * y[i];
+    }
+  }
+}
+
+CAFFE_SIMD_CLONES void cblas_saxpby(const int N, const float alpha,
+    const float* X, const int incX, const float beta, float* Y,
+    const int incY) {
+  if (incX != 1 || incY != 1) {
+    cblas_sscal(N, beta, Y, incY);
+    cblas_saxpy(N, alpha, X, incX, Y, incY);
+    return;
+  }
+  vaxpby(N, alpha, X, beta, Y);
+}
+
+CAFFE_SIMD_CLONES void cblas_daxpby(const int N, const double alpha,
+    const double* X, const int incX, const double beta, double* Y,
+    const int incY) {
+  if (incX != 1 || incY != 1) {
+    cblas_dscal(N, beta, Y, incY);
+    cblas_daxpy(N, alpha, X, incX, Y, incY);
+    return;
+  }
+  vaxpby(N, alpha, X, beta, Y);
+}
+
+#endif  // USE_MKL
@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/nchwc.hpp"
+#include "caffe/util/parallel.hpp"
+#include "caffe/util/simd.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void nchw_to_nchwc_cpu(const int num, const int channels,
+    const int spatial_dim, const int block, const Dtype* src, Dtype* dst) {
+  for (int n = 0; n < num; ++n) {
+    for (int c = 0; c < channels; ++c) {
+      const Dtype* src_channel = src + (n * channels + c) * spatial_dim;
+      Dtype* dst_channel = dst + ((n * channels + c - c % block) *
+          spatial_dim) + c % block;
+      for (int i = 0; i < spatial_dim; ++i) {
+        dst_channel[i * block] = src_channel[i];
+      }
+    }
+  }
+}
+
+template void nchw_to_nchwc_cpu<float>(const int num, const int channels,
+    const int spatial_dim, const int block, const float* src, float* dst);
+template void nchw_to_nchwc_cpu<double>(const int num, const int channels,
+    const int spatial_dim, const int block, const double* src, double* dst);
+
+template <typename Dtype>
+void nchwc_to_nchw_cpu(const int num, const int channels,
+    const int spatial_dim, const int block, const Dtype* src, Dtype* dst) {
+  for (int n = 0; n < num; ++n) {
+    for (int c = 0; c < channels; ++c) {
+      const Dtype* src_channel = src + ((n * channels + c - c % block) *
+          spatial_dim) + c % block;
+      Dtype* dst_channel = dst + (n * channels + c) * spatial_dim;
+      for (int i = 0; i < spatial_dim; ++i) {
+        dst_channel[i] = src_channel[i * block];
+      }
+    }
+  }
+}
+
+template void nchwc_to_nchw_cpu<float>(const int num, const int channels,
+    const int spatial_dim, const int block, const float* src, float* dst);
+template void nchwc_to_nchw_cpu<double>(const int num, const int channels,
+    const int spatial_dim, const int block, const double* src, double* dst);
+
+template <typename Dtype>
+void conv_weights_to_nchwc_cpu(const Dtype* weights, const int num_output,
+    const int channels, const int kernel_h, const int kernel_w,
+    const int block, Dtype* dst) {
+  const int kernel_size = kernel_h * kernel_w;
+  for (int o = 0; o < num_output; ++o) {
+    for (int c = 0; c < channels; ++c) {
+      const Dtype* src_kernel = weights + (o * channels + c) * kernel_size;
+      // The block of the output and input channel, then the kernel offset.
+      Dtype* dst_kernel = dst + ((o / block) * (channels / block) + c / block)
+          * kernel_size * block * block + (c % block) * block + o % block;
+      for (int k = 0; k < kernel_size; ++k) {
+        dst_kernel[k * block * block] = src_kernel[k];
+      }
+    }
+  }
+}
+
+template void conv_weights_to_nchwc_cpu<float>(const float* weights,
+    const int num_output, const int channels, const int kernel_h,
+    const int kernel_w, const int block, float* dst);
+template void conv_weights_to_nchwc_cpu<double>(const double* weights,
+    const int num_output, const int channels, const int kernel_h,
+    const int kernel_w, const int block, double* dst);
+
+// The outputs of a row whose block of output channels conv_nchwc_tile sums
+// at once.
+const int kNchwcTile = 4;
+
+// Sums, for the kNchwcTile outputs of a row from output, their block of
+// kBlock output channels over the input blocks and the kernel offsets k: the
+// input of output t is at offsets[k * kNchwcTile + t] in each input block,
+// times mask[k * kNchwcTile + t], which is 0 in the padding. Each weight
+// row is multiplied into the four outputs at once, along the output
+// channels, and the sums are written to the first outputs outputs. block,
+// which equals kBlock, bounds the input channels at run time so that the
+// compiler keeps that loop rolled.
+#define DEFINE_CONV_NCHWC_TILE(Dtype, kBlock) \
+  CAFFE_SIMD_CLONES static void conv_nchwc_tile_##Dtype##_##kBlock( \
+      const int block, const int input_blocks, const int input_block_size, \
+      const int kernel_size, const int* offsets, const Dtype* mask, \
+      const Dtype* input, const Dtype* weights, const int outputs, \
+      Dtype* output) { \
+    Dtype sum0[kBlock], sum1[kBlock], sum2[kBlock], sum3[kBlock]; \
+    for (int oc = 0; oc < kBlock; ++oc) { \
+      sum0[oc] = sum1[oc] = sum2[oc] = sum3[oc] = 0; \
+    } \
+    for (int ib = 0; ib < input_blocks; ++ib) { \
+      const Dtype* in = input + ib * input_block_size; \
+      for (int k = 0; k < kernel_size; ++k) { \
+        const Dtype* w = weights + (ib * kernel_size + k) * kBlock * kBlock; \
+        const int* offset = offsets + k * kNchwcTile; \
+        const Dtype* scale = mask + k * kNchwcTile; \
+        const Dtype* in0 = in + offset[0]; \
+        const Dtype* in1 = in + offset[1]; \
+        const Dtype* in2 = in + offset[2]; \
+        const Dtype* in3 = in + offset[3]; \
+        for (int ic = 0; ic < block; ++ic) { \
+          const Dtype v0 = in0[ic] * scale[0]; \
+          const Dtype v1 = in1[ic] * scale[1]; \
+          const Dtype v2 = in2[ic] * scale[2]; \
+          const Dtype v3 = in3[ic] * scale[3]; \
+          const Dtype* w_row = w + ic * kBlock; \
+          for (int oc = 0; oc < kBlock; ++oc) { \
+            sum0[oc] += v0 * w_row[oc]; \
+            sum1[oc] += v1 * w_row[oc]; \
+            sum2[oc] += v2 * w_row[oc]; \
+            sum3[oc] += v3 * w_row[oc]; \
+          } \
+        } \
+      } \
+    } \
+    const Dtype* sums[kNchwcTile] = {sum0, sum1, sum2, sum3}; \
+    for (int t = 0; t < outputs; ++t) { \
+      for (int oc = 0; oc < kBlock; ++oc) { \
+        output[t * kBlock + oc] = sums[t][oc]; \
+      } \
+    } \
+  }
+
+// Only blocks of 16 fill the vectors along the output channels: with blocks of
+// 8 the compiler vectorizes across the input channels instead, which is no
+// faster than conv_nchwc_tile_any (see BaseConvolutionLayer).
+DEFINE_CONV_NCHWC_TILE(float, 16)
+DEFINE_CONV_NCHWC_TILE(double, 16)
+
+// The same for the other blocks, summing in the output.
+template <typename Dtype>
+void conv_nchwc_tile_any(const int block, const int input_blocks,
+    const int input_block_size, const int kernel_size, const int* offsets,
+    const Dtype* mask, const Dtype* input, const Dtype* weights,
+    const int outputs, Dtype* output) {
+  caffe_set(outputs * block, Dtype(0), output);
+  for (int ib = 0; ib < input_blocks; ++ib) {
+    const Dtype* in = input + ib * input_block_size;
+    for (int k = 0; k < kernel_size; ++k) {
+      const Dtype* w = weights + (ib * kernel_size + k) * block * block;
+      for (int t = 0; t < outputs; ++t) {
+        const Dtype* in_t = in + offsets[k * kNchwcTile + t];
+        const Dtype scale = mask[k * kNchwcTile + t];
+        Dtype* out = output + t * block;
+        for (int ic = 0; ic < block; ++ic) {
+          const Dtype value = in_t[ic] * scale;
+          for (int oc = 0; oc < block; ++oc) {
+            out[oc] += value * w[ic * block + oc];
+          }
+        }
+      }
+    }
+  }
+}
+
+#define CONV_NCHWC_TILE(Dtype) \
+  inline void conv_nchwc_tile(const int block, const int input_blocks, \
+      const int input_block_size, const int kernel_size, const int* offsets, \
+      const Dtype* mask, const Dtype* input, const Dtype* weights, \
+      const int outputs, Dtype* output) { \
+    if (block == 16) { \
+      conv_nchwc_tile_##Dtype##_16(block, input_blocks, input_block_size, \
+          kernel_size, offsets, mask, input, weights, outputs, output); \
+    } else { \
+      conv_nchwc_tile_any(block, input_blocks, input_block_size, \
+          kernel_size, offsets, mask, input, weights, outputs, output); \
+    } \
+  }
+
+CONV_NCHWC_TILE(float)
+CONV_NCHWC_TILE(double)
+
+// The rows of the output blocks of conv_nchwc_cpu, by tiles of kNchwcTile
+// outputs.
+template <typename Dtype>
+class ConvNchwcRows {
+ public:
+  ConvNchwcRows(const Dtype* input, const int channels, const int height,
+      const int width, const Dtype* weights, const int kernel_h,
+      const int kernel_w, const int pad_h, const int pad_w,
+      const int stride_h, const int stride_w, const int dilation_h,
+      const int dilation_w, const int block, const int output_h,
+      const int output_w, Dtype* output)
+      : input_(input), channels_(channels), height_(height), width_(width),
+        weights_(weights), kernel_h_(kernel_h), kernel_w_(kernel_w),
+        pad_h_(pad_h), pad_w_(pad_w), stride_h_(stride_h),
+        stride_w_(stride_w), dilation_h_(dilation_h),
+        dilation_w_(dilation_w), block_(block), output_h_(output_h),
+        output_w_(output_w), output_(output) {}
+
+  void operator()(const int begin, const int end) const {
+    const int block = block_;
+    const int input_blocks = channels_ / block;
+    const int kernel_size = kernel_h_ * kernel_w_;
+    std::vector<int> offsets(kernel_size * kNchwcTile);
+    std::vector<Dtype> mask(kernel_size * kNchwcTile);
+    for (int row = begin; row < end; ++row) {
+      const int ob = row / output_h_;
+      const int oh = row % output_h_;
+      const Dtype* weights =
+          weights_ + ob * input_blocks * kernel_size * block * block;
+      Dtype* output = output_ + row * output_w_ * block;
+      for (int ow = 0; ow < output_w_; ow += kNchwcTile) {
+        const int outputs = std::min(kNchwcTile, output_w_ - ow);
+        for (int kh = 0; kh < kernel_h_; ++kh) {
+          const int ih = oh * stride_h_ - pad_h_ + kh * dilation_h_;
+          for (int kw = 0; kw < kernel_w_; ++kw) {
+            const int k = (kh * kernel_w_ + kw) * kNchwcTile;
+            for (int t = 0; t < kNchwcTile; ++t) {
+              const int iw = (ow + t) * stride_w_ - pad_w_ + kw * dilation_w_;
+              const bool inside = t < outputs && ih >= 0 && ih < height_ &&
+                  iw >= 0 && iw < width_;
+              offsets[k + t] = inside ? (ih * width_ + iw) * block : 0;
+              mask[k + t] = inside ? Dtype(1) : Dtype(0);
+            }
+          }
+        }
+        conv_nchwc_tile(block, input_blocks, height_ * width_ * block,
+            kernel_size, &offsets[0], &mask[0], input_, weights, outputs,
+            output + ow * block);
+      }
+    }
+  }
+
+ private:
+  const Dtype* input_;
+  const int channels_, height_, width_;
+  const Dtype* weights_;
+  const int kernel_h_, kernel_w_, pad_h_, pad_w_, stride_h_, stride_w_;
+  const int dilation_h_, dilation_w_, block_, output_h_, output_w_;
+  Dtype* output_;
+};
+
+template <typename Dtype>
+void conv_nchwc_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const Dtype* weights,
+    const int num_output, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int block,
+    Dtype* data_out) {
+  const int output_h = (height + 2 * pad_h -
+      (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+  const int output_w = (width + 2 * pad_w -
+      (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+  parallel_for((num_output / block) * output_h, ConvNchwcRows<Dtype>(data_im,
+      channels, height, width, weights, kernel_h, kernel_w, pad_h, pad_w,
+      stride_h, stride_w, dilation_h, dilation_w, block, output_h, output_w,
+      data_out), parallel_grain(output_w * block * channels * kernel_h *
+      kernel_w));
+}
+
+template void conv_nchwc_cpu<float>(const float* data_im, const int channels,
+    const int height, const int width, const float* weights,
+    const int num_output, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int block,
+    float* data_out);
+template void conv_nchwc_cpu<double>(const double* data_im,
+    const int channels, const int height, const int width,
+    const double* weights, const int num_output, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int block, double* data_out);
+
+}  // namespace caffe
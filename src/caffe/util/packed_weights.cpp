@@ -0,0 +1,49 @@
+#include <algorithm>
+
+#include "caffe/util/packed_weights.hpp"
+
+namespace caffe {
+
+// The size of a panel of unpacked weights, which stays in the L2 cache of a
+// core along with the panels of the other operand of the GEMM.
+const int kPackedWeightsPanelBytes = 128 << 10;
+
+template <typename Dtype>
+int PackedWeights<Dtype>::panel_rows(const int row_size) {
+  return std::max(1, static_cast<int>(kPackedWeightsPanelBytes /
+      (std::max(row_size, 1) * sizeof(Dtype))));
+}
+
+template <typename Dtype>
+const Dtype* PackedWeights<Dtype>::Panel(const Blob<Dtype>& weights,
+    const int row_size, const int row_begin, const int row_end) {
+  if (!weights.data_packed()) {
+    return weights.cpu_data() + row_begin * row_size;
+  }
+  const size_t size = (row_end - row_begin) * row_size * sizeof(Dtype);
+  if (!panel_ || panel_->size() < size) {
+    panel_.reset(new SyncedMemory(size));
+  }
+  Dtype* panel = static_cast<Dtype*>(panel_->mutable_cpu_data());
+  weights.UnpackTo(row_begin * row_size, (row_end - row_begin) * row_size,
+      panel);
+  return panel;
+}
+
+template <typename Dtype>
+const Blob<Dtype>& PackedWeights<Dtype>::Int8(const Blob<Dtype>& weights) {
+  if (int8_memory_ != weights.data() ||
+      int8_version_ != int8_memory_->version()) {
+    // Packing a blob sharing the weights replaces its own data only.
+    int8_.ReshapeLike(weights);
+    int8_.ShareData(weights);
+    int8_.Pack(INT8);
+    int8_memory_ = weights.data();
+    int8_version_ = int8_memory_->version();
+  }
+  return int8_;
+}
+
+INSTANTIATE_CLASS(PackedWeights);
+
+}  // namespace caffe
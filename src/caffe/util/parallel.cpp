@@ -0,0 +1,55 @@
+#include <algorithm>
+
+#include "caffe/util/parallel.hpp"
+
+#ifdef USE_MKL
+#include <mkl.h>
+#elif defined(USE_OPENBLAS)
+extern "C" {
+int openblas_get_num_threads(void);
+int openblas_get_parallel(void);
+void openblas_set_num_threads(int num_threads);
+}
+#endif
+
+namespace caffe {
+
+int parallel_threads(const int n, const int grain) {
+#ifdef _OPENMP
+  if (omp_in_parallel()) {
+    return 1;
+  }
+  return std::max(1, std::min(Caffe::num_threads(),
+      n / std::max(grain, 1)));
+#else
+  return 1;
+#endif
+}
+
+void caffe_set_blas_num_threads(const int threads) {
+#ifdef USE_MKL
+  mkl_set_num_threads(threads);
+#elif defined(USE_OPENBLAS)
+  openblas_set_num_threads(threads);
+#endif
+}
+
+BlasThreadsGuard::BlasThreadsGuard(const int threads) : blas_threads_(0) {
+#if defined(USE_OPENBLAS) && !defined(USE_MKL)
+  // 1 is the pthreads build of OpenBLAS.
+  if (threads > 1 && openblas_get_parallel() == 1) {
+    blas_threads_ = openblas_get_num_threads();
+    if (blas_threads_ > 1) {
+      openblas_set_num_threads(1);
+    }
+  }
+#endif
+}
+
+BlasThreadsGuard::~BlasThreadsGuard() {
+  if (blas_threads_ > 1) {
+    caffe_set_blas_num_threads(blas_threads_);
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/util/parallel.hpp"
+#include "caffe/util/quantize.hpp"
+#include "caffe/util/simd.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+Dtype caffe_cpu_amax(const int n, const Dtype* x) {
+  Dtype amax = 0;
+  for (int i = 0; i < n; ++i) {
+    amax = std::max(amax, std::fabs(x[i]));
+  }
+  return amax;
+}
+
+template float caffe_cpu_amax<float>(const int n, const float* x);
+template double caffe_cpu_amax<double>(const int n, const double* x);
+
+template <typename Dtype>
+void caffe_cpu_quantize(const int n, const Dtype* x, const Dtype scale,
+    int8_t* y) {
+  const Dtype inv_scale = Dtype(1) / scale;
+  for (int i = 0; i < n; ++i) {
+    const Dtype value = std::min(std::max(x[i] * inv_scale,
+        Dtype(-kInt8Max)), Dtype(kInt8Max));
+    y[i] = static_cast<int8_t>(value >= 0 ? value + Dtype(0.5)
+        : value - Dtype(0.5));
+  }
+}
+
+template void caffe_cpu_quantize<float>(const int n, const float* x,
+    const float scale, int8_t* y);
+template void caffe_cpu_quantize<double>(const int n, const double* x,
+    const double scale, int8_t* y);
+
+template <typename Dtype>
+void caffe_cpu_dequantize(const int n, const int8_t* x, const Dtype scale,
+    Dtype* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = x[i] * scale;
+  }
+}
+
+template void caffe_cpu_dequantize<float>(const int n, const int8_t* x,
+    const float scale, float* y);
+template void caffe_cpu_dequantize<double>(const int n, const int8_t* x,
+    const double scale, double* y);
+
+template <typename Dtype>
+void caffe_cpu_quantize_slices(const int slices, const int slice_size,
+    const Dtype* x, int8_t* y, float* scales) {
+  for (int i = 0; i < slices; ++i) {
+    const Dtype* slice = x + i * slice_size;
+    const Dtype scale = int8_scale(caffe_cpu_amax(slice_size, slice));
+    caffe_cpu_quantize(slice_size, slice, scale, y + i * slice_size);
+    scales[i] = scale;
+  }
+}
+
+template void caffe_cpu_quantize_slices<float>(const int slices,
+    const int slice_size, const float* x, int8_t* y, float* scales);
+template void caffe_cpu_quantize_slices<double>(const int slices,
+    const int slice_size, const double* x, int8_t* y, float* scales);
+
+template <typename Dtype>
+void caffe_cpu_dequantize_slices(const int slices, const int slice_size,
+    const int8_t* x, const float* scales, Dtype* y) {
+  for (int i = 0; i < slices; ++i) {
+    caffe_cpu_dequantize(slice_size, x + i * slice_size, Dtype(scales[i]),
+        y + i * slice_size);
+  }
+}
+
+template void caffe_cpu_dequantize_slices<float>(const int slices,
+    const int slice_size, const int8_t* x, const float* scales, float* y);
+template void caffe_cpu_dequantize_slices<double>(const int slices,
+    const int slice_size, const int8_t* x, const float* scales, double* y);
+
+// c[j] += a . b_j for the rows b_j = b + j * ldb of k entries, four rows at
+// a time to share the loads of a. With b widened to 16 bits the compiler
+// vectorizes the dot products into multiply-adds of pairs of 16-bit
+// products (pmaddwd), which it does not for two int8 operands.
+CAFFE_SIMD_CLONES static void int8_dot_rows(const int k, const int8_t* a,
+    const int rows, const int16_t* b, const int ldb, int32_t* c) {
+  int j = 0;
+  for (; j + 3 < rows; j += 4) {
+    const int16_t* b0 = b + j * ldb;
+    const int16_t* b1 = b0 + ldb;
+    const int16_t* b2 = b1 + ldb;
+    const int16_t* b3 = b2 + ldb;
+    int32_t sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+    for (int i = 0; i < k; ++i) {
+      const int16_t x = a[i];
+      sum0 += x * b0[i];
+      sum1 += x * b1[i];
+      sum2 += x * b2[i];
+      sum3 += x * b3[i];
+    }
+    c[j] += sum0;
+    c[j + 1] += sum1;
+    c[j + 2] += sum2;
+    c[j + 3] += sum3;
+  }
+  for (; j < rows; ++j) {
+    const int16_t* b0 = b + j * ldb;
+    int32_t sum = 0;
+    for (int i = 0; i < k; ++i) {
+      const int16_t x = a[i];
+      sum += x * b0[i];
+    }
+    c[j] += sum;
+  }
+}
+
+// The GEMM runs in blocks of B of kInt8BlockSize entries, 128KB once packed
+// in 16 bits, which stay in the L2 cache while every row of A multiplies
+// them, so that B is read from memory once per product rather than once per
+// row of A. Either way the entries of C are dot products along K: the
+// blocks of B not transposed are packed transposed, kInt8BlockN columns by
+// kInt8BlockK rows at a time.
+const int kInt8BlockN = 256;
+const int kInt8BlockK = 256;
+const int kInt8BlockSize = kInt8BlockN * kInt8BlockK;
+
+// C = A * B over a range of blocks of kInt8BlockN columns of C.
+class Int8GemmBlocks {
+ public:
+  Int8GemmBlocks(const int M, const int N, const int K, const int8_t* A,
+      const int8_t* B, int32_t* C)
+      : M_(M), N_(N), K_(K), A_(A), B_(B), C_(C) {}
+
+  void operator()(const int begin, const int end) const {
+    vector<int16_t> packed(kInt8BlockSize);
+    for (int block = begin; block < end; ++block) {
+      const int j0 = block * kInt8BlockN;
+      const int nb = std::min(kInt8BlockN, N_ - j0);
+      for (int i = 0; i < M_; ++i) {
+        std::fill(C_ + i * N_ + j0, C_ + i * N_ + j0 + nb, 0);
+      }
+      for (int k0 = 0; k0 < K_; k0 += kInt8BlockK) {
+        const int kb = std::min(kInt8BlockK, K_ - k0);
+        // The block of B as nb rows of kb.
+        for (int k = 0; k < kb; ++k) {
+          const int8_t* b = B_ + (k0 + k) * N_ + j0;
+          for (int j = 0; j < nb; ++j) {
+            packed[j * kb + k] = b[j];
+          }
+        }
+        for (int i = 0; i < M_; ++i) {
+          int8_dot_rows(kb, A_ + i * K_ + k0, nb, &packed[0], kb,
+              C_ + i * N_ + j0);
+        }
+      }
+    }
+  }
+
+ private:
+  const int M_, N_, K_;
+  const int8_t* A_;
+  const int8_t* B_;
+  int32_t* C_;
+};
+
+// C = A * B^T over a range of blocks of block_rows rows of B, which are the
+// columns of C.
+class Int8GemmTransposedBlocks {
+ public:
+  Int8GemmTransposedBlocks(const int M, const int N, const int K,
+      const int block_rows, const int8_t* A, const int8_t* B, int32_t* C)
+      : M_(M), N_(N), K_(K), block_rows_(block_rows), A_(A), B_(B), C_(C) {}
+
+  void operator()(const int begin, const int end) const {
+    vector<int16_t> packed(block_rows_ * K_);
+    for (int block = begin; block < end; ++block) {
+      const int j0 = block * block_rows_;
+      const int nb = std::min(block_rows_, N_ - j0);
+      std::copy(B_ + j0 * K_, B_ + (j0 + nb) * K_, packed.begin());
+      for (int i = 0; i < M_; ++i) {
+        int32_t* c = C_ + i * N_ + j0;
+        std::fill(c, c + nb, 0);
+        int8_dot_rows(K_, A_ + i * K_, nb, &packed[0], K_, c);
+      }
+    }
+  }
+
+ private:
+  const int M_, N_, K_, block_rows_;
+  const int8_t* A_;
+  const int8_t* B_;
+  int32_t* C_;
+};
+
+void caffe_cpu_gemm_int8(const CBLAS_TRANSPOSE TransB, const int M,
+    const int N, const int K, const int8_t* A, const int8_t* B, int32_t* C) {
+  // The work of a block, bounded so as not to overflow an int.
+  const int row_work = std::min(M * K, kParallelWork);
+  if (TransB == CblasNoTrans) {
+    parallel_for((N + kInt8BlockN - 1) / kInt8BlockN,
+        Int8GemmBlocks(M, N, K, A, B, C),
+        parallel_grain(row_work * kInt8BlockN));
+  } else {
+    const int block_rows = std::max(4, kInt8BlockSize / std::max(K, 1));
+    parallel_for((N + block_rows - 1) / block_rows,
+        Int8GemmTransposedBlocks(M, N, K, block_rows, A, B, C),
+        parallel_grain(row_work * block_rows));
+  }
+}
+
+}  // namespace caffe
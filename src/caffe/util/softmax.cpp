@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <cmath>
+
+#include "caffe/util/fast_math.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/parallel.hpp"
+#include "caffe/util/softmax.hpp"
+
+namespace caffe {
+
+// The width of the tiles of the softmaxes over the channels of the planes
+// (inner_num > 1), whose rows stay in L1 from the max to the division.
+const int kSoftmaxTile = 256;
+
+// The number of items of the softmaxes of an outer index: the row of
+// channels if inner_num is 1, or else the tiles of the plane.
+static int softmax_tiles(const int inner_num) {
+  return inner_num == 1 ? 1 : (inner_num + kSoftmaxTile - 1) / kSoftmaxTile;
+}
+
+template <typename Dtype>
+class SoftmaxForward {
+ public:
+  SoftmaxForward(const int channels, const int inner_num, const Dtype* x,
+      Dtype* y, Dtype* log_norm, const bool fast)
+      : channels_(channels), inner_num_(inner_num), x_(x), y_(y),
+        log_norm_(log_norm), fast_(fast) {}
+
+  void operator()(const int begin, const int end) const {
+    const int tiles = softmax_tiles(inner_num_);
+    for (int i = begin; i < end; ++i) {
+      const int outer = i / tiles;
+      const int first = i % tiles * kSoftmaxTile;
+      const int offset = outer * channels_ * inner_num_ + first;
+      Dtype* log_norm = log_norm_ ?
+          log_norm_ + outer * inner_num_ + first : NULL;
+      if (inner_num_ == 1) {
+        Row(x_ + offset, y_ + offset, log_norm);
+      } else {
+        Tile(std::min(kSoftmaxTile, inner_num_ - first), x_ + offset,
+            y_ + offset, log_norm);
+      }
+    }
+  }
+
+ private:
+  void Exp(const int n, Dtype* y) const {
+    if (fast_) {
+      caffe_cpu_fast_exp(n, y, y);
+    } else {
+      caffe_exp(n, y, y);
+    }
+  }
+
+  // A softmax of contiguous channels; the exps are positive, so their sum
+  // is their asum.
+  void Row(const Dtype* x, Dtype* y, Dtype* log_norm) const {
+    Dtype max_value = x[0];
+    for (int j = 1; j < channels_; ++j) {
+      max_value = std::max(max_value, x[j]);
+    }
+    for (int j = 0; j < channels_; ++j) {
+      y[j] = x[j] - max_value;
+    }
+    Exp(channels_, y);
+    const Dtype sum = caffe_cpu_asum(channels_, y);
+    if (log_norm) {
+      *log_norm = max_value + std::log(sum);
+    }
+    if (fast_) {
+      caffe_scal(channels_, Dtype(1) / sum, y);
+    } else {
+      for (int j = 0; j < channels_; ++j) {
+        y[j] /= sum;
+      }
+    }
+  }
+
+  // The softmaxes of a tile of n positions of a plane.
+  void Tile(const int n, const Dtype* x, Dtype* y, Dtype* log_norm) const {
+    Dtype max_value[kSoftmaxTile];
+    Dtype sum[kSoftmaxTile];
+    for (int k = 0; k < n; ++k) {
+      max_value[k] = x[k];
+      sum[k] = 0;
+    }
+    for (int j = 1; j < channels_; ++j) {
+      const Dtype* x_j = x + j * inner_num_;
+      for (int k = 0; k < n; ++k) {
+        max_value[k] = std::max(max_value[k], x_j[k]);
+      }
+    }
+    for (int j = 0; j < channels_; ++j) {
+      const Dtype* x_j = x + j * inner_num_;
+      Dtype* y_j = y + j * inner_num_;
+      for (int k = 0; k < n; ++k) {
+        y_j[k] = x_j[k] - max_value[k];
+      }
+      Exp(n, y_j);
+      for (int k = 0; k < n; ++k) {
+        sum[k] += y_j[k];
+      }
+    }
+    if (log_norm) {
+      for (int k = 0; k < n; ++k) {
+        log_norm[k] = max_value[k] + std::log(sum[k]);
+      }
+    }
+    if (fast_) {
+      for (int k = 0; k < n; ++k) {
+        sum[k] = Dtype(1) / sum[k];
+      }
+    }
+    for (int j = 0; j < channels_; ++j) {
+      Dtype* y_j = y + j * inner_num_;
+      if (fast_) {
+        caffe_mul(n, y_j, sum, y_j);
+      } else {
+        caffe_div(n, y_j, sum, y_j);
+      }
+    }
+  }
+
+  const int channels_, inner_num_;
+  const Dtype* x_;
+  Dtype* y_;
+  Dtype* log_norm_;
+  const bool fast_;
+};
+
+template <typename Dtype>
+void caffe_cpu_softmax(const int outer_num, const int channels,
+    const int inner_num, const Dtype* x, Dtype* y, Dtype* log_norm,
+    const bool fast) {
+  parallel_for(outer_num * softmax_tiles(inner_num),
+      SoftmaxForward<Dtype>(channels, inner_num, x, y, log_norm, fast),
+      parallel_grain(channels * std::min(inner_num, kSoftmaxTile)));
+}
+
+template void caffe_cpu_softmax<float>(const int outer_num,
+    const int channels, const int inner_num, const float* x, float* y,
+    float* log_norm, const bool fast);
+template void caffe_cpu_softmax<double>(const int outer_num,
+    const int channels, const int inner_num, const double* x, double* y,
+    double* log_norm, const bool fast);
+
+template <typename Dtype>
+class SoftmaxBackward {
+ public:
+  SoftmaxBackward(const int channels, const int inner_num, const Dtype* y,
+      const Dtype* y_diff, Dtype* x_diff)
+      : channels_(channels), inner_num_(inner_num), y_(y), y_diff_(y_diff),
+        x_diff_(x_diff) {}
+
+  void operator()(const int begin, const int end) const {
+    const int tiles = softmax_tiles(inner_num_);
+    for (int i = begin; i < end; ++i) {
+      const int first = i % tiles * kSoftmaxTile;
+      const int offset = i / tiles * channels_ * inner_num_ + first;
+      const Dtype* y = y_ + offset;
+      const Dtype* y_diff = y_diff_ + offset;
+      Dtype* x_diff = x_diff_ + offset;
+      if (inner_num_ == 1) {
+        const Dtype dot = caffe_cpu_dot(channels_, y_diff, y);
+        for (int j = 0; j < channels_; ++j) {
+          x_diff[j] = y[j] * (y_diff[j] - dot);
+        }
+        continue;
+      }
+      const int n = std::min(kSoftmaxTile, inner_num_ - first);
+      Dtype dot[kSoftmaxTile];
+      for (int k = 0; k < n; ++k) {
+        dot[k] = 0;
+      }
+      for (int j = 0; j < channels_; ++j) {
+        for (int k = 0; k < n; ++k) {
+          dot[k] += y_diff[j * inner_num_ + k] * y[j * inner_num_ + k];
+        }
+      }
+      for (int j = 0; j < channels_; ++j) {
+        for (int k = 0; k < n; ++k) {
+          x_diff[j * inner_num_ + k] = y[j * inner_num_ + k] *
+              (y_diff[j * inner_num_ + k] - dot[k]);
+        }
+      }
+    }
+  }
+
+ private:
+  const int channels_, inner_num_;
+  const Dtype* y_;
+  const Dtype* y_diff_;
+  Dtype* x_diff_;
+};
+
+template <typename Dtype>
+void caffe_cpu_softmax_backward(const int outer_num, const int channels,
+    const int inner_num, const Dtype* y, const Dtype* y_diff,
+    Dtype* x_diff) {
+  parallel_for(outer_num * softmax_tiles(inner_num),
+      SoftmaxBackward<Dtype>(channels, inner_num, y, y_diff, x_diff),
+      parallel_grain(channels * std::min(inner_num, kSoftmaxTile)));
+}
+
+template void caffe_cpu_softmax_backward<float>(const int outer_num,
+    const int channels, const int inner_num, const float* y,
+    const float* y_diff, float* x_diff);
+template void caffe_cpu_softmax_backward<double>(const int outer_num,
+    const int channels, const int inner_num, const double* y,
+    const double* y_diff, double* x_diff);
+
+}  // namespace caffe
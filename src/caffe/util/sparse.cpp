@@ -0,0 +1,319 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/parallel.hpp"
+#include "caffe/util/sparse.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+double caffe_cpu_sparsity(const int n, const Dtype* x) {
+  if (n == 0) {
+    return 0;
+  }
+  int zeros = 0;
+  for (int i = 0; i < n; ++i) {
+    zeros += x[i] == 0;
+  }
+  return static_cast<double>(zeros) / n;
+}
+
+template double caffe_cpu_sparsity<float>(const int n, const float* x);
+template double caffe_cpu_sparsity<double>(const int n, const double* x);
+
+template <typename Dtype>
+bool SparseWeights<Dtype>::Update(const Blob<Dtype>& weights, const int rows,
+    const float threshold) {
+  if (threshold > 1) {
+    memory_.reset();
+    active_ = false;
+    return false;
+  }
+  if (memory_ == weights.data() && version_ == memory_->version()) {
+    return active_;
+  }
+  SyncedMemory buffer(weights.count() * sizeof(Dtype));
+  const Dtype* data = weights.unpacked_cpu_data(&buffer);
+  memory_ = weights.data();
+  version_ = memory_->version();
+  sparsity_ = caffe_cpu_sparsity(weights.count(), data);
+  active_ = weights.count() > 0 && sparsity_ >= threshold;
+  row_offsets_.assign(1, 0);
+  columns_.clear();
+  values_.clear();
+  if (!active_) {
+    return false;
+  }
+  CHECK_EQ(weights.count() % rows, 0);
+  const int cols = weights.count() / rows;
+  columns_.reserve(weights.count() - static_cast<int>(sparsity_ *
+      weights.count()));
+  values_.reserve(columns_.capacity());
+  for (int r = 0; r < rows; ++r) {
+    for (int c = 0; c < cols; ++c) {
+      if (data[r * cols + c] != 0) {
+        columns_.push_back(c);
+        values_.push_back(data[r * cols + c]);
+      }
+    }
+    row_offsets_.push_back(values_.size());
+  }
+  return true;
+}
+
+// Each row of C sums the rows of B picked by the nonzeros of a row of the
+// weights, which vectorizes along N; the rows are split over the threads.
+template <typename Dtype>
+class SparseRowsMultiplyDense {
+ public:
+  SparseRowsMultiplyDense(const int row_begin, const int N,
+      const int* row_offsets, const int* columns, const Dtype* values,
+      const Dtype* B, Dtype* C)
+      : row_begin_(row_begin), N_(N), row_offsets_(row_offsets),
+        columns_(columns), values_(values), B_(B), C_(C) {}
+
+  void operator()(const int begin, const int end) const {
+    for (int r = row_begin_ + begin; r < row_begin_ + end; ++r) {
+      Dtype* c = C_ + (r - row_begin_) * N_;
+      caffe_set(N_, Dtype(0), c);
+      for (int i = row_offsets_[r]; i < row_offsets_[r + 1]; ++i) {
+        const Dtype value = values_[i];
+        const Dtype* b = B_ + columns_[i] * N_;
+        for (int j = 0; j < N_; ++j) {
+          c[j] += value * b[j];
+        }
+      }
+    }
+  }
+
+ private:
+  const int row_begin_, N_;
+  const int* row_offsets_;
+  const int* columns_;
+  const Dtype* values_;
+  const Dtype* B_;
+  Dtype* C_;
+};
+
+// Each output is a dot product of the vector B with the nonzeros of a row.
+template <typename Dtype>
+class SparseRowsDot {
+ public:
+  SparseRowsDot(const int* row_offsets, const int* columns,
+      const Dtype* values, const Dtype* B, Dtype* C)
+      : row_offsets_(row_offsets), columns_(columns), values_(values), B_(B),
+        C_(C) {}
+
+  void operator()(const int begin, const int end) const {
+    for (int r = begin; r < end; ++r) {
+      Dtype sum = 0;
+      for (int i = row_offsets_[r]; i < row_offsets_[r + 1]; ++i) {
+        sum += values_[i] * B_[columns_[i]];
+      }
+      C_[r] = sum;
+    }
+  }
+
+ private:
+  const int* row_offsets_;
+  const int* columns_;
+  const Dtype* values_;
+  const Dtype* B_;
+  Dtype* C_;
+};
+
+template <typename Dtype>
+void SparseWeights<Dtype>::MultiplyDense(const int row_begin,
+    const int row_end, const int N, const Dtype* B, Dtype* C) const {
+  CHECK(active_);
+  const int rows = row_end - row_begin;
+  const int nonzeros = row_offsets_[row_end] - row_offsets_[row_begin];
+  parallel_for(rows, SparseRowsMultiplyDense<Dtype>(row_begin, N,
+      &row_offsets_[0], columns_.empty() ? NULL : &columns_[0],
+      values_.empty() ? NULL : &values_[0], B, C),
+      parallel_grain((nonzeros / std::max(rows, 1) + 1) * N));
+}
+
+template <typename Dtype>
+void SparseWeights<Dtype>::MultiplyDenseTransposed(const int M,
+    const int cols, const Dtype* B, Dtype* C) {
+  CHECK(active_);
+  const int N = rows();
+  if (M == 1) {
+    parallel_for(N, SparseRowsDot<Dtype>(&row_offsets_[0],
+        columns_.empty() ? NULL : &columns_[0],
+        values_.empty() ? NULL : &values_[0], B, C),
+        parallel_grain(nonzeros() / std::max(N, 1) + 1));
+    return;
+  }
+  // C^T = W B^T, by MultiplyDense over the transposed B.
+  transposed_input_.resize(cols * M);
+  transposed_output_.resize(N * M);
+  for (int m = 0; m < M; ++m) {
+    for (int c = 0; c < cols; ++c) {
+      transposed_input_[c * M + m] = B[m * cols + c];
+    }
+  }
+  MultiplyDense(0, N, M, &transposed_input_[0], &transposed_output_[0]);
+  for (int m = 0; m < M; ++m) {
+    for (int r = 0; r < N; ++r) {
+      C[m * N + r] = transposed_output_[r * M + m];
+    }
+  }
+}
+
+INSTANTIATE_CLASS(SparseWeights);
+
+// The products of a sparse A with a dense B are split over the rows of B,
+// each a dense vector whose entries at the nonzeros of A are gathered (or
+// scattered), so the threads never write the same memory.
+
+template <typename Dtype>
+class CSRMultiplyDenseTransposed {
+ public:
+  CSRMultiplyDenseTransposed(const int rows, const int N, const int cols,
+      const int* row_offsets, const int* columns, const Dtype* values,
+      const Dtype* B, Dtype* C)
+      : rows_(rows), N_(N), cols_(cols), row_offsets_(row_offsets),
+        columns_(columns), values_(values), B_(B), C_(C) {}
+
+  void operator()(const int begin, const int end) const {
+    for (int r = 0; r < rows_; ++r) {
+      for (int n = begin; n < end; ++n) {
+        const Dtype* b = B_ + n * cols_;
+        Dtype sum = 0;
+        for (int i = row_offsets_[r]; i < row_offsets_[r + 1]; ++i) {
+          sum += values_[i] * b[columns_[i]];
+        }
+        C_[r * N_ + n] = sum;
+      }
+    }
+  }
+
+ private:
+  const int rows_, N_, cols_;
+  const int* row_offsets_;
+  const int* columns_;
+  const Dtype* values_;
+  const Dtype* B_;
+  Dtype* C_;
+};
+
+template <typename Dtype>
+void caffe_cpu_csrmm_nt(const int rows, const int N, const int cols,
+    const int* row_offsets, const int* columns, const Dtype* values,
+    const Dtype* B, Dtype* C) {
+  parallel_for(N, CSRMultiplyDenseTransposed<Dtype>(rows, N, cols,
+      row_offsets, columns, values, B, C),
+      parallel_grain(row_offsets[rows] - row_offsets[0]));
+}
+
+template void caffe_cpu_csrmm_nt<float>(const int rows, const int N,
+    const int cols, const int* row_offsets, const int* columns,
+    const float* values, const float* B, float* C);
+template void caffe_cpu_csrmm_nt<double>(const int rows, const int N,
+    const int cols, const int* row_offsets, const int* columns,
+    const double* values, const double* B, double* C);
+
+template <typename Dtype>
+class CSRTransposedMultiplyAdd {
+ public:
+  CSRTransposedMultiplyAdd(const int rows, const int N, const int cols,
+      const int* row_offsets, const int* columns, const Dtype* values,
+      const Dtype* D, Dtype* C)
+      : rows_(rows), N_(N), cols_(cols), row_offsets_(row_offsets),
+        columns_(columns), values_(values), D_(D), C_(C) {}
+
+  void operator()(const int begin, const int end) const {
+    for (int r = 0; r < rows_; ++r) {
+      for (int n = begin; n < end; ++n) {
+        const Dtype d = D_[r * N_ + n];
+        if (d == 0) {
+          continue;
+        }
+        Dtype* c = C_ + n * cols_;
+        for (int i = row_offsets_[r]; i < row_offsets_[r + 1]; ++i) {
+          c[columns_[i]] += d * values_[i];
+        }
+      }
+    }
+  }
+
+ private:
+  const int rows_, N_, cols_;
+  const int* row_offsets_;
+  const int* columns_;
+  const Dtype* values_;
+  const Dtype* D_;
+  Dtype* C_;
+};
+
+template <typename Dtype>
+void caffe_cpu_csrmm_tn(const int rows, const int N, const int cols,
+    const int* row_offsets, const int* columns, const Dtype* values,
+    const Dtype* D, Dtype* C) {
+  parallel_for(N, CSRTransposedMultiplyAdd<Dtype>(rows, N, cols,
+      row_offsets, columns, values, D, C),
+      parallel_grain(row_offsets[rows] - row_offsets[0]));
+}
+
+template void caffe_cpu_csrmm_tn<float>(const int rows, const int N,
+    const int cols, const int* row_offsets, const int* columns,
+    const float* values, const float* D, float* C);
+template void caffe_cpu_csrmm_tn<double>(const int rows, const int N,
+    const int cols, const int* row_offsets, const int* columns,
+    const double* values, const double* D, double* C);
+
+// The entries of D B at the nonzeros of A are split over the rows of A
+// instead, as each is a dot product of a row of D with a column of B.
+template <typename Dtype>
+class CSRSampledDenseProduct {
+ public:
+  CSRSampledDenseProduct(const int N, const int cols,
+      const int* row_offsets, const int* columns, const Dtype* D,
+      const Dtype* B, Dtype* x)
+      : N_(N), cols_(cols), row_offsets_(row_offsets), columns_(columns),
+        D_(D), B_(B), x_(x) {}
+
+  void operator()(const int begin, const int end) const {
+    for (int r = begin; r < end; ++r) {
+      const Dtype* d = D_ + r * N_;
+      for (int i = row_offsets_[r]; i < row_offsets_[r + 1]; ++i) {
+        const Dtype* b = B_ + columns_[i];
+        Dtype sum = 0;
+        for (int n = 0; n < N_; ++n) {
+          sum += d[n] * b[n * cols_];
+        }
+        x_[i] = sum;
+      }
+    }
+  }
+
+ private:
+  const int N_, cols_;
+  const int* row_offsets_;
+  const int* columns_;
+  const Dtype* D_;
+  const Dtype* B_;
+  Dtype* x_;
+};
+
+template <typename Dtype>
+void caffe_cpu_csr_sddmm(const int rows, const int N, const int cols,
+    const int* row_offsets, const int* columns, const Dtype* D,
+    const Dtype* B, Dtype* x) {
+  const int nonzeros = row_offsets[rows] - row_offsets[0];
+  parallel_for(rows, CSRSampledDenseProduct<Dtype>(N, cols, row_offsets,
+      columns, D, B, x),
+      parallel_grain(rows > 0 ? nonzeros / rows * N : 0));
+}
+
+template void caffe_cpu_csr_sddmm<float>(const int rows, const int N,
+    const int cols, const int* row_offsets, const int* columns,
+    const float* D, const float* B, float* x);
+template void caffe_cpu_csr_sddmm<double>(const int rows, const int N,
+    const int cols, const int* row_offsets, const int* columns,
+    const double* D, const double* B, double* x);
+
+}  // namespace caffe
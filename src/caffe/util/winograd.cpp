@@ -0,0 +1,322 @@
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/winograd.hpp"
+
+namespace caffe {
+
+// The transform matrices B^T, G and A^T of F(2x2, 3x3) and F(4x4, 3x3).
+static const double kInputTransform2[] = {
+  1,  0, -1,  0,
+  0,  1,  1,  0,
+  0, -1,  1,  0,
+  0,  1,  0, -1
+};
+static const double kFilterTransform2[] = {
+  1,    0,   0,
+  0.5,  0.5, 0.5,
+  0.5, -0.5, 0.5,
+  0,    0,   1
+};
+static const double kOutputTransform2[] = {
+  1, 1,  1,  0,
+  0, 1, -1, -1
+};
+static const double kInputTransform4[] = {
+  4,  0, -5,  0, 1, 0,
+  0, -4, -4,  1, 1, 0,
+  0,  4, -4, -1, 1, 0,
+  0, -2, -1,  2, 1, 0,
+  0,  2, -1, -2, 1, 0,
+  0,  4,  0, -5, 0, 1
+};
+static const double kFilterTransform4[] = {
+  1. / 4,   0,        0,
+  -1. / 6,  -1. / 6,  -1. / 6,
+  -1. / 6,  1. / 6,   -1. / 6,
+  1. / 24,  1. / 12,  1. / 6,
+  1. / 24,  -1. / 12, 1. / 6,
+  0,        0,        1
+};
+static const double kOutputTransform4[] = {
+  1, 1,  1, 1,  1, 0,
+  0, 1, -1, 2, -2, 0,
+  0, 1,  1, 4,  4, 0,
+  0, 1, -1, 8, -8, 1
+};
+
+// The transform matrices of a tile size in Dtype, and their transposes for
+// the backward transforms.
+template <typename Dtype>
+class WinogradTransform {
+ public:
+  explicit WinogradTransform(const int tile) : tile_(tile), alpha_(tile + 2) {
+    const double* input = tile == 2 ? kInputTransform2 : kInputTransform4;
+    const double* filter = tile == 2 ? kFilterTransform2 : kFilterTransform4;
+    const double* output = tile == 2 ? kOutputTransform2 : kOutputTransform4;
+    Transpose(input, alpha_, alpha_, input_, input_t_);
+    Transpose(filter, alpha_, 3, filter_, filter_t_);
+    Transpose(output, tile_, alpha_, output_, output_t_);
+  }
+  inline int tile() const { return tile_; }
+  inline int alpha() const { return alpha_; }
+  inline const Dtype* input() const { return input_; }
+  inline const Dtype* filter() const { return filter_; }
+  inline const Dtype* output() const { return output_; }
+  inline const Dtype* input_t() const { return input_t_; }
+  inline const Dtype* filter_t() const { return filter_t_; }
+  inline const Dtype* output_t() const { return output_t_; }
+
+ private:
+  // Copies the rows x cols matrix L and its transpose.
+  static void Transpose(const double* L, const int rows, const int cols,
+      Dtype* copy, Dtype* transposed) {
+    for (int i = 0; i < rows; ++i) {
+      for (int j = 0; j < cols; ++j) {
+        copy[i * cols + j] = L[i * cols + j];
+        transposed[j * rows + i] = L[i * cols + j];
+      }
+    }
+  }
+
+  int tile_;
+  int alpha_;
+  Dtype input_[6 * 6];
+  Dtype filter_[6 * 3];
+  Dtype output_[4 * 6];
+  Dtype input_t_[6 * 6];
+  Dtype filter_t_[3 * 6];
+  Dtype output_t_[6 * 4];
+};
+
+// The transforms of a tile size, built once.
+template <typename Dtype>
+static const WinogradTransform<Dtype>& winograd_transform(const int tile) {
+  CHECK(tile == 2 || tile == 4) << "Winograd tile size must be 2 or 4.";
+  static const WinogradTransform<Dtype> transform2(2);
+  static const WinogradTransform<Dtype> transform4(4);
+  return tile == 2 ? transform2 : transform4;
+}
+
+// Computes Y = L X L^T, for the n x n Y, the k x k X and the n x k matrix L.
+// The backward transforms pass the transposes of the forward matrices.
+template <typename Dtype>
+static void transform(const Dtype* L, const int n, const int k,
+    const Dtype* X, Dtype* Y) {
+  Dtype LX[6 * 6];
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < k; ++j) {
+      Dtype sum = 0;
+      for (int l = 0; l < k; ++l) {
+        sum += L[i * k + l] * X[l * k + j];
+      }
+      LX[i * k + j] = sum;
+    }
+  }
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      Dtype sum = 0;
+      for (int l = 0; l < k; ++l) {
+        sum += LX[i * k + l] * L[j * k + l];
+      }
+      Y[i * n + j] = sum;
+    }
+  }
+}
+
+template <typename Dtype>
+void winograd_input_transform_cpu(const int tile, const Dtype* data_im,
+    const int channels, const int height, const int width, const int pad_h,
+    const int pad_w, const int tiles_h, const int tiles_w, Dtype* data_tile) {
+  const WinogradTransform<Dtype>& transforms =
+      winograd_transform<Dtype>(tile);
+  const int alpha = transforms.alpha();
+  const int tiles = tiles_h * tiles_w;
+  Dtype d[6 * 6], v[6 * 6];
+  for (int c = 0; c < channels; ++c) {
+    const Dtype* im = data_im + c * height * width;
+    for (int p = 0; p < tiles; ++p) {
+      const int h_start = (p / tiles_w) * tile - pad_h;
+      const int w_start = (p % tiles_w) * tile - pad_w;
+      for (int i = 0; i < alpha; ++i) {
+        const int h = h_start + i;
+        for (int j = 0; j < alpha; ++j) {
+          const int w = w_start + j;
+          d[i * alpha + j] = (h >= 0 && h < height && w >= 0 && w < width) ?
+              im[h * width + w] : Dtype(0);
+        }
+      }
+      transform(transforms.input(), alpha, alpha, d, v);
+      for (int x = 0; x < alpha * alpha; ++x) {
+        data_tile[(x * channels + c) * tiles + p] = v[x];
+      }
+    }
+  }
+}
+
+template void winograd_input_transform_cpu<float>(const int tile,
+    const float* data_im, const int channels, const int height,
+    const int width, const int pad_h, const int pad_w, const int tiles_h,
+    const int tiles_w, float* data_tile);
+template void winograd_input_transform_cpu<double>(const int tile,
+    const double* data_im, const int channels, const int height,
+    const int width, const int pad_h, const int pad_w, const int tiles_h,
+    const int tiles_w, double* data_tile);
+
+template <typename Dtype>
+void winograd_input_transform_backward_cpu(const int tile,
+    const Dtype* data_tile, const int channels, const int height,
+    const int width, const int pad_h, const int pad_w, const int tiles_h,
+    const int tiles_w, Dtype* data_im) {
+  const WinogradTransform<Dtype>& transforms =
+      winograd_transform<Dtype>(tile);
+  const int alpha = transforms.alpha();
+  const int tiles = tiles_h * tiles_w;
+  Dtype d[6 * 6], v[6 * 6];
+  caffe_set(channels * height * width, Dtype(0), data_im);
+  for (int c = 0; c < channels; ++c) {
+    Dtype* im = data_im + c * height * width;
+    for (int p = 0; p < tiles; ++p) {
+      for (int x = 0; x < alpha * alpha; ++x) {
+        v[x] = data_tile[(x * channels + c) * tiles + p];
+      }
+      transform(transforms.input_t(), alpha, alpha, v, d);
+      // The input tiles overlap, so their gradients add up.
+      const int h_start = (p / tiles_w) * tile - pad_h;
+      const int w_start = (p % tiles_w) * tile - pad_w;
+      for (int i = 0; i < alpha; ++i) {
+        const int h = h_start + i;
+        if (h < 0 || h >= height) { continue; }
+        for (int j = 0; j < alpha; ++j) {
+          const int w = w_start + j;
+          if (w >= 0 && w < width) {
+            im[h * width + w] += d[i * alpha + j];
+          }
+        }
+      }
+    }
+  }
+}
+
+template void winograd_input_transform_backward_cpu<float>(const int tile,
+    const float* data_tile, const int channels, const int height,
+    const int width, const int pad_h, const int pad_w, const int tiles_h,
+    const int tiles_w, float* data_im);
+template void winograd_input_transform_backward_cpu<double>(const int tile,
+    const double* data_tile, const int channels, const int height,
+    const int width, const int pad_h, const int pad_w, const int tiles_h,
+    const int tiles_w, double* data_im);
+
+template <typename Dtype>
+void winograd_filter_transform_cpu(const int tile, const Dtype* weights,
+    const int num, Dtype* filter_tile) {
+  const WinogradTransform<Dtype>& transforms =
+      winograd_transform<Dtype>(tile);
+  const int alpha = transforms.alpha();
+  Dtype u[6 * 6];
+  for (int f = 0; f < num; ++f) {
+    transform(transforms.filter(), alpha, 3, weights + f * 9, u);
+    for (int x = 0; x < alpha * alpha; ++x) {
+      filter_tile[x * num + f] = u[x];
+    }
+  }
+}
+
+template void winograd_filter_transform_cpu<float>(const int tile,
+    const float* weights, const int num, float* filter_tile);
+template void winograd_filter_transform_cpu<double>(const int tile,
+    const double* weights, const int num, double* filter_tile);
+
+template <typename Dtype>
+void winograd_filter_transform_backward_cpu(const int tile,
+    const Dtype* filter_tile, const int num, Dtype* weights) {
+  const WinogradTransform<Dtype>& transforms =
+      winograd_transform<Dtype>(tile);
+  const int alpha = transforms.alpha();
+  Dtype u[6 * 6], g[3 * 3];
+  for (int f = 0; f < num; ++f) {
+    for (int x = 0; x < alpha * alpha; ++x) {
+      u[x] = filter_tile[x * num + f];
+    }
+    transform(transforms.filter_t(), 3, alpha, u, g);
+    for (int x = 0; x < 9; ++x) {
+      weights[f * 9 + x] += g[x];
+    }
+  }
+}
+
+template void winograd_filter_transform_backward_cpu<float>(const int tile,
+    const float* filter_tile, const int num, float* weights);
+template void winograd_filter_transform_backward_cpu<double>(const int tile,
+    const double* filter_tile, const int num, double* weights);
+
+template <typename Dtype>
+void winograd_output_transform_cpu(const int tile, const Dtype* data_tile,
+    const int channels, const int height, const int width, const int tiles_h,
+    const int tiles_w, Dtype* data_im) {
+  const WinogradTransform<Dtype>& transforms =
+      winograd_transform<Dtype>(tile);
+  const int alpha = transforms.alpha();
+  const int tiles = tiles_h * tiles_w;
+  Dtype m[6 * 6], y[4 * 4];
+  for (int c = 0; c < channels; ++c) {
+    Dtype* im = data_im + c * height * width;
+    for (int p = 0; p < tiles; ++p) {
+      for (int x = 0; x < alpha * alpha; ++x) {
+        m[x] = data_tile[(x * channels + c) * tiles + p];
+      }
+      transform(transforms.output(), tile, alpha, m, y);
+      const int h_start = (p / tiles_w) * tile;
+      const int w_start = (p % tiles_w) * tile;
+      for (int i = 0; i < tile && h_start + i < height; ++i) {
+        for (int j = 0; j < tile && w_start + j < width; ++j) {
+          im[(h_start + i) * width + w_start + j] = y[i * tile + j];
+        }
+      }
+    }
+  }
+}
+
+template void winograd_output_transform_cpu<float>(const int tile,
+    const float* data_tile, const int channels, const int height,
+    const int width, const int tiles_h, const int tiles_w, float* data_im);
+template void winograd_output_transform_cpu<double>(const int tile,
+    const double* data_tile, const int channels, const int height,
+    const int width, const int tiles_h, const int tiles_w, double* data_im);
+
+template <typename Dtype>
+void winograd_output_transform_backward_cpu(const int tile,
+    const Dtype* data_im, const int channels, const int height,
+    const int width, const int tiles_h, const int tiles_w, Dtype* data_tile) {
+  const WinogradTransform<Dtype>& transforms =
+      winograd_transform<Dtype>(tile);
+  const int alpha = transforms.alpha();
+  const int tiles = tiles_h * tiles_w;
+  Dtype m[6 * 6], y[4 * 4];
+  for (int c = 0; c < channels; ++c) {
+    const Dtype* im = data_im + c * height * width;
+    for (int p = 0; p < tiles; ++p) {
+      // The outputs cropped away have no gradient.
+      const int h_start = (p / tiles_w) * tile;
+      const int w_start = (p % tiles_w) * tile;
+      for (int i = 0; i < tile; ++i) {
+        for (int j = 0; j < tile; ++j) {
+          y[i * tile + j] = (h_start + i < height && w_start + j < width) ?
+              im[(h_start + i) * width + w_start + j] : Dtype(0);
+        }
+      }
+      transform(transforms.output_t(), alpha, tile, y, m);
+      for (int x = 0; x < alpha * alpha; ++x) {
+        data_tile[(x * channels + c) * tiles + p] = m[x];
+      }
+    }
+  }
+}
+
+template void winograd_output_transform_backward_cpu<float>(const int tile,
+    const float* data_im, const int channels, const int height,
+    const int width, const int tiles_h, const int tiles_w, float* data_tile);
+template void winograd_output_transform_backward_cpu<double>(const int tile,
+    const double* data_im, const int channels, const int height,
+    const int width, const int tiles_h, const int tiles_w, double* data_tile);
+
+}  // namespace caffe
@@ -13,7 +13,9 @@ namespace bp = boost::python;
 
 #include "boost/algorithm/string.hpp"
 #include "caffe/caffe.hpp"
+#include "caffe/util/conv_autotune.hpp"
 #include "caffe/util/signal_handler.h"
+#include "caffe/util/sparse.hpp"
 
 using caffe::Blob;
 using caffe::Caffe;
@@ -41,6 +43,18 @@ DEFINE_string(weights, "",
     "separated by ','. Cannot be set simultaneously with snapshot.");
 DEFINE_int32(iterations, 50,
     "The number of iterations to run.");
+DEFINE_string(param_storage, "",
+    "Optional; the precision in which test and time store the weights: "
+    "FP16 or BF16. Makes time benchmark the forward pass of the TEST phase.");
+DEFINE_string(conv_algorithm, "",
+    "Optional; the algorithm with which test and time run the convolution "
+    "layers which do not set their own, e.g. AUTOTUNE.");
+DEFINE_string(conv_autotune_cache, "",
+    "Optional; the file caching the CPU convolution algorithms selected by "
+    "the AUTOTUNE algorithm across runs.");
+DEFINE_int32(threads, 0,
+    "Optional; the number of CPU threads of the layers and of BLAS. "
+    "All the cores, or OMP_NUM_THREADS, by default.");
 DEFINE_string(sigint_effect, "stop",
              "Optional; action to take when a SIGINT signal is received: "
               "snapshot, stop or none.");
@@ -48,6 +62,26 @@ DEFINE_string(sighup_effect, "snapshot",
              "Optional; action to take when a SIGHUP signal is received: "
              "snapshot, stop or none.");
 
+// Parse the precision given by --param_storage, NATIVE if unset.
+caffe::StoragePrecision get_param_storage() {
+  caffe::StoragePrecision precision = caffe::NATIVE;
+  if (FLAGS_param_storage.size()) {
+    CHECK(caffe::StoragePrecision_Parse(FLAGS_param_storage, &precision))
+        << "Unknown param_storage: " << FLAGS_param_storage;
+  }
+  return precision;
+}
+
+// Set the convolution algorithm given by --conv_algorithm, if any.
+void set_conv_algorithm(caffe::NetParameter* net_param) {
+  if (FLAGS_conv_algorithm.size()) {
+    caffe::ConvolutionParameter::Algorithm algorithm;
+    CHECK(caffe::ConvolutionParameter::Algorithm_Parse(FLAGS_conv_algorithm,
+        &algorithm)) << "Unknown conv_algorithm: " << FLAGS_conv_algorithm;
+    net_param->set_conv_algorithm(algorithm);
+  }
+}
+
 // A simple registry for caffe commands.
 typedef int (*BrewFunction)();
 typedef std::map<caffe::string, BrewFunction> BrewMap;
@@ -159,6 +193,8 @@ int train() {
 
   caffe::SolverParameter solver_param;
   caffe::ReadSolverParamsFromTextFileOrDie(FLAGS_solver, &solver_param);
+  // Skip the fillers of the weights restored or finetuned from.
+  solver_param.set_defer_fill(FLAGS_snapshot.size() || FLAGS_weights.size());
 
   // If the gpus flag is not provided, allow the mode and device to be set
   // in the solver prototxt.
@@ -211,6 +247,8 @@ int train() {
   } else if (FLAGS_weights.size()) {
     CopyLayers(solver.get(), FLAGS_weights);
   }
+  // Fill the rest now, before the weights are synchronized across GPUs.
+  solver->net()->FillDeferredParams();
 
   if (gpus.size() > 1) {
     caffe::P2PSync<float> sync(solver, NULL, solver->param());
@@ -247,7 +285,14 @@ int test() {
     Caffe::set_mode(Caffe::CPU);
   }
   // Instantiate the caffe net.
-  Net<float> caffe_net(FLAGS_model, caffe::TEST);
+  caffe::NetParameter net_param;
+  caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &net_param);
+  net_param.mutable_state()->set_phase(caffe::TEST);
+  // Skip the fillers of the weights loaded right after.
+  net_param.set_defer_fill(true);
+  net_param.set_param_storage(get_param_storage());
+  set_conv_algorithm(&net_param);
+  Net<float> caffe_net(net_param);
   caffe_net.CopyTrainedLayersFrom(FLAGS_weights);
   LOG(INFO) << "Running for " << FLAGS_iterations << " iterations.";
 
@@ -313,8 +358,15 @@ int time() {
     LOG(INFO) << "Use CPU.";
     Caffe::set_mode(Caffe::CPU);
   }
-  // Instantiate the caffe net.
-  Net<float> caffe_net(FLAGS_model, caffe::TRAIN);
+  // Instantiate the caffe net; packed weights are only kept by TEST nets,
+  // which are timed without their backward pass.
+  caffe::NetParameter net_param;
+  caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &net_param);
+  const bool backward = FLAGS_param_storage.empty();
+  net_param.mutable_state()->set_phase(backward ? caffe::TRAIN : caffe::TEST);
+  net_param.set_param_storage(get_param_storage());
+  set_conv_algorithm(&net_param);
+  Net<float> caffe_net(net_param);
 
   // Do a clean forward and backward pass, so that memory allocation are done
   // and future iterations will be more stable.
@@ -324,8 +376,10 @@ int time() {
   float initial_loss;
   caffe_net.Forward(vector<Blob<float>*>(), &initial_loss);
   LOG(INFO) << "Initial loss: " << initial_loss;
-  LOG(INFO) << "Performing Backward";
-  caffe_net.Backward();
+  if (backward) {
+    LOG(INFO) << "Performing Backward";
+    caffe_net.Backward();
+  }
 
   const vector<shared_ptr<Layer<float> > >& layers = caffe_net.layers();
   const vector<vector<Blob<float>*> >& bottom_vecs = caffe_net.bottom_vecs();
@@ -354,7 +408,7 @@ int time() {
     }
     forward_time += forward_timer.MicroSeconds();
     backward_timer.Start();
-    for (int i = layers.size() - 1; i >= 0; --i) {
+    for (int i = layers.size() - 1; backward && i >= 0; --i) {
       timer.Start();
       layers[i]->Backward(top_vecs[i], bottom_need_backward[i],
                           bottom_vecs[i]);
@@ -387,6 +441,93 @@ int time() {
 }
 RegisterBrewFunction(time);
 
+// Sets the sparse_weight_threshold of the Convolution and InnerProduct layers
+// to threshold, keeping their previous thresholds by name if given.
+static void set_sparse_weight_threshold(const float threshold,
+    caffe::NetParameter* net_param,
+    std::map<caffe::string, float>* thresholds = NULL) {
+  for (int i = 0; i < net_param->layer_size(); ++i) {
+    caffe::LayerParameter* layer_param = net_param->mutable_layer(i);
+    float previous;
+    if (layer_param->type() == "Convolution") {
+      previous = layer_param->convolution_param().sparse_weight_threshold();
+      layer_param->mutable_convolution_param()->set_sparse_weight_threshold(
+          threshold);
+    } else if (layer_param->type() == "InnerProduct") {
+      previous = layer_param->inner_product_param().sparse_weight_threshold();
+      layer_param->mutable_inner_product_param()->set_sparse_weight_threshold(
+          threshold);
+    } else {
+      continue;
+    }
+    if (thresholds) {
+      (*thresholds)[layer_param->name()] = previous;
+    }
+  }
+}
+
+// Sparsity: report the fraction of zero weights of each Convolution and
+// InnerProduct layer, and the speedup of their CPU forward pass with the
+// weights multiplied in sparse rather than dense form.
+int sparsity() {
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to analyze.";
+  LOG(INFO) << "Use CPU.";
+  Caffe::set_mode(Caffe::CPU);
+  caffe::NetParameter net_param;
+  caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &net_param);
+  net_param.mutable_state()->set_phase(caffe::TEST);
+  // The same model, with the sparse form never and always used.
+  std::map<caffe::string, float> thresholds;
+  caffe::NetParameter dense_param(net_param);
+  set_sparse_weight_threshold(2, &dense_param, &thresholds);
+  caffe::NetParameter sparse_param(net_param);
+  set_sparse_weight_threshold(0, &sparse_param);
+  Net<float> dense_net(dense_param);
+  Net<float> sparse_net(sparse_param);
+  if (FLAGS_weights.size()) {
+    dense_net.CopyTrainedLayersFrom(FLAGS_weights);
+    sparse_net.CopyTrainedLayersFrom(FLAGS_weights);
+  }
+  // A clean forward pass allocates the memory and compresses the weights.
+  dense_net.ForwardPrefilled();
+  sparse_net.ForwardPrefilled();
+
+  LOG(INFO) << "*** Sparsity analysis begins ***";
+  LOG(INFO) << "Timing for " << FLAGS_iterations << " iterations.";
+  Timer timer;
+  for (int i = 0; i < dense_net.layers().size(); ++i) {
+    const caffe::LayerParameter& layer_param =
+        dense_net.layers()[i]->layer_param();
+    if (layer_param.type() != "Convolution" &&
+        layer_param.type() != "InnerProduct") {
+      continue;
+    }
+    const Blob<float>& weights = *dense_net.layers()[i]->blobs()[0];
+    const double sparsity = caffe::caffe_cpu_sparsity(weights.count(),
+        weights.cpu_data());
+    double forward_time[2];
+    Net<float>* nets[2] = { &dense_net, &sparse_net };
+    for (int k = 0; k < 2; ++k) {
+      Layer<float>* layer = nets[k]->layers()[i].get();
+      const vector<Blob<float>*>& bottom = nets[k]->bottom_vecs()[i];
+      const vector<Blob<float>*>& top = nets[k]->top_vecs()[i];
+      timer.Start();
+      for (int j = 0; j < FLAGS_iterations; ++j) {
+        layer->Forward(bottom, top);
+      }
+      forward_time[k] = timer.MilliSeconds() / FLAGS_iterations;
+    }
+    LOG(INFO) << std::setfill(' ') << std::setw(10) << layer_param.name()
+        << "\tsparsity: " << 100 * sparsity << "%\tdense: " << forward_time[0]
+        << " ms.\tsparse: " << forward_time[1] << " ms.\tspeedup: "
+        << forward_time[0] / forward_time[1] << "x"
+        << (sparsity >= thresholds[layer_param.name()] ? " (used)" : "");
+  }
+  LOG(INFO) << "*** Sparsity analysis ends ***";
+  return 0;
+}
+RegisterBrewFunction(sparsity);
+
 int main(int argc, char** argv) {
   // Print output to stderr (while still logging).
   FLAGS_alsologtostderr = 1;
@@ -399,9 +540,15 @@ int main(int argc, char** argv) {
       "  train           train or finetune a model\n"
       "  test            score a model\n"
       "  device_query    show GPU diagnostic information\n"
-      "  time            benchmark model execution time");
+      "  time            benchmark model execution time\n"
+      "  sparsity        report the weight sparsity of a model and the\n"
+      "                  speedup of its sparse execution");
   // Run tool or show usage.
   caffe::GlobalInit(&argc, &argv);
+  caffe::ConvAutotuneCache::set_path(FLAGS_conv_autotune_cache);
+  if (FLAGS_threads > 0) {
+    Caffe::set_num_threads(FLAGS_threads);
+  }
   if (argc == 2) {
 #ifdef WITH_PYTHON_LAYER
     try {
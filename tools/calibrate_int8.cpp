@@ -0,0 +1,81 @@
+// This is a script to calibrate a net for the INT8 engines. It runs the net,
+// which must read its own samples (e.g., with a Data layer over an LMDB), and
+// records the largest absolute value of the bottom of each layer. It then
+// writes a copy of the net proto with its Convolution and InnerProduct layers
+// on the INT8 engine, quantizing their bottoms with the recorded ranges.
+// Usage:
+//    calibrate_int8 net_proto_file weights_file num_iterations
+//        net_proto_file_out
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/quantize.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  if (argc != 5) {
+    LOG(ERROR) << "Usage: "
+        << "calibrate_int8 net_proto_file weights_file num_iterations "
+        << "net_proto_file_out";
+    return 1;
+  }
+  const int num_iterations = atoi(argv[3]);
+  CHECK_GT(num_iterations, 0);
+
+  NetParameter net_param;
+  ReadNetParamsFromTextFileOrDie(argv[1], &net_param);
+  net_param.mutable_state()->set_phase(caffe::TEST);
+  NetParameter calibrated_param = net_param;
+  net_param.set_defer_fill(true);
+  Net<float> net(net_param);
+  net.CopyTrainedLayersFrom(argv[2]);
+
+  // The range of the first bottom of each layer, as it runs.
+  const vector<vector<Blob<float>*> >& bottom_vecs = net.bottom_vecs();
+  vector<float> ranges(net.layers().size(), 0);
+  for (int iter = 0; iter < num_iterations; ++iter) {
+    for (int i = 0; i < net.layers().size(); ++i) {
+      if (bottom_vecs[i].size()) {
+        const Blob<float>& bottom = *bottom_vecs[i][0];
+        ranges[i] = std::max(ranges[i],
+            caffe_cpu_amax(bottom.count(), bottom.cpu_data()));
+      }
+      net.ForwardFromTo(i, i);
+    }
+  }
+
+  int num_calibrated = 0;
+  const vector<string>& layer_names = net.layer_names();
+  for (int i = 0; i < calibrated_param.layer_size(); ++i) {
+    LayerParameter* layer_param = calibrated_param.mutable_layer(i);
+    if (layer_param->type() == "Convolution") {
+      layer_param->mutable_convolution_param()->set_engine(
+          ConvolutionParameter_Engine_INT8);
+    } else if (layer_param->type() == "InnerProduct") {
+      layer_param->mutable_inner_product_param()->set_engine(
+          InnerProductParameter_Engine_INT8);
+    } else {
+      continue;
+    }
+    // Layers of other phases or stages keep dynamic ranges.
+    const int layer_id = std::find(layer_names.begin(), layer_names.end(),
+        layer_param->name()) - layer_names.begin();
+    if (layer_id == layer_names.size()) { continue; }
+    layer_param->mutable_quantization_param()->set_bottom_range(
+        ranges[layer_id]);
+    LOG(ERROR) << layer_param->name() << ": " << layer_param->bottom(0)
+        << " in [" << -ranges[layer_id] << ", " << ranges[layer_id] << "]";
+    ++num_calibrated;
+  }
+  WriteProtoToTextFile(calibrated_param, argv[4]);
+
+  LOG(ERROR) << "Calibrated " << num_calibrated << " layers over "
+      << num_iterations << " iterations into " << argv[4];
+  return 0;
+}
@@ -0,0 +1,31 @@
+// This is a script to convert trained weights to the flat format, which nets
+// load by mapping the file rather than copying the weights.
+// Usage:
+//    convert_model_to_flat net_proto_file weights_file_in flat_file_out
+
+#include <string>
+
+#include "caffe/caffe.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  if (argc != 4) {
+    LOG(ERROR) << "Usage: "
+        << "convert_model_to_flat net_proto_file weights_file_in "
+        << "flat_file_out";
+    return 1;
+  }
+
+  NetParameter net_param;
+  ReadNetParamsFromTextFileOrDie(argv[1], &net_param);
+  net_param.mutable_state()->set_phase(caffe::TEST);
+  net_param.set_defer_fill(true);
+  Net<float> net(net_param);
+  net.CopyTrainedLayersFrom(argv[2]);
+  net.ToFlat(argv[3]);
+
+  LOG(ERROR) << "Wrote flat weights to " << argv[3];
+  return 0;
+}